@@ -101,7 +101,7 @@ namespace ANML
     check_runtime_error(m_context != NULL,"ANMLTranslator context can't be NULL");
   }      
 
-  void ANMLTranslator::toNDDL(std::vector<ANML::ANMLElement*>& program, std::ostream& os) const
+  bool ANMLTranslator::prepare(std::vector<ANML::ANMLElement*>& program) const
   {
     for (unsigned int i=0; i<program.size(); i++) 
       program[i]->preProcess(*m_context);
@@ -110,7 +110,19 @@ namespace ANML
     for (unsigned int i=0; i<program.size(); i++) 
       program[i]->validate(*m_context,problems);
 
-    if (problems.size() == 0) {    	        	
+    if (problems.size() > 0) {
+      // TODO: Return problems instead
+      std::cerr << "Validation ERRORS translating into NDDL:" << std::endl;
+      for (unsigned int i=0; i<problems.size(); i++) 
+        std::cerr << problems[i] << std::endl;        	
+    } 	            
+
+    return problems.size() == 0;
+  }
+
+  void ANMLTranslator::toNDDL(std::vector<ANML::ANMLElement*>& program, std::ostream& os) const
+  {
+    if (prepare(program)) {    	        	
       // TODO: make this optional
       os << "#include \"Plasma.nddl\"" << std::endl;
       os << "#include \"PlannerConfig.nddl\"" << std::endl;
@@ -123,12 +135,25 @@ namespace ANML
       for (unsigned int i=0; i<program.size(); i++) 
         program[i]->toNDDL(*m_context,os);
     }   
-    else {
-      // TODO: Return problems instead
-      std::cerr << "Validation ERRORS translating into NDDL:" << std::endl;
-      for (unsigned int i=0; i<problems.size(); i++) 
-        std::cerr << problems[i] << std::endl;        	
-    } 	            
+  }
+
+  void ANMLTranslator::toSchema(std::vector<ANML::ANMLElement*>& program, SchemaBuilder& builder, std::ostream& os) const
+  {
+    if (prepare(program)) {
+      builder.include("Plasma.nddl");
+      builder.include("PlannerConfig.nddl");
+
+      std::vector<std::string> noParams;
+      builder.beginClass("Decomposition","Object");
+      builder.addPredicate("execute",noParams,noParams);
+      builder.endClass();
+      os << "Decomposition decomposition = new Decomposition();" << std::endl << std::endl;
+
+      m_plannerConfig->toNDDL(*m_context,os);
+
+      for (unsigned int i=0; i<program.size(); i++) 
+        program[i]->toSchema(*m_context,builder,os);
+    }
   }
 
   std::string ANMLTranslator::toString() const
@@ -331,6 +356,12 @@ namespace ANML
       m_elements[i]->toNDDL(context,os);
   }
 
+  void ANMLElementList::toSchema(ANMLContext& context,SchemaBuilder& builder,std::ostream& os) const
+  {
+    for (unsigned int i=0;i<m_elements.size();i++)
+      m_elements[i]->toSchema(context,builder,os);
+  }
+
   std::string defaultValueSetterName="setValue";
 
   std::string makeValueSetterName(int idx)
@@ -482,6 +513,11 @@ namespace ANML
     os << "typedef " << m_wrappedType.getName() << " " << m_typeName << ";" << std::endl; 
   }    
 
+  void TypeAlias::toSchema(ANMLContext& context, SchemaBuilder& builder, std::ostream& os) const 
+  { 
+    builder.defineAlias(m_typeName,m_wrappedType.getName());
+  }    
+
   Range::Range(const std::string& name,const Type& dataType,const std::string& lb,const std::string& ub)	
       : Type(name!="" ? name : autoIdentifier("Range")),
         m_isResourceType(false),
@@ -525,6 +561,23 @@ namespace ANML
     }      
   }
 
+  void Range::toSchema(ANMLContext& context, SchemaBuilder& builder, std::ostream& os) const
+  {
+    if (m_isResourceType) {
+      std::vector<std::string> superArgs;
+      superArgs.push_back(m_ub);
+      superArgs.push_back(m_lb);
+      std::vector<std::string> noMembers;
+
+      builder.beginClass(getName(),"Reusable");
+      builder.addConstructor(superArgs,noMembers,noMembers);
+      builder.endClass();
+    }
+    else {
+      builder.defineRange(getName(),m_dataType.getName(),m_lb,m_ub);
+    }      
+  }
+
   Enumeration::Enumeration(const std::string& name,const Type& dataType,const std::vector<Expr*>& values)
     : Type(name!="" ? name : autoIdentifier("Enumeration"))
     , m_dataType(dataType)
@@ -558,6 +611,23 @@ namespace ANML
     Type::toNDDL(context,os);                                
   }
 
+  void Enumeration::toSchema(ANMLContext& context, SchemaBuilder& builder, std::ostream& os) const
+  {
+    std::vector<std::string> values;
+    for (unsigned int i=0;i<m_values.size(); i++) 
+      values.push_back(m_values[i]->toString());
+    builder.defineEnum(getName()+"Enum",values);
+
+    std::vector<std::string> paramTypes(1,getName()+"Enum");
+    std::vector<std::string> paramNames(1,"value");
+    builder.beginClass(getName(),"Timeline");
+    builder.addPredicate("setValue",paramTypes,paramNames);
+    builder.endClass();
+
+    // An empty rule adds nothing, so only the value setter is left
+    Type::toNDDL(context,os);                                
+  }
+
   ObjType::ObjType(const std::string& name,ObjType* parentObjType)
     : Type(name)
       , m_parentObjType(parentObjType)
@@ -582,13 +652,29 @@ namespace ANML
     os << " }" << std::endl;
   }
 
+  void ObjType::declareValueSetters(SchemaBuilder& builder) const
+  {
+    std::vector<std::string> paramTypes;
+    std::vector<std::string> paramNames;
+    std::map<std::string,Variable*>::const_iterator varIt = m_variables.begin();              
+    for (; varIt != m_variables.end() ; ++varIt) {
+      paramTypes.push_back(varIt->second->getDataType().getName());
+      paramNames.push_back(varIt->second->getName());
+    }
+
+    builder.addPredicate("setValue",paramTypes,paramNames);
+  }
+
+  std::string ObjType::getParentName() const
+  {
+    return ((m_parentObjType != NULL && m_parentObjType->getName() != "object") 
+            ? m_parentObjType->getName() 
+            : "");
+  }
+
   void ObjType::toNDDL(ANMLContext& context, std::ostream& os) const
   {
-    std::string parent = (
-                          (m_parentObjType != NULL && m_parentObjType->getName() != "object") 
-                          ? (std::string(" extends ") + m_parentObjType->getName()) 
-                          : ""
-                         );
+    std::string parent = (getParentName() != "" ? " extends " + getParentName() : "");
 
     os << "class " << getName() << parent << std::endl 
       << "{" << std::endl;
@@ -640,6 +726,48 @@ namespace ANML
     Type::toNDDL(context,os); 	     
   }
 
+  void ObjType::toSchema(ANMLContext& context, SchemaBuilder& builder, std::ostream& os) const
+  {
+    builder.beginClass(getName(),(getParentName() != "" ? getParentName() : "Object"));
+
+    std::vector<std::string> allocTypes;
+    std::vector<std::string> allocNames;
+    std::map<std::string,Variable*>::const_iterator varIt = m_variables.begin();              
+    for (; varIt != m_variables.end() ; ++varIt) {
+      Variable* v = varIt->second;
+      builder.addMember(v->getDataType().getName(),v->getName());
+      if (!v->getDataType().isPrimitive()) {
+        allocTypes.push_back(v->getDataType().getName());
+        allocNames.push_back(v->getName());
+      }
+    }
+
+    std::map<std::string,Action*>::const_iterator actIt = m_actions.begin();              
+    for (; actIt != m_actions.end() ; ++actIt) {
+      std::vector<std::string> paramTypes;
+      std::vector<std::string> paramNames;
+      const std::vector<Variable*>& params = actIt->second->getParams();
+      for (unsigned int j=0; j<params.size(); j++) {
+        paramTypes.push_back(params[j]->getDataType().getName());
+        paramNames.push_back(params[j]->getName());
+      }
+      builder.addPredicate(actIt->second->getName(),paramTypes,paramNames);
+    }
+
+    declareValueSetters(builder);
+
+    builder.addConstructor(std::vector<std::string>(),allocTypes,allocNames);
+    builder.endClass();
+
+    // Action bodies are rules, which are still written as NDDL
+    for (unsigned int i=0; i<m_elements.size(); i++) {
+      if (m_elements[i]->getElementType() != "VAR_DECLARATION") 
+        m_elements[i]->toSchema(context,builder,os);
+    }   
+
+    Type::toNDDL(context,os); 	     
+  }
+
   VectorType::VectorType(const std::string& name)
     : ObjType(name,Type::OBJECT)
   {
@@ -687,6 +815,15 @@ namespace ANML
     Type::toNDDL(context,os);                                                         
   }
 
+  void VectorType::toSchema(ANMLContext& context, SchemaBuilder& builder, std::ostream& os) const
+  {
+    builder.beginClass(getName(),"Timeline");
+    declareValueSetters(builder);
+    builder.endClass();
+
+    Type::toNDDL(context,os);                                                         
+  }
+
   Variable::Variable(const Type& dataType, const std::string& name)
       : m_name(name),
         m_objType(NULL),
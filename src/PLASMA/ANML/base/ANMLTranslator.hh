@@ -22,6 +22,7 @@ class LHSExpr;
 class LHSPlannerConfig;
 class Proposition;
 class ObjType;
+class SchemaBuilder;
 class TemporalQualifier;
 class Type;
 class Variable;
@@ -40,6 +41,10 @@ class ANMLTranslator
       virtual LHSPlannerConfig* getPlannerConfig() { return m_plannerConfig; }
             
       virtual void toNDDL(std::vector<ANML::ANMLElement*>& program,std::ostream& os) const;
+
+      // Like toNDDL, but types and classes are handed to builder instead of being written as NDDL.
+      // Only rules, globals and the planner configuration are written to os.
+      virtual void toSchema(std::vector<ANML::ANMLElement*>& program,SchemaBuilder& builder,std::ostream& os) const;
       
 	  virtual std::string toString() const;      
       
@@ -48,6 +53,32 @@ class ANMLTranslator
       LHSPlannerConfig* m_plannerConfig;
       
       ANMLContext* createGlobalContext();          
+
+      // preProcess and validate program, returns false if there were validation problems
+      bool prepare(std::vector<ANML::ANMLElement*>& program) const;
+};
+
+// Receives the types and classes of a translated model, so they can be built without going
+// through NDDL text. Names and literals are as they would appear in the equivalent NDDL.
+class SchemaBuilder
+{
+  public:
+    virtual ~SchemaBuilder() {}
+
+    // Read an NDDL file the translation depends on
+    virtual void include(const std::string& fileName) = 0;
+
+    virtual void defineAlias(const std::string& name,const std::string& dataType) = 0;
+    virtual void defineRange(const std::string& name,const std::string& dataType,const std::string& lb,const std::string& ub) = 0;
+    virtual void defineEnum(const std::string& name,const std::vector<std::string>& values) = 0;
+
+    // Members, predicates and the constructor of a class are added between beginClass and endClass
+    virtual void beginClass(const std::string& name,const std::string& parentName) = 0;
+    virtual void addMember(const std::string& dataType,const std::string& name) = 0;
+    virtual void addPredicate(const std::string& name,const std::vector<std::string>& paramTypes,const std::vector<std::string>& paramNames) = 0;
+    // superArgs are literals for the parent constructor, allocated members are set to a new object of their type
+    virtual void addConstructor(const std::vector<std::string>& superArgs,const std::vector<std::string>& memberTypes,const std::vector<std::string>& memberNames) = 0;
+    virtual void endClass() = 0;
 };
 
 class ANMLContext
@@ -110,6 +141,8 @@ class ANMLElement
     virtual void preProcess (ANMLContext& context) {}
     virtual bool validate   (ANMLContext& context,std::vector<std::string>& problems) { return true; }
     virtual void toNDDL     (ANMLContext& context,std::ostream& os) const;
+    // Hands declarations to builder where it can, writes NDDL for the rest
+    virtual void toSchema   (ANMLContext& context,SchemaBuilder& builder,std::ostream& os) const { toNDDL(context,os); }
 
     virtual std::string toString() const;
     
@@ -129,6 +162,7 @@ class ANMLElementList : public ANMLElement
     virtual void preProcess (ANMLContext& context);
     virtual bool validate(ANMLContext& context,std::vector<std::string>& problems);
     virtual void toNDDL(ANMLContext& context,std::ostream& os) const;
+    virtual void toSchema(ANMLContext& context,SchemaBuilder& builder,std::ostream& os) const;
     
   protected:
     std::vector<ANMLElement*> m_elements;  	
@@ -209,6 +243,7 @@ class Type
                          const std::string& rhs) const;   
                                  
     virtual void toNDDL(ANMLContext& context,std::ostream& os) const;
+    virtual void toSchema(ANMLContext& context,SchemaBuilder& builder,std::ostream& os) const { toNDDL(context,os); }
     
     virtual ValueSetter& getValueSetter() { return m_valueSetter; }
     virtual const std::string& getValueSetterName() const;
@@ -234,6 +269,7 @@ class TypeAlias : public Type
 	virtual bool isPrimitive() const { return m_wrappedType.isPrimitive(); }
 	    
     virtual void toNDDL(ANMLContext& context,std::ostream& os) const;    
+    virtual void toSchema(ANMLContext& context,SchemaBuilder& builder,std::ostream& os) const;
 
   protected:    
     const Type& m_wrappedType;
@@ -252,6 +288,7 @@ class Range : public Type
 	virtual bool isPrimitive() const { return !m_isResourceType; }
 	    
     virtual void toNDDL(ANMLContext& context,std::ostream& os) const;
+    virtual void toSchema(ANMLContext& context,SchemaBuilder& builder,std::ostream& os) const;
     
   protected:
     bool m_isResourceType;
@@ -269,6 +306,7 @@ class Enumeration : public Type
 	virtual bool isPrimitive() const { return false; }
 	    
     virtual void toNDDL(ANMLContext& context, std::ostream& os) const;
+    virtual void toSchema(ANMLContext& context,SchemaBuilder& builder,std::ostream& os) const;
     
   protected:
     const Type& m_dataType;
@@ -288,11 +326,14 @@ class ObjType : public Type, public ANMLContext, public ANMLElementList
 	virtual bool isPrimitive() const { return false; }
 
     virtual void toNDDL(ANMLContext& context, std::ostream& os) const;
+    virtual void toSchema(ANMLContext& context,SchemaBuilder& builder,std::ostream& os) const;
     
   protected:
     ObjType* m_parentObjType; 
     
     void declareValueSetters(std::ostream& os) const;         
+    void declareValueSetters(SchemaBuilder& builder) const;
+    std::string getParentName() const;
 };
 
 class VectorType : public ObjType
@@ -307,6 +348,7 @@ class VectorType : public ObjType
                          const std::string& rhs) const;   
     
     virtual void toNDDL(ANMLContext& context, std::ostream& os) const;  
+    virtual void toSchema(ANMLContext& context,SchemaBuilder& builder,std::ostream& os) const;
 };
 
 class ConstraintDef 
@@ -386,6 +428,7 @@ class TypeDefinition : public ANMLElement
     virtual ~TypeDefinition() {}
 
     virtual void toNDDL(ANMLContext& context,std::ostream& os) const { m_anmlType->toNDDL(context,os); }
+    virtual void toSchema(ANMLContext& context,SchemaBuilder& builder,std::ostream& os) const { m_anmlType->toSchema(context,builder,os); }
     
   protected:
     Type* m_anmlType;        
@@ -0,0 +1,185 @@
+/*
+ * AnmlSchemaBuilder.cc
+ *
+ */
+
+#include "AnmlSchemaBuilder.hh"
+
+#include "Debug.hh"
+#include "Error.hh"
+#include "Engine.hh"
+#include "Domains.hh"
+#include "ObjectType.hh"
+#include "Schema.hh"
+
+#include <sstream>
+#include <boost/scoped_ptr.hpp>
+
+namespace EUROPA {
+
+AnmlSchemaBuilder::AnmlSchemaBuilder(EngineId engine)
+    : m_engine(engine)
+    , m_symbolTable(engine)
+    , m_class(NULL)
+    , m_errors()
+{
+}
+
+AnmlSchemaBuilder::~AnmlSchemaBuilder()
+{
+    delete m_class;
+}
+
+std::string AnmlSchemaBuilder::build(const ANML::ANMLTranslator& translator, std::vector<ANML::ANMLElement*>& program)
+{
+    std::ostringstream rules;
+    translator.toSchema(program,*this,rules);
+
+    debugMsg("AnmlSchemaBuilder:build","NDDL for rules:" << std::endl << rules.str());
+    m_errors += interpretNddl(rules.str());
+
+    return m_errors;
+}
+
+void AnmlSchemaBuilder::include(const std::string& fileName)
+{
+    m_errors += interpretNddl("#include \"" + fileName + "\"\n");
+}
+
+void AnmlSchemaBuilder::defineAlias(const std::string& name,const std::string& dataType)
+{
+    DataTypeId dt = getDataType(dataType);
+    ExprTypedef typeDef(dt,name,dt->baseDomain().copy());
+    typeDef.eval(m_symbolTable);
+}
+
+void AnmlSchemaBuilder::defineRange(const std::string& name,const std::string& dataType,const std::string& lb,const std::string& ub)
+{
+    DataTypeId dt = getDataType(dataType);
+    boost::scoped_ptr<Domain> lower(m_symbolTable.makeNumericDomainFromLiteral(dataType,lb));
+    boost::scoped_ptr<Domain> upper(m_symbolTable.makeNumericDomainFromLiteral(dataType,ub));
+
+    Domain* baseDomain;
+    if (dataType == "float")
+        baseDomain = new IntervalDomain(lower->getSingletonValue(),upper->getSingletonValue());
+    else
+        baseDomain = new IntervalIntDomain((eint)lower->getSingletonValue(),(eint)upper->getSingletonValue());
+
+    ExprTypedef typeDef(dt,name,baseDomain);
+    typeDef.eval(m_symbolTable);
+}
+
+void AnmlSchemaBuilder::defineEnum(const std::string& name,const std::vector<std::string>& values)
+{
+    std::vector<LabelStr> labels(values.begin(),values.end());
+    ExprEnumdef enumDef(name,labels);
+    enumDef.eval(m_symbolTable);
+}
+
+void AnmlSchemaBuilder::beginClass(const std::string& name,const std::string& parentName)
+{
+    check_error(m_class == NULL, "Class " + name + " begun inside class " + (m_class != NULL ? m_class->getName() : ""));
+
+    ObjectTypeId parent = m_symbolTable.getObjectType(parentName);
+    check_runtime_error(parent.isId(),"class " + parentName + " is undefined");
+
+    m_class = new ObjectType(name,parent);
+    // As in the NDDL interpreter, so members and parameters can refer to the class being defined
+    m_symbolTable.getPlanDatabase()->getSchema()->declareObjectType(name);
+    debugMsg("AnmlSchemaBuilder:beginClass","Defining class " << name << " extends " << parentName);
+}
+
+void AnmlSchemaBuilder::addMember(const std::string& dataType,const std::string& name)
+{
+    check_error(m_class != NULL);
+    m_class->addMember(getDataType(dataType),name);
+}
+
+void AnmlSchemaBuilder::addPredicate(const std::string& name,const std::vector<std::string>& paramTypes,const std::vector<std::string>& paramNames)
+{
+    check_error(m_class != NULL);
+    check_error(paramTypes.size() == paramNames.size());
+
+    InterpretedTokenType* tokenType = new InterpretedTokenType(m_class->getId(),m_class->getName() + "." + name,"predicate");
+    tokenType->setLazySlaves(m_symbolTable.lazySlaves());
+
+    for (unsigned int i=0;i<paramNames.size();i++) {
+        DataTypeId dt = getDataType(paramTypes[i]);
+        tokenType->addArg(dt,paramNames[i]);
+        tokenType->addBodyExpr(new ExprVarDeclaration(paramNames[i],dt,NULL,true));
+    }
+
+    m_class->addTokenType(tokenType->getId());
+}
+
+void AnmlSchemaBuilder::addConstructor(const std::vector<std::string>& superArgs,const std::vector<std::string>& memberTypes,const std::vector<std::string>& memberNames)
+{
+    check_error(m_class != NULL);
+    check_error(memberTypes.size() == memberNames.size());
+
+    ExprConstructorSuperCall* superCall = NULL;
+    if (superArgs.size() > 0) {
+        std::vector<Expr*> args;
+        for (unsigned int i=0;i<superArgs.size();i++)
+            args.push_back(makeLiteral(superArgs[i]));
+        superCall = new ExprConstructorSuperCall(m_class->getParent()->getName(),args);
+    }
+
+    std::vector<Expr*> body;
+    for (unsigned int i=0;i<memberNames.size();i++) {
+        body.push_back(new ExprAssignment(
+            new ExprVarRef(memberNames[i],getDataType(memberTypes[i])),
+            new ExprNewObject(memberTypes[i],memberNames[i],std::vector<Expr*>())
+        ));
+    }
+
+    m_class->addObjectFactory(
+        (new InterpretedObjectFactory(
+            m_class->getId(),
+            m_class->getName(),
+            std::vector<std::string>(),
+            std::vector<std::string>(),
+            superCall,
+            body)
+        )->getId()
+    );
+}
+
+void AnmlSchemaBuilder::endClass()
+{
+    check_error(m_class != NULL);
+
+    // The definition owns the class from here on, and deletes it if it is not registered
+    ExprObjectTypeDefinition classDef(m_class->getId());
+    m_class = NULL;
+    classDef.eval(m_symbolTable);
+}
+
+std::string AnmlSchemaBuilder::interpretNddl(const std::string& nddl)
+{
+    LanguageInterpreter* interpreter = m_engine->getLanguageInterpreter("nddl");
+    check_runtime_error(interpreter != NULL,"ANML models can't be built without the NDDL interpreter");
+
+    std::istringstream is(nddl);
+    return interpreter->interpret(is,"<eval>");
+}
+
+DataTypeId AnmlSchemaBuilder::getDataType(const std::string& name) const
+{
+    if (m_class != NULL && m_class->getName() == name)
+        return m_class->getVarType();
+
+    DataTypeId dt = m_symbolTable.getDataType(name);
+    check_runtime_error(dt.isId(),"Type " + name + " has not been defined");
+    return dt;
+}
+
+// Types a literal the way the NDDL lexer would
+Expr* AnmlSchemaBuilder::makeLiteral(const std::string& value)
+{
+    const char* type = (value.find_first_of(".eE") != std::string::npos ||
+                        value == "inff" || value == "-inff" ? "float" : "int");
+    return new ExprConstant(type,m_symbolTable.makeNumericDomainFromLiteral(type,value));
+}
+
+}
@@ -0,0 +1,60 @@
+/*
+ * AnmlSchemaBuilder.hh
+ *
+ */
+
+#ifndef ANMLSCHEMABUILDER_HH_
+#define ANMLSCHEMABUILDER_HH_
+
+#include "ANMLTranslator.hh"
+#include "NddlInterpreter.hh"
+
+namespace EUROPA {
+
+/**
+ * Builds the types, classes and predicates of a translated ANML model directly in the plan
+ * database schema, with the same interpreter structures the NDDL interpreter builds from the
+ * equivalent NDDL. Rules are still translated to NDDL and interpreted.
+ */
+class AnmlSchemaBuilder : public ANML::SchemaBuilder
+{
+public:
+    AnmlSchemaBuilder(EngineId engine);
+    virtual ~AnmlSchemaBuilder();
+
+    /**
+     * @brief Build the model in program.
+     * @return The errors reported while interpreting the NDDL for what could not be built directly.
+     */
+    std::string build(const ANML::ANMLTranslator& translator, std::vector<ANML::ANMLElement*>& program);
+
+    virtual void include(const std::string& fileName);
+
+    virtual void defineAlias(const std::string& name,const std::string& dataType);
+    virtual void defineRange(const std::string& name,const std::string& dataType,const std::string& lb,const std::string& ub);
+    virtual void defineEnum(const std::string& name,const std::vector<std::string>& values);
+
+    virtual void beginClass(const std::string& name,const std::string& parentName);
+    virtual void addMember(const std::string& dataType,const std::string& name);
+    virtual void addPredicate(const std::string& name,const std::vector<std::string>& paramTypes,const std::vector<std::string>& paramNames);
+    virtual void addConstructor(const std::vector<std::string>& superArgs,const std::vector<std::string>& memberTypes,const std::vector<std::string>& memberNames);
+    virtual void endClass();
+
+protected:
+    EngineId m_engine;
+    NddlSymbolTable m_symbolTable;
+    ObjectType* m_class; /*!< The class between beginClass and endClass */
+    std::string m_errors;
+
+    std::string interpretNddl(const std::string& nddl);
+    DataTypeId getDataType(const std::string& name) const;
+    Expr* makeLiteral(const std::string& value);
+
+private:
+    AnmlSchemaBuilder(const AnmlSchemaBuilder&);
+    AnmlSchemaBuilder& operator=(const AnmlSchemaBuilder&);
+};
+
+}
+
+#endif /* ANMLSCHEMABUILDER_HH_ */
@@ -962,7 +962,8 @@ void ConstraintEngine::notify(const ConstrainedVariableId source,
    * @see getIndex
    */
   ConstrainedVariableId ConstraintEngine::getVariable(unsigned int index){
-    check_error(index < m_variables.size());
+    if(index >= m_variables.size())
+      return ConstrainedVariableId::noId();
     unsigned int i = 0;
     for(ConstrainedVariableSet::const_iterator it = m_variables.begin(); it != m_variables.end(); ++it){
       if(i == index){
@@ -1169,7 +1170,12 @@ ConstraintEngine::createVariable(const std::string& typeName,
 ConstraintId ConstraintEngine::createConstraint(const std::string& name,
                                                 const std::vector<ConstrainedVariableId>& scope,
                                                 const std::string& violationExpl) {
-  ConstraintTypeId factory = getCESchema()->getConstraintType(name);
+  return createConstraint(getCESchema()->getConstraintType(name), scope, violationExpl);
+}
+
+ConstraintId ConstraintEngine::createConstraint(const ConstraintTypeId factory,
+                                                const std::vector<ConstrainedVariableId>& scope,
+                                                const std::string& violationExpl) {
   check_error(factory.isValid());
   ConstraintId constraint = factory->createConstraint(getId(), scope, violationExpl);
 
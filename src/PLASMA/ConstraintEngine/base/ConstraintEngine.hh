@@ -224,6 +224,7 @@ typedef Id<ConstraintEngineListener> ConstraintEngineListenerId;
 
     /**
      * @brief Get variable based on its position in the set of variables.
+     * @return noId if there is no variable at that position.
      * @note This is not a const in-case it manages some internal cache to optimize later
      */
     ConstrainedVariableId getVariable(unsigned int index);
@@ -339,6 +340,13 @@ typedef Id<ConstraintEngineListener> ConstraintEngineListenerId;
                                   const std::vector<ConstrainedVariableId>& scope,
                                   const std::string& violationExpl="");
 
+    /**
+     * @brief Create a constraint from a constraint type that has already been looked up.
+     */
+    ConstraintId createConstraint(const ConstraintTypeId factory,
+                                  const std::vector<ConstrainedVariableId>& scope,
+                                  const std::string& violationExpl="");
+
     void deleteConstraint(const ConstraintId c);
 
     /**
@@ -612,6 +612,7 @@ tokenType[ObjectType* objType]
 			{ 
 			    tokenTypeName = objType->getName() + "." + c_str($ttName.text->chars);
 			    tokenType = new InterpretedTokenType(objType->getId(),tokenTypeName,c_str($kind.text->chars)); //NOTE: This can leak if one of the tokenStatements throws
+			    tokenType->setLazySlaves(CTX->SymbolTable->lazySlaves());
 			    pushContext(CTX,new NddlTokenSymbolTable(CTX->SymbolTable,tokenType->getId(),objType->getId())); 
 			}
 			tokenStatements[tokenType]
@@ -713,6 +714,9 @@ rule returns [Expr* result]
             }
 		    std::string source="\"" + filename + "," + std::string(buff) + "\"";
 		    InterpretedRuleFactory* rf = new InterpretedRuleFactory(predName,source,ruleBody);
+		    rf->setCompiled(CTX->SymbolTable->compileRules(),
+		                   CTX->SymbolTable->getPlanDatabase()->getConstraintEngine()->getCESchema());
+		    rf->setLazySlaves(CTX->SymbolTable->lazySlaves());
             CTX->SymbolTable->popFromCleanupStack(ruleBody.size());
 		    if (iTokenType != NULL) 
 		        iTokenType->addRule(rf);
@@ -6,6 +6,7 @@
  */
 
 #include "Interpreter.hh"
+#include "RuleProgram.hh"
 
 #include <string.h>
 #include <stdio.h>
@@ -28,8 +29,12 @@
 
 #include "NddlRules.hh"
 #include "NddlUtils.hh"
+#include <algorithm>
 #include <typeinfo>
 #include <iterator>
+#include <limits>
+#include <map>
+#include <set>
 
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
@@ -190,11 +195,15 @@ std::string getAutoName(const std::string& prefix) {
 /*
  * ExprVarRef
  */
+const unsigned int ExprVarRef::NO_SLOT = std::numeric_limits<unsigned int>::max();
+
 ExprVarRef::ExprVarRef(const std::string& varName, const DataTypeId type)
     : m_varName(varName)
     , m_varType(type)
     , m_parentName()
     , m_vars()
+    , m_depth(0)
+    , m_slot(NO_SLOT)
 {
   tokenize(m_varName,m_vars,".");
 
@@ -219,9 +228,26 @@ ExprVarRef::ExprVarRef(const std::string& varName, const DataTypeId type)
       return m_varType;
   }
 
+void ExprVarRef::bindSlot(unsigned int depth, unsigned int slot) {
+  check_error(m_parentName.empty(), "Only unqualified references can be bound to a slot: " + toString());
+  m_depth = depth;
+  m_slot = slot;
+}
+
 DataRef ExprVarRef::eval(EvalContext& context) const {
   ConstrainedVariableId var;
 
+  if (m_slot != NO_SLOT) {
+    ConstrainedVariableId* slot = context.getSlot(m_depth, m_slot);
+    if (slot != NULL) {
+      // Declared names are filled when declared; token and global variables are looked up once
+      if (slot->isNoId())
+        *slot = context.getVar(m_varName);
+      if (slot->isId())
+        return DataRef(*slot);
+    }
+  }
+
   if (m_parentName == "") {
     var = context.getVar(m_varName.c_str());
     if (var.isNoId()) {
@@ -916,6 +942,22 @@ TokenId PredicateInstanceRef::createGlobalToken(EvalContext& context, bool isFac
   return token;
 }
 
+namespace {
+ConstrainedVariableId subgoalOwner(EvalContext& context,
+                                   const std::string& predicateInstance,
+                                   bool constrained) {
+  if (!constrained)
+    return ConstrainedVariableId::noId();
+
+  unsigned long tokenCnt =
+      std::count(predicateInstance.begin(), predicateInstance.end(), '.') + 1;
+  if (tokenCnt == 1)
+    return context.getVar("object");
+  else
+    return context.getVar(predicateInstance.substr(0,predicateInstance.find('.')).c_str());
+}
+}
+
 TokenId PredicateInstanceRef::createSubgoal(EvalContext& context,
                                             InterpretedRuleInstance* rule,
                                             const std::string& relationName) {
@@ -928,15 +970,7 @@ TokenId PredicateInstanceRef::createSubgoal(EvalContext& context,
   std::string predicateName(m_predicateName); // TODO: auto-generate name if not provided?
   std::string predicateInstance(m_predicateInstance);
   bool constrained = isConstrained(context,predicateInstance);
-  ConstrainedVariableId owner;
-  if (constrained) {
-    unsigned long tokenCnt =
-        std::count(predicateInstance.begin(), predicateInstance.end(), '.') + 1;
-    if (tokenCnt == 1)
-      owner = context.getVar("object");
-    else
-      owner = context.getVar(predicateInstance.substr(0,predicateInstance.find('.')).c_str());
-  }
+  ConstrainedVariableId owner = subgoalOwner(context,predicateInstance,constrained);
 
   TokenId slave = rule->createSubgoal(
       predicateName,
@@ -953,6 +987,23 @@ TokenId PredicateInstanceRef::createSubgoal(EvalContext& context,
   return slave;
 }
 
+void PredicateInstanceRef::addPendingSubgoal(EvalContext& context,
+                                             InterpretedRuleInstance* rule,
+                                             const std::string& relationName) {
+  std::string predicateType = predicateInstanceToType(context,m_predicateName.c_str(),
+                                                      m_predicateInstance.c_str());
+  bool constrained = isConstrained(context,m_predicateInstance);
+  rule->addPendingSubgoal(
+      new InterpretedPendingSlave(m_predicateName,
+                                  predicateType,
+                                  m_predicateInstance,
+                                  relationName,
+                                  constrained,
+                                  subgoalOwner(context,m_predicateInstance,constrained),
+                                  m_attributes));
+  debugMsg("Interpreter:InterpretedRule","Recorded pending subgoal " << predicateType << ":" << m_predicateName);
+}
+
   int PredicateInstanceRef::getAttributes(  ) const
   {
     return m_attributes;
@@ -1104,8 +1155,17 @@ void createRelation(EvalContext& context,
   {
     const std::string& relationName = m_relation.c_str();
 
+    // Slaves related to the master can be left pending, the relation is posted when they are created
+    InterpretedRuleInstance* rule =
+        reinterpret_cast<InterpretedRuleInstance*>(context.getElement("RuleInstance"));
+    bool lazy = (rule != NULL && rule->hasLazySlaves() && m_origin->isThis());
+
     TokenId origin = m_origin->getToken(context,"any"); // This will create a subgoal if necessary
     for (unsigned int i=0;i<m_targets.size();i++) {
+        if (lazy && m_targets[i]->isSubgoal()) {
+            m_targets[i]->addPendingSubgoal(context,rule,relationName);
+            continue;
+        }
         TokenId target = m_targets[i]->getToken(context,relationName); // This will create a subgoal if necessary
         createRelation(context,relationName,origin,target);
     }
@@ -1170,6 +1230,13 @@ void createRelation(EvalContext& context,
   }
 
   DataRef ExprIf::doEval(RuleInstanceEvalContext& context) const
+  {
+    evalGuard(context, NULL, NULL);
+    return DataRef::null;
+  }
+
+  void ExprIf::evalGuard(RuleInstanceEvalContext& context, const RuleProgram* ifProgram,
+                         const RuleProgram* elseProgram) const
   {
     bool isOpEquals = (m_guard->getOperator() == "equals" || m_guard->getOperator()=="==");
 
@@ -1189,6 +1256,7 @@ void createRelation(EvalContext& context,
                                       isOpEquals,
                                       vars,
                                       m_ifBody);
+      iri->setProgram(ifProgram);
       context.getRuleInstance()->addChildRule(iri);
       
       if (m_elseBody.size() > 0) {
@@ -1200,6 +1268,7 @@ void createRelation(EvalContext& context,
                 !isOpEquals,
                 vars,
                 m_elseBody);
+        elseBody->setProgram(elseProgram);
         context.getRuleInstance()->addChildRule(elseBody);
       }
 
@@ -1215,18 +1284,18 @@ void createRelation(EvalContext& context,
       //   debugMsg("Interpreter:evalIf", (*it)->toLongString());
       // }
       checkRuntimeError(ALWAYS_FAILS, "Didn't expect to get here.")
-      context.getRuleInstance()->addChildRule(
+      InterpretedRuleInstance* iri =
           new InterpretedRuleInstance(
               context.getRuleInstance()->getId(),
               makeScope(lhs.getValue()),
               isOpEquals,
-              m_ifBody));
+              m_ifBody);
+      iri->setProgram(ifProgram);
+      context.getRuleInstance()->addChildRule(iri);
 
       check_runtime_error(m_elseBody.size()==0, "Can't have else body for singleton guard");
       debugMsg("Interpreter:InterpretedRule","Evaluated mult-var IF " << m_guard->toString());
     }
-
-    return DataRef::null;
   }
 
   std::string ExprIf::toString() const
@@ -1242,6 +1311,7 @@ void createRelation(EvalContext& context,
     : m_varName(varName)
     , m_varValue(varValue)
     , m_loopBody(loopBody)
+    , m_slot(ExprVarRef::NO_SLOT)
   {
   }
 
@@ -1253,7 +1323,7 @@ void createRelation(EvalContext& context,
   }
 
 DataRef ExprLoop::doEval(RuleInstanceEvalContext& context) const {
-  context.getRuleInstance()->executeLoop(context,m_varName,m_varValue,m_loopBody);
+  context.getRuleInstance()->executeLoop(context,m_varName,m_varValue,m_loopBody,m_slot);
   debugMsg("Interpreter:InterpretedRule",
            "Evaluated LOOP " << m_varName << "," << m_varValue);
   return DataRef::null;
@@ -1277,7 +1347,7 @@ InterpretedToken::InterpretedToken(
                     IntervalIntDomain(),                  // end
                     IntervalIntDomain(1, PLUS_INFINITY),  // duration
                     Token::noObject(),                    // Object Name
-                    false)
+                    false), m_deferredBody()
 {
   commonInit(body, _close);
   debugMsg("Interpreter:InterpretedToken",
@@ -1290,7 +1360,8 @@ InterpretedToken::InterpretedToken(
     const std::string& predicateName,
     const std::string& relation,
     const std::vector<Expr*>& body,
-    const bool& _close)
+    const bool& _close,
+    const bool& lazy)
     : IntervalToken(_master,
 		    relation,
 		    predicateName,
@@ -1298,8 +1369,8 @@ InterpretedToken::InterpretedToken(
 		    IntervalIntDomain(),                 // end
 		    IntervalIntDomain(1, PLUS_INFINITY), // duration
 		    Token::noObject(),                   // Object Name
-		    false) {
-  commonInit(body, _close);
+		    false), m_deferredBody() {
+  commonInit(body, _close, lazy);
   debugMsg("Interpreter:InterpretedToken",
            "Created slave token(" << getKey() << ") of type:" << 
            predicateName << " objectVar=" << 
@@ -1312,18 +1383,56 @@ InterpretedToken::InterpretedToken(
 
   void InterpretedToken::commonInit(
                     const std::vector<Expr*>& body,
-				    const bool& autoClose)
+				    const bool& autoClose,
+				    const bool& lazy)
   {
     // TODO: Pass in EvalContext to give access to class or global context
     TokenEvalContext context(NULL,getId());
 
-    for (unsigned int i=0; i < body.size(); i++)
+    // Parameter declarations and assignments are always evaluated, rules and
+    // relations may refer to them before the token is activated
+    for (unsigned int i=0; i < body.size(); i++) {
+      if (lazy && isDeferrable(body[i]))
+        m_deferredBody.push_back(body[i]);
+      else
         body[i]->eval(context);
+    }
+
+    debugMsg("Interpreter:InterpretedToken",
+             "Deferred " << m_deferredBody.size() << " body constraints for token(" << getKey() << ")");
 
     if (autoClose)
       close();
   }
 
+  bool InterpretedToken::isDeferrable(const Expr* e)
+  {
+    return dynamic_cast<const ExprConstraint*>(e) != NULL ||
+        dynamic_cast<const CExpr*>(e) != NULL;
+  }
+
+  void InterpretedToken::materialize()
+  {
+    if (m_deferredBody.empty())
+      return;
+
+    debugMsg("Interpreter:InterpretedToken",
+             "Materializing " << m_deferredBody.size() << " body constraints for token(" << getKey() << ")");
+
+    std::vector<Expr*> body;
+    body.swap(m_deferredBody);
+
+    TokenEvalContext context(NULL,getId());
+    for (unsigned int i=0; i < body.size(); i++)
+        body[i]->eval(context);
+  }
+
+  void InterpretedToken::activate()
+  {
+    materialize();
+    IntervalToken::activate();
+  }
+
   /*
    * InterpretedTokenType
    */
@@ -1331,7 +1440,7 @@ InterpretedTokenType::InterpretedTokenType(
     const ObjectTypeId ot,
     const std::string& predicateName,
     const std::string& kind)
-    : TokenType(ot,predicateName), m_body(), m_rules() {
+    : TokenType(ot,predicateName), m_body(), m_rules(), m_lazySlaves(false) {
   // TODO: offer conversion methods in TokenType
   int attributes=0;
   if (kind=="action")
@@ -1426,7 +1535,8 @@ TokenId InterpretedTokenType::createInstance(const TokenId master, const std::st
         name,
         relation,
         m_body,
-        false))->getId();
+        false,
+        m_lazySlaves))->getId();
     // TODO: this should be done for all tokens, not just InterpretedTokens
     token->setAttributes(getAttributes());
   }
@@ -1435,7 +1545,7 @@ TokenId InterpretedTokenType::createInstance(const TokenId master, const std::st
     // TODO: Hack! this makes it impossible to extend native tokens
     // class hierarchy needs to be fixed to avoid this cast
     InterpretedToken* it = id_cast<InterpretedToken>(token);
-    it->commonInit(m_body,false);
+    it->commonInit(m_body,false,m_lazySlaves);
   }
 
   return token;
@@ -1480,6 +1590,10 @@ ConstrainedVariableId RuleInstanceEvalContext::getVar(const std::string& name) {
   }
 }
 
+ConstrainedVariableId* RuleInstanceEvalContext::getSlot(unsigned int depth, unsigned int slot) {
+  return &m_ruleInstance->getSlot(depth, slot);
+}
+
 TokenId RuleInstanceEvalContext::getToken(const std::string& name) {
   TokenId tok = m_ruleInstance->getSlave(name);
   if (!tok.isNoId()) {
@@ -1565,6 +1679,8 @@ bool TokenEvalContext::isClass(const std::string& className) const {
 						   const std::vector<Expr*>& body)
     : RuleInstance(rule, token, planDb)
     , m_body(body)
+    , m_slots()
+    , m_program(NULL)
   {
   }
 
@@ -1576,6 +1692,8 @@ bool TokenEvalContext::isClass(const std::string& className) const {
 						   const std::vector<Expr*>& body)
     : RuleInstance(parent,var,domain,positive)
     , m_body(body)
+    , m_slots()
+    , m_program(NULL)
   {
   }
 
@@ -1587,6 +1705,8 @@ InterpretedRuleInstance::InterpretedRuleInstance(const RuleInstanceId parent,
                                                  const std::vector<Expr*>& body)
     : RuleInstance(parent,var,domain,positive, guardComponents)
     , m_body(body)
+    , m_slots()
+    , m_program(NULL)
   {
   }
 
@@ -1597,6 +1717,8 @@ InterpretedRuleInstance::InterpretedRuleInstance(const RuleInstanceId parent,
 						   const std::vector<Expr*>& body)
     : RuleInstance(parent,vars,positive)
     , m_body(body)
+    , m_slots()
+    , m_program(NULL)
   {
   }
 
@@ -1620,8 +1742,12 @@ InterpretedRuleInstance::InterpretedRuleInstance(const RuleInstanceId parent,
 	       "Body: " << (*it)->toString());
     }
 
-    for (unsigned int i=0; i < m_body.size(); i++) {
-      m_body[i]->eval(evalContext);
+    if (m_program != NULL)
+      m_program->execute(evalContext);
+    else {
+      for (unsigned int i=0; i < m_body.size(); i++) {
+        m_body[i]->eval(evalContext);
+      }
     }
 
     debugMsg("Interpreter:InterpretedRule",
@@ -1687,6 +1813,24 @@ TokenId InterpretedRuleInstance::createSubgoal(const std::string& name,
   return slave;
 }
 
+TokenId InterpretedRuleInstance::materializeSlave(const PendingSlave& pending) {
+  // Only addPendingSubgoal records pending slaves on interpreted rule instances
+  const InterpretedPendingSlave& slave = static_cast<const InterpretedPendingSlave&>(pending);
+
+  TokenId token = createSubgoal(slave.getName(),
+                                slave.getPredicateType(),
+                                slave.getPredicateInstance(),
+                                slave.getRelation(),
+                                slave.isConstrained(),
+                                slave.getOwner());
+  token->addAttributes(slave.getAttributes());
+
+  RuleInstanceEvalContext context(NULL,getId());
+  createRelation(context,slave.getRelation(),m_token,token);
+  debugMsg("Interpreter:InterpretedRule","Created pending subgoal " << slave.getPredicateType() << ":" << slave.getName());
+  return token;
+}
+
 ConstrainedVariableId InterpretedRuleInstance::addLocalVariable(const Domain& baseDomain,
                                                                 bool canBeSpecified,
                                                                 const std::string& name) {
@@ -1703,10 +1847,34 @@ ConstrainedVariableId InterpretedRuleInstance::addObjectVariable(const std::stri
   return localVariable;
 }
 
+ConstrainedVariableId& InterpretedRuleInstance::getSlot(unsigned int depth, unsigned int slot) {
+  if (depth > 0) {
+    check_error(m_parent.isValid(), "No enclosing rule instance for a bound slot.");
+    return boost::polymorphic_downcast<InterpretedRuleInstance*>(
+        static_cast<RuleInstance*>(m_parent))->getSlot(depth - 1, slot);
+  }
+
+  if (slot >= m_slots.size())
+    m_slots.resize(slot + 1);
+  return m_slots[slot];
+}
+
+void InterpretedRuleInstance::setSlot(unsigned int slot, const ConstrainedVariableId var) {
+  if (slot != ExprVarRef::NO_SLOT)
+    getSlot(0, slot) = var;
+}
+
+void InterpretedRuleInstance::handleUndo() {
+  // The variables of the execution are about to be deleted; keep the storage for the next one
+  std::fill(m_slots.begin(), m_slots.end(), ConstrainedVariableId::noId());
+}
+
 void InterpretedRuleInstance::executeLoop(EvalContext& evalContext,
                                           const std::string& loopVarName,
                                           const std::string& valueSet,
-                                          const std::vector<Expr*>& loopBody) {
+                                          const std::vector<Expr*>& loopBody,
+                                          unsigned int loopVarSlot,
+                                          const RuleProgram* loopProgram) {
   // Create a local domain based on the objects included in the valueSet
   ConstrainedVariableId setVar = evalContext.getVar(valueSet.c_str());
   check_error(!setVar.isNoId(),"Loop var can't be NULL");
@@ -1749,14 +1917,19 @@ void InterpretedRuleInstance::executeLoop(EvalContext& evalContext,
       loopVarDomain.insert(loop_var->getKey());
       loopVarDomain.close();
       // This will automatically put it in the evalContext, since all RuleInstance vars are reachable there
-      addVariable(loopVarDomain, false, loopVarName);
+      setSlot(loopVarSlot, addVariable(loopVarDomain, false, loopVarName));
     }
 
     // execute loop body
-    for (unsigned int i=0; i < loopBody.size(); i++)
-      loopBody[i]->eval(evalContext);
+    if (loopProgram != NULL)
+      loopProgram->execute(*boost::polymorphic_downcast<RuleInstanceEvalContext*>(&evalContext));
+    else {
+      for (unsigned int i=0; i < loopBody.size(); i++)
+        loopBody[i]->eval(evalContext);
+    }
 
     clearLoopVar(loopVarName);
+    setSlot(loopVarSlot, ConstrainedVariableId::noId());
   }
 }
 
@@ -1769,6 +1942,8 @@ InterpretedRuleFactory::InterpretedRuleFactory(const std::string& predicate,
                                                const std::vector<Expr*>& body)
     : Rule(predicate,source)
     , m_body(body)
+    , m_lazySlaves(false)
+    , m_program()
   {
     debugMsg("InterpretedRuleFactory:InterpretedRuleFactory",
 	     "Instantiating rule for " << source);
@@ -1777,8 +1952,20 @@ InterpretedRuleFactory::InterpretedRuleFactory(const std::string& predicate,
 	       (*it)->toString());
 
     }
+    bindRuleSlots(m_body);
   }
 
+void InterpretedRuleFactory::setCompiled(bool compiled, const CESchemaId& ceSchema) {
+  if (!compiled)
+    m_program.reset();
+  else if (!m_program)
+    m_program.reset(RuleProgram::compile(m_body, ceSchema));
+}
+
+bool InterpretedRuleFactory::isCompiled() const {
+  return m_program.get() != NULL;
+}
+
 InterpretedRuleFactory::~InterpretedRuleFactory() {
   debugMsg("InterpretedRuleFactory:~InterpretedRuleFactory",
            "Instantiating rule for " << m_source);
@@ -1798,6 +1985,8 @@ RuleInstanceId InterpretedRuleFactory::createInstance(const TokenId token,
                                                       const RulesEngineId &rulesEngine) const {
 
   InterpretedRuleInstance *foo = new InterpretedRuleInstance(m_id, token, planDb, m_body);
+  foo->setProgram(m_program.get());
+  foo->setLazySlaves(m_lazySlaves);
     //TODO: Fix this once we start using smart pointers more.  setRulesEngine can throw,
     //      leaking foo
     try {
@@ -1910,6 +2099,7 @@ DataRef ExprEnumdef::eval(EvalContext& context) const {
       , m_type(type)
       , m_initValue(initValue)
       , m_canBeSpecified(canBeSpecified)
+      , m_slot(ExprVarRef::NO_SLOT)
   {
   }
 
@@ -2045,6 +2235,9 @@ ConstrainedVariableId ExprVarDeclaration::makeRuleVar(RuleInstanceEvalContext& c
   if (m_initValue != NULL)
     localVar->restrictBaseDomain(m_initValue->eval(context).getValue()->derivedDomain());
 
+  // References evaluated before this declaration may have resolved the name in an outer scope
+  context.getRuleInstance()->setSlot(m_slot, localVar);
+
   context.addVar(m_name.c_str(),localVar);
   debugMsg("Interpreter:InterpretedRule","Added RuleInstance local var:" << localVar->toLongString());
   return localVar;
@@ -2587,5 +2780,125 @@ void getVariableReferences(const Expr* expr, EvalContext& ctx,
   }
 }
 
+namespace {
+/**
+ * @brief Slots assigned to names in one rule scope, and the names declared there.
+ */
+class RuleScope {
+ public:
+  RuleScope() : m_slots(), m_declared() {}
+
+  unsigned int getSlot(const std::string& name) {
+    std::map<std::string, unsigned int>::const_iterator it = m_slots.find(name);
+    if (it != m_slots.end())
+      return it->second;
+    unsigned int slot = static_cast<unsigned int>(m_slots.size());
+    m_slots.insert(std::make_pair(name, slot));
+    return slot;
+  }
+
+  void declare(const std::string& name) {m_declared.insert(name);}
+  bool isDeclared(const std::string& name) const {return m_declared.find(name) != m_declared.end();}
+
+ private:
+  std::map<std::string, unsigned int> m_slots;
+  std::set<std::string> m_declared;
+};
+
+/**
+ * Declarations in loop bodies are made on the enclosing rule instance, so they belong to its scope.
+ * If and else bodies are evaluated by child rule instances, and so are nested scopes.
+ */
+void collectDeclarations(const std::vector<Expr*>& body, RuleScope& scope) {
+  for (std::vector<Expr*>::const_iterator it = body.begin(); it != body.end(); ++it) {
+    if (dynamic_cast<const ExprVarDeclaration*>(*it) != NULL)
+      scope.declare(static_cast<const ExprVarDeclaration*>(*it)->getName());
+    else if (dynamic_cast<const ExprLoop*>(*it) != NULL) {
+      const ExprLoop* loop = static_cast<const ExprLoop*>(*it);
+      scope.declare(loop->getVarName());
+      collectDeclarations(loop->getBody(), scope);
+    }
+  }
 }
 
+void bindScope(const std::vector<Expr*>& body, std::vector<RuleScope>& scopes);
+
+void bindExpr(Expr* expr, std::vector<RuleScope>& scopes) {
+  if (expr == NULL)
+    return;
+
+  if (dynamic_cast<ExprVarRef*>(expr) != NULL) {
+    ExprVarRef* ref = static_cast<ExprVarRef*>(expr);
+    if (ref->isQualified())
+      return;
+    // Undeclared names are token or global variables, found from the outermost scope
+    unsigned int index = static_cast<unsigned int>(scopes.size()) - 1;
+    while (index > 0 && !scopes[index].isDeclared(ref->getVarName()))
+      index--;
+    ref->bindSlot(static_cast<unsigned int>(scopes.size()) - 1 - index,
+                  scopes[index].getSlot(ref->getVarName()));
+  }
+  else if (dynamic_cast<ExprVarDeclaration*>(expr) != NULL) {
+    ExprVarDeclaration* decl = static_cast<ExprVarDeclaration*>(expr);
+    decl->bindSlot(scopes.back().getSlot(decl->getName()));
+    bindExpr(const_cast<Expr*>(decl->getInitValue()), scopes);
+  }
+  else if (dynamic_cast<ExprLoop*>(expr) != NULL) {
+    ExprLoop* loop = static_cast<ExprLoop*>(expr);
+    loop->bindSlot(scopes.back().getSlot(loop->getVarName()));
+    for (std::vector<Expr*>::const_iterator it = loop->getBody().begin(); it != loop->getBody().end(); ++it)
+      bindExpr(*it, scopes);
+  }
+  else if (dynamic_cast<ExprIf*>(expr) != NULL) {
+    ExprIf* e = static_cast<ExprIf*>(expr);
+    bindExpr(e->getGuard(), scopes);
+    bindScope(e->getIfBody(), scopes);
+    bindScope(e->getElseBody(), scopes);
+  }
+  else if (dynamic_cast<ExprIfGuard*>(expr) != NULL) {
+    ExprIfGuard* e = static_cast<ExprIfGuard*>(expr);
+    bindExpr(e->getLhs(), scopes);
+    bindExpr(e->getRhs(), scopes);
+  }
+  else if (dynamic_cast<ExprConstraint*>(expr) != NULL) {
+    std::vector<Expr*> args = static_cast<ExprConstraint*>(expr)->getArgs();
+    for (std::vector<Expr*>::const_iterator it = args.begin(); it != args.end(); ++it)
+      bindExpr(*it, scopes);
+  }
+  else if (dynamic_cast<ExprAssignment*>(expr) != NULL) {
+    ExprAssignment* e = static_cast<ExprAssignment*>(expr);
+    bindExpr(e->getLhs(), scopes);
+    bindExpr(e->getRhs(), scopes);
+  }
+  else if (dynamic_cast<CExprValue*>(expr) != NULL)
+    bindExpr(static_cast<CExprValue*>(expr)->getValue(), scopes);
+  else if (dynamic_cast<CExprBinary*>(expr) != NULL) {
+    CExprBinary* e = static_cast<CExprBinary*>(expr);
+    bindExpr(const_cast<CExpr*>(e->getLhs()), scopes);
+    bindExpr(const_cast<CExpr*>(e->getRhs()), scopes);
+  }
+  else if (dynamic_cast<CExprFunction*>(expr) != NULL) {
+    std::vector<CExpr*> args = static_cast<CExprFunction*>(expr)->getArgs();
+    for (std::vector<CExpr*>::const_iterator it = args.begin(); it != args.end(); ++it)
+      bindExpr(*it, scopes);
+  }
+  // Other expressions resolve their names when evaluated
+}
+
+void bindScope(const std::vector<Expr*>& body, std::vector<RuleScope>& scopes) {
+  if (body.empty())
+    return;
+  scopes.push_back(RuleScope());
+  collectDeclarations(body, scopes.back());
+  for (std::vector<Expr*>::const_iterator it = body.begin(); it != body.end(); ++it)
+    bindExpr(*it, scopes);
+  scopes.pop_back();
+}
+}
+
+void bindRuleSlots(const std::vector<Expr*>& body) {
+  std::vector<RuleScope> scopes;
+  bindScope(body, scopes);
+}
+
+}
@@ -41,6 +41,7 @@ private:
 
   class TokenEvalContext;
   class RuleInstanceEvalContext;
+  class RuleProgram;
 
 class ExprVarDeclaration : public Expr {
  private:
@@ -58,15 +59,24 @@ class ExprVarDeclaration : public Expr {
   const Expr* getInitValue() const;
   void setInitValue(Expr* iv);
 
+  /**
+   * @brief Bind the slot of the declared name in the enclosing rule scope.
+   * @see bindRuleSlots
+   */
+  void bindSlot(unsigned int slot) {m_slot = slot;}
+
  protected:
   std::string m_name;
   DataTypeId m_type;
   Expr* m_initValue;
   bool m_canBeSpecified;
+  unsigned int m_slot;
 
   ConstrainedVariableId makeGlobalVar(EvalContext& context) const;
   ConstrainedVariableId makeTokenVar(TokenEvalContext& context) const;
   ConstrainedVariableId makeRuleVar(RuleInstanceEvalContext& context) const;
+
+  friend class RuleProgram;
 };
 
 class ExprVarRef : public Expr {
@@ -78,11 +88,25 @@ class ExprVarRef : public Expr {
   virtual const DataTypeId getDataType() const;
   virtual std::string toString() const;
 
+  bool isQualified() const {return !m_parentName.empty();}
+  const std::string& getVarName() const {return m_varName;}
+
+  /**
+   * @brief Bind this reference to a slot of the rule instance 'depth' parents up from the one
+   * evaluating it. Bound references are looked up by name only on their first evaluation.
+   * @see bindRuleSlots
+   */
+  void bindSlot(unsigned int depth, unsigned int slot);
+
+  static const unsigned int NO_SLOT;
+
  protected:
   std::string m_varName;
   DataTypeId m_varType;
   std::string m_parentName;
   std::vector<std::string> m_vars;
+  unsigned int m_depth;
+  unsigned int m_slot;
 };
 
 class ExprAssignment : public Expr {
@@ -117,6 +141,7 @@ class ExprConstraint : public Expr {
 
   const std::string getName() const { return m_name; }
   std::vector<Expr*> getArgs() const;// { return m_args; }
+  const std::string& getViolationExpl() const { return m_violationExpl; }
   virtual std::string toString() const;
 
  protected:
@@ -300,6 +325,17 @@ class PredicateInstanceRef {
   int     getAttributes() const;
   const TokenTypeId getTokenType();
 
+  // True for the implicit reference to the master token of a rule
+  bool isThis() const { return m_predicateInstance.empty() && m_predicateName == "this"; }
+  // True if evaluating the reference in a rule creates a slave
+  bool isSubgoal() const { return !m_predicateInstance.empty(); }
+
+  /**
+   * @brief Records the slave as pending on a rule instance with lazy slaves instead of creating it.
+   * The relation to the master is posted when the slave is created.
+   */
+  void addPendingSubgoal(EvalContext& ctx, InterpretedRuleInstance* rule, const std::string& relationName);
+
  protected:
   TokenTypeId m_tokenType;
   std::string m_predicateInstance;
@@ -420,6 +456,8 @@ private:
 
   virtual std::string toString() const { return m_value->toString(); }
 
+  Expr* getValue() const { return m_value.get(); }
+
   // CExpr methods
   virtual bool hasReturnValue() const { return true; }
   virtual bool isSingleton() { return true; /*TODO:not accurate?*/}
@@ -480,14 +518,32 @@ class CExprBinary : public CExpr {
                          const std::string& predicateName,
                          const std::string& relation,
                          const std::vector<Expr*>& body,
-                         const bool& close = false);
+                         const bool& close = false,
+                         const bool& lazy = false);
 
 
   	    virtual ~InterpretedToken();
 
+        /**
+         * @brief Evaluates the body constraints deferred at creation, if any, and activates the token.
+         */
+        virtual void activate();
+
+        /**
+         * @brief Posts the body constraints deferred for a lazily created slave. A no-op otherwise.
+         */
+        void materialize();
+
+        bool isMaterialized() const { return m_deferredBody.empty(); }
+
     protected:
+        std::vector<Expr*> m_deferredBody; /*!< Body constraints not yet posted. Owned by the token type. */
+
         void commonInit(const std::vector<Expr*>& body,
-                        const bool& autoClose);
+                        const bool& autoClose,
+                        const bool& lazy = false);
+
+        static bool isDeferrable(const Expr* e);
 
         friend class InterpretedTokenType;
   };
@@ -502,12 +558,20 @@ class InterpretedTokenType: public TokenType {
   void addBodyExpr(Expr* e);
   void addRule(InterpretedRuleFactory* rf);
 
+  /**
+   * @brief When set, slaves of this type defer their body constraints until they are activated.
+   * Slaves that are merged or rejected never post them.
+   */
+  void setLazySlaves(bool lazy) { m_lazySlaves = lazy; }
+  bool hasLazySlaves() const { return m_lazySlaves; }
+
   virtual TokenId createInstance(const PlanDatabaseId planDb, const std::string& name, bool rejectable, bool isFact) const;
   virtual TokenId createInstance(const TokenId master, const std::string& name, const std::string& relation) const;
 
  protected:
   std::vector<Expr*> m_body;
   std::vector<InterpretedRuleFactory*> m_rules;
+  bool m_lazySlaves;
   TokenTypeId getParentType(const PlanDatabaseId planDb) const;
   void processExpr(Expr* e);
 
@@ -532,6 +596,37 @@ class TokenEvalContext : public EvalContext {
   TokenId m_token;
 };
 
+  /**
+   * @brief A slave of an interpreted rule with lazy slaves, recorded with what createSubgoal needs.
+   */
+  class InterpretedPendingSlave : public PendingSlave
+  {
+    public:
+        InterpretedPendingSlave(const std::string& name,
+                                const std::string& predicateType,
+                                const std::string& predicateInstance,
+                                const std::string& relation,
+                                bool isConstrained,
+                                ConstrainedVariableId owner,
+                                int attributes)
+            : PendingSlave(name, predicateType, relation)
+            , m_predicateInstance(predicateInstance)
+            , m_isConstrained(isConstrained)
+            , m_owner(owner)
+            , m_attributes(attributes) {}
+
+        const std::string& getPredicateInstance() const { return m_predicateInstance; }
+        bool isConstrained() const { return m_isConstrained; }
+        ConstrainedVariableId getOwner() const { return m_owner; }
+        int getAttributes() const { return m_attributes; }
+
+    private:
+        std::string m_predicateInstance;
+        bool m_isConstrained;
+        ConstrainedVariableId m_owner; /*!< Rule or token variable, valid for as long as the rule is executed */
+        int m_attributes;
+  };
+
   class InterpretedRuleInstance : public RuleInstance
   {
   	public:
@@ -568,6 +663,8 @@ class TokenEvalContext : public EvalContext {
                    bool isConstrained,
                    ConstrainedVariableId owner);
 
+        void addPendingSubgoal(InterpretedPendingSlave* slave) { addPendingSlave(slave); }
+
         ConstrainedVariableId addLocalVariable(
                        const Domain& baseDomain,
 				       bool canBeSpecified,
@@ -582,14 +679,45 @@ class TokenEvalContext : public EvalContext {
         void executeLoop(EvalContext& evalContext,
                          const std::string& loopVarName,
                          const std::string& valueSet,
-                         const std::vector<Expr*>& loopBody);
+                         const std::vector<Expr*>& loopBody,
+                         unsigned int loopVarSlot = ExprVarRef::NO_SLOT,
+                         const RuleProgram* loopProgram = NULL);
+
+        /**
+         * @brief Execute the body with the given compiled program instead of walking its expressions.
+         */
+        void setProgram(const RuleProgram* program) { m_program = program; }
+
+        /**
+         * @brief The variable for a slot of the rule instance 'depth' parents up. A noId entry
+         * has not been declared or looked up yet.
+         */
+        ConstrainedVariableId& getSlot(unsigned int depth, unsigned int slot);
+
+        /**
+         * @brief Bind a slot of this instance to the variable its name now refers to, or to noId
+         * when the name goes out of scope. Ignores NO_SLOT.
+         */
+        void setSlot(unsigned int slot, const ConstrainedVariableId var);
 
 
     protected:
         std::vector<Expr*> m_body;
+        std::vector<ConstrainedVariableId> m_slots; /*!< Variables resolved for slots bound in the body */
+        const RuleProgram* m_program; /*!< The compiled body, owned by the rule factory. NULL to walk m_body */
 
         virtual void handleExecute();
 
+        /**
+         * @brief Empties the slots, since the variables they hold are deleted with the execution.
+         */
+        virtual void handleUndo();
+
+        /**
+         * @brief Creates a slave recorded by addPendingSubgoal and posts its relation to the master.
+         */
+        virtual TokenId materializeSlave(const PendingSlave& slave);
+
         friend class ExprIf;
         friend class ExprVarRef;
   };
@@ -608,8 +736,23 @@ class TokenEvalContext : public EvalContext {
 
         const std::vector<Expr*>& getBody() const;
 
+        /**
+         * @brief Compile the body so instances execute it on the RuleProgram VM, or discard the
+         * compiled body so instances walk the expressions. Constraint types are resolved in the
+         * given schema. Must be called before any instance is created.
+         */
+        void setCompiled(bool compiled, const CESchemaId& ceSchema);
+        bool isCompiled() const;
+
+        /**
+         * @brief When set, instances record slaves related to the master as pending and create them on first use.
+         */
+        void setLazySlaves(bool lazy) { m_lazySlaves = lazy; }
+
     protected:
         std::vector<Expr*> m_body;
+        bool m_lazySlaves;
+        boost::scoped_ptr<RuleProgram> m_program;
   };
 
   class RuleInstanceEvalContext : public EvalContext
@@ -621,6 +764,7 @@ class TokenEvalContext : public EvalContext {
         virtual void* getElement(const std::string& name) const;
 
         virtual ConstrainedVariableId getVar(const std::string& name);
+        virtual ConstrainedVariableId* getSlot(unsigned int depth, unsigned int slot);
         virtual InterpretedRuleInstanceId getRuleInstance() { return m_ruleInstance; }
 
         virtual TokenId getToken(const std::string& name);
@@ -683,6 +827,17 @@ private:
   virtual DataRef doEval(RuleInstanceEvalContext& context) const;
   virtual std::string toString() const;
 
+  /**
+   * @brief Create the child rule instances for the if and else bodies. Children execute the given
+   * compiled bodies if not NULL.
+   */
+  void evalGuard(RuleInstanceEvalContext& context, const RuleProgram* ifProgram,
+                 const RuleProgram* elseProgram) const;
+
+  ExprIfGuard* getGuard() const {return m_guard;}
+  const std::vector<Expr*>& getIfBody() const {return m_ifBody;}
+  const std::vector<Expr*>& getElseBody() const {return m_elseBody;}
+
  protected:
   ExprIfGuard* m_guard;
   std::vector<Expr*> m_ifBody;
@@ -697,10 +852,17 @@ private:
 
   	    virtual DataRef doEval(RuleInstanceEvalContext& context) const;
 
+        const std::string& getVarName() const {return m_varName;}
+        const std::string& getValueSet() const {return m_varValue;}
+        const std::vector<Expr*>& getBody() const {return m_loopBody;}
+        void bindSlot(unsigned int slot) {m_slot = slot;}
+        unsigned int getSlot() const {return m_slot;}
+
     protected:
         std::string m_varName;
     std::string m_varValue;
         std::vector<Expr*> m_loopBody;
+        unsigned int m_slot;
   };
 
   class NativeTokenType: public TokenType
@@ -715,6 +877,14 @@ private:
 void getVariableReferences(const Expr* expr, EvalContext& ctx,
                            std::vector<ConstrainedVariableId>& dest);
 
+/**
+ * @brief Resolution pass over a rule body, binding each unqualified variable reference to the
+ * (depth, slot) of the rule scope that declares it. Each if/else body is a nested scope, evaluated
+ * by a child rule instance. Names not declared in the rule are bound to the outermost scope, where
+ * token and global variables are found.
+ */
+void bindRuleSlots(const std::vector<Expr*>& body);
+
 }
 
 #endif // H_Interpreter
@@ -6,8 +6,16 @@
  */
 
 #include "NddlInterpreter.hh"
+#include "NddlModelCache.hh"
 
 #include <sys/stat.h>
+#include <pthread.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
 
 #include "NDDL3Lexer.h"
 #include "NDDL3Parser.h"
@@ -16,18 +24,21 @@
 
 #include "ConstraintType.hh"
 #include "CESchema.hh"
+#include "DbClient.hh"
 #include "Debug.hh"
 #include "Utils.hh"
 #include "PathDefs.hh"
+#include "Mutex.hh"
 
 #include <boost/cast.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 
 namespace EUROPA {
 
 NddlInterpreter::NddlInterpreter(EngineId engine) 
-    : m_engine(engine), m_filesread(), m_inputstreams() {}
+    : m_engine(engine), m_filesread(), m_includeMisses(), m_inputstreams() {}
 
 NddlInterpreter::~NddlInterpreter()
 {
@@ -127,8 +138,10 @@ std::string NddlInterpreter::getFilename(const std::string& f)
             debugMsg("NddlInterpreter","Found:" << fullName);
             return fullName;
         }
-        else
+        else {
             debugMsg("NddlInterpreter",fullName << " doesn't exist");
+            m_includeMisses.push_back(fullName);
+        }
     }
 
     return "";
@@ -173,59 +186,475 @@ struct CleanUpSymbolTable {
   NddlSymbolTable* m_end;
 };
 
+// Holds a bulk load scope open on a client, if there is one, until it is closed.  A scope that is
+// never closed, because the load failed, is abandoned without propagating.
+struct BulkLoadScope {
+  BulkLoadScope(const DbClientId client) : m_client(client) {
+    if (m_client.isId())
+      m_client->beginBulkLoad();
+  }
+  ~BulkLoadScope() {
+    if (m_client.isId())
+      m_client->abandonBulkLoad();
+  }
+  // Propagates what was loaded; false if that proves the plan database inconsistent
+  bool close() {
+    if (m_client.isNoId())
+      return true;
+    DbClientId client = m_client;
+    m_client = DbClientId::noId();
+    return client->endBulkLoad();
+  }
+  DbClientId m_client;
+};
+
+/**
+ * The lexer, parser and input of one model, which own the AST they build.
+ */
+class ModelParse {
+public:
+  ModelParse(std::istream& ins, const std::string& source, NddlInterpreter* interpreter)
+      : m_strInput(), m_input(getInputStream(ins,source,m_strInput)), m_closeInput(m_input),
+        m_lexer(NDDL3LexerNew(m_input)), m_freeLexer(m_lexer),
+        m_tstream(NULL), m_parser(NULL), m_tree(NULL) {
+    m_lexer->parserObj = interpreter;
+    m_tstream = antlr3CommonTokenStreamSourceNew(ANTLR3_SIZE_HINT, TOKENSOURCE(m_lexer));
+    m_parser = NDDL3ParserNew(m_tstream);
+  }
+  ModelParse(const std::string& fileName, NddlInterpreter* interpreter)
+      : m_strInput(),
+        m_input(antlr3FileStreamNew(reinterpret_cast<pANTLR3_UINT8>(const_cast<char*>(fileName.c_str())),
+                                    ANTLR3_ENC_8BIT)),
+        m_closeInput(m_input), m_lexer(NDDL3LexerNew(m_input)), m_freeLexer(m_lexer),
+        m_tstream(NULL), m_parser(NULL), m_tree(NULL) {
+    m_lexer->parserObj = interpreter;
+    m_tstream = antlr3CommonTokenStreamSourceNew(ANTLR3_SIZE_HINT, TOKENSOURCE(m_lexer));
+    m_parser = NDDL3ParserNew(m_tstream);
+  }
+  ~ModelParse() {
+    if (m_parser != NULL)
+      m_parser->free(m_parser);
+    if (m_tstream != NULL)
+      m_tstream->free(m_tstream);
+  }
+
+  // Build the AST, throwing PSLanguageExceptionList on lexer or parser errors
+  pANTLR3_BASE_TREE parse() {
+    NDDL3Parser_nddl_return result = m_parser->nddl(m_parser);
+    unsigned int errorCount = m_parser->pParser->rec->state->errorCount +
+                              m_lexer->pLexer->rec->state->errorCount;
+    if (errorCount > 0) {
+      // Since errors are no longer printed during parsing, print them here
+      // to debugMsg
+      std::vector<PSLanguageException> *lerrors = m_lexer->lexerErrors;
+      std::vector<PSLanguageException> *perrors = m_parser->parserErrors;
+      for (std::vector<PSLanguageException>::const_iterator it = lerrors->begin(); it != lerrors->end(); ++it) {
+        debugMsg("NddlInterpreter:interpret", it->asString());
+      }
+      for (std::vector<PSLanguageException>::const_iterator it = perrors->begin(); it != perrors->end(); ++it) {
+        debugMsg("NddlInterpreter:interpret", it->asString());
+      }
+      // Copy errors over
+      std::vector<PSLanguageException> all(*lerrors);
+      for (std::vector<PSLanguageException>::const_iterator it = perrors->begin(); it != perrors->end(); ++it)
+        all.push_back(*it);
+
+      debugMsg("NddlInterpreter:interpret", "Interpreter returned errors");
+
+      // Now throw the whole thing
+      throw PSLanguageExceptionList(all);
+    }
+    m_tree = result.tree;
+    return m_tree;
+  }
+
+private:
+  ModelParse(const ModelParse&);
+  ModelParse& operator=(const ModelParse&);
+
+  std::string m_strInput;
+  pANTLR3_INPUT_STREAM m_input;
+  CallClose<pANTLR3_INPUT_STREAM> m_closeInput;
+  pNDDL3Lexer m_lexer;
+  CallFree<pNDDL3Lexer> m_freeLexer;
+  pANTLR3_COMMON_TOKEN_STREAM m_tstream;
+  pNDDL3Parser m_parser;
+  pANTLR3_BASE_TREE m_tree;
+};
+
+namespace {
+/**
+ * An #include directive, at the position of its '#'.
+ */
+struct IncludeDirective {
+  ANTLR3_UINT32 line;
+  ANTLR3_INT32 charPosition;
+  std::string fileName; /*!< As resolved against the include path */
+};
+
+bool isNddlSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f';
+}
+
+/**
+ * A position in the text of an nddl file, which keeps the lexer's line and column.
+ */
+class ScanPosition {
+public:
+  ScanPosition(const std::string& text) : m_text(text), m_pos(0), m_line(1), m_charPosition(0) {}
+
+  bool atEnd() const {return m_pos >= m_text.size();}
+  char get() const {return m_text[m_pos];}
+  bool startsWith(const char* str) const {return m_text.compare(m_pos, std::strlen(str), str) == 0;}
+  std::string::size_type offset() const {return m_pos;}
+  ANTLR3_UINT32 line() const {return m_line;}
+  ANTLR3_INT32 charPosition() const {return m_charPosition;}
+
+  // Step over count characters, or to the end of the text
+  void advance(std::string::size_type count = 1) {
+    for (; count > 0 && !atEnd(); --count, ++m_pos) {
+      if (m_text[m_pos] == '\n') {
+        m_line++;
+        m_charPosition = 0;
+      }
+      else
+        m_charPosition++;
+    }
+  }
+
+private:
+  const std::string& m_text;
+  std::string::size_type m_pos;
+  ANTLR3_UINT32 m_line;
+  ANTLR3_INT32 m_charPosition;
+};
+
+/**
+ * Find the quoted names in the #include directives of an nddl file, skipping comments and
+ * string literals the way the lexer does.
+ */
+bool scanIncludes(const std::string& fileName, std::vector<std::pair<IncludeDirective, std::string> >& includes) {
+  std::ifstream in(fileName.c_str(), std::ios::in | std::ios::binary);
+  if (!in.good())
+    return false;
+  const std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  ScanPosition pos(text);
+  while (!pos.atEnd()) {
+    if (pos.startsWith("//")) {
+      while (!pos.atEnd() && pos.get() != '\n')
+        pos.advance();
+    }
+    else if (pos.startsWith("/*")) {
+      pos.advance(2);
+      while (!pos.atEnd() && !pos.startsWith("*/"))
+        pos.advance();
+      pos.advance(2);
+    }
+    else if (pos.get() == '"') {
+      pos.advance();
+      while (!pos.atEnd() && pos.get() != '"')
+        pos.advance(pos.get() == '\\' ? 2 : 1);
+      pos.advance();
+    }
+    else if (pos.startsWith("#include")) {
+      IncludeDirective directive;
+      directive.line = pos.line();
+      directive.charPosition = pos.charPosition();
+      pos.advance(8);
+      std::string::size_type start = pos.offset();
+      while (!pos.atEnd() && isNddlSpace(pos.get()))
+        pos.advance();
+      if (pos.offset() == start || pos.atEnd() || pos.get() != '"')
+        return false;
+      std::string::size_type nameStart = pos.offset();
+      pos.advance();
+      while (!pos.atEnd() && pos.get() != '"')
+        pos.advance();
+      if (pos.atEnd())
+        return false;
+      pos.advance();
+      includes.push_back(std::make_pair(directive, text.substr(nameStart, pos.offset() - nameStart)));
+    }
+    else
+      pos.advance();
+  }
+  return true;
+}
+
+/**
+ * The include guard of one lexer in a parallel parse. It holds every file of the model, so the lexer
+ * never stacks another file's input, and answers include lookups from the names resolved before the
+ * threads started, so lexers on different threads share nothing that changes.
+ */
+class ResolvedIncludeGuard : public NddlInterpreter {
+public:
+  ResolvedIncludeGuard(const EngineId engine, const std::map<std::string, std::string>& resolved,
+                       const std::vector<std::string>& files, const std::vector<std::string>& includePath)
+      : NddlInterpreter(engine), m_resolved(resolved), m_includePath(includePath) {
+    m_filesread = files;
+  }
+
+  std::string getFilename(const std::string& f) {
+    std::map<std::string, std::string>::const_iterator it = m_resolved.find(f);
+    return it == m_resolved.end() ? "" : it->second;
+  }
+
+  std::vector<std::string> getIncludePath() {return m_includePath;}
+
+private:
+  const std::map<std::string, std::string>& m_resolved;
+  const std::vector<std::string>& m_includePath;
+};
+}
+
+/**
+ * Parses a model file and the files it includes concurrently, then splices their ASTs into the
+ * tree a serial parse would have built, with each included file's statements in place of the
+ * #include that first reached it.
+ *
+ * Every include is resolved before the threads start. Each file is then lexed and parsed on its own,
+ * with its own ResolvedIncludeGuard. The interpreter's include guard is only updated by the splice,
+ * in include order, after the threads are done.
+ */
+class ParallelModelParse {
+public:
+  ParallelModelParse(const std::string& source, NddlInterpreter* interpreter, unsigned int threadCount)
+      : m_source(source), m_interpreter(interpreter), m_threadCount(threadCount), m_files(),
+        m_fileIndex(), m_resolved(), m_includePath(), m_next(0), m_failed(false),
+        m_strFactory(antlr3StringFactoryNew(ANTLR3_ENC_8BIT)),
+        m_adaptor(ANTLR3_TREE_ADAPTORNew(m_strFactory)) {
+    pthread_mutex_init(&m_mutex, NULL);
+  }
+  ~ParallelModelParse() {
+    for (std::vector<FileParse*>::iterator it = m_files.begin(); it != m_files.end(); ++it)
+      delete *it;
+    m_adaptor->free(m_adaptor);
+    m_strFactory->close(m_strFactory);
+    pthread_mutex_destroy(&m_mutex);
+  }
+
+  /**
+   * Build the AST, throwing PSLanguageExceptionList on lexer or parser errors.
+   * @return NULL if the include graph couldn't be discovered, so the model should be parsed serially.
+   */
+  pANTLR3_BASE_TREE parse() {
+    if (!discover())
+      return NULL;
+
+    std::vector<pthread_t> threads(std::min<size_t>(m_threadCount, m_files.size()));
+    size_t started = 0;
+    for (; started < threads.size(); ++started) {
+      if (pthread_create(&threads[started], NULL, &ParallelModelParse::work, this) != 0)
+        break;
+    }
+    if (started == 0)
+      work(this);
+    for (size_t i = 0; i < started; ++i)
+      pthread_join(threads[i], NULL);
+
+    if (m_failed)
+      return NULL;
+    std::vector<PSLanguageException> errors;
+    for (std::vector<FileParse*>::const_iterator it = m_files.begin(); it != m_files.end(); ++it)
+      errors.insert(errors.end(), (*it)->errors.begin(), (*it)->errors.end());
+    if (!errors.empty())
+      throw PSLanguageExceptionList(errors);
+
+    pANTLR3_BASE_TREE rootTree = m_files.front()->tree;
+    pANTLR3_BASE_TREE root = m_adaptor->createTypeText(m_adaptor, rootTree->getType(rootTree),
+                                                       rootTree->getText(rootTree)->chars);
+    splice(*m_files.front(), root);
+    debugMsg("NddlInterpreter:parallelParse",
+             "Parsed " << m_files.size() << " files on " << std::max<size_t>(started, 1) << " threads");
+    return root;
+  }
+
+private:
+  ParallelModelParse(const ParallelModelParse&);
+  ParallelModelParse& operator=(const ParallelModelParse&);
+
+  struct FileParse {
+    FileParse(const std::string& name)
+        : fileName(name), includes(), guard(NULL), parse(NULL), tree(NULL), errors() {}
+    ~FileParse() {
+      delete parse;
+      delete guard;
+    }
+    std::string fileName;
+    std::vector<IncludeDirective> includes;
+    ResolvedIncludeGuard* guard; /*!< Only used by the thread that parses the file */
+    ModelParse* parse;
+    pANTLR3_BASE_TREE tree;
+    std::vector<PSLanguageException> errors;
+  };
+
+  // Find every file reachable through #include from the source that isn't already read
+  bool discover() {
+    m_includePath = m_interpreter->getIncludePath();
+    addFile(m_source);
+    for (size_t i = 0; i < m_files.size(); ++i) {
+      std::vector<std::pair<IncludeDirective, std::string> > found;
+      if (!scanIncludes(m_files[i]->fileName, found)) {
+        debugMsg("NddlInterpreter:parallelParse", "Failed to scan includes of " << m_files[i]->fileName);
+        return false;
+      }
+      for (std::vector<std::pair<IncludeDirective, std::string> >::iterator it = found.begin();
+           it != found.end(); ++it) {
+        std::map<std::string, std::string>::const_iterator resolved = m_resolved.find(it->second);
+        if (resolved == m_resolved.end())
+          resolved = m_resolved.insert(std::make_pair(it->second, m_interpreter->getFilename(it->second))).first;
+        it->first.fileName = resolved->second;
+        if (it->first.fileName.empty()) {
+          debugMsg("NddlInterpreter:parallelParse", "Failed to find " << it->second);
+          return false;
+        }
+        m_files[i]->includes.push_back(it->first);
+        if (!m_interpreter->queryIncludeGuard(it->first.fileName) &&
+            m_fileIndex.find(it->first.fileName) == m_fileIndex.end())
+          addFile(it->first.fileName);
+      }
+    }
+
+    // Every lexer's guard holds every included file, so none stacks another file's input
+    std::vector<std::string> includedFiles;
+    for (std::map<std::string, std::string>::const_iterator it = m_resolved.begin(); it != m_resolved.end(); ++it)
+      includedFiles.push_back(it->second);
+    for (std::vector<FileParse*>::iterator it = m_files.begin(); it != m_files.end(); ++it)
+      (*it)->guard = new ResolvedIncludeGuard(m_interpreter->getEngine(), m_resolved, includedFiles, m_includePath);
+    return true;
+  }
+
+  void addFile(const std::string& fileName) {
+    m_fileIndex.insert(std::make_pair(fileName, m_files.size()));
+    m_files.push_back(new FileParse(fileName));
+  }
+
+  static void* work(void* arg) {
+    ParallelModelParse* self = static_cast<ParallelModelParse*>(arg);
+    while (true) {
+      FileParse* file = NULL;
+      {
+        MutexGrabber grabber(self->m_mutex);
+        if (self->m_next == self->m_files.size() || self->m_failed)
+          return NULL;
+        file = self->m_files[self->m_next++];
+      }
+      try {
+        file->parse = new ModelParse(file->fileName, file->guard);
+        file->tree = file->parse->parse();
+      }
+      catch (const PSLanguageExceptionList& exceptions) {
+        for (long i = 0; i < exceptions.getExceptionCount(); ++i)
+          file->errors.push_back(exceptions.getException(static_cast<int>(i)));
+      }
+      catch (...) {
+        MutexGrabber grabber(self->m_mutex);
+        self->m_failed = true;
+      }
+    }
+  }
+
+  // Append the statements of file to root, expanding includes that haven't been read yet
+  void splice(const FileParse& file, pANTLR3_BASE_TREE root) {
+    std::vector<IncludeDirective>::const_iterator include = file.includes.begin();
+    ANTLR3_UINT32 count = file.tree->getChildCount(file.tree);
+    for (ANTLR3_UINT32 i = 0; i < count; ++i) {
+      pANTLR3_BASE_TREE child = static_cast<pANTLR3_BASE_TREE>(file.tree->getChild(file.tree, i));
+      ANTLR3_UINT32 line = child->getLine(child);
+      ANTLR3_INT32 charPosition = child->getCharPositionInLine(child);
+      for (; include != file.includes.end() &&
+               (include->line < line || (include->line == line && include->charPosition < charPosition));
+           ++include)
+        spliceInclude(*include, root);
+      m_adaptor->addChild(m_adaptor, root, child);
+    }
+    for (; include != file.includes.end(); ++include)
+      spliceInclude(*include, root);
+  }
+
+  void spliceInclude(const IncludeDirective& include, pANTLR3_BASE_TREE root) {
+    if (m_interpreter->queryIncludeGuard(include.fileName))
+      return;
+    m_interpreter->addInclude(include.fileName);
+    std::map<std::string, size_t>::const_iterator it = m_fileIndex.find(include.fileName);
+    checkError(it != m_fileIndex.end(), "No parse of " << include.fileName);
+    splice(*m_files[it->second], root);
+  }
+
+  std::string m_source;
+  NddlInterpreter* m_interpreter;
+  unsigned int m_threadCount;
+  std::vector<FileParse*> m_files; /*!< In the order they were discovered, source first */
+  std::map<std::string, size_t> m_fileIndex;
+  std::map<std::string, std::string> m_resolved; /*!< Quoted include names, and the files they resolve to */
+  std::vector<std::string> m_includePath;
+  size_t m_next; /*!< The next file to parse */
+  bool m_failed;
+  pthread_mutex_t m_mutex;
+  pANTLR3_STRING_FACTORY m_strFactory;
+  pANTLR3_BASE_TREE_ADAPTOR m_adaptor;
+};
+
+unsigned int NddlInterpreter::getParseThreadCount(const std::string& source) {
+  if (source == "<eval>")
+    return 1;
+  int count = std::atoi(getEngine()->getConfig()->getProperty("nddl.parseThreads").c_str());
+  return count > 1 ? static_cast<unsigned int>(count) : 1;
+}
+
+bool NddlInterpreter::useBulkLoad(const std::string& source) {
+  return source != "<eval>" && getEngine()->getConfig()->getProperty("nddl.bulkLoad") == "true";
+}
+
+NddlModelCache* NddlInterpreter::getModelCache(const std::string& source) {
+  const std::string& directory = getEngine()->getConfig()->getProperty("nddl.modelCache");
+  // An image holds every file a model includes, so it is only valid if none were read before
+  if (directory.empty() || source == "<eval>" || !m_filesread.empty())
+    return NULL;
+  return new NddlModelCache(directory, getIncludePath());
+}
+
 std::string NddlInterpreter::interpret(std::istream& ins, const std::string& source) {
   if (queryIncludeGuard(source))
   {
     debugMsg("NddlInterpreter:error", "Ignoring root file: " << source << ". Bug?");
     return "";
   }
+  boost::scoped_ptr<NddlModelCache> cache(getModelCache(source));
   addInclude(source);
 
-  std::string strInput;
-  pANTLR3_INPUT_STREAM input = getInputStream(ins,source,strInput);
-  CallClose<pANTLR3_INPUT_STREAM> closeInput(input);
-
-  pNDDL3Lexer lexer = NDDL3LexerNew(input);
-  CallFree<pNDDL3Lexer> freeLexer(lexer);
-  lexer->parserObj = this;
-  pANTLR3_COMMON_TOKEN_STREAM tstream = antlr3CommonTokenStreamSourceNew(ANTLR3_SIZE_HINT, TOKENSOURCE(lexer));
-  CallFree<pANTLR3_COMMON_TOKEN_STREAM> freeTstream(tstream);
-  pNDDL3Parser parser = NDDL3ParserNew(tstream);
-  CallFree<pNDDL3Parser> freeParser(parser);
-
-  // Build he AST
-  NDDL3Parser_nddl_return result = parser->nddl(parser);
-  unsigned int errorCount = parser->pParser->rec->state->errorCount +
-                            lexer->pLexer->rec->state->errorCount;
-  if (errorCount > 0) {
-    // Since errors are no longer printed during parsing, print them here
-    // to debugMsg
-    std::vector<PSLanguageException> *lerrors = lexer->lexerErrors;
-    std::vector<PSLanguageException> *perrors = parser->parserErrors;
-    for (std::vector<PSLanguageException>::const_iterator it = lerrors->begin(); it != lerrors->end(); ++it) {
-      debugMsg("NddlInterpreter:interpret", it->asString());
+  pANTLR3_BASE_TREE tree = NULL;
+  if (cache.get() != NULL) {
+    std::vector<std::string> files;
+    tree = cache->load(source, files);
+    for (std::vector<std::string>::const_iterator it = files.begin(); it != files.end(); ++it) {
+      if (!queryIncludeGuard(*it))
+        addInclude(*it);
     }
-    for (std::vector<PSLanguageException>::const_iterator it = perrors->begin(); it != perrors->end(); ++it) {
-      debugMsg("NddlInterpreter:interpret", it->asString());
-    }
-    // Copy errors over
-    std::vector<PSLanguageException> all(*lerrors);
-    for (std::vector<PSLanguageException>::const_iterator it = perrors->begin(); it != perrors->end(); ++it)
-      all.push_back(*it);
-
-    debugMsg("NddlInterpreter:interpret", "Interpreter returned errors");
+  }
 
-    // Now throw the whole thing
-    throw PSLanguageExceptionList(all);
+  boost::scoped_ptr<ParallelModelParse> parallelParse;
+  unsigned int threadCount = getParseThreadCount(source);
+  if (tree == NULL && threadCount > 1) {
+    parallelParse.reset(new ParallelModelParse(source, this, threadCount));
+    tree = parallelParse->parse();
   }
-  else {
-    condDebugMsg(result.tree->toStringTree(result.tree) != NULL, "NddlInterpreter:interpret",
-                 "NDDL AST:\n" << result.tree->toStringTree(result.tree)->chars);
-    condDebugMsg(result.tree->toStringTree(result.tree) == NULL, "NddlInterpreter:interpret", "Empty NDDL AST.");
+
+  boost::scoped_ptr<ModelParse> parse;
+  if (tree == NULL) {
+    parse.reset(new ModelParse(ins, source, this));
+    tree = parse->parse();
   }
+  if (cache.get() != NULL && tree != NULL && (parse.get() != NULL || parallelParse.get() != NULL))
+    cache->store(source, m_filesread, m_includeMisses, tree);
+
+  condDebugMsg(tree->toStringTree(tree) != NULL, "NddlInterpreter:interpret",
+               "NDDL AST:\n" << tree->toStringTree(tree)->chars);
+  condDebugMsg(tree->toStringTree(tree) == NULL, "NddlInterpreter:interpret", "Empty NDDL AST.");
 
   // Walk the AST to create nddl expr to evaluate
-  pANTLR3_COMMON_TREE_NODE_STREAM nodeStream = antlr3CommonTreeNodeStreamNewTree(result.tree, ANTLR3_SIZE_HINT);
+  pANTLR3_COMMON_TREE_NODE_STREAM nodeStream = antlr3CommonTreeNodeStreamNewTree(tree, ANTLR3_SIZE_HINT);
   CallFree<pANTLR3_COMMON_TREE_NODE_STREAM> freeNodeStream(nodeStream);
   pNDDL3Tree treeParser = NDDL3TreeNew(nodeStream);
   CallFree<pNDDL3Tree> freeTreeParser(treeParser);
@@ -234,9 +663,12 @@ std::string NddlInterpreter::interpret(std::istream& ins, const std::string& sou
   treeParser->SymbolTable = &symbolTable;
   CleanUpSymbolTable cleanUpSymbolTable(treeParser, &symbolTable);
   CleanUpInputStreams cleanInputStreams(m_inputstreams);
+  BulkLoadScope bulkLoad(useBulkLoad(source) ? symbolTable.getPlanDatabase()->getClient() : DbClientId::noId());
   try {
     treeParser->nddl(treeParser);
     // TODO: report treeParser antlr errors the same way we do it for tree builder lexer and parser
+    if (!bulkLoad.close())
+      symbolTable.addError("The plan database is inconsistent after loading " + source);
   }
   catch (const std::string&) {
     debugMsg("NddlInterpreter:error",
@@ -322,6 +754,16 @@ void* NddlSymbolTable::getElement(const std::string& name) const
     return EvalContext::getElement(name);
 }
 
+bool NddlSymbolTable::lazySlaves() const
+{
+    return engine()->getConfig()->getProperty("nddl.lazySlaves") == "true";
+}
+
+bool NddlSymbolTable::compileRules() const
+{
+    return engine()->getConfig()->getProperty("nddl.compileRules") == "true";
+}
+
 const PlanDatabaseId NddlSymbolTable::getPlanDatabase() const
 {
   return (reinterpret_cast<PlanDatabase*>(getElement("PlanDatabase")))->getId();
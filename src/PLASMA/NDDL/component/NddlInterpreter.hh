@@ -17,6 +17,8 @@
 
 namespace EUROPA {
 
+class NddlModelCache;
+
 class NddlSymbolTable : public EvalContext {
 private:
   NddlSymbolTable(const NddlSymbolTable&);
@@ -47,6 +49,12 @@ private:
 
   virtual CFunctionId getCFunction(const std::string& name, const std::vector<CExpr*>& args);
 
+  // True if slave tokens should defer their body constraints until activation ("nddl.lazySlaves")
+  bool lazySlaves() const;
+
+  // True if rule bodies should be compiled instead of walked by the tree interpreter ("nddl.compileRules")
+  bool compileRules() const;
+
   Domain* makeNumericDomainFromLiteral(const std::string& type,const std::string& value);
 
   void checkConstraint(const std::string& name,const std::vector<Expr*>& args);
@@ -138,16 +146,27 @@ public:
     virtual ~NddlInterpreter();
     virtual std::string interpret(std::istream& input, const std::string& source);
 
-    std::string getFilename(const std::string& f);
+    virtual std::string getFilename(const std::string& f);
     bool queryIncludeGuard(const std::string& f);
     void addInclude(const std::string &f);
 
-    std::vector<std::string> getIncludePath();
+    virtual std::vector<std::string> getIncludePath();
     void addInputStream(pANTLR3_INPUT_STREAM in);
 
 protected:
+    // The image cache for source, if "nddl.modelCache" names a directory and nothing was read before it
+    NddlModelCache* getModelCache(const std::string& source);
+
+    // The number of threads "nddl.parseThreads" allows for parsing source and its includes. 1 parses serially.
+    unsigned int getParseThreadCount(const std::string& source);
+
+    // True if "nddl.bulkLoad" asks for source to be evaluated in one DbClient bulk load scope,
+    // so the initial state is propagated once, after its last statement
+    bool useBulkLoad(const std::string& source);
+
     EngineId m_engine;
     std::vector<std::string> m_filesread;
+    std::vector<std::string> m_includeMisses; /*!< Paths getFilename tried and found no file at */
   std::vector<pANTLR3_INPUT_STREAM> m_inputstreams;
 };
 
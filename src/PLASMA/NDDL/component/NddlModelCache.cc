@@ -0,0 +1,424 @@
+#include "NddlModelCache.hh"
+
+#include "Debug.hh"
+#include "Error.hh"
+#include "PathDefs.hh"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdint.h>
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @file NddlModelCache.cc
+ * @brief Reading and writing of model images.
+ *
+ * An image is laid out as a header, the table of files, the table of include misses, the nodes of
+ * the AST in pre-order and a pool holding file names, misses and node text. All offsets are into
+ * the pool.
+ */
+
+namespace EUROPA {
+
+namespace {
+
+const char IMAGE_MAGIC[8] = {'N', 'D', 'D', 'L', 'A', 'S', 'T', '\0'};
+const uint32_t IMAGE_VERSION = 2;
+const uint32_t IMAGE_BYTE_ORDER = 0x01020304;
+const uint32_t NO_FILE = 0xffffffff;
+const uint32_t NIL_NODE = 0x1;
+
+struct ImageHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint64_t contentHash;
+  uint32_t fileCount;
+  uint32_t nodeCount;
+  uint32_t stringBytes;
+  uint32_t missCount;
+};
+
+// A file the model was read from, or a path include resolution found no file at
+struct ImageFile {
+  uint32_t offset;
+  uint32_t length;
+};
+
+struct ImageNode {
+  uint32_t type;
+  uint32_t line;
+  int32_t charPosition;
+  uint32_t childCount;
+  uint32_t file;
+  uint32_t textOffset;
+  uint32_t textLength;
+  uint32_t flags;
+};
+
+const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+void fnv(uint64_t& hash, const char* data, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= FNV_PRIME;
+  }
+}
+
+void fnv(uint64_t& hash, const std::string& str) {
+  fnv(hash, str.c_str(), str.size() + 1);
+}
+
+/**
+ * A read-only view of a whole file, mapped where possible.
+ */
+class MappedImage {
+public:
+  MappedImage(const std::string& path) : m_data(NULL), m_size(0), m_buffer() {
+#ifdef _MSC_VER
+    std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+    if (!in.good())
+      return;
+    m_buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    if (!m_buffer.empty()) {
+      m_data = &m_buffer[0];
+      m_size = m_buffer.size();
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void* addr = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr != MAP_FAILED) {
+        m_data = static_cast<const char*>(addr);
+        m_size = static_cast<size_t>(st.st_size);
+      }
+    }
+    close(fd);
+#endif
+  }
+
+  ~MappedImage() {
+#ifndef _MSC_VER
+    if (m_data != NULL)
+      munmap(const_cast<char*>(m_data), m_size);
+#endif
+  }
+
+  const char* data() const {return m_data;}
+  size_t size() const {return m_size;}
+
+private:
+  MappedImage(const MappedImage&);
+  MappedImage& operator=(const MappedImage&);
+
+  const char* m_data;
+  size_t m_size;
+  std::vector<char> m_buffer;
+};
+
+uint32_t addString(std::string& pool, const char* str, size_t length) {
+  uint32_t offset = static_cast<uint32_t>(pool.size());
+  pool.append(str, length);
+  return offset;
+}
+
+ImageFile addPath(std::string& pool, const std::string& path) {
+  ImageFile file;
+  file.offset = addString(pool, path.c_str(), path.size());
+  file.length = static_cast<uint32_t>(path.size());
+  return file;
+}
+
+bool pathExists(const std::string& path) {
+#ifdef _MSC_VER
+  std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+  return in.good();
+#else
+  struct stat st;
+  return stat(path.c_str(), &st) == 0;
+#endif
+}
+
+void appendNodes(pANTLR3_BASE_TREE tree, const std::map<std::string, uint32_t>& fileIndex,
+                 std::vector<ImageNode>& nodes, std::string& pool) {
+  ImageNode node;
+  std::memset(&node, 0, sizeof(ImageNode));
+  node.childCount = tree->getChildCount(tree);
+  node.file = NO_FILE;
+
+  if (tree->isNilNode(tree) == ANTLR3_TRUE)
+    node.flags = NIL_NODE;
+  else {
+    node.type = tree->getType(tree);
+    node.line = tree->getLine(tree);
+    node.charPosition = tree->getCharPositionInLine(tree);
+
+    pANTLR3_STRING text = tree->getText(tree);
+    if (text != NULL && text->chars != NULL) {
+      size_t length = std::strlen(reinterpret_cast<const char*>(text->chars));
+      node.textOffset = addString(pool, reinterpret_cast<const char*>(text->chars), length);
+      node.textLength = static_cast<uint32_t>(length);
+    }
+
+    pANTLR3_COMMON_TOKEN token = tree->getToken(tree);
+    if (token != NULL && token->input != NULL && token->input->fileName != NULL) {
+      std::map<std::string, uint32_t>::const_iterator it =
+          fileIndex.find(reinterpret_cast<const char*>(token->input->fileName->chars));
+      if (it != fileIndex.end())
+        node.file = it->second;
+    }
+  }
+  nodes.push_back(node);
+
+  for (ANTLR3_UINT32 i = 0; i < node.childCount; ++i)
+    appendNodes(static_cast<pANTLR3_BASE_TREE>(tree->getChild(tree, i)), fileIndex, nodes, pool);
+}
+
+}
+
+NddlModelCache::NddlModelCache(const std::string& directory,
+                               const std::vector<std::string>& includePath)
+    : m_directory(directory), m_includePath(includePath),
+      m_strFactory(antlr3StringFactoryNew(ANTLR3_ENC_8BIT)),
+      m_adaptor(ANTLR3_TREE_ADAPTORNew(m_strFactory)), m_streams() {}
+
+NddlModelCache::~NddlModelCache() {
+  for (std::vector<pANTLR3_INPUT_STREAM>::iterator it = m_streams.begin(); it != m_streams.end(); ++it) {
+    if (*it != NULL)
+      (*it)->close(*it);
+  }
+  m_adaptor->free(m_adaptor);
+  m_strFactory->close(m_strFactory);
+}
+
+std::string NddlModelCache::getImagePath(const std::string& source) const {
+  uint64_t hash = FNV_OFFSET;
+  fnv(hash, source);
+
+  std::string::size_type slash = source.find_last_of("/\\");
+  std::ostringstream os;
+  os << m_directory << PATH_STR << (slash == std::string::npos ? source : source.substr(slash + 1))
+     << "." << std::hex << hash << ".nddlc";
+  return os.str();
+}
+
+bool NddlModelCache::hashContents(const std::vector<std::string>& files,
+                                  unsigned long long& result) const {
+  uint64_t hash = FNV_OFFSET;
+  for (std::vector<std::string>::const_iterator it = m_includePath.begin(); it != m_includePath.end(); ++it)
+    fnv(hash, *it);
+
+  char buffer[65536];
+  for (std::vector<std::string>::const_iterator it = files.begin(); it != files.end(); ++it) {
+    std::ifstream in(it->c_str(), std::ios::in | std::ios::binary);
+    if (!in.good())
+      return false;
+    fnv(hash, *it);
+    while (in.good()) {
+      in.read(buffer, sizeof(buffer));
+      fnv(hash, buffer, static_cast<size_t>(in.gcount()));
+    }
+  }
+  result = hash;
+  return true;
+}
+
+pANTLR3_BASE_TREE NddlModelCache::load(const std::string& source, std::vector<std::string>& files) {
+  std::string path = getImagePath(source);
+  MappedImage image(path);
+  if (image.data() == NULL || image.size() < sizeof(ImageHeader)) {
+    debugMsg("NddlModelCache:load", "No image for " << source << " at " << path);
+    return NULL;
+  }
+
+  const ImageHeader* header = reinterpret_cast<const ImageHeader*>(image.data());
+  if (std::memcmp(header->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0 ||
+      header->version != IMAGE_VERSION || header->byteOrder != IMAGE_BYTE_ORDER) {
+    debugMsg("NddlModelCache:load", "Ignoring incompatible image " << path);
+    return NULL;
+  }
+
+  size_t filesStart = sizeof(ImageHeader);
+  size_t missesStart = filesStart + header->fileCount * sizeof(ImageFile);
+  size_t nodesStart = missesStart + header->missCount * sizeof(ImageFile);
+  size_t poolStart = nodesStart + header->nodeCount * sizeof(ImageNode);
+  if (header->fileCount == 0 || header->nodeCount == 0 || poolStart + header->stringBytes != image.size()) {
+    debugMsg("NddlModelCache:load", "Ignoring truncated image " << path);
+    return NULL;
+  }
+
+  const ImageFile* imageFiles = reinterpret_cast<const ImageFile*>(image.data() + filesStart);
+  const ImageFile* imageMisses = reinterpret_cast<const ImageFile*>(image.data() + missesStart);
+  const ImageNode* nodes = reinterpret_cast<const ImageNode*>(image.data() + nodesStart);
+  const char* pool = image.data() + poolStart;
+
+  std::vector<std::string> imageFileNames;
+  for (uint32_t i = 0; i < header->fileCount; ++i) {
+    if (imageFiles[i].offset + imageFiles[i].length > header->stringBytes)
+      return NULL;
+    imageFileNames.push_back(std::string(pool + imageFiles[i].offset, imageFiles[i].length));
+  }
+  if (imageFileNames.front() != source)
+    return NULL;
+
+  unsigned long long hash = 0;
+  if (!hashContents(imageFileNames, hash) || hash != header->contentHash) {
+    debugMsg("NddlModelCache:load", "Image " << path << " is out of date");
+    return NULL;
+  }
+
+  // An include that resolves differently now may name another file
+  for (uint32_t i = 0; i < header->missCount; ++i) {
+    if (imageMisses[i].offset + imageMisses[i].length > header->stringBytes)
+      return NULL;
+    std::string miss(pool + imageMisses[i].offset, imageMisses[i].length);
+    if (pathExists(miss)) {
+      debugMsg("NddlModelCache:load", "Image " << path << " is out of date, " << miss << " now exists");
+      return NULL;
+    }
+  }
+
+  size_t streamBase = m_streams.size();
+  for (std::vector<std::string>::const_iterator it = imageFileNames.begin(); it != imageFileNames.end(); ++it)
+    m_streams.push_back(antlr3StringStreamNew(reinterpret_cast<pANTLR3_UINT8>(const_cast<char*>("")),
+                                              ANTLR3_ENC_8BIT, 0,
+                                              reinterpret_cast<pANTLR3_UINT8>(const_cast<char*>(it->c_str()))));
+
+  // Rebuild in pre-order, keeping the parents whose children are still to come
+  pANTLR3_BASE_TREE root = NULL;
+  std::vector<std::pair<pANTLR3_BASE_TREE, uint32_t> > parents;
+  for (uint32_t i = 0; i < header->nodeCount; ++i) {
+    const ImageNode& node = nodes[i];
+    if (node.textOffset + node.textLength > header->stringBytes ||
+        (node.file != NO_FILE && node.file >= header->fileCount) ||
+        (root != NULL && parents.empty())) {
+      debugMsg("NddlModelCache:load", "Ignoring corrupt image " << path);
+      return NULL;
+    }
+
+    pANTLR3_BASE_TREE tree = NULL;
+    if (node.flags & NIL_NODE)
+      tree = static_cast<pANTLR3_BASE_TREE>(m_adaptor->nilNode(m_adaptor));
+    else {
+      std::string text(pool + node.textOffset, node.textLength);
+      tree = m_adaptor->createTypeText(m_adaptor, node.type,
+                                       reinterpret_cast<pANTLR3_UINT8>(const_cast<char*>(text.c_str())));
+      pANTLR3_COMMON_TOKEN token = tree->getToken(tree);
+      token->setLine(token, node.line);
+      token->setCharPositionInLine(token, node.charPosition);
+      if (node.file != NO_FILE)
+        token->input = m_streams[streamBase + node.file];
+    }
+
+    if (root == NULL)
+      root = tree;
+    else {
+      m_adaptor->addChild(m_adaptor, parents.back().first, tree);
+      parents.back().second--;
+    }
+
+    if (node.childCount > 0)
+      parents.push_back(std::make_pair(tree, node.childCount));
+    while (!parents.empty() && parents.back().second == 0)
+      parents.pop_back();
+  }
+
+  if (!parents.empty()) {
+    debugMsg("NddlModelCache:load", "Ignoring corrupt image " << path);
+    return NULL;
+  }
+
+  debugMsg("NddlModelCache:load", "Loaded " << header->nodeCount << " nodes from " << path);
+  files = imageFileNames;
+  return root;
+}
+
+void NddlModelCache::store(const std::string& source, const std::vector<std::string>& files,
+                           const std::vector<std::string>& misses, pANTLR3_BASE_TREE tree) {
+  checkError(!files.empty() && files.front() == source,
+             "The files of a model must start with its root " << source);
+
+  ImageHeader header;
+  std::memset(&header, 0, sizeof(ImageHeader));
+  std::memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+  header.version = IMAGE_VERSION;
+  header.byteOrder = IMAGE_BYTE_ORDER;
+
+  unsigned long long hash = 0;
+  if (!hashContents(files, hash)) {
+    debugMsg("NddlModelCache:store", "Not caching " << source << ", its files can't be read");
+    return;
+  }
+  header.contentHash = hash;
+
+  std::string pool;
+  std::vector<ImageFile> imageFiles;
+  std::map<std::string, uint32_t> fileIndex;
+  for (std::vector<std::string>::const_iterator it = files.begin(); it != files.end(); ++it) {
+    fileIndex.insert(std::make_pair(*it, static_cast<uint32_t>(imageFiles.size())));
+    imageFiles.push_back(addPath(pool, *it));
+  }
+
+  std::vector<ImageFile> imageMisses;
+  std::set<std::string> missSet(misses.begin(), misses.end());
+  for (std::set<std::string>::const_iterator it = missSet.begin(); it != missSet.end(); ++it)
+    imageMisses.push_back(addPath(pool, *it));
+
+  std::vector<ImageNode> nodes;
+  appendNodes(tree, fileIndex, nodes, pool);
+
+  header.fileCount = static_cast<uint32_t>(imageFiles.size());
+  header.nodeCount = static_cast<uint32_t>(nodes.size());
+  header.stringBytes = static_cast<uint32_t>(pool.size());
+  header.missCount = static_cast<uint32_t>(imageMisses.size());
+
+  // Write beside the image and rename, so a reader never sees a partial image
+  std::string path = getImagePath(source);
+  std::string tmpPath = path + ".tmp";
+  {
+    std::ofstream out(tmpPath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.good()) {
+      debugMsg("NddlModelCache:store", "Not caching " << source << ", can't write " << tmpPath);
+      return;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(ImageHeader));
+    out.write(reinterpret_cast<const char*>(&imageFiles[0]), imageFiles.size() * sizeof(ImageFile));
+    if (!imageMisses.empty())
+      out.write(reinterpret_cast<const char*>(&imageMisses[0]), imageMisses.size() * sizeof(ImageFile));
+    out.write(reinterpret_cast<const char*>(&nodes[0]), nodes.size() * sizeof(ImageNode));
+    out.write(pool.data(), static_cast<std::streamsize>(pool.size()));
+    if (!out.good()) {
+      debugMsg("NddlModelCache:store", "Not caching " << source << ", failed writing " << tmpPath);
+      out.close();
+      std::remove(tmpPath.c_str());
+      return;
+    }
+  }
+
+  if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+    std::remove(path.c_str());
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+      debugMsg("NddlModelCache:store", "Not caching " << source << ", can't replace " << path);
+      std::remove(tmpPath.c_str());
+      return;
+    }
+  }
+  debugMsg("NddlModelCache:store", "Wrote " << nodes.size() << " nodes for " << source << " to " << path);
+}
+
+}
@@ -0,0 +1,71 @@
+#ifndef NDDLMODELCACHE_H_
+#define NDDLMODELCACHE_H_
+
+/**
+ * @file NddlModelCache.hh
+ * @brief Binary images of parsed NDDL models.
+ */
+
+#include <string>
+#include <vector>
+
+#include <antlr3.h>
+
+namespace EUROPA {
+
+/**
+ * @brief Stores the AST built by NDDL3Parser for a model file and everything it includes, and
+ * rebuilds it on later runs without lexing, parsing or resolving includes.
+ *
+ * An image is keyed by the path of the root file. It records the files that were read and a hash
+ * of their contents and of the include path, and is only used while that hash still matches.
+ * It also records the paths include resolution tried before finding each include, and is only
+ * used while there is still no file at any of them, so a file that would now shadow an include
+ * makes the model be read again. Images are memory mapped where the platform supports it.
+ */
+class NddlModelCache {
+public:
+  /**
+   * @param directory Where images are read and written.
+   * @param includePath The include path the model is resolved against.
+   */
+  NddlModelCache(const std::string& directory, const std::vector<std::string>& includePath);
+  ~NddlModelCache();
+
+  /**
+   * @brief Rebuild the AST for source from its image.
+   * @param files Set to the files the model was read from, root first.
+   * @return NULL if there is no usable image. Otherwise a tree owned by this cache.
+   */
+  pANTLR3_BASE_TREE load(const std::string& source, std::vector<std::string>& files);
+
+  /**
+   * @brief Write the image of a parsed model. Failures only disable caching for this model.
+   * @param files The files the model was read from, root first.
+   * @param misses The paths include resolution found no file at while reading them.
+   */
+  void store(const std::string& source, const std::vector<std::string>& files,
+             const std::vector<std::string>& misses, pANTLR3_BASE_TREE tree);
+
+  std::string getImagePath(const std::string& source) const;
+
+  /**
+   * @brief Hash of the include path and of the names and contents of the given files.
+   * @return false if a file could not be read.
+   */
+  bool hashContents(const std::vector<std::string>& files, unsigned long long& hash) const;
+
+private:
+  NddlModelCache(const NddlModelCache&);
+  NddlModelCache& operator=(const NddlModelCache&);
+
+  std::string m_directory;
+  std::vector<std::string> m_includePath;
+  pANTLR3_STRING_FACTORY m_strFactory;
+  pANTLR3_BASE_TREE_ADAPTOR m_adaptor;
+  std::vector<pANTLR3_INPUT_STREAM> m_streams; /*!< One per file, so rebuilt tokens keep their file name */
+};
+
+}
+
+#endif /* NDDLMODELCACHE_H_ */
@@ -0,0 +1,168 @@
+#include "RuleProgram.hh"
+
+#include "ConstraintEngine.hh"
+#include "CESchema.hh"
+#include "DbClient.hh"
+#include "PlanDatabase.hh"
+#include "Debug.hh"
+#include "Error.hh"
+
+#include <sstream>
+
+/**
+ * @file RuleProgram.cc
+ * @brief Compiler and VM for interpreted rule bodies.
+ */
+
+namespace EUROPA {
+
+RuleProgram::FramePool::~FramePool() {
+  check_error(m_inUse == 0, "Rule program destroyed while executing.");
+  for (std::vector<Frame*>::const_iterator it = m_frames.begin(); it != m_frames.end(); ++it)
+    delete *it;
+}
+
+RuleProgram::Frame& RuleProgram::FramePool::acquire(unsigned int capacity) {
+  if (m_inUse == m_frames.size()) {
+    m_frames.push_back(new Frame());
+    m_frames.back()->reserve(capacity);
+  }
+  return *m_frames[m_inUse++];
+}
+
+/**
+ * @brief Takes a frame from a pool and returns it when an execution ends, normally or not.
+ */
+class RuleProgram::FrameLease {
+ public:
+  FrameLease(FramePool& pool, unsigned int capacity) : m_pool(pool), m_frame(pool.acquire(capacity)) {}
+  ~FrameLease() {m_pool.release();}
+  Frame& get() {return m_frame;}
+ private:
+  FrameLease(const FrameLease&);
+  FrameLease& operator=(const FrameLease&);
+  FramePool& m_pool;
+  Frame& m_frame;
+};
+
+RuleProgram::RuleProgram(const CESchemaId& ceSchema)
+    : m_ceSchema(ceSchema), m_instructions(), m_maxArity(0), m_frames() {}
+
+RuleProgram* RuleProgram::compile(const std::vector<Expr*>& body, const CESchemaId& ceSchema) {
+  check_error(ceSchema.isValid(), "Can't compile a rule body without a constraint schema.");
+  RuleProgram* program = new RuleProgram(ceSchema);
+  program->m_instructions.reserve(body.size());
+  for (std::vector<Expr*>::const_iterator it = body.begin(); it != body.end(); ++it)
+    program->compileStatement(*it);
+
+  debugMsg("RuleProgram:compile", "Compiled " << program->size() << " instructions, " <<
+           program->getFallbackCount() << " evaluated as expressions" << std::endl << program->toString());
+  return program;
+}
+
+void RuleProgram::compileStatement(Expr* expr) {
+  check_error(expr != NULL, "Can't compile a NULL expression.");
+
+  if (dynamic_cast<ExprConstraint*>(expr) != NULL &&
+      m_ceSchema->isConstraintType(static_cast<ExprConstraint*>(expr)->getName())) {
+    Instruction instr(CONSTRAINT, expr);
+    instr.constraintType = m_ceSchema->getConstraintType(static_cast<ExprConstraint*>(expr)->getName());
+    instr.args = static_cast<ExprConstraint*>(expr)->getArgs();
+    if (instr.args.size() > m_maxArity)
+      m_maxArity = static_cast<unsigned int>(instr.args.size());
+    m_instructions.push_back(instr);
+  }
+  else if (dynamic_cast<ExprVarDeclaration*>(expr) != NULL)
+    m_instructions.push_back(Instruction(CREATE_VAR, expr));
+  else if (dynamic_cast<ExprRelation*>(expr) != NULL)
+    m_instructions.push_back(Instruction(CREATE_SLAVE, expr));
+  else if (dynamic_cast<ExprIf*>(expr) != NULL) {
+    ExprIf* e = static_cast<ExprIf*>(expr);
+    Instruction instr(GUARD, expr);
+    instr.body.reset(compile(e->getIfBody(), m_ceSchema));
+    if (!e->getElseBody().empty())
+      instr.elseBody.reset(compile(e->getElseBody(), m_ceSchema));
+    m_instructions.push_back(instr);
+  }
+  else if (dynamic_cast<ExprLoop*>(expr) != NULL) {
+    Instruction instr(LOOP, expr);
+    instr.body.reset(compile(static_cast<ExprLoop*>(expr)->getBody(), m_ceSchema));
+    m_instructions.push_back(instr);
+  }
+  else
+    m_instructions.push_back(Instruction(EVAL, expr));
+}
+
+void RuleProgram::execute(RuleInstanceEvalContext& context) const {
+  FrameLease frame(m_frames, m_maxArity);
+
+  for (std::vector<Instruction>::const_iterator it = m_instructions.begin();
+       it != m_instructions.end(); ++it) {
+    const Instruction& instr = *it;
+    switch (instr.op) {
+      case CONSTRAINT:
+        executeConstraint(instr, context, frame.get());
+        break;
+      case GUARD:
+        static_cast<const ExprIf*>(instr.expr)->evalGuard(context, instr.body.get(), instr.elseBody.get());
+        break;
+      case LOOP: {
+        const ExprLoop* loop = static_cast<const ExprLoop*>(instr.expr);
+        context.getRuleInstance()->executeLoop(context, loop->getVarName(), loop->getValueSet(),
+                                               loop->getBody(), loop->getSlot(), instr.body.get());
+        break;
+      }
+      case CREATE_VAR:
+        static_cast<const ExprVarDeclaration*>(instr.expr)->makeRuleVar(context);
+        break;
+      case CREATE_SLAVE:
+      case EVAL:
+        instr.expr->eval(context);
+        break;
+    }
+  }
+}
+
+void RuleProgram::executeConstraint(const Instruction& instr, RuleInstanceEvalContext& context,
+                                    Frame& frame) const {
+  frame.clear();
+  for (std::vector<Expr*>::const_iterator it = instr.args.begin(); it != instr.args.end(); ++it)
+    frame.push_back((*it)->eval(context).getValue());
+
+  InterpretedRuleInstanceId rule = context.getRuleInstance();
+  const PlanDatabaseId pdb = rule->getPlanDatabase();
+  const ExprConstraint* expr = static_cast<const ExprConstraint*>(instr.expr);
+  ConstraintId c = pdb->getClient()->createConstraint(instr.constraintType, frame, expr->getViolationExpl());
+  rule->addConstraint(c);
+  debugMsg("Interpreter:InterpretedRule","Added Constraint : " << c->toString());
+}
+
+unsigned int RuleProgram::getFallbackCount() const {
+  unsigned int count = 0;
+  for (std::vector<Instruction>::const_iterator it = m_instructions.begin();
+       it != m_instructions.end(); ++it) {
+    if (it->op == EVAL)
+      count++;
+  }
+  return count;
+}
+
+const char* RuleProgram::getOpName(OpCode op) {
+  static const char* sl_names[] = {"CREATE_VAR", "CREATE_SLAVE", "CONSTRAINT", "GUARD", "LOOP", "EVAL"};
+  return sl_names[op];
+}
+
+std::string RuleProgram::toString() const {
+  std::ostringstream os;
+  for (std::vector<Instruction>::const_iterator it = m_instructions.begin();
+       it != m_instructions.end(); ++it) {
+    os << getOpName(it->op) << " " << it->expr->toString() << std::endl;
+    if (it->body)
+      os << "{" << std::endl << it->body->toString() << "}" << std::endl;
+    if (it->elseBody)
+      os << "else {" << std::endl << it->elseBody->toString() << "}" << std::endl;
+  }
+  return os.str();
+}
+
+}
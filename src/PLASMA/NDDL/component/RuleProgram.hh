@@ -0,0 +1,107 @@
+#ifndef H_RuleProgram
+#define H_RuleProgram
+
+/**
+ * @file RuleProgram.hh
+ * @brief Rule bodies lowered to a linear instruction stream, and the VM that executes them.
+ */
+
+#include "Interpreter.hh"
+
+#include <boost/smart_ptr/shared_ptr.hpp>
+#include <string>
+#include <vector>
+
+namespace EUROPA {
+
+/**
+ * @brief A rule body compiled once by its InterpretedRuleFactory and executed on every firing.
+ *
+ * The program linearizes the dispatch over the statements of the body; it is not a full
+ * bytecode. Each statement becomes one instruction:
+ * - Constraints are created from a ConstraintType resolved at compile time, with arguments
+ *   gathered in a frame taken from a pool kept by the program.
+ * - Variable declarations create the rule variable directly, without dispatching on the context.
+ * - Guards and loops carry compiled programs for their nested bodies.
+ * - Slave creation, constraints whose type is not registered yet, and any statement the compiler
+ *   does not recognize evaluate their expressions, so the tree interpreter remains the
+ *   reference for those.
+ */
+class RuleProgram {
+ public:
+  enum OpCode {
+    CREATE_VAR = 0, /*!< Declare a rule variable */
+    CREATE_SLAVE,   /*!< Create slave tokens and relations */
+    CONSTRAINT,     /*!< Create a constraint by pre-resolved type */
+    GUARD,          /*!< Create child rule instances for if/else bodies */
+    LOOP,           /*!< Execute the body once per object in a set */
+    EVAL            /*!< Evaluate the expression tree */
+  };
+
+  /**
+   * @brief Compile a rule body, resolving constraint types in the given schema. Returns a new
+   * program owned by the caller.
+   */
+  static RuleProgram* compile(const std::vector<Expr*>& body, const CESchemaId& ceSchema);
+
+  /**
+   * @brief Execute on the rule instance in the given context.
+   */
+  void execute(RuleInstanceEvalContext& context) const;
+
+  /**
+   * @brief The number of instructions, and the number of those that evaluate an expression tree.
+   */
+  unsigned int size() const {return static_cast<unsigned int>(m_instructions.size());}
+  unsigned int getFallbackCount() const;
+
+  std::string toString() const;
+
+  static const char* getOpName(OpCode op);
+
+ private:
+  struct Instruction {
+    Instruction(OpCode o, Expr* e)
+        : op(o), expr(e), args(), constraintType(), body(), elseBody() {}
+    OpCode op;
+    Expr* expr;
+    std::vector<Expr*> args;
+    ConstraintTypeId constraintType;     /*!< Resolved at compile time */
+    boost::shared_ptr<RuleProgram> body; /*!< Loop or if body */
+    boost::shared_ptr<RuleProgram> elseBody;
+  };
+
+  typedef std::vector<ConstrainedVariableId> Frame;
+
+  /**
+   * @brief Argument frames reused across executions. A guard can fire a child rule instance, and
+   * so run a nested program, while this one executes, so each execution takes the next free frame.
+   */
+  class FramePool {
+   public:
+    FramePool() : m_frames(), m_inUse(0) {}
+    ~FramePool();
+    Frame& acquire(unsigned int capacity);
+    void release() {m_inUse--;}
+   private:
+    FramePool(const FramePool&);
+    FramePool& operator=(const FramePool&);
+    std::vector<Frame*> m_frames;
+    unsigned int m_inUse;
+  };
+  class FrameLease;
+
+  RuleProgram(const CESchemaId& ceSchema);
+
+  void compileStatement(Expr* expr);
+  void executeConstraint(const Instruction& instr, RuleInstanceEvalContext& context, Frame& frame) const;
+
+  const CESchemaId m_ceSchema;
+  std::vector<Instruction> m_instructions;
+  unsigned int m_maxArity;
+  mutable FramePool m_frames;
+};
+
+}
+
+#endif
@@ -0,0 +1,168 @@
+#include "ModuleConstraintEngine.hh"
+#include "ModulePlanDatabase.hh"
+#include "ModuleRulesEngine.hh"
+#include "ModuleTemporalNetwork.hh"
+
+#include "Interpreter.hh"
+
+#include "ConstraintEngine.hh"
+#include "DbClient.hh"
+#include "Engine.hh"
+#include "Object.hh"
+#include "ObjectType.hh"
+#include "PlanDatabase.hh"
+#include "Schema.hh"
+#include "Token.hh"
+#include "TokenVariable.hh"
+#include "Utils.hh"
+
+#include <boost/cast.hpp>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * @file Times loading an initial state of facts through a DbClient, propagating after each fact and
+ * inside a bulk load scope, and writes one CSV row per mode.
+ *
+ * Usage: nddl-bulk-load [name=value ...]
+ *
+ *   modes=each,bulk         each propagates after every fact, as a loader that checks consistency
+ *                           statement by statement does; bulk loads inside one bulk load scope
+ *   facts=100000            the number of facts loaded
+ *   csv=nddl-bulk-load.csv  the file the results are written to
+ *
+ * Each fact has its duration specified and is constrained to precede the next, so propagation reaches
+ * the temporal network.  Each row records the time to create the facts and the time to propagate what
+ * remains when they are all created.  Times are CPU time.
+ */
+
+using namespace EUROPA;
+
+class BulkLoadEngine : public EngineBase {
+ public:
+  BulkLoadEngine() {
+    addModule((new ModuleConstraintEngine())->getId());
+    addModule((new ModuleConstraintLibrary())->getId());
+    addModule((new ModulePlanDatabase())->getId());
+    addModule((new ModuleRulesEngine())->getId());
+    addModule((new ModuleTemporalNetwork())->getId());
+    doStart();
+  }
+  ~BulkLoadEngine() {doShutdown();}
+};
+
+struct LoadOptions {
+  std::vector<std::string> modes;
+  int facts;
+  std::string csv;
+};
+
+struct LoadResult {
+  double loadTime;
+  double propagateTime;
+  bool consistent;
+};
+
+static double seconds() {
+  return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+}
+
+static bool parseOptions(int argc, const char** argv, LoadOptions& options) {
+  tokenize("each,bulk", options.modes, ",");
+  options.facts = 100000;
+  options.csv = "nddl-bulk-load.csv";
+
+  for(int i = 1; i < argc; ++i) {
+    const std::string arg(argv[i]);
+    const std::string::size_type eq = arg.find('=');
+    if(eq == std::string::npos) {
+      std::cerr << "Expected name=value, got " << arg << std::endl;
+      return false;
+    }
+    const std::string name = arg.substr(0, eq);
+    const std::string value = arg.substr(eq + 1);
+    if(name == "modes") {
+      options.modes.clear();
+      tokenize(value, options.modes, ",");
+    }
+    else if(name == "facts")
+      options.facts = toValue<int>(value);
+    else if(name == "csv")
+      options.csv = value;
+    else {
+      std::cerr << "Unknown option " << name << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+static LoadResult run(const LoadOptions& options, const std::string& mode) {
+  checkError(mode == "each" || mode == "bulk", "Unknown mode " << mode);
+  BulkLoadEngine engine;
+  PlanDatabase& db = *boost::polymorphic_cast<PlanDatabase*>(engine.getComponent("PlanDatabase"));
+  Schema* schema = boost::polymorphic_cast<Schema*>(engine.getComponent("Schema"));
+
+  ObjectType* ot = new ObjectType("Foo", schema->getObjectType(Schema::rootObject()));
+  ot->addTokenType((new InterpretedTokenType(ot->getId(), "Foo.pred", "predicate"))->getId());
+  schema->registerObjectType(ot->getId());
+  new Object(db.getId(), "Foo", "foo");
+
+  DbClientId client = db.getClient();
+  const bool bulk = (mode == "bulk");
+  LoadResult result;
+  result.consistent = true;
+
+  double start = seconds();
+  if(bulk)
+    client->beginBulkLoad();
+  TokenId previous;
+  for(int i = 0; i < options.facts; ++i) {
+    TokenId fact = client->createToken("Foo.pred", "", false, true);
+    client->specify(fact->duration(), 1);
+    if(previous.isId()) {
+      std::vector<ConstrainedVariableId> scope;
+      scope.push_back(previous->end());
+      scope.push_back(fact->start());
+      client->createConstraint("precedes", scope);
+    }
+    previous = fact;
+    if(!bulk)
+      result.consistent = client->propagate() && result.consistent;
+  }
+  result.loadTime = seconds() - start;
+
+  start = seconds();
+  result.consistent = (bulk ? client->endBulkLoad() : client->propagate()) && result.consistent;
+  result.propagateTime = seconds() - start;
+  return result;
+}
+
+int main(int argc, const char** argv) {
+  LoadOptions options;
+  if(!parseOptions(argc, argv, options))
+    return 1;
+
+  std::ofstream csv(options.csv.c_str());
+  if(!csv) {
+    std::cerr << "Can't write " << options.csv << std::endl;
+    return 1;
+  }
+  const std::string header = "mode,facts,load_s,propagate_s,consistent";
+  csv << header << std::endl;
+  std::cout << header << std::endl;
+
+  for(std::vector<std::string>::const_iterator mode = options.modes.begin(); mode != options.modes.end(); ++mode) {
+    const LoadResult result = run(options, *mode);
+    std::stringstream row;
+    row << *mode << "," << options.facts << "," << result.loadTime << "," << result.propagateTime << ","
+        << (result.consistent ? "true" : "false");
+    csv << row.str() << std::endl;
+    std::cout << row.str() << std::endl;
+  }
+  return 0;
+}
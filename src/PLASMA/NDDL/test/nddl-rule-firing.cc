@@ -0,0 +1,223 @@
+#include "ModuleConstraintEngine.hh"
+#include "ModulePlanDatabase.hh"
+#include "ModuleRulesEngine.hh"
+#include "ModuleTemporalNetwork.hh"
+
+#include "Interpreter.hh"
+
+#include "ConstraintEngine.hh"
+#include "DataTypes.hh"
+#include "DbClient.hh"
+#include "Domains.hh"
+#include "Engine.hh"
+#include "Object.hh"
+#include "ObjectType.hh"
+#include "PlanDatabase.hh"
+#include "RulesEngine.hh"
+#include "Schema.hh"
+#include "Token.hh"
+#include "Utils.hh"
+
+#include <boost/cast.hpp>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * @file Times the firing of a generated interpreted rule, walking its expressions and running its compiled
+ * program, and writes one CSV row per mode.
+ *
+ * Usage: nddl-rule-firing [name=value ...]
+ *
+ *   modes=tree,compiled     how rule instances execute the body
+ *   tokens=500              the number of tokens activated in each round
+ *   locals=4                the number of local variables the body declares
+ *   constraints=8           the number of constraints the body posts, each on a local and a token variable
+ *   rounds=10               the number of times every token is activated and cancelled
+ *   csv=nddl-rule-firing.csv  the file the results are written to
+ *
+ * The body also guards a nested scope on its first local, which refers back to that local, so both
+ * enclosing-scope and local references are resolved on each firing.  The guard is never satisfied here.
+ *
+ * Each row records the mean time to activate a token, which fires its rule, and the mean time to cancel
+ * it, which undoes the rule.  Times are CPU time.
+ */
+
+using namespace EUROPA;
+
+class RuleFiringEngine : public EngineBase {
+ public:
+  RuleFiringEngine() {
+    addModule((new ModuleConstraintEngine())->getId());
+    addModule((new ModuleConstraintLibrary())->getId());
+    addModule((new ModulePlanDatabase())->getId());
+    addModule((new ModuleRulesEngine())->getId());
+    addModule((new ModuleTemporalNetwork())->getId());
+    doStart();
+  }
+  ~RuleFiringEngine() {doShutdown();}
+};
+
+struct FiringOptions {
+  std::vector<std::string> modes;
+  int tokens;
+  int locals;
+  int constraints;
+  int rounds;
+  std::string csv;
+};
+
+struct FiringResult {
+  double fireTime;
+  double undoTime;
+};
+
+static double seconds() {
+  return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+}
+
+static bool parseOptions(int argc, const char** argv, FiringOptions& options) {
+  tokenize("tree,compiled", options.modes, ",");
+  options.tokens = 500;
+  options.locals = 4;
+  options.constraints = 8;
+  options.rounds = 10;
+  options.csv = "nddl-rule-firing.csv";
+
+  for(int i = 1; i < argc; ++i) {
+    const std::string arg(argv[i]);
+    const std::string::size_type eq = arg.find('=');
+    if(eq == std::string::npos) {
+      std::cerr << "Expected name=value, got " << arg << std::endl;
+      return false;
+    }
+    const std::string name = arg.substr(0, eq);
+    const std::string value = arg.substr(eq + 1);
+    if(name == "modes") {
+      options.modes.clear();
+      tokenize(value, options.modes, ",");
+    }
+    else if(name == "tokens")
+      options.tokens = toValue<int>(value);
+    else if(name == "locals")
+      options.locals = toValue<int>(value);
+    else if(name == "constraints")
+      options.constraints = toValue<int>(value);
+    else if(name == "rounds")
+      options.rounds = toValue<int>(value);
+    else if(name == "csv")
+      options.csv = value;
+    else {
+      std::cerr << "Unknown option " << name << std::endl;
+      return false;
+    }
+  }
+  if(options.locals < 1) {
+    std::cerr << "locals must be at least 1" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+static std::string localName(int i) {
+  std::stringstream name;
+  name << "v" << i;
+  return name.str();
+}
+
+/**
+ * @brief The generated body: the locals, then the constraints, then the guarded scope.
+ */
+static std::vector<Expr*> makeBody(const FiringOptions& options) {
+  static const char* sl_tokenVars[] = {"start", "end", "duration"};
+  std::vector<Expr*> body;
+  for(int i = 0; i < options.locals; ++i)
+    body.push_back(new ExprVarDeclaration(localName(i), IntDT::instance(), NULL, true));
+  for(int i = 0; i < options.constraints; ++i) {
+    std::vector<Expr*> args;
+    args.push_back(new ExprVarRef(localName(i % options.locals), IntDT::instance()));
+    args.push_back(new ExprVarRef(sl_tokenVars[i % 3], IntDT::instance()));
+    body.push_back(new ExprConstraint("leq", args, ""));
+  }
+
+  std::vector<Expr*> args, ifBody;
+  ifBody.push_back(new ExprVarDeclaration("y", IntDT::instance(), NULL, true));
+  args.push_back(new ExprVarRef("y", IntDT::instance()));
+  args.push_back(new ExprVarRef(localName(0), IntDT::instance()));
+  ifBody.push_back(new ExprConstraint("eq", args, ""));
+  ExprIfGuard* guard = new ExprIfGuard("==", new ExprVarRef(localName(0), IntDT::instance()),
+                                       new ExprConstant(IntDT::NAME(), new IntervalIntDomain(-1, -1)));
+  body.push_back(new ExprIf(guard, ifBody, std::vector<Expr*>()));
+  return body;
+}
+
+static FiringResult run(const FiringOptions& options, const std::string& mode) {
+  RuleFiringEngine engine;
+  PlanDatabase& db = *boost::polymorphic_cast<PlanDatabase*>(engine.getComponent("PlanDatabase"));
+  Schema* schema = boost::polymorphic_cast<Schema*>(engine.getComponent("Schema"));
+  RulesEngine* re = boost::polymorphic_cast<RulesEngine*>(engine.getComponent("RulesEngine"));
+
+  ObjectType* ot = new ObjectType("Foo", schema->getObjectType(Schema::rootObject()));
+  ot->addTokenType((new InterpretedTokenType(ot->getId(), "Foo.pred", "predicate"))->getId());
+  schema->registerObjectType(ot->getId());
+  new Object(db.getId(), "Foo", "foo");
+
+  InterpretedRuleFactory* rule = new InterpretedRuleFactory("Foo.pred", "Foo.pred", makeBody(options));
+  checkError(mode == "tree" || mode == "compiled", "Unknown mode " << mode);
+  rule->setCompiled(mode == "compiled", db.getConstraintEngine()->getCESchema());
+  re->getRuleSchema()->registerRule(rule->getId());
+
+  DbClientId client = db.getClient();
+  std::vector<TokenId> tokens;
+  for(int i = 0; i < options.tokens; ++i)
+    tokens.push_back(client->createToken("Foo.pred"));
+
+  FiringResult result;
+  result.fireTime = 0;
+  result.undoTime = 0;
+  for(int round = 0; round < options.rounds; ++round) {
+    double start = seconds();
+    for(std::vector<TokenId>::const_iterator it = tokens.begin(); it != tokens.end(); ++it)
+      client->activate(*it);
+    result.fireTime += seconds() - start;
+
+    start = seconds();
+    for(std::vector<TokenId>::const_iterator it = tokens.begin(); it != tokens.end(); ++it)
+      client->cancel(*it);
+    result.undoTime += seconds() - start;
+  }
+  const int firings = options.rounds * options.tokens;
+  if(firings > 0) {
+    result.fireTime /= firings;
+    result.undoTime /= firings;
+  }
+  return result;
+}
+
+int main(int argc, const char** argv) {
+  FiringOptions options;
+  if(!parseOptions(argc, argv, options))
+    return 1;
+
+  std::ofstream csv(options.csv.c_str());
+  if(!csv) {
+    std::cerr << "Can't write " << options.csv << std::endl;
+    return 1;
+  }
+  const std::string header = "mode,tokens,locals,constraints,rounds,fire_us,undo_us";
+  csv << header << std::endl;
+  std::cout << header << std::endl;
+
+  for(std::vector<std::string>::const_iterator mode = options.modes.begin(); mode != options.modes.end(); ++mode) {
+    const FiringResult result = run(options, *mode);
+    std::stringstream row;
+    row << *mode << "," << options.tokens << "," << options.locals << "," << options.constraints << ","
+        << options.rounds << "," << 1e6 * result.fireTime << "," << 1e6 * result.undoTime;
+    csv << row.str() << std::endl;
+    std::cout << row.str() << std::endl;
+  }
+  return 0;
+}
@@ -9,6 +9,26 @@
 #include "ModuleTemporalNetwork.hh"
 #include "ModuleRulesEngine.hh"
 #include "ModuleNddl.hh"
+#include "NddlInterpreter.hh"
+#include "NddlModelCache.hh"
+#include "Interpreter.hh"
+#include "RulesEngine.hh"
+#include "RuleInstance.hh"
+#include "PlanDatabase.hh"
+#include "Schema.hh"
+#include "ObjectType.hh"
+#include "Object.hh"
+#include "Token.hh"
+#include "TokenVariable.hh"
+#include "DbClient.hh"
+#include "Constraint.hh"
+#include "ConstraintEngine.hh"
+#include "DataTypes.hh"
+#include "Domains.hh"
+#include <boost/cast.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
 
 using namespace EUROPA;
 using namespace NDDL;
@@ -22,6 +42,311 @@ void NDDLModuleTests::syntaxTests()
     CPPUNIT_ASSERT_MESSAGE("Nddl3 parser reported problems :\n" + result,result.size() == 0);
 }
 
+namespace {
+PlanDatabaseId getPlanDatabase(NddlTestEngine& engine)
+{
+    return boost::polymorphic_cast<PlanDatabase*>(engine.getComponent("PlanDatabase"))->getId();
+}
+
+/**
+ * Defines the object type Foo with one instance and the predicate Foo.pred, and registers an
+ * interpreted rule for Foo.pred with the given body.
+ */
+InterpretedRuleFactory* defineRule(NddlTestEngine& engine, const std::vector<Expr*>& body)
+{
+    Schema* schema = boost::polymorphic_cast<Schema*>(engine.getComponent("Schema"));
+    ObjectType* ot = new ObjectType("Foo", schema->getObjectType(Schema::rootObject()));
+    ot->addTokenType((new InterpretedTokenType(ot->getId(), "Foo.pred", "predicate"))->getId());
+    schema->registerObjectType(ot->getId());
+    new Object(getPlanDatabase(engine), "Foo", "foo");
+
+    InterpretedRuleFactory* rule = new InterpretedRuleFactory("Foo.pred", "Foo.pred", body);
+    RulesEngine* re = boost::polymorphic_cast<RulesEngine*>(engine.getComponent("RulesEngine"));
+    re->getRuleSchema()->registerRule(rule->getId());
+    return rule;
+}
+
+/**
+ * int x;
+ * leq(x, duration);
+ * if (x == 5) {
+ *   int y;
+ *   eq(y, x);
+ * }
+ */
+std::vector<Expr*> makeGuardedBody()
+{
+    std::vector<Expr*> args, ifBody, body;
+    body.push_back(new ExprVarDeclaration("x", IntDT::instance(), NULL, true));
+    args.push_back(new ExprVarRef("x", IntDT::instance()));
+    args.push_back(new ExprVarRef("duration", IntDT::instance()));
+    body.push_back(new ExprConstraint("leq", args, ""));
+
+    args.clear();
+    ifBody.push_back(new ExprVarDeclaration("y", IntDT::instance(), NULL, true));
+    args.push_back(new ExprVarRef("y", IntDT::instance()));
+    args.push_back(new ExprVarRef("x", IntDT::instance()));
+    ifBody.push_back(new ExprConstraint("eq", args, ""));
+    ExprIfGuard* guard = new ExprIfGuard("==", new ExprVarRef("x", IntDT::instance()),
+                                         new ExprConstant(IntDT::NAME(), new IntervalIntDomain(5, 5)));
+    body.push_back(new ExprIf(guard, ifBody, std::vector<Expr*>()));
+    return body;
+}
+
+RuleInstanceId getRuleInstance(NddlTestEngine& engine, const TokenId token)
+{
+    RulesEngine* re = boost::polymorphic_cast<RulesEngine*>(engine.getComponent("RulesEngine"));
+    std::set<RuleInstanceId> ruleInstances;
+    re->getRuleInstances(token, ruleInstances);
+    CPPUNIT_ASSERT(ruleInstances.size() == 1);
+    return *ruleInstances.begin();
+}
+
+/**
+ * The single constraint named 'name' on the variable.
+ */
+ConstraintId getConstraint(const ConstrainedVariableId var, const std::string& name)
+{
+    std::set<ConstraintId> constraints;
+    var->constraints(constraints);
+    ConstraintId result;
+    for (std::set<ConstraintId>::const_iterator it = constraints.begin(); it != constraints.end(); ++it) {
+        if ((*it)->getName() == name) {
+            CPPUNIT_ASSERT(result.isNoId());
+            result = *it;
+        }
+    }
+    CPPUNIT_ASSERT(result.isId());
+    return result;
+}
+
+/**
+ * Fires the guarded body on one token, with the guard satisfied, and describes the constraints
+ * on the variables the rule declared, one "name(var, ...)" per constraint, sorted.
+ */
+std::vector<std::string> fireGuardedBody(bool compiled)
+{
+    NddlTestEngine engine;
+    engine.init();
+    PlanDatabaseId db = getPlanDatabase(engine);
+    InterpretedRuleFactory* rule = defineRule(engine, makeGuardedBody());
+    rule->setCompiled(compiled, db->getConstraintEngine()->getCESchema());
+    CPPUNIT_ASSERT(rule->isCompiled() == compiled);
+
+    DbClientId client = db->getClient();
+    TokenId token = client->createToken("Foo.pred", "t0");
+    client->activate(token);
+    RuleInstanceId root = getRuleInstance(engine, token);
+    client->specify(root->getVariable("x"), 5);
+    CPPUNIT_ASSERT(client->propagate());
+    CPPUNIT_ASSERT(root->getChildRules().size() == 1);
+
+    std::vector<ConstrainedVariableId> vars = root->getVariables();
+    const std::vector<ConstrainedVariableId>& childVars = root->getChildRules().front()->getVariables();
+    vars.insert(vars.end(), childVars.begin(), childVars.end());
+    std::set<ConstraintId> constraints;
+    for (std::vector<ConstrainedVariableId>::const_iterator it = vars.begin(); it != vars.end(); ++it)
+        (*it)->constraints(constraints);
+
+    std::vector<std::string> result;
+    for (std::set<ConstraintId>::const_iterator it = constraints.begin(); it != constraints.end(); ++it) {
+        std::string desc = (*it)->getName() + "(";
+        const std::vector<ConstrainedVariableId>& scope = (*it)->getScope();
+        for (unsigned int i = 0; i < scope.size(); i++)
+            desc += (i > 0 ? "," : "") + scope[i]->getName();
+        result.push_back(desc + ")");
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+}
+
+void NDDLModuleTests::ruleSlotTests()
+{
+    NddlTestEngine engine;
+    engine.init();
+    defineRule(engine, makeGuardedBody());
+    PlanDatabaseId db = getPlanDatabase(engine);
+    DbClientId client = db->getClient();
+    TokenId token = client->createToken("Foo.pred", "t0");
+
+    // The second firing follows an undo, which deletes the variables the slots held
+    for (int i = 0; i < 2; i++) {
+        client->activate(token);
+        CPPUNIT_ASSERT(client->propagate());
+        RuleInstanceId root = getRuleInstance(engine, token);
+        ConstrainedVariableId x = root->getVariable("x");
+        CPPUNIT_ASSERT(x.isValid() && x->parent() == root);
+
+        // A declared name and a token variable
+        ConstraintId leq = getConstraint(x, "leq");
+        CPPUNIT_ASSERT(leq->getScope()[0] == x);
+        CPPUNIT_ASSERT(leq->getScope()[1] == token->duration());
+
+        // A name declared in the if body, and one declared a scope up
+        client->specify(x, 5);
+        CPPUNIT_ASSERT(client->propagate());
+        CPPUNIT_ASSERT(root->getChildRules().size() == 1);
+        RuleInstanceId child = root->getChildRules().front();
+        CPPUNIT_ASSERT(child->isExecuted());
+        ConstrainedVariableId y = child->getVariable("y");
+        CPPUNIT_ASSERT(y.isValid() && y->parent() == child);
+        ConstraintId eq = getConstraint(y, "eq");
+        CPPUNIT_ASSERT(eq->getScope()[0] == y);
+        CPPUNIT_ASSERT(eq->getScope()[1] == x);
+
+        client->reset(x);
+        client->cancel(token);
+    }
+}
+
+void NDDLModuleTests::compiledRuleTests()
+{
+    std::vector<std::string> walked = fireGuardedBody(false);
+    std::vector<std::string> compiled = fireGuardedBody(true);
+    // leq and eq, and the listener of the guard on x
+    CPPUNIT_ASSERT(walked.size() == 3);
+    CPPUNIT_ASSERT_MESSAGE(walked.front() + ", ... != " + compiled.front() + ", ...", walked == compiled);
+}
+
+namespace {
+void writeFile(const std::string& path, const std::string& text)
+{
+    std::ofstream out(path.c_str());
+    out << text;
+    CPPUNIT_ASSERT(out.good());
+}
+
+void configureCache(NddlTestEngine& engine, const std::string& cacheDir, const std::string& includePath)
+{
+    engine.getConfig()->setProperty("nddl.modelCache", cacheDir);
+    engine.getConfig()->setProperty("nddl.includePath", includePath);
+}
+
+/**
+ * Interprets root in a fresh engine that caches images in cacheDir, and tells whether the model
+ * declared the class.
+ */
+bool declares(const std::string& root, const std::string& cacheDir, const std::string& includePath,
+              const std::string& className)
+{
+    NddlTestEngine engine;
+    engine.init();
+    configureCache(engine, cacheDir, includePath);
+    std::string result = engine.executeScript("nddl", root, true /*isFile*/);
+    CPPUNIT_ASSERT_MESSAGE("Nddl3 parser reported problems :\n" + result, result.empty());
+    Schema* schema = boost::polymorphic_cast<Schema*>(engine.getComponent("Schema"));
+    return schema->isObjectType(className);
+}
+
+/**
+ * The files the image of root was read from, or nothing if there is no usable image.
+ */
+std::vector<std::string> loadImage(const std::string& root, const std::string& cacheDir,
+                                   const std::string& includePath)
+{
+    NddlTestEngine engine;
+    engine.init();
+    configureCache(engine, cacheDir, includePath);
+    NddlInterpreter interpreter(engine.getId());
+    NddlModelCache cache(cacheDir, interpreter.getIncludePath());
+    std::vector<std::string> files;
+    if (cache.load(root, files) == NULL)
+        files.clear();
+    return files;
+}
+}
+
+void NDDLModuleTests::modelCacheTests()
+{
+    char dirTemplate[] = "/tmp/nddl-model-cache-XXXXXX";
+    CPPUNIT_ASSERT(mkdtemp(dirTemplate) != NULL);
+    const std::string dir(dirTemplate);
+    const std::string first = dir + "/first", second = dir + "/second", cacheDir = dir + "/cache";
+    CPPUNIT_ASSERT(system(("mkdir " + first + " " + second + " " + cacheDir).c_str()) == 0);
+    const std::string includePath = first + ":" + second;
+    const std::string root = dir + "/model.nddl";
+    const std::string included = second + "/included.nddl";
+    const std::string shadow = first + "/included.nddl";
+
+    writeFile(root, "#include \"included.nddl\"\nclass Root {}\n");
+    writeFile(included, "class Included {}\n");
+    CPPUNIT_ASSERT(loadImage(root, cacheDir, includePath).empty());
+    CPPUNIT_ASSERT(declares(root, cacheDir, includePath, "Included"));
+
+    // A hit reads the same files
+    std::vector<std::string> files = loadImage(root, cacheDir, includePath);
+    CPPUNIT_ASSERT(files.size() == 2 && files[0] == root && files[1] == included);
+    CPPUNIT_ASSERT(declares(root, cacheDir, includePath, "Included"));
+
+    // An edited include misses, and its model is cached again
+    writeFile(included, "class Edited {}\n");
+    CPPUNIT_ASSERT(loadImage(root, cacheDir, includePath).empty());
+    CPPUNIT_ASSERT(declares(root, cacheDir, includePath, "Edited"));
+    CPPUNIT_ASSERT(loadImage(root, cacheDir, includePath).size() == 2);
+
+    // A file earlier on the include path shadows the include the image was built with
+    writeFile(shadow, "class Shadow {}\n");
+    CPPUNIT_ASSERT(loadImage(root, cacheDir, includePath).empty());
+    CPPUNIT_ASSERT(declares(root, cacheDir, includePath, "Shadow"));
+    files = loadImage(root, cacheDir, includePath);
+    CPPUNIT_ASSERT(files.size() == 2 && files[1] == shadow);
+
+    CPPUNIT_ASSERT(system(("rm -rf " + dir).c_str()) == 0);
+}
+
+namespace {
+/**
+ * Interprets root in a fresh engine with threads parse threads, and returns the image it caches in
+ * cacheDir, which holds the files in the order the include guard took them, and then the AST.
+ */
+std::string parseImage(const std::string& root, const std::string& cacheDir, const std::string& includePath,
+                       const std::string& threads)
+{
+    NddlTestEngine engine;
+    engine.init();
+    configureCache(engine, cacheDir, includePath);
+    engine.getConfig()->setProperty("nddl.parseThreads", threads);
+    std::string result = engine.executeScript("nddl", root, true /*isFile*/);
+    CPPUNIT_ASSERT_MESSAGE("Nddl3 parser reported problems :\n" + result, result.empty());
+
+    NddlInterpreter interpreter(engine.getId());
+    NddlModelCache cache(cacheDir, interpreter.getIncludePath());
+    std::ifstream in(cache.getImagePath(root).c_str(), std::ios::in | std::ios::binary);
+    CPPUNIT_ASSERT(in.good());
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+}
+
+void NDDLModuleTests::parallelParseTests()
+{
+    char dirTemplate[] = "/tmp/nddl-parallel-parse-XXXXXX";
+    CPPUNIT_ASSERT(mkdtemp(dirTemplate) != NULL);
+    const std::string dir(dirTemplate);
+    const std::string includePath = dir + "/include";
+    const std::string serialCache = dir + "/serial", parallelCache = dir + "/parallel";
+    CPPUNIT_ASSERT(system(("mkdir " + includePath + " " + serialCache + " " + parallelCache).c_str()) == 0);
+    const std::string root = dir + "/model.nddl";
+
+    // a is discovered before c, but a serial parse reaches c first, through b
+    writeFile(root, "#include \"b.nddl\"\nclass Root {}\n#include \"a.nddl\"\nRoot r = new Root();\n");
+    writeFile(includePath + "/b.nddl", "class B {}\n#include \"c.nddl\"\n#include \"a.nddl\"\nclass B2 extends B {}\n");
+    writeFile(includePath + "/c.nddl", "// #include \"a.nddl\"\nclass C {}\n");
+    writeFile(includePath + "/a.nddl", "#include \"c.nddl\"\nclass A {}\n");
+
+    const std::string serial = parseImage(root, serialCache, includePath, "1");
+    const std::string parallel = parseImage(root, parallelCache, includePath, "4");
+    CPPUNIT_ASSERT(!serial.empty());
+    CPPUNIT_ASSERT_MESSAGE("The parallel parse built a different image", parallel == serial);
+
+    std::vector<std::string> files = loadImage(root, parallelCache, includePath);
+    CPPUNIT_ASSERT(files.size() == 4);
+    CPPUNIT_ASSERT(files[0] == root && files[1] == includePath + "/b.nddl");
+    CPPUNIT_ASSERT(files[2] == includePath + "/c.nddl" && files[3] == includePath + "/a.nddl");
+
+    CPPUNIT_ASSERT(system(("rm -rf " + dir).c_str()) == 0);
+}
+
 
 
 NddlTest::NddlTest(const std::string& testName,
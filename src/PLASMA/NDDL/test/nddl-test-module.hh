@@ -9,6 +9,10 @@
 class NDDLModuleTests : public CppUnit::TestFixture {
   CPPUNIT_TEST_SUITE(NDDLModuleTests);
   CPPUNIT_TEST(syntaxTests);
+  CPPUNIT_TEST(ruleSlotTests);
+  CPPUNIT_TEST(compiledRuleTests);
+  CPPUNIT_TEST(modelCacheTests);
+  CPPUNIT_TEST(parallelParseTests);
   CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -21,6 +25,10 @@ public:
   }
 
   void syntaxTests();
+  void ruleSlotTests();
+  void compiledRuleTests();
+  void modelCacheTests();
+  void parallelParseTests();
 };
 
 class NddlTest : public CppUnit::TestFixture
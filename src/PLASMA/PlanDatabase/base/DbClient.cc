@@ -31,7 +31,8 @@ namespace EUROPA {
 
 DbClient::DbClient(const PlanDatabaseId db)
     : m_id(this), m_planDb(db), m_keysOfTokensCreated(), m_listeners(), 
-      m_deleted(false), m_transactionLoggingEnabled(false) {
+      m_deleted(false), m_transactionLoggingEnabled(false), m_bulkLoadDepth(0),
+      m_bulkLoadAutoPropagation(false) {
   check_error(db.isValid());
 }
 
@@ -240,6 +241,16 @@ void DbClient::deleteToken(const TokenId token, const std::string& name) {
     return constraint;
   }
 
+  ConstraintId DbClient::createConstraint(const ConstraintTypeId type,
+				 const std::vector<ConstrainedVariableId>& scope,
+				 const std::string& violationExpl)
+  {
+    ConstraintId constraint = m_planDb->getConstraintEngine()->createConstraint(type,scope,violationExpl);
+    debugMsg("DbClient:createConstraint", constraint->toString());
+    publish(notifyConstraintCreated(constraint));
+    return constraint;
+  }
+
   void DbClient::deleteConstraint(const ConstraintId c)
   {
     publish(notifyConstraintDeleted(c));
@@ -278,6 +289,35 @@ void DbClient::deleteToken(const TokenId token, const std::string& name) {
     return m_planDb->getConstraintEngine()->constraintConsistent();
   }
 
+  void DbClient::beginBulkLoad() {
+    if (m_bulkLoadDepth++ > 0)
+      return;
+    ConstraintEngineId ce = m_planDb->getConstraintEngine();
+    m_bulkLoadAutoPropagation = ce->getAutoPropagation();
+    ce->setAutoPropagation(false);
+    debugMsg("DbClient:bulkLoad", "Began bulk load");
+  }
+
+  bool DbClient::endBulkLoad() {
+    checkError(m_bulkLoadDepth > 0, "endBulkLoad without a matching beginBulkLoad");
+    if (--m_bulkLoadDepth > 0)
+      return !m_planDb->getConstraintEngine()->provenInconsistent();
+    ConstraintEngineId ce = m_planDb->getConstraintEngine();
+    ce->setAutoPropagation(m_bulkLoadAutoPropagation);
+    bool consistent = propagate();
+    debugMsg("DbClient:bulkLoad",
+             "Ended bulk load" << (consistent ? "" : ", which is inconsistent"));
+    return consistent;
+  }
+
+  void DbClient::abandonBulkLoad() {
+    checkError(m_bulkLoadDepth > 0, "abandonBulkLoad without a matching beginBulkLoad");
+    if (--m_bulkLoadDepth > 0)
+      return;
+    m_planDb->getConstraintEngine()->setAutoPropagation(m_bulkLoadAutoPropagation);
+    debugMsg("DbClient:bulkLoad", "Abandoned bulk load");
+  }
+
 
   ObjectId DbClient::getObject(const std::string& name) const {return m_planDb->getObject(name);}
 
@@ -385,6 +425,16 @@ void DbClient::deleteToken(const TokenId token, const std::string& name) {
     return s.str();
   }
 
+  TokenId DbClient::getTokenByLocalVariable(const ConstrainedVariableId var) const {
+    const TokenSet& tokens = m_planDb->getTokens();
+    for(TokenSet::const_iterator it = tokens.begin(); it != tokens.end(); ++it) {
+      const ConstrainedVariableSet& locals = (*it)->getLocalVariables();
+      if(locals.find(var) != locals.end())
+        return *it;
+    }
+    return TokenId::noId();
+  }
+
   ConstrainedVariableId DbClient::getVariableByIndex(unsigned int index){
     return m_planDb->getConstraintEngine()->getVariable(index);
   }
@@ -565,6 +615,21 @@ void DbClient::deleteToken(const TokenId token, const std::string& name) {
       m_client->close();
   }
 
+  void PSPlanDatabaseClientImpl::beginBulkLoad()
+  {
+      m_client->beginBulkLoad();
+  }
+
+  bool PSPlanDatabaseClientImpl::endBulkLoad()
+  {
+      return m_client->endBulkLoad();
+  }
+
+  void PSPlanDatabaseClientImpl::abandonBulkLoad()
+  {
+      m_client->abandonBulkLoad();
+  }
+
   ConstrainedVariableId PSPlanDatabaseClientImpl::toId(PSVariable* v)
   {
       return boost::polymorphic_cast<ConstrainedVariable*>(v)->getId();
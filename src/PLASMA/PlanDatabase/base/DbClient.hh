@@ -158,6 +158,14 @@ namespace EUROPA {
 				  const std::vector<ConstrainedVariableId>& scope,
 				  const std::string& violationExpl="");
 
+    /**
+     * @brief Create a constraint from a constraint type that has already been looked up, avoiding
+     * the lookup by name.
+     */
+    ConstraintId createConstraint(const ConstraintTypeId type,
+				  const std::vector<ConstrainedVariableId>& scope,
+				  const std::string& violationExpl="");
+
     /**
      * @brief Construction of a unary constraint.
      * @param name The name of the constraint to be created
@@ -212,6 +220,37 @@ namespace EUROPA {
      */
     bool propagate();
 
+    /**
+     * @brief Open a bulk load scope, for creating a large initial state.
+     *
+     * Automatic propagation is suspended until the matching endBulkLoad. Rules fire and temporal
+     * constraints reach the temporal network as part of propagation, so each is done once, over
+     * everything loaded, rather than as each token and constraint is created. An explicit call to
+     * propagate() still propagates. Scopes may be nested; only the outermost one has any effect.
+     * Creations are not staged and events are not coalesced: tokens, variables and constraints
+     * are created, and listeners notified, as each call is made.
+     * @see endBulkLoad(), abandonBulkLoad()
+     */
+    void beginBulkLoad();
+
+    /**
+     * @brief Close a bulk load scope. Closing the outermost scope restores automatic propagation
+     * to its previous setting and propagates.
+     * @return false if the plan database is proven inconsistent, otherwise true.
+     */
+    bool endBulkLoad();
+
+    /**
+     * @brief Close a bulk load scope without propagating, for a load that failed part way.
+     * Closing the outermost scope restores automatic propagation to its previous setting.
+     */
+    void abandonBulkLoad();
+
+    /**
+     * @brief True if a bulk load scope is open.
+     */
+    bool isBulkLoading() const {return m_bulkLoadDepth > 0;}
+
     /**
      * @brief Lookup an object by name. It is an error if the object is not present.
      * @return The requested object
@@ -273,6 +312,12 @@ namespace EUROPA {
      */
     std::string getPathAsString(const TokenId targetToken) const;
 
+    /**
+     * @brief Retrieve the token a rule variable is local to.
+     * @return noId if the variable is not local to any token.
+     */
+    TokenId getTokenByLocalVariable(const ConstrainedVariableId var) const;
+
     /**
      * @brief Retrieve a constrained variable of any type based on its 'index'
      */
@@ -357,6 +402,8 @@ namespace EUROPA {
     std::set<DbClientListenerId> m_listeners; /*! Stores current DbClientListeners */
     bool m_deleted; /*!< Used to indicate a deletion and this ignore synchronization of listeners on removal */
     bool m_transactionLoggingEnabled; /*!< Used to configure transaction loggng services required for Key Matching */
+    unsigned int m_bulkLoadDepth; /*!< The number of open bulk load scopes */
+    bool m_bulkLoadAutoPropagation; /*!< The auto propagation setting to restore when the outermost scope closes */
   };
 
   class PSPlanDatabaseClientImpl : public PSPlanDatabaseClient
@@ -391,6 +438,10 @@ namespace EUROPA {
       virtual void close(const std::string& objectType);
       virtual void close();
 
+      virtual void beginBulkLoad();
+      virtual bool endBulkLoad();
+      virtual void abandonBulkLoad();
+
     protected:
       DbClientId m_client;
 
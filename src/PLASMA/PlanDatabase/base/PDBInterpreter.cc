@@ -88,6 +88,8 @@ namespace EUROPA {
 
 void* EvalContext::getElement(const std::string&) const {return NULL;}
 
+ConstrainedVariableId* EvalContext::getSlot(unsigned int, unsigned int) {return NULL;}
+
   std::string EvalContext::toString() const
   {
     std::ostringstream os;
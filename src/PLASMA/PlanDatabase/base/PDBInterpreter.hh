@@ -39,6 +39,12 @@ class EvalContext {
 
   virtual void* getElement(const std::string& name) const;
 
+  /**
+   * @brief The cached variable for a slot bound in a rule body, 'depth' scopes up. NULL if this
+   * context does not evaluate a rule body.
+   */
+  virtual ConstrainedVariableId* getSlot(unsigned int depth, unsigned int slot);
+
   virtual std::string toString() const;
 
  protected:
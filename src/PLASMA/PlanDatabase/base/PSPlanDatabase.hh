@@ -145,6 +145,13 @@ class PSPlanDatabaseClient;
       virtual void close(PSVariable* variable) = 0;
       virtual void close(const std::string& objectType) = 0;
       virtual void close() = 0;
+
+      // Suspend automatic propagation until the matching endBulkLoad, which propagates once
+      // and returns false if the result is inconsistent.  abandonBulkLoad closes the scope
+      // without propagating
+      virtual void beginBulkLoad() = 0;
+      virtual bool endBulkLoad() = 0;
+      virtual void abandonBulkLoad() = 0;
   };
 }
 
@@ -7,8 +7,11 @@
 #include "TokenVariable.hh"
 #include "ConstrainedVariable.hh"
 #include "Utils.hh"
+#include "LabelStr.hh"
 #include "Debug.hh"
 
+#include <cmath>
+
 namespace EUROPA {
 
   // bool PlanDatabaseWriter::s_useStandardKeys = true;
@@ -23,13 +26,14 @@ namespace EUROPA {
 
     void PlanDatabaseWriter::write(PlanDatabaseId db, std::ostream& os) {
       check_error(!db->getConstraintEngine()->provenInconsistent());
-      ObjectSet objs = db->getObjects();
-      TokenSet alltokens = db->getTokens();
+      const ObjectSet& objs = db->getObjects();
+      TokenSet written;
       os << "Objects *************************" << std::endl;
       indent()++;
       for (ObjectSet::const_iterator oit = objs.begin(); oit != objs.end() ; ++oit) {
 	ObjectId object = *oit;
-	os << indentation() << object->getType() << ":"
+	writeIndentation(os);
+	os << object->getType() << ":"
 	   << object->getName() << "*************************" << std::endl;
 
 
@@ -48,38 +52,43 @@ namespace EUROPA {
 
 	if(!toks.empty()){
 	  indent()++;
-	  os << indentation() << "Tokens *************************" << std::endl;
+	  writeIndentation(os);
+	  os << "Tokens *************************" << std::endl;
 	  for(std::list<TokenId>::const_iterator tokit = toks.begin(); tokit != toks.end(); ++tokit) {
 	    TokenId t = (*tokit);
-	    alltokens.erase(t);
+	    written.insert(t);
 	    writeToken(t, os);
 	  }
 
-	  os << indentation() << "End Tokens *********************" << std::endl;
+	  writeIndentation(os);
+	  os << "End Tokens *********************" << std::endl;
 	  indent()--;
 	}
 
 	// print variables associated with this object.
-	const std::vector<ConstrainedVariableId> variables = object->getVariables();
+	const std::vector<ConstrainedVariableId>& variables = object->getVariables();
 	std::vector<ConstrainedVariableId>::const_iterator varit;
 	if(!variables.empty()){
 	  indent()++;
-	  os << indentation() << "Variables *************************" << std::endl;
+	  writeIndentation(os);
+	  os << "Variables *************************" << std::endl;
 	  for(varit = variables.begin(); varit != variables.end(); ++varit) {
 	    ConstrainedVariableId var = *varit;
 	    writeVariable(var, os);
 	  }
-	  os << indentation() << "End Variables *********************" << std::endl;
+	  writeIndentation(os);
+	  os << "End Variables *********************" << std::endl;
 	  indent()--;
 	}
 
-	os << indentation() << "End " << object->getType() << ":" << object->getName()
+	writeIndentation(os);
+	os << "End " << object->getType() << ":" << object->getName()
 	   << "*************************" << std::endl;
       }
       indent()--;
 
       // print global variables
-      const ConstrainedVariableSet globalVariablesSet = db->getGlobalVariables();
+      const ConstrainedVariableSet& globalVariablesSet = db->getGlobalVariables();
       if (! globalVariablesSet.empty()) {
         os << "Global Variables" << "*************************" << std::endl;
         for(ConstrainedVariableSet::const_iterator it = globalVariablesSet.begin(); it != globalVariablesSet.end(); ++it) {
@@ -88,37 +97,24 @@ namespace EUROPA {
 	  writeVariable(var,os);
         }
       }
-      if (alltokens.empty())
+
+      // Tokens not written with an object are grouped by state in one pass over the database's tokens.
+      const TokenSet& alltokens = db->getTokens();
+      if (written.size() == alltokens.size())
         return;
-      TokenSet activeTokens;
-      TokenSet inactiveTokens;
-      TokenSet incompleteTokens;
-      TokenSet mergedTokens;
-      TokenSet rejectedTokens;
-      TokenSet::const_iterator tokit = alltokens.begin();
-      for ( ; tokit != alltokens.end(); tokit++) {
-        TokenId t = *tokit;
-	checkError(t.isValid(), t);
-	checkError(!t->isTerminated(), t->getKey());
-
-        if (t->isMerged())
-          mergedTokens.insert(t);
-        else if (t->isActive())
-          activeTokens.insert(t);
-        else if (t->isRejected())
-          rejectedTokens.insert(t);
-        else if (t->isInactive())
-          inactiveTokens.insert(t);
-        else if (t->isIncomplete())
-          incompleteTokens.insert(t);
-        else
-          check_error(false, "Token with unknown status");
+      std::vector<TokenId> byState[STATE_COUNT];
+      for (TokenSet::const_iterator it = alltokens.begin(); it != alltokens.end(); ++it) {
+	TokenId tok = *it;
+	checkError(tok.isValid(), tok);
+	checkError(!tok->isTerminated(), tok->getKey());
+	if (written.find(tok) == written.end())
+	  byState[getState(tok)].push_back(tok);
       }
-      printTokensHelper(os, "Active", activeTokens);
-      printTokensHelper(os, "Merged", mergedTokens);
-      printTokensHelper(os, "Rejected", rejectedTokens);
-      printTokensHelper(os, "Inactive", inactiveTokens);
-      printTokensHelper(os, "Incomplete", incompleteTokens);
+      printTokensHelper(os, "Active", byState[ACTIVE_STATE]);
+      printTokensHelper(os, "Merged", byState[MERGED_STATE]);
+      printTokensHelper(os, "Rejected", byState[REJECTED_STATE]);
+      printTokensHelper(os, "Inactive", byState[INACTIVE_STATE]);
+      printTokensHelper(os, "Incomplete", byState[INCOMPLETE_STATE]);
       // Skip printing these for two reasons:
       // 1. Expensive due to constraints not being propagated to their variable domains.
       // 2. Their id's are printed when their active token is printed with writeToken().
@@ -127,64 +123,92 @@ namespace EUROPA {
 
     void PlanDatabaseWriter::printTokensHelper(std::ostream& os,
                                   const std::string& name,
-                                  const TokenSet& tokens) {
+                                  const std::vector<TokenId>& tokens) {
       if (tokens.empty())
         return;
       os << name << " Tokens: *************************" << std::endl;
-      TokenSet::const_iterator it = tokens.begin();
-      for ( ; it != tokens.end(); ++it){
-	TokenId tok = *it;
-	checkError(tok.isValid(), tok);
-        writeToken(tok, os);
-      }
+      for (std::vector<TokenId>::const_iterator it = tokens.begin(); it != tokens.end(); ++it)
+        writeToken(*it, os);
+    }
+
+    PlanDatabaseWriter::TokenState PlanDatabaseWriter::getState(const TokenId t) {
+      if (t->isMerged())
+        return MERGED_STATE;
+      else if (t->isActive())
+        return ACTIVE_STATE;
+      else if (t->isRejected())
+        return REJECTED_STATE;
+      else if (t->isInactive())
+        return INACTIVE_STATE;
+      check_error(t->isIncomplete(), "Token with unknown status");
+      return INCOMPLETE_STATE;
+    }
+
+    const char* PlanDatabaseWriter::getStateName(const TokenId t) {
+      static const char* sl_names[STATE_COUNT] = {"active", "merged", "rejected", "inactive", "incomplete"};
+      return sl_names[getState(t)];
     }
 
   std::string PlanDatabaseWriter::timeDomain(const Domain& dom){
     std::stringstream ss;
+    writeTimeDomain(dom, ss);
+    return ss.str();
+  }
 
+  void PlanDatabaseWriter::writeTimeDomain(const Domain& dom, std::ostream& os){
     if(dom.isSingleton())
-      ss << "{";
+      os << "{";
     else
-      ss << "[";
+      os << "[";
 
     if(dom.getLowerBound() == MINUS_INFINITY)
-      ss << "-inf";
+      os << "-inf";
     else if(dom.getLowerBound() == PLUS_INFINITY)
-      ss << "+inf";
+      os << "+inf";
     else
-      ss << dom.getLowerBound();
+      os << dom.getLowerBound();
 
     if(!dom.isSingleton()){
-      ss << ", ";
+      os << ", ";
       if(dom.getUpperBound() == MINUS_INFINITY)
-	ss << "-inf";
+	os << "-inf";
       else if(dom.getUpperBound() == PLUS_INFINITY)
-	ss << "+inf";
+	os << "+inf";
       else
-	ss << dom.getUpperBound();
+	os << dom.getUpperBound();
     }
 
     if(dom.isSingleton())
-      ss << "}";
+      os << "}";
     else
-      ss << "]";
-
-    return ss.str();
+      os << "]";
   }
 
   std::string PlanDatabaseWriter::simpleTokenSummary(const TokenId token) {
     std::stringstream ss;
-    ss << token->toString() << timeDomain(token->start()->lastDomain()) <<  " --> " << timeDomain(token->end()->lastDomain());
+    writeSimpleTokenSummary(token, ss);
     return ss.str();
 
   }
+
+  void PlanDatabaseWriter::writeSimpleTokenSummary(const TokenId token, std::ostream& os) {
+    os << token->toString();
+    writeTimeDomain(token->start()->lastDomain(), os);
+    os << " --> ";
+    writeTimeDomain(token->end()->lastDomain(), os);
+  }
+
     void PlanDatabaseWriter::writeToken(const TokenId t, std::ostream& os) {
       indent()++;
       check_error(t.isValid());
       TempVarId st = t->start();
-      os << indentation() << "\t" << timeDomain(st->lastDomain()) << std::endl;
-      os << indentation() << "\t" << t->getPredicateName() << "(" ;
-      std::vector<ConstrainedVariableId> vars = t->parameters();
+      writeIndentation(os);
+      os << "\t";
+      writeTimeDomain(st->lastDomain(), os);
+      os << std::endl;
+      writeIndentation(os);
+      os << "\t" << t->getPredicateName() << "(" ;
+      const std::vector<ConstrainedVariableId>& vars = t->parameters();
       for (std::vector<ConstrainedVariableId>::const_iterator varit = vars.begin(); varit != vars.end(); ++varit) {
 	ConstrainedVariableId v = (*varit);
 	checkError(v.isValid(), v);
@@ -199,20 +223,30 @@ namespace EUROPA {
 	os.unsetf(std::ios::fixed);
       }
       os << ")" <<std::endl;
-      os << indentation() << "\tKey=" << getKey(t);
+      writeIndentation(os);
+      os << "\tKey=";
+      writeKey(t, os);
       if (t->master().isNoId())
 	os << "  Master=NONE" << std::endl;
-      else
-	os << "  Master=" << getKey(t->master()) << " " << simpleTokenSummary(t->master()) << std::endl;
+      else {
+	os << "  Master=";
+	writeKey(t->master(), os);
+	os << " ";
+	writeSimpleTokenSummary(t->master(), os);
+	os << std::endl;
+      }
 
 
-      TokenSet mergedtoks = t->getMergedTokens();
+      const TokenSet& mergedtoks = t->getMergedTokens();
 
       for (TokenSet::const_iterator mit = mergedtoks.begin(); mit != mergedtoks.end(); ++mit) {
 	TokenId mergedToken = *mit;
-	os << indentation() << "\t\tMerged Key=" << getKey(mergedToken);
+	writeIndentation(os);
+	os << "\t\tMerged Key=";
+	writeKey(mergedToken, os);
 	if(mergedToken->master().isId()){
-	  os << " from " << simpleTokenSummary(mergedToken->master());
+	  os << " from ";
+	  writeSimpleTokenSummary(mergedToken->master(), os);
 	}
 	else
 	  os << " ROOT";
@@ -220,29 +254,193 @@ namespace EUROPA {
 	os  << std::endl;
       }
 
-      os << indentation() << "\t" << timeDomain(t->end()->lastDomain()) << std::endl;
+      writeIndentation(os);
+      os << "\t";
+      writeTimeDomain(t->end()->lastDomain(), os);
+      os << std::endl;
       indent()--;
     }
 
     void PlanDatabaseWriter::writeVariable(const ConstrainedVariableId var, std::ostream& os) {
       check_error(var.isValid());
       indent()++;
-      os << indentation() << var->getName() << "=" << var->lastDomain() << std::endl;
+      writeIndentation(os);
+      os << var->getName() << "=" << var->lastDomain() << std::endl;
       indent()--;
     }
 
-    std::string PlanDatabaseWriter::getKey(const TokenId token){
+    void PlanDatabaseWriter::writeKey(const TokenId token, std::ostream& os){
       if(useStandardKeys())
-	return EUROPA::toString(token->getKey());
+	os << token->getKey();
       else
-	return token->getPlanDatabase()->getClient()->getPathAsString(token);
+	os << token->getPlanDatabase()->getClient()->getPathAsString(token);
     }
 
-    std::string PlanDatabaseWriter::indentation(){
-      std::string s;
+    void PlanDatabaseWriter::writeIndentation(std::ostream& os){
       for(unsigned int i=0; i<indent(); i++)
-	s = s + "\t";
-      return s;
+	os.put('\t');
+    }
+
+    void PlanDatabaseWriter::writeJson(const PlanDatabaseId db, std::ostream& os) {
+      check_error(!db->getConstraintEngine()->provenInconsistent());
+      os << "{\"objects\":[";
+      const ObjectSet& objs = db->getObjects();
+      for (ObjectSet::const_iterator it = objs.begin(); it != objs.end(); ++it) {
+        if (it != objs.begin())
+          os << ",";
+        writeJson(*it, os);
+      }
+      os << "],\"globalVariables\":[";
+      const ConstrainedVariableSet& globals = db->getGlobalVariables();
+      for (ConstrainedVariableSet::const_iterator it = globals.begin(); it != globals.end(); ++it) {
+        if (it != globals.begin())
+          os << ",";
+        writeJson(*it, os);
+      }
+      os << "],\"tokens\":[";
+      const TokenSet& tokens = db->getTokens();
+      for (TokenSet::const_iterator it = tokens.begin(); it != tokens.end(); ++it) {
+        if (it != tokens.begin())
+          os << ",";
+        writeJson(*it, os);
+      }
+      os << "]}";
+    }
+
+    void PlanDatabaseWriter::writeJson(const ObjectId object, std::ostream& os) {
+      check_error(object.isValid());
+      os << "{\"key\":" << object->getKey() << ",\"name\":";
+      writeJsonString(object->getName().c_str(), os);
+      os << ",\"type\":";
+      writeJsonString(object->getType().c_str(), os);
+
+      // Tokens in timeline order where there is one
+      os << ",\"tokens\":[";
+      if (TimelineId::convertable(object)) {
+        const std::list<TokenId>& toks = TimelineId(object)->getTokenSequence();
+        for (std::list<TokenId>::const_iterator it = toks.begin(); it != toks.end(); ++it)
+          os << (it == toks.begin() ? "" : ",") << (*it)->getKey();
+      }
+      else {
+        const TokenSet& toks = object->tokens();
+        for (TokenSet::const_iterator it = toks.begin(); it != toks.end(); ++it)
+          os << (it == toks.begin() ? "" : ",") << (*it)->getKey();
+      }
+
+      os << "],\"variables\":[";
+      const std::vector<ConstrainedVariableId>& vars = object->getVariables();
+      for (std::vector<ConstrainedVariableId>::const_iterator it = vars.begin(); it != vars.end(); ++it) {
+        if (it != vars.begin())
+          os << ",";
+        writeJson(*it, os);
+      }
+      os << "]}";
+    }
+
+    void PlanDatabaseWriter::writeJson(const TokenId token, std::ostream& os) {
+      check_error(token.isValid());
+      os << "{\"key\":" << token->getKey() << ",\"predicate\":";
+      writeJsonString(token->getPredicateName().c_str(), os);
+      os << ",\"state\":\"" << getStateName(token) << "\",\"master\":";
+      if (token->master().isId())
+        os << token->master()->getKey();
+      else
+        os << "null";
+      if (token->isMerged())
+        os << ",\"activeToken\":" << token->getActiveToken()->getKey();
+      os << ",\"start\":";
+      writeJson(ConstrainedVariableId(token->start()), os);
+      os << ",\"end\":";
+      writeJson(ConstrainedVariableId(token->end()), os);
+      os << ",\"duration\":";
+      writeJson(ConstrainedVariableId(token->duration()), os);
+      os << ",\"parameters\":[";
+      const std::vector<ConstrainedVariableId>& params = token->parameters();
+      for (std::vector<ConstrainedVariableId>::const_iterator it = params.begin(); it != params.end(); ++it) {
+        if (it != params.begin())
+          os << ",";
+        writeJson(*it, os);
+      }
+      os << "]}";
+    }
+
+    void PlanDatabaseWriter::writeJson(const ConstrainedVariableId var, std::ostream& os) {
+      check_error(var.isValid());
+      const Domain& dom = var->lastDomain();
+      os << "{\"name\":";
+      writeJsonString(var->getName().c_str(), os);
+      os << ",\"type\":";
+      writeJsonString(dom.getTypeName().c_str(), os);
+      if (dom.isEnumerated()) {
+        if (dom.isOpen()) {
+          os << ",\"open\":true}";
+          return;
+        }
+        std::list<edouble> values;
+        dom.getValues(values);
+        os << ",\"values\":[";
+        for (std::list<edouble>::const_iterator it = values.begin(); it != values.end(); ++it) {
+          if (it != values.begin())
+            os << ",";
+          writeJsonValue(dom, *it, os);
+        }
+        os << "]}";
+      }
+      else {
+        os << ",\"lb\":";
+        writeJsonValue(dom, dom.getLowerBound(), os);
+        os << ",\"ub\":";
+        writeJsonValue(dom, dom.getUpperBound(), os);
+        os << "}";
+      }
+    }
+
+    void PlanDatabaseWriter::writeJsonValue(const Domain& dom, edouble value, std::ostream& os) {
+      if (dom.isBool())
+        os << (value == 0 ? "false" : "true");
+      else if (dom.isEntity() || dom.isNumeric()) // The keys of objects, and numbers
+        writeJsonNumber(value, os);
+      else
+        writeJsonString(LabelStr(value).c_str(), os);
+    }
+
+    void PlanDatabaseWriter::writeJsonNumber(edouble value, std::ostream& os) {
+      static const double sl_exactLimit = 9007199254740992.0; // 2^53, past which doubles skip integers
+      if (value == MINUS_INFINITY)
+        os << "\"-inf\"";
+      else if (value == PLUS_INFINITY)
+        os << "\"+inf\"";
+      else {
+        const double d = cast_double(value);
+        if (d == std::floor(d) && std::fabs(d) < sl_exactLimit)
+          os << static_cast<eint::basis_type>(d); // Integers, such as the keys of objects, in full
+        else {
+          // Enough digits to read back the same double
+          std::streamsize precision = os.precision(17);
+          os << d;
+          os.precision(precision);
+        }
+      }
+    }
+
+    void PlanDatabaseWriter::writeJsonString(const char* str, std::ostream& os) {
+      static const char* sl_hex = "0123456789abcdef";
+      os.put('"');
+      for (const char* c = str; *c != '\0'; ++c) {
+        switch (*c) {
+          case '"': os << "\\\""; break;
+          case '\\': os << "\\\\"; break;
+          case '\n': os << "\\n"; break;
+          case '\t': os << "\\t"; break;
+          case '\r': os << "\\r"; break;
+          default:
+            if (static_cast<unsigned char>(*c) < 0x20)
+              os << "\\u00" << sl_hex[(*c >> 4) & 0xf] << sl_hex[*c & 0xf];
+            else
+              os.put(*c);
+        }
+      }
+      os.put('"');
     }
 
     unsigned int& PlanDatabaseWriter::indent(){
@@ -255,4 +453,94 @@ namespace EUROPA {
       return sl_useStandardKeys;
     }
 
+  PlanDatabaseDiffWriter::PlanDatabaseDiffWriter(const PlanDatabaseId planDatabase)
+    : PlanDatabaseListener(planDatabase), m_changedObjects(), m_changedTokens(), m_addedKeys(),
+      m_removedObjects(), m_removedTokens() {}
+
+  bool PlanDatabaseDiffWriter::empty() const {
+    return m_changedObjects.empty() && m_changedTokens.empty() &&
+      m_removedObjects.empty() && m_removedTokens.empty();
+  }
+
+  void PlanDatabaseDiffWriter::write(std::ostream& os) {
+    os << "{\"removedObjects\":[";
+    for (std::set<eint>::const_iterator it = m_removedObjects.begin(); it != m_removedObjects.end(); ++it)
+      os << (it == m_removedObjects.begin() ? "" : ",") << *it;
+    os << "],\"objects\":[";
+    for (ObjectSet::const_iterator it = m_changedObjects.begin(); it != m_changedObjects.end(); ++it) {
+      if (it != m_changedObjects.begin())
+        os << ",";
+      PlanDatabaseWriter::writeJson(*it, os);
+    }
+    os << "],\"removedTokens\":[";
+    for (std::set<eint>::const_iterator it = m_removedTokens.begin(); it != m_removedTokens.end(); ++it)
+      os << (it == m_removedTokens.begin() ? "" : ",") << *it;
+    os << "],\"tokens\":[";
+    for (TokenSet::const_iterator it = m_changedTokens.begin(); it != m_changedTokens.end(); ++it) {
+      if (it != m_changedTokens.begin())
+        os << ",";
+      PlanDatabaseWriter::writeJson(*it, os);
+    }
+    os << "]}";
+
+    m_changedObjects.clear();
+    m_changedTokens.clear();
+    m_addedKeys.clear();
+    m_removedObjects.clear();
+    m_removedTokens.clear();
+  }
+
+  void PlanDatabaseDiffWriter::notifyAdded(const ObjectId object) {
+    m_addedKeys.insert(object->getKey());
+    m_changedObjects.insert(object);
+  }
+
+  void PlanDatabaseDiffWriter::notifyRemoved(const ObjectId object) {
+    m_changedObjects.erase(object);
+    // Something created and deleted since the last write was never seen by the consumer
+    if (m_addedKeys.erase(object->getKey()) == 0)
+      m_removedObjects.insert(object->getKey());
+  }
+
+  void PlanDatabaseDiffWriter::notifyAdded(const TokenId token) {
+    m_addedKeys.insert(token->getKey());
+    m_changedTokens.insert(token);
+  }
+
+  void PlanDatabaseDiffWriter::notifyRemoved(const TokenId token) {
+    m_changedTokens.erase(token);
+    if (m_addedKeys.erase(token->getKey()) == 0)
+      m_removedTokens.insert(token->getKey());
+  }
+
+  void PlanDatabaseDiffWriter::notifyActivated(const TokenId token) {m_changedTokens.insert(token);}
+
+  void PlanDatabaseDiffWriter::notifyDeactivated(const TokenId token) {m_changedTokens.insert(token);}
+
+  void PlanDatabaseDiffWriter::notifyMerged(const TokenId token) {m_changedTokens.insert(token);}
+
+  void PlanDatabaseDiffWriter::notifySplit(const TokenId token) {m_changedTokens.insert(token);}
+
+  void PlanDatabaseDiffWriter::notifyRejected(const TokenId token) {m_changedTokens.insert(token);}
+
+  void PlanDatabaseDiffWriter::notifyReinstated(const TokenId token) {m_changedTokens.insert(token);}
+
+  void PlanDatabaseDiffWriter::notifyCommitted(const TokenId token) {m_changedTokens.insert(token);}
+
+  void PlanDatabaseDiffWriter::notifyTerminated(const TokenId token) {m_changedTokens.erase(token);}
+
+  void PlanDatabaseDiffWriter::notifyConstrained(const ObjectId object, const TokenId predecessor,
+                                                 const TokenId successor) {
+    m_changedObjects.insert(object);
+    m_changedTokens.insert(predecessor);
+    m_changedTokens.insert(successor);
+  }
+
+  void PlanDatabaseDiffWriter::notifyFreed(const ObjectId object, const TokenId predecessor,
+                                           const TokenId successor) {
+    m_changedObjects.insert(object);
+    m_changedTokens.insert(predecessor);
+    m_changedTokens.insert(successor);
+  }
+
 }
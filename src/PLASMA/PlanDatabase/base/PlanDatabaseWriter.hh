@@ -2,10 +2,20 @@
 #define H_PlanDatabaseWriter
 
 #include "PlanDatabaseDefs.hh"
+#include "PlanDatabaseListener.hh"
 #include <sstream>
+#include <set>
 
 namespace EUROPA {
 
+  /**
+   * @brief Writes a plan database to a stream, either as indented text or as JSON.
+   *
+   * Output goes straight to the stream; nothing is built up in memory first. The JSON form is
+   * an object with "objects", "globalVariables" and "tokens" arrays. Objects and tokens are
+   * identified by their entity keys, and variables are written with their bounds ("lb", "ub") or
+   * their values. Infinite bounds are written as the strings "-inf" and "+inf".
+   */
   class PlanDatabaseWriter {
 
   public:
@@ -14,6 +24,14 @@ namespace EUROPA {
 
     static void write(PlanDatabaseId db, std::ostream& os);
 
+    static void writeJson(const PlanDatabaseId db, std::ostream& os);
+
+    static void writeJson(const ObjectId object, std::ostream& os);
+
+    static void writeJson(const TokenId token, std::ostream& os);
+
+    static void writeJson(const ConstrainedVariableId var, std::ostream& os);
+
     // [lb, ub] or {singleton}
     static std::string timeDomain(const Domain& dom);
 
@@ -21,17 +39,41 @@ namespace EUROPA {
 
   private:
 
+    /* Token states, in the order tokens are listed by state */
+    enum TokenState {
+      ACTIVE_STATE = 0,
+      MERGED_STATE,
+      REJECTED_STATE,
+      INACTIVE_STATE,
+      INCOMPLETE_STATE,
+      STATE_COUNT
+    };
+
     static void printTokensHelper(std::ostream& os,
                                   const std::string& name,
-                                  const TokenSet& tokens);
+                                  const std::vector<TokenId>& tokens);
 
     static void writeToken(const TokenId t, std::ostream& os);
 
     static void writeVariable(const ConstrainedVariableId var, std::ostream& os);
 
-    static std::string getKey(const TokenId token);
+    static void writeTimeDomain(const Domain& dom, std::ostream& os);
+
+    static void writeSimpleTokenSummary(const TokenId token, std::ostream& os);
+
+    static void writeKey(const TokenId token, std::ostream& os);
+
+    static void writeIndentation(std::ostream& os);
+
+    static void writeJsonString(const char* str, std::ostream& os);
+
+    static void writeJsonNumber(edouble value, std::ostream& os);
 
-    static std::string indentation();
+    static void writeJsonValue(const Domain& dom, edouble value, std::ostream& os);
+
+    static TokenState getState(const TokenId token);
+
+    static const char* getStateName(const TokenId token);
 
     static unsigned int& indent();
 
@@ -39,6 +81,53 @@ namespace EUROPA {
 
   };
 
+  /**
+   * @brief Accumulates the objects and tokens changed by plan database events, and writes them
+   * as JSON so a consumer holding an earlier plan only receives what is new.
+   *
+   * Each call to write covers the events since the previous call. Changed objects and tokens are
+   * written in full, in the form used by PlanDatabaseWriter::writeJson, under "objects" and
+   * "tokens"; deleted ones are listed by key under "removedObjects" and "removedTokens". Domain
+   * restrictions made by propagation are not plan database events, so a token is only written
+   * again when its own state, placement or ordering changes.
+   */
+  class PlanDatabaseDiffWriter : public PlanDatabaseListener {
+  public:
+    PlanDatabaseDiffWriter(const PlanDatabaseId planDatabase);
+
+    /**
+     * @brief Write the changes since the last call, and start accumulating again.
+     */
+    void write(std::ostream& os);
+
+    /**
+     * @brief True if nothing has changed since the last call to write.
+     */
+    bool empty() const;
+
+  private:
+    void notifyAdded(const ObjectId object);
+    void notifyRemoved(const ObjectId object);
+    void notifyAdded(const TokenId token);
+    void notifyRemoved(const TokenId token);
+    void notifyActivated(const TokenId token);
+    void notifyDeactivated(const TokenId token);
+    void notifyMerged(const TokenId token);
+    void notifySplit(const TokenId token);
+    void notifyRejected(const TokenId token);
+    void notifyReinstated(const TokenId token);
+    void notifyConstrained(const ObjectId object, const TokenId predecessor, const TokenId successor);
+    void notifyFreed(const ObjectId object, const TokenId predecessor, const TokenId successor);
+    void notifyCommitted(const TokenId token);
+    void notifyTerminated(const TokenId token);
+
+    ObjectSet m_changedObjects;
+    TokenSet m_changedTokens;
+    std::set<eint> m_addedKeys; /*!< Objects and tokens created since the last write */
+    std::set<eint> m_removedObjects;
+    std::set<eint> m_removedTokens;
+  };
+
 }
 
 #endif /* #ifndef H_PlanDatabaseWriter */
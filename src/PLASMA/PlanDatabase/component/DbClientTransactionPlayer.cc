@@ -11,6 +11,7 @@
 #include "DbClient.hh"
 #include "DbClientTransactionPlayer.hh"
 #include "DbClientTransactionLog.hh"
+#include "DbClientTransactionStream.hh"
 #include "Utils.hh"
 #include "CESchema.hh"
 
@@ -92,8 +93,8 @@ namespace EUROPA {
   }
 
   DbClientTransactionPlayer::DbClientTransactionPlayer(const DbClientId & client)
-      : m_client(client), m_objectCount(0), m_varCount(0), m_filters(), m_tokens(),
-        m_variables(), m_relations(){
+      : m_client(client), m_objectCount(0), m_varCount(0), m_deferPropagation(false), m_filters(),
+        m_tokens(), m_variables(), m_relations(){
   }
 
   DbClientTransactionPlayer::~DbClientTransactionPlayer() {
@@ -116,16 +117,44 @@ CESchemaId DbClientTransactionPlayer::getCESchema() const {
     int txCounter = 0;
     check_error(is, "Invalid input stream for playing transactions.");
 
-    while (!is.eof()) {
-      if (is.peek() != '<') {
-        is.get(); // discard characters up to '<'
-        continue;
+    // Children of nddl elements are played as they are read, as processTransaction would play
+    // them from the whole element. skipDepth is the depth of a group abandoned after propagation
+    // failed, or 0.
+    DbClientXmlTransactionReader reader(is);
+    unsigned int skipDepth = 0;
+    const TiXmlElement* tx = NULL;
+    for (DbClientXmlTransactionReader::Event event = reader.next(tx);
+         event != DbClientXmlTransactionReader::END;
+         event = reader.next(tx)) {
+      switch (event) {
+        case DbClientXmlTransactionReader::BEGIN_GROUP:
+          txCounter++;
+          if (skipDepth == 0 && m_filters.find("nddl") != m_filters.end())
+            skipDepth = reader.getDepth();
+          break;
+        case DbClientXmlTransactionReader::END_GROUP:
+          if (skipDepth > reader.getDepth())
+            skipDepth = 0;
+          else if (skipDepth != 0)
+            break;
+          else if (!m_deferPropagation)
+            m_client->propagate();
+          // A group is itself a child of any enclosing group
+          if (skipDepth == 0 && reader.getDepth() > 0 && !m_deferPropagation && !m_client->propagate())
+            skipDepth = reader.getDepth();
+          break;
+        case DbClientXmlTransactionReader::TRANSACTION:
+          if (reader.getDepth() == 0)
+            txCounter++;
+          if (skipDepth != 0)
+            break;
+          processTransaction(*tx);
+          if (reader.getDepth() > 0 && !m_deferPropagation && !m_client->propagate())
+            skipDepth = reader.getDepth();
+          break;
+        default:
+          break;
       }
-
-      TiXmlElement tx("");
-      is >> tx;
-      processTransaction(tx);
-      txCounter++;
     }
     check_error(txCounter > 0, "Failed to find any transactions in stream.");
   }
@@ -140,6 +169,16 @@ CESchemaId DbClientTransactionPlayer::getCESchema() const {
     }
   }
 
+  void DbClientTransactionPlayer::play(DbClientTransactionReader& reader) {
+    int txCounter = 0;
+    DbClientTransactionRecord record;
+    while (reader.next(record)) {
+      processTransaction(record);
+      txCounter++;
+    }
+    check_error(txCounter > 0, "Failed to find any transactions in stream.");
+  }
+
   void DbClientTransactionPlayer::rewind(std::istream& is, bool breakpoint) {
     check_error(is, "Invalid input stream for playing transactions.");
     std::list<TiXmlElement*> transactions;
@@ -175,6 +214,39 @@ CESchemaId DbClientTransactionPlayer::getCESchema() const {
     }
   }
 
+  /**
+   * Slaves and rule variables are created by rules, which may be waiting on propagation.
+   */
+  TokenId DbClientTransactionPlayer::getTokenByPath(const std::vector<unsigned int>& path) {
+    TokenId token = m_client->getTokenByPath(path);
+    if (token.isNoId() && m_deferPropagation) {
+      m_client->propagate();
+      token = m_client->getTokenByPath(path);
+    }
+    return token;
+  }
+
+  ConstrainedVariableId DbClientTransactionPlayer::getVariableByIndex(unsigned int index) {
+    ConstrainedVariableId variable = m_client->getVariableByIndex(index);
+    if (variable.isNoId() && m_deferPropagation) {
+      m_client->propagate();
+      variable = m_client->getVariableByIndex(index);
+    }
+    return variable;
+  }
+
+  /**
+   * Rule variables are found among the locals of their token, by name and by the order they were made in.
+   */
+  ConstrainedVariableId DbClientTransactionPlayer::getLocalVariable(const TokenId token, const std::string& name,
+                                                                    unsigned int occurrence) {
+    const ConstrainedVariableSet& locals = token->getLocalVariables();
+    for (ConstrainedVariableSet::const_iterator it = locals.begin(); it != locals.end(); ++it)
+      if ((*it)->getName() == name && occurrence-- == 0)
+        return *it;
+    return ConstrainedVariableId::noId();
+  }
+
   bool DbClientTransactionPlayer::transactionFiltered(const TiXmlElement& trans) const {
     for(std::set<std::string>::const_iterator it = m_filters.begin(); it != m_filters.end();
 	++it)
@@ -252,12 +324,149 @@ CESchemaId DbClientTransactionPlayer::getCESchema() const {
 	for (TiXmlElement * child_el = element.FirstChildElement() ;
 	     child_el != NULL ; child_el = child_el->NextSiblingElement()) {
 	  processTransaction(*child_el);
-	  if (!m_client->propagate())
+	  if (!m_deferPropagation && !m_client->propagate())
 	    return;
 	}
       }
     }
-    m_client->propagate();
+    if (!m_deferPropagation)
+      m_client->propagate();
+  }
+
+  void DbClientTransactionPlayer::processTransaction(DbClientTransactionRecord& record) {
+    debugMsg("DbClientTransactionPlayer:processTransaction",
+	     "Processing binary transaction of kind " << record.getKind());
+    switch (record.getKind()) {
+      case DbClientTransactionRecord::VARIABLE_CREATED: {
+	std::string type = record.readString();
+	std::string name = record.readString();
+	Domain* baseDomain = (record.readByte() != 0 ? recordAsDomain(record) : NULL);
+	ConstrainedVariableId variable;
+	if (baseDomain != NULL) {
+	  variable = m_client->createVariable(type, *baseDomain, name, false, true);
+	  delete baseDomain;
+	}
+	else
+	  variable = m_client->createVariable(type, name);
+	m_variables[name] = variable;
+	break;
+      }
+      case DbClientTransactionRecord::VARIABLE_DELETED: {
+	std::string name = record.readString();
+	std::map<std::string, ConstrainedVariableId>::iterator it = m_variables.find(name);
+	checkRuntimeError(it != m_variables.end(), "No variable was created as " << name);
+	ConstrainedVariableId variable = it->second;
+	m_variables.erase(it);
+	m_client->deleteVariable(variable);
+	break;
+      }
+      case DbClientTransactionRecord::OBJECT_CREATED: {
+	std::string type = record.readString();
+	std::string name = record.readString();
+	std::vector<const Domain*> arguments;
+	for (unsigned int i = record.readInt(); i > 0; i--)
+	  arguments.push_back(recordAsDomain(record));
+	check_error_variable(ObjectId object = ) m_client->createObject(type, name, arguments);
+	check_error(object.isValid());
+	for (std::vector<const Domain*>::const_iterator it = arguments.begin(); it != arguments.end(); ++it)
+	  delete *it;
+	break;
+      }
+      case DbClientTransactionRecord::OBJECT_DELETED: {
+	ObjectId object = m_client->getObject(record.readString());
+	check_error(object.isValid());
+	m_client->deleteObject(object);
+	break;
+      }
+      case DbClientTransactionRecord::CLOSED:
+	m_client->close();
+	break;
+      case DbClientTransactionRecord::TYPE_CLOSED:
+	m_client->close(record.readString());
+	break;
+      case DbClientTransactionRecord::GOAL_CREATED:
+      case DbClientTransactionRecord::FACT_CREATED: {
+	bool isFact = record.getKind() == DbClientTransactionRecord::FACT_CREATED;
+	std::string name = toString(record.readInt());
+	std::string type = record.readString();
+	createToken(name.c_str(), type.c_str(), !isFact, isFact);
+	break;
+      }
+      case DbClientTransactionRecord::TOKEN_DELETED: {
+	TokenId token = recordAsToken(record);
+	check_error(token.isValid());
+	m_client->deleteToken(token, record.readString());
+	break;
+      }
+      case DbClientTransactionRecord::CONSTRAINED:
+      case DbClientTransactionRecord::FREED: {
+	ObjectId object = m_client->getObject(record.readString());
+	check_error(object.isValid());
+	TokenId predecessor = recordAsToken(record);
+	TokenId successor = recordAsToken(record);
+	check_error(predecessor.isValid() && successor.isValid());
+	if (record.getKind() == DbClientTransactionRecord::CONSTRAINED)
+	  m_client->constrain(object, predecessor, successor);
+	else
+	  m_client->free(object, predecessor, successor);
+	break;
+      }
+      case DbClientTransactionRecord::ACTIVATED: {
+	TokenId token = recordAsToken(record);
+	check_error(token.isValid());
+	if(!token->isActive())
+	  m_client->activate(token);
+	break;
+      }
+      case DbClientTransactionRecord::MERGED: {
+	TokenId token = recordAsToken(record);
+	TokenId activeToken = recordAsToken(record);
+	check_error(token.isValid() && activeToken.isValid());
+	m_client->merge(token, activeToken);
+	break;
+      }
+      case DbClientTransactionRecord::REJECTED:
+      case DbClientTransactionRecord::CANCELLED: {
+	TokenId token = recordAsToken(record);
+	check_error(token.isValid());
+	if (record.getKind() == DbClientTransactionRecord::REJECTED)
+	  m_client->reject(token);
+	else
+	  m_client->cancel(token);
+	break;
+      }
+      case DbClientTransactionRecord::CONSTRAINT_CREATED: {
+	std::string name = record.readString();
+	record.readInt(); // The index the constraint is given again
+	std::vector<ConstrainedVariableId> variables;
+	for (unsigned int i = record.readInt(); i > 0; i--)
+	  variables.push_back(recordAsVariable(record));
+	m_client->createConstraint(name, variables);
+	break;
+      }
+      case DbClientTransactionRecord::CONSTRAINT_DELETED:
+	m_client->deleteConstraint(m_client->getConstraintByIndex(record.readInt()));
+	break;
+      case DbClientTransactionRecord::VARIABLE_SPECIFIED:
+      case DbClientTransactionRecord::VARIABLE_RESTRICTED: {
+	ConstrainedVariableId variable = recordAsVariable(record);
+	const Domain* value = recordAsDomain(record);
+	if (record.getKind() == DbClientTransactionRecord::VARIABLE_SPECIFIED && value->isSingleton())
+	  m_client->specify(variable, value->getSingletonValue());
+	else
+	  m_client->restrict(variable, *value);
+	delete value;
+	break;
+      }
+      case DbClientTransactionRecord::VARIABLE_RESET:
+	m_client->reset(recordAsVariable(record));
+	break;
+      default:
+	checkRuntimeError(ALWAYS_FAIL, "Unknown transaction kind " << record.getKind());
+    }
+    checkRuntimeError(record.atEnd(), "Malformed transaction of kind " << record.getKind());
+    if (!m_deferPropagation)
+      m_client->propagate();
   }
 
   template<typename Iterator>
@@ -364,7 +573,7 @@ CESchemaId DbClientTransactionPlayer::getCESchema() const {
       str << index;
       unsigned int key;
       str >> key;
-      var = m_client->getVariableByIndex(key);
+      var = getVariableByIndex(key);
     }
     else {
       check_error(m_client->isGlobalVariable(name));
@@ -588,7 +797,7 @@ void DbClientTransactionPlayer::playTokenCreated(const TiXmlElement & element) {
 	str >> pathElement;
 	path.push_back(pathElement);
       }
-      tok = m_client->getTokenByPath(path);
+      tok = getTokenByPath(path);
     }
 
     check_error(tok.isValid());
@@ -1351,6 +1560,112 @@ void DbClientTransactionPlayer::playTokenCreated(const TiXmlElement & element) {
      return m_tokens[token];
   }
 
+  //! binary input functions
+
+  TokenId DbClientTransactionPlayer::recordAsToken(DbClientTransactionRecord& record) {
+    std::vector<unsigned int> path(record.readInt());
+    for (std::vector<unsigned int>::iterator it = path.begin(); it != path.end(); ++it)
+      *it = record.readInt();
+    return getTokenByPath(path);
+  }
+
+  ConstrainedVariableId DbClientTransactionPlayer::recordAsVariable(DbClientTransactionRecord& record) {
+    ConstrainedVariableId variable;
+    unsigned char reference = record.readByte();
+    if (reference == DbClientTransactionRecord::TOKEN_VARIABLE) {
+      TokenId token = recordAsToken(record);
+      check_error(token.isValid());
+      unsigned int index = record.readInt();
+      check_error(index < token->getVariables().size());
+      variable = token->getVariables()[index];
+    }
+    else if (reference == DbClientTransactionRecord::OBJECT_VARIABLE) {
+      ObjectId object = m_client->getObject(record.readString());
+      check_error(object.isValid());
+      unsigned int index = record.readInt();
+      check_error(index < object->getVariables().size());
+      variable = object->getVariables()[index];
+    }
+    else if (reference == DbClientTransactionRecord::GLOBAL_VARIABLE)
+      variable = m_client->getGlobalVariable(record.readString());
+    else if (reference == DbClientTransactionRecord::LOCAL_VARIABLE) {
+      TokenId token = recordAsToken(record);
+      check_error(token.isValid());
+      std::string name = record.readString();
+      unsigned int occurrence = record.readInt();
+      variable = getLocalVariable(token, name, occurrence);
+      if (variable.isNoId() && m_deferPropagation) {
+        m_client->propagate();
+        variable = getLocalVariable(token, name, occurrence);
+      }
+    }
+    else {
+      checkRuntimeError(reference == DbClientTransactionRecord::INDEXED_VARIABLE,
+                        "Unknown variable reference " << static_cast<int>(reference));
+      variable = getVariableByIndex(record.readInt());
+    }
+    check_error(variable.isValid());
+    return variable;
+  }
+
+  Domain * DbClientTransactionPlayer::recordAsDomain(DbClientTransactionRecord& record) {
+    std::string type = record.readString();
+    unsigned char form = record.readByte();
+    if (form == DbClientTransactionRecord::INTERVAL_DOMAIN) {
+      IntervalDomain* domain = dynamic_cast<IntervalDomain*>(getCESchema()->baseDomain(type).copy());
+      check_error(domain != NULL,
+		  "type '" + type + "' should indicate an interval domain type");
+      edouble min = record.readNumber();
+      domain->intersect(min, record.readNumber());
+      return domain;
+    }
+
+    unsigned char kind = record.readByte();
+    if (form == DbClientTransactionRecord::SINGLETON_DOMAIN) {
+      edouble value = recordAsValue(record, kind, type);
+      if (kind == DbClientTransactionRecord::OBJECT_VALUE) {
+	ObjectId object = Entity::getTypedEntity<Object>(value);
+	return new ObjectDomain(getCESchema()->getDataType(object->getType().c_str()), object);
+      }
+      Domain * domain = getCESchema()->baseDomain(type).copy();
+      if(domain->isOpen() && !domain->isMember(value))
+	domain->insert(value);
+      domain->set(value);
+      return domain;
+    }
+
+    checkRuntimeError(form == DbClientTransactionRecord::ENUMERATED_DOMAIN,
+                      "Unknown domain form " << static_cast<int>(form));
+    DataTypeId dataType = getCESchema()->getDataType(type.c_str());
+    std::list<edouble> values;
+    for (unsigned int i = record.readInt(); i > 0; i--)
+      values.push_back(recordAsValue(record, kind, type));
+    if (kind == DbClientTransactionRecord::OBJECT_VALUE) {
+      std::list<ObjectId> objects;
+      for (std::list<edouble>::const_iterator it = values.begin(); it != values.end(); ++it)
+	objects.push_back(Entity::getTypedEntity<Object>(*it));
+      return new ObjectDomain(dataType, objects);
+    }
+    if (kind == DbClientTransactionRecord::NUMBER_VALUE)
+      return new EnumeratedDomain(dataType, values);
+    if (dataType->isString())
+      return new StringDomain(values, dataType);
+    return new SymbolDomain(values, dataType);
+  }
+
+  edouble DbClientTransactionPlayer::recordAsValue(DbClientTransactionRecord& record, unsigned char kind,
+                                                   const std::string& type) {
+    if (kind == DbClientTransactionRecord::NUMBER_VALUE)
+      return record.readNumber();
+    if (kind == DbClientTransactionRecord::SYMBOL_VALUE)
+      return m_client->createValue(type, record.readString());
+    checkRuntimeError(kind == DbClientTransactionRecord::OBJECT_VALUE,
+                      "Unknown value kind " << static_cast<int>(kind));
+    ObjectId object = m_client->getObject(record.readString());
+    check_error(object.isValid());
+    return object->getKey();
+  }
+
   //! XML input functions
 
   Domain *
@@ -1634,7 +1949,7 @@ DbClientTransactionPlayer::xmlAsEnumeratedDomain(const TiXmlElement & element,
 
       const char * token_path = variable.Attribute("token");
       if (token_path != NULL) {
-        TokenId token = m_client->getTokenByPath(pathAsVector(token_path));
+        TokenId token = getTokenByPath(pathAsVector(token_path));
         check_error(token.isValid());
         check_error(static_cast<unsigned>(index) < token->getVariables().size());
         return token->getVariables()[static_cast<unsigned>(index)];
@@ -1649,7 +1964,7 @@ DbClientTransactionPlayer::xmlAsEnumeratedDomain(const TiXmlElement & element,
       }
 
       // rule variables
-      return m_client->getVariableByIndex(static_cast<unsigned>(index));
+      return getVariableByIndex(static_cast<unsigned>(index));
     }
 
     ConstrainedVariableId var = xmlAsCreateVariable(NULL, NULL, &variable);
@@ -1671,7 +1986,7 @@ DbClientTransactionPlayer::xmlAsEnumeratedDomain(const TiXmlElement & element,
     if (strcmp(token.Value(), "token") == 0) {
       const char * path = token.Attribute("path");
       if (path != NULL) {
-        return m_client->getTokenByPath(pathAsVector(path));
+        return getTokenByPath(pathAsVector(path));
       }
 
       const char * name = token.Attribute("name");
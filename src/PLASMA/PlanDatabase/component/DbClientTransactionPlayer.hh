@@ -17,6 +17,8 @@
 namespace EUROPA {
 
 	class TiXmlElement;
+  class DbClientTransactionReader;
+  class DbClientTransactionRecord;
 
   class DbClientTransactionPlayer {
   public:
@@ -25,7 +27,9 @@ namespace EUROPA {
 
     /**
      * @brief Play all transactions from an input stream
-     * @param is a stream of xml-based transactions.
+     * @param is a stream of xml-based transactions. Transactions are parsed and played one at a
+     * time, including the children of nddl elements, so the stream is never held in memory.
+     * @see DbClientXmlTransactionReader
      */
     void play(std::istream& is);
 
@@ -35,6 +39,13 @@ namespace EUROPA {
      */
     void play(const DbClientTransactionLogId txLog);
 
+    /**
+     * @brief Play all transactions from a binary transaction stream
+     * @param reader the source of transactions, as written by a DbClientTransactionWriter. Each
+     * record is played as it is decoded.
+     */
+    void play(DbClientTransactionReader& reader);
+
     /**
      * @brief Play the inverses of transactions from an input stream.
      * @param is a stream of xml-based transactions
@@ -50,6 +61,13 @@ namespace EUROPA {
      */
     void rewind(const DbClientTransactionLogId txLog, bool breakpoint = false);
 
+    /**
+     * @brief When set, transactions are played without propagating after each one. Propagation is
+     * left to the caller, except where a transaction refers to a token or variable that rules have
+     * yet to create.
+     */
+    void setDeferPropagation(bool defer) {m_deferPropagation = defer;}
+
     void setFilter(const std::set<std::string>& filters);
     static const std::set<std::string>& MODEL_TRANSACTIONS();
     static const std::set<std::string>& STATE_TRANSACTIONS();
@@ -66,6 +84,7 @@ namespace EUROPA {
     bool transactionMatch(const TiXmlElement& trans, const std::string& name) const;
     bool transactionFiltered(const TiXmlElement& trans) const;
     virtual void processTransaction(const TiXmlElement & element);
+    void processTransaction(DbClientTransactionRecord& record);
     template<typename Iterator>
     void processTransactionInverse(const TiXmlElement& element,
 				   Iterator start, Iterator end);
@@ -131,9 +150,15 @@ namespace EUROPA {
     CESchemaId getCESchema() const;
     SchemaId getSchema() const;
 
+    TokenId getTokenByPath(const std::vector<unsigned int>& path);
+    ConstrainedVariableId getVariableByIndex(unsigned int index);
+    ConstrainedVariableId getLocalVariable(const TokenId token, const std::string& name,
+                                           unsigned int occurrence);
+
     DbClientId m_client;
     int m_objectCount;
     int m_varCount;
+    bool m_deferPropagation;
     std::set<std::string> m_filters;
     std::map<std::string, TokenId> m_tokens;
     std::map<std::string, ConstrainedVariableId> m_variables;
@@ -154,6 +179,28 @@ namespace EUROPA {
      */
     TokenId parseToken(const char * tokString);
 
+  //! binary input functions
+
+    /**
+     * @brief read a token path from a binary transaction
+     */
+    TokenId recordAsToken(DbClientTransactionRecord& record);
+
+    /**
+     * @brief read a variable reference from a binary transaction
+     */
+    ConstrainedVariableId recordAsVariable(DbClientTransactionRecord& record);
+
+    /**
+     * @brief create a domain as written in a binary transaction
+     */
+    Domain * recordAsDomain(DbClientTransactionRecord& record);
+
+    /**
+     * @brief read a value of the given type from a binary transaction
+     */
+    edouble recordAsValue(DbClientTransactionRecord& record, unsigned char kind, const std::string& type);
+
   //! XML input functions
 
     /**
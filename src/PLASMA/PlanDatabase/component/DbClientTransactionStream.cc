@@ -0,0 +1,735 @@
+#include "DbClientTransactionStream.hh"
+#include "Constraint.hh"
+#include "ConstrainedVariable.hh"
+#include "Debug.hh"
+#include "Domain.hh"
+#include "Error.hh"
+#include "LabelStr.hh"
+#include "Object.hh"
+#include "Schema.hh"
+#include "Token.hh"
+#include "tinyxml.h"
+
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <list>
+#include <stdint.h>
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace EUROPA {
+
+namespace {
+  const char STREAM_MAGIC[8] = {'E', 'U', 'T', 'X', 'L', 'O', 'G', '\0'};
+  const uint32_t STREAM_VERSION = 2;
+  const uint32_t STREAM_BYTE_ORDER = 0x01020304;
+
+  /* Records are a 32 bit payload length, a kind and the payload */
+  const unsigned char BEGIN_RECORD = 1;
+  const unsigned char SYMBOL_RECORD = 2;
+  const unsigned char TRANSACTION_RECORD = 3;
+  const size_t RECORD_HEADER_SIZE = sizeof(uint32_t) + 1;
+
+  void appendInt(std::string& out, uint32_t value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(uint32_t));
+  }
+
+  void appendBeginRecord(std::ostream& os) {
+    std::string payload(STREAM_MAGIC, sizeof(STREAM_MAGIC));
+    appendInt(payload, STREAM_VERSION);
+    appendInt(payload, STREAM_BYTE_ORDER);
+    std::string record;
+    appendInt(record, static_cast<uint32_t>(payload.size()));
+    record.push_back(static_cast<char>(BEGIN_RECORD));
+    record.append(payload);
+    os.write(record.data(), static_cast<std::streamsize>(record.size()));
+  }
+}
+
+  DbClientTransactionRecord::DbClientTransactionRecord()
+    : m_reader(NULL), m_pos(NULL), m_end(NULL), m_kind(VARIABLE_CREATED) {}
+
+  unsigned char DbClientTransactionRecord::readByte() {
+    checkRuntimeError(m_pos < m_end, "Malformed transaction in " << m_reader->getFileName());
+    return static_cast<unsigned char>(*m_pos++);
+  }
+
+  unsigned int DbClientTransactionRecord::readInt() {
+    return m_reader->readInt(m_pos, m_end);
+  }
+
+  double DbClientTransactionRecord::readNumber() {
+    checkRuntimeError(m_end - m_pos >= static_cast<long>(sizeof(double)),
+                      "Malformed transaction in " << m_reader->getFileName());
+    double value;
+    std::memcpy(&value, m_pos, sizeof(double));
+    m_pos += sizeof(double);
+    return value;
+  }
+
+  void DbClientTransactionRecord::readSymbol(const char*& str, unsigned int& length) {
+    uint32_t symbol = readInt();
+    checkRuntimeError(symbol < m_reader->m_symbols.size(),
+                      "Undefined symbol " << symbol << " in " << m_reader->getFileName());
+    str = m_reader->m_symbols[symbol].first;
+    length = m_reader->m_symbols[symbol].second;
+  }
+
+  std::string DbClientTransactionRecord::readString() {
+    const char* str = NULL;
+    unsigned int length = 0;
+    readSymbol(str, length);
+    return std::string(str, length);
+  }
+
+  DbClientTransactionWriter::DbClientTransactionWriter(const DbClientId client, bool chronologicalBacktracking)
+    : DbClientListener(client), m_chronologicalBacktracking(chronologicalBacktracking), m_buffer(),
+      m_record(), m_pending(), m_transactions(), m_symbols(), m_symbolOrder(), m_tokensCreated(0),
+      m_localVariableTokens() {}
+
+  DbClientTransactionWriter::~DbClientTransactionWriter() {}
+
+  void DbClientTransactionWriter::notifyObjectCreated(const ObjectId object) {
+    const std::vector<const Domain*> noArguments;
+    notifyObjectCreated(object, noArguments);
+  }
+
+  void DbClientTransactionWriter::notifyObjectCreated(const ObjectId object,
+                                                      const std::vector<const Domain*>& arguments) {
+    beginTransaction(DbClientTransactionRecord::OBJECT_CREATED);
+    writeSymbol(object->getType());
+    writeSymbol(object->getName());
+    writeInt(static_cast<unsigned int>(arguments.size()));
+    for (std::vector<const Domain*>::const_iterator it = arguments.begin(); it != arguments.end(); ++it)
+      writeDomain(**it);
+    endTransaction();
+  }
+
+  void DbClientTransactionWriter::notifyObjectDeleted(const ObjectId object) {
+    beginTransaction(DbClientTransactionRecord::OBJECT_DELETED);
+    writeSymbol(object->getName());
+    endTransaction();
+  }
+
+  void DbClientTransactionWriter::notifyClosed() {
+    beginTransaction(DbClientTransactionRecord::CLOSED);
+    endTransaction();
+  }
+
+  void DbClientTransactionWriter::notifyClosed(const std::string& objectType) {
+    beginTransaction(DbClientTransactionRecord::TYPE_CLOSED);
+    writeSymbol(objectType);
+    endTransaction();
+  }
+
+  void DbClientTransactionWriter::notifyTokenCreated(const TokenId token) {
+    beginTransaction(token->isFact() ? DbClientTransactionRecord::FACT_CREATED :
+                     DbClientTransactionRecord::GOAL_CREATED);
+    writeInt(static_cast<unsigned int>(m_tokensCreated++));
+    writeSymbol(token->getPredicateName());
+    endTransaction();
+  }
+
+  void DbClientTransactionWriter::notifyTokenDeleted(const TokenId token, const std::string& name) {
+    beginTransaction(DbClientTransactionRecord::TOKEN_DELETED);
+    writeToken(token);
+    writeSymbol(name);
+    endTransaction();
+  }
+
+  void DbClientTransactionWriter::notifyConstrained(const ObjectId object, const TokenId predecessor,
+                                                    const TokenId successor) {
+    beginTransaction(DbClientTransactionRecord::CONSTRAINED);
+    writeSymbol(object->getName());
+    writeToken(predecessor);
+    writeToken(successor);
+    endTransaction();
+  }
+
+  void DbClientTransactionWriter::notifyFreed(const ObjectId object, const TokenId predecessor,
+                                              const TokenId successor) {
+    beginTransaction(DbClientTransactionRecord::FREED);
+    writeSymbol(object->getName());
+    writeToken(predecessor);
+    writeToken(successor);
+    if (!retractLast(DbClientTransactionRecord::CONSTRAINED))
+      endTransaction();
+  }
+
+  void DbClientTransactionWriter::notifyActivated(const TokenId token) {
+    beginTransaction(DbClientTransactionRecord::ACTIVATED);
+    writeToken(token);
+    endTransaction();
+  }
+
+  void DbClientTransactionWriter::notifyMerged(const TokenId token, const TokenId activeToken) {
+    beginTransaction(DbClientTransactionRecord::MERGED);
+    writeToken(token);
+    writeToken(activeToken);
+    endTransaction();
+  }
+
+  void DbClientTransactionWriter::notifyRejected(const TokenId token) {
+    beginTransaction(DbClientTransactionRecord::REJECTED);
+    writeToken(token);
+    endTransaction();
+  }
+
+  void DbClientTransactionWriter::notifyCancelled(const TokenId token) {
+    beginTransaction(DbClientTransactionRecord::CANCELLED);
+    writeToken(token);
+    if (!retractLast(DbClientTransactionRecord::ACTIVATED, DbClientTransactionRecord::MERGED,
+                     DbClientTransactionRecord::REJECTED))
+      endTransaction();
+  }
+
+  void DbClientTransactionWriter::notifyConstraintCreated(const ConstraintId constraint) {
+    beginTransaction(DbClientTransactionRecord::CONSTRAINT_CREATED);
+    writeSymbol(constraint->getName());
+    writeInt(m_client->getIndexByConstraint(constraint));
+    const std::vector<ConstrainedVariableId>& scope = constraint->getScope();
+    writeInt(static_cast<unsigned int>(scope.size()));
+    for (std::vector<ConstrainedVariableId>::const_iterator it = scope.begin(); it != scope.end(); ++it)
+      writeVariable(*it);
+    endTransaction();
+  }
+
+  void DbClientTransactionWriter::notifyConstraintDeleted(const ConstraintId constraint) {
+    beginTransaction(DbClientTransactionRecord::CONSTRAINT_DELETED);
+    writeInt(m_client->getIndexByConstraint(constraint));
+    endTransaction();
+  }
+
+  void DbClientTransactionWriter::notifyVariableCreated(const ConstrainedVariableId variable) {
+    if (variable->isInternal())
+      return;
+    const Domain& baseDomain = variable->baseDomain();
+    std::string type = baseDomain.getTypeName();
+    if (m_client->getSchema()->isObjectType(type)) {
+      ObjectId object = Entity::getTypedEntity<Object>(baseDomain.getLowerBound());
+      check_error(object.isValid());
+      type = object->getType();
+    }
+    beginTransaction(DbClientTransactionRecord::VARIABLE_CREATED);
+    writeSymbol(type);
+    writeSymbol(variable->getName());
+    writeByte(baseDomain.isEmpty() ? 0 : 1);
+    if (!baseDomain.isEmpty())
+      writeDomain(baseDomain);
+    endTransaction();
+  }
+
+  void DbClientTransactionWriter::notifyVariableDeleted(const ConstrainedVariableId variable) {
+    if (variable->isInternal())
+      return;
+    // The player knows each variable it created by name
+    beginTransaction(DbClientTransactionRecord::VARIABLE_DELETED);
+    writeSymbol(variable->getName());
+    endTransaction();
+  }
+
+  void DbClientTransactionWriter::notifyVariableSpecified(const ConstrainedVariableId variable) {
+    if (variable->isInternal())
+      return;
+    checkError(variable->lastDomain().isSingleton(), variable->toString() << " is not a singleton.");
+    beginTransaction(DbClientTransactionRecord::VARIABLE_SPECIFIED);
+    writeVariable(variable);
+    writeDomain(variable->lastDomain());
+    endTransaction();
+  }
+
+  void DbClientTransactionWriter::notifyVariableRestricted(const ConstrainedVariableId variable) {
+    if (variable->isInternal())
+      return;
+    beginTransaction(DbClientTransactionRecord::VARIABLE_RESTRICTED);
+    writeVariable(variable);
+    writeDomain(variable->baseDomain());
+    endTransaction();
+  }
+
+  void DbClientTransactionWriter::notifyVariableReset(const ConstrainedVariableId variable) {
+    if (variable->isInternal())
+      return;
+    beginTransaction(DbClientTransactionRecord::VARIABLE_RESET);
+    writeVariable(variable);
+    if (!retractLast(DbClientTransactionRecord::VARIABLE_SPECIFIED))
+      endTransaction();
+  }
+
+  void DbClientTransactionWriter::flush(std::ostream& os) {
+    write(os);
+    m_buffer.clear();
+    m_transactions.clear();
+    m_symbols.clear();
+    m_symbolOrder.clear();
+  }
+
+  void DbClientTransactionWriter::write(std::ostream& os) const {
+    check_error(os.good(), "Invalid output stream for writing transactions.");
+    appendBeginRecord(os);
+    os.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+    os.flush();
+  }
+
+  void DbClientTransactionWriter::beginTransaction(DbClientTransactionRecord::Kind kind) {
+    // Symbols first used by this transaction are appended to the buffer while it is encoded
+    m_record.clear();
+    m_record.push_back(static_cast<char>(kind));
+    m_pending.symbolOffset = m_buffer.size();
+    m_pending.symbolCount = m_symbols.size();
+  }
+
+  void DbClientTransactionWriter::endTransaction() {
+    m_pending.recordOffset = m_buffer.size();
+    appendRecord(TRANSACTION_RECORD, m_record);
+    m_transactions.push_back(m_pending);
+  }
+
+  /**
+   * The transaction being encoded retracts the last one if that is of the given kind and its operands
+   * start with the same ones. If so, the last one is removed along with the symbols it introduced.
+   */
+  bool DbClientTransactionWriter::retractLast(DbClientTransactionRecord::Kind kind) {
+    if (!m_chronologicalBacktracking || m_transactions.empty())
+      return false;
+    const BufferedTransaction& last = m_transactions.back();
+    size_t payload = last.recordOffset + RECORD_HEADER_SIZE;
+    // Symbols interned for the retraction mean its operands differ
+    if (payload >= m_buffer.size() || static_cast<unsigned char>(m_buffer[payload]) != kind ||
+        m_buffer.size() - payload < m_record.size() ||
+        m_buffer.compare(payload + 1, m_record.size() - 1, m_record, 1, std::string::npos) != 0)
+      return false;
+
+    while (m_symbolOrder.size() > last.symbolCount) {
+      m_symbols.erase(m_symbolOrder.back());
+      m_symbolOrder.pop_back();
+    }
+    m_buffer.resize(last.symbolOffset);
+    m_transactions.pop_back();
+    return true;
+  }
+
+  bool DbClientTransactionWriter::retractLast(DbClientTransactionRecord::Kind kind1,
+                                              DbClientTransactionRecord::Kind kind2,
+                                              DbClientTransactionRecord::Kind kind3) {
+    return retractLast(kind1) || retractLast(kind2) || retractLast(kind3);
+  }
+
+  void DbClientTransactionWriter::writeByte(unsigned char value) {
+    m_record.push_back(static_cast<char>(value));
+  }
+
+  void DbClientTransactionWriter::writeInt(unsigned int value) {
+    appendInt(m_record, static_cast<uint32_t>(value));
+  }
+
+  void DbClientTransactionWriter::writeNumber(double value) {
+    m_record.append(reinterpret_cast<const char*>(&value), sizeof(double));
+  }
+
+  void DbClientTransactionWriter::writeSymbol(const std::string& str) {
+    writeInt(intern(str));
+  }
+
+  void DbClientTransactionWriter::writeToken(const TokenId token) {
+    std::vector<unsigned int> path = m_client->getPathByToken(token);
+    writeInt(static_cast<unsigned int>(path.size()));
+    for (std::vector<unsigned int>::const_iterator it = path.begin(); it != path.end(); ++it)
+      writeInt(*it);
+  }
+
+  void DbClientTransactionWriter::writeVariable(const ConstrainedVariableId variable) {
+    const EntityId parent = variable->parent();
+    if (parent.isId() && variable->getIndex() != ConstrainedVariable::NO_INDEX) {
+      if (TokenId::convertable(parent)) {
+        writeByte(DbClientTransactionRecord::TOKEN_VARIABLE);
+        writeToken(TokenId(parent));
+        writeInt(variable->getIndex());
+        return;
+      }
+      if (ObjectId::convertable(parent)) {
+        writeByte(DbClientTransactionRecord::OBJECT_VARIABLE);
+        writeSymbol(ObjectId(parent)->getName());
+        writeInt(variable->getIndex());
+        return;
+      }
+    }
+    const std::string& name = variable->getName();
+    if (m_client->isGlobalVariable(name) && m_client->getGlobalVariable(name) == variable) {
+      writeByte(DbClientTransactionRecord::GLOBAL_VARIABLE);
+      writeSymbol(name);
+      return;
+    }
+    if (parent.isId()) {
+      // Rule variables are identified by name among the locals of their token, which the player finds
+      // once the rule has fired. Keys are not reused, so a rule instance found here is never stale.
+      std::map<eint, TokenId>::iterator it = m_localVariableTokens.find(parent->getKey());
+      if (it == m_localVariableTokens.end())
+        it = m_localVariableTokens.insert(it, std::make_pair(parent->getKey(),
+                                                             m_client->getTokenByLocalVariable(variable)));
+      if (it->second.isId()) {
+        const ConstrainedVariableSet& locals = it->second->getLocalVariables();
+        unsigned int occurrence = 0;
+        for (ConstrainedVariableSet::const_iterator local = locals.begin();
+             local != locals.end() && *local != variable; ++local)
+          if ((*local)->getName() == name)
+            occurrence++;
+        writeByte(DbClientTransactionRecord::LOCAL_VARIABLE);
+        writeToken(it->second);
+        writeSymbol(name);
+        writeInt(occurrence);
+        return;
+      }
+    }
+    writeByte(DbClientTransactionRecord::INDEXED_VARIABLE);
+    writeInt(m_client->getIndexByVariable(variable));
+  }
+
+  void DbClientTransactionWriter::writeDomain(const Domain& domain) {
+    check_error(!domain.isEmpty());
+    DbClientTransactionRecord::ValueKind kind = DbClientTransactionRecord::NUMBER_VALUE;
+    if (domain.isEntity())
+      kind = DbClientTransactionRecord::OBJECT_VALUE;
+    else if (!domain.isNumeric())
+      kind = DbClientTransactionRecord::SYMBOL_VALUE;
+
+    writeSymbol(domain.getTypeName());
+    if (domain.isSingleton()) {
+      writeByte(DbClientTransactionRecord::SINGLETON_DOMAIN);
+      writeByte(static_cast<unsigned char>(kind));
+      writeValue(domain, kind, domain.getSingletonValue());
+    }
+    else if (domain.isEnumerated()) {
+      writeByte(DbClientTransactionRecord::ENUMERATED_DOMAIN);
+      writeByte(static_cast<unsigned char>(kind));
+      std::list<edouble> values;
+      domain.getValues(values);
+      writeInt(static_cast<unsigned int>(values.size()));
+      for (std::list<edouble>::const_iterator it = values.begin(); it != values.end(); ++it)
+        writeValue(domain, kind, *it);
+    }
+    else {
+      check_error(domain.isInterval());
+      writeByte(DbClientTransactionRecord::INTERVAL_DOMAIN);
+      writeNumber(cast_double(domain.getLowerBound()));
+      writeNumber(cast_double(domain.getUpperBound()));
+    }
+  }
+
+  void DbClientTransactionWriter::writeValue(const Domain& domain, DbClientTransactionRecord::ValueKind kind,
+                                             edouble value) {
+    if (kind == DbClientTransactionRecord::NUMBER_VALUE)
+      writeNumber(cast_double(value));
+    else if (kind == DbClientTransactionRecord::SYMBOL_VALUE)
+      writeSymbol(LabelStr(value).toString());
+    else {
+      ObjectId object = Entity::getTypedEntity<Object>(value);
+      check_error(object.isValid());
+      writeSymbol(object->getName());
+    }
+  }
+
+  unsigned int DbClientTransactionWriter::intern(const std::string& str) {
+    std::map<std::string, unsigned int>::iterator it = m_symbols.find(str);
+    if (it != m_symbols.end())
+      return it->second;
+
+    uint32_t symbol = static_cast<uint32_t>(m_symbols.size());
+    m_symbolOrder.push_back(m_symbols.insert(std::make_pair(str, symbol)).first);
+    std::string payload;
+    appendInt(payload, symbol);
+    payload.append(str);
+    appendRecord(SYMBOL_RECORD, payload);
+    return symbol;
+  }
+
+  void DbClientTransactionWriter::appendRecord(unsigned char kind, const std::string& payload) {
+    appendInt(m_buffer, static_cast<uint32_t>(payload.size()));
+    m_buffer.push_back(static_cast<char>(kind));
+    m_buffer.append(payload);
+  }
+
+  DbClientTransactionReader::DbClientTransactionReader(const std::string& fileName)
+    : m_fileName(fileName), m_data(NULL), m_size(0), m_pos(0), m_buffer(), m_symbols() {
+#ifdef _MSC_VER
+    std::ifstream in(fileName.c_str(), std::ios::in | std::ios::binary);
+    checkRuntimeError(in.good(), "Failed to open transactions in " << fileName);
+    m_buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    if (!m_buffer.empty()) {
+      m_data = &m_buffer[0];
+      m_size = m_buffer.size();
+    }
+#else
+    int fd = open(fileName.c_str(), O_RDONLY);
+    checkRuntimeError(fd >= 0, "Failed to open transactions in " << fileName);
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void* addr = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr != MAP_FAILED) {
+        m_data = static_cast<const char*>(addr);
+        m_size = static_cast<size_t>(st.st_size);
+      }
+    }
+    close(fd);
+    checkRuntimeError(m_data != NULL, "Failed to map transactions in " << fileName);
+#endif
+    debugMsg("DbClientTransactionReader:DbClientTransactionReader",
+             "Reading " << m_size << " bytes of transactions from " << fileName);
+  }
+
+  DbClientTransactionReader::~DbClientTransactionReader() {
+#ifndef _MSC_VER
+    if (m_data != NULL)
+      munmap(const_cast<char*>(m_data), m_size);
+#endif
+  }
+
+  bool DbClientTransactionReader::next(DbClientTransactionRecord& transaction) {
+    while (m_pos < m_size) {
+      size_t offset = m_pos;
+      checkRuntimeError(m_size - offset >= RECORD_HEADER_SIZE,
+                        "Truncated record at offset " << offset << " in " << m_fileName);
+      const char* pos = m_data + offset;
+      uint32_t length = readInt(pos, m_data + m_size);
+      unsigned char kind = static_cast<unsigned char>(*pos++);
+      checkRuntimeError(length <= static_cast<size_t>(m_data + m_size - pos),
+                        "Truncated record at offset " << offset << " in " << m_fileName);
+      checkRuntimeError(offset != 0 || kind == BEGIN_RECORD,
+                        m_fileName << " is not a transaction stream.");
+      const char* end = pos + length;
+      m_pos = static_cast<size_t>(end - m_data);
+
+      switch (kind) {
+        case BEGIN_RECORD:
+          checkRuntimeError(length == sizeof(STREAM_MAGIC) + 2 * sizeof(uint32_t) &&
+                            std::memcmp(pos, STREAM_MAGIC, sizeof(STREAM_MAGIC)) == 0,
+                            m_fileName << " is not a transaction stream.");
+          pos += sizeof(STREAM_MAGIC);
+          checkRuntimeError(readInt(pos, end) == STREAM_VERSION, "Unsupported version of " << m_fileName);
+          checkRuntimeError(readInt(pos, end) == STREAM_BYTE_ORDER,
+                            m_fileName << " was written with a different byte order.");
+          m_symbols.clear();
+          break;
+        case SYMBOL_RECORD: {
+          uint32_t symbol = readInt(pos, end);
+          checkRuntimeError(symbol == m_symbols.size(),
+                            "Symbol " << symbol << " out of sequence in " << m_fileName);
+          m_symbols.push_back(std::make_pair(pos, static_cast<unsigned int>(end - pos)));
+          break;
+        }
+        case TRANSACTION_RECORD:
+          checkRuntimeError(pos < end, "Empty transaction at offset " << offset << " in " << m_fileName);
+          transaction.m_reader = this;
+          transaction.m_kind = static_cast<DbClientTransactionRecord::Kind>(static_cast<unsigned char>(*pos));
+          transaction.m_pos = pos + 1;
+          transaction.m_end = end;
+          return true;
+        default:
+          checkRuntimeError(false, "Unknown record kind " << static_cast<int>(kind) <<
+                            " in " << m_fileName);
+      }
+    }
+    return false;
+  }
+
+  unsigned int DbClientTransactionReader::readInt(const char*& pos, const char* end) const {
+    checkRuntimeError(end - pos >= static_cast<long>(sizeof(uint32_t)),
+                      "Malformed record in " << m_fileName);
+    uint32_t value;
+    std::memcpy(&value, pos, sizeof(uint32_t));
+    pos += sizeof(uint32_t);
+    return value;
+  }
+
+  DbClientXmlTransactionReader::DbClientXmlTransactionReader(std::istream& is, unsigned int bufferSize)
+    : m_is(is), m_bufferSize(bufferSize), m_buffer(), m_pos(0), m_offset(0), m_depth(0),
+      m_document(new TiXmlDocument()) {
+    check_error(m_is.good(), "Invalid input stream for reading transactions.");
+    check_error(m_bufferSize > 0);
+  }
+
+  DbClientXmlTransactionReader::~DbClientXmlTransactionReader() {
+    delete m_document;
+  }
+
+  DbClientXmlTransactionReader::Event DbClientXmlTransactionReader::next(const TiXmlElement*& transaction) {
+    transaction = NULL;
+    while (true) {
+      // Drop consumed input once it is at least half the buffer
+      if (m_pos > 0 && 2 * m_pos >= m_buffer.size()) {
+        m_buffer.erase(0, m_pos);
+        m_offset += m_pos;
+        m_pos = 0;
+      }
+
+      size_t start = find("<", m_pos);
+      if (start == std::string::npos) {
+        checkRuntimeError(m_depth == 0, "Unterminated nddl element in transactions.");
+        m_pos = m_buffer.size();
+        return END;
+      }
+
+      if (lookingAt(start, "<?") || lookingAt(start, "<!")) {
+        m_pos = skipMarkup(start);
+        continue;
+      }
+
+      if (lookingAt(start, "</")) {
+        size_t end = find(">", start);
+        checkRuntimeError(end != std::string::npos, "Unterminated tag at offset " << m_offset + start);
+        checkRuntimeError(m_depth > 0 && tagName(start + 2) == "nddl",
+                          "Unexpected closing tag at offset " << m_offset + start);
+        m_depth--;
+        m_pos = end + 1;
+        return END_GROUP;
+      }
+
+      // An nddl element that has content is a group rather than a transaction
+      if (tagName(start + 1) == "nddl") {
+        size_t end = scanTag(start);
+        if (m_buffer[end - 2] != '/') {
+          m_depth++;
+          m_pos = end;
+          return BEGIN_GROUP;
+        }
+      }
+
+      size_t end = scanElement(start);
+      // Parse in place, terminating the element's text for the duration
+      char next = end < m_buffer.size() ? m_buffer[end] : '\0';
+      if (end < m_buffer.size())
+        m_buffer[end] = '\0';
+      m_document->Clear();
+      m_document->Parse(m_buffer.c_str() + start);
+      if (end < m_buffer.size())
+        m_buffer[end] = next;
+      m_pos = end;
+
+      checkRuntimeError(!m_document->Error() && m_document->RootElement() != NULL,
+                        "Failed to parse transaction at offset " << m_offset + start << ": " <<
+                        m_document->ErrorDesc());
+      transaction = m_document->RootElement();
+      return TRANSACTION;
+    }
+  }
+
+  bool DbClientXmlTransactionReader::fill() {
+    if (!m_is.good())
+      return false;
+    size_t size = m_buffer.size();
+    m_buffer.resize(size + m_bufferSize);
+    m_is.read(&m_buffer[size], static_cast<std::streamsize>(m_bufferSize));
+    m_buffer.resize(size + static_cast<size_t>(m_is.gcount()));
+    return m_buffer.size() > size;
+  }
+
+  bool DbClientXmlTransactionReader::available(size_t pos) {
+    while (pos >= m_buffer.size()) {
+      if (!fill())
+        return false;
+    }
+    return true;
+  }
+
+  bool DbClientXmlTransactionReader::lookingAt(size_t pos, const char* str) {
+    for (size_t i = 0; str[i] != '\0'; i++) {
+      if (!available(pos + i) || m_buffer[pos + i] != str[i])
+        return false;
+    }
+    return true;
+  }
+
+  size_t DbClientXmlTransactionReader::find(const char* str, size_t from) {
+    size_t length = std::strlen(str);
+    while (true) {
+      size_t pos = m_buffer.find(str, from);
+      if (pos != std::string::npos)
+        return pos;
+      // A match may straddle the end of what has been read so far
+      if (m_buffer.size() >= length && m_buffer.size() - length + 1 > from)
+        from = m_buffer.size() - length + 1;
+      if (!fill())
+        return std::string::npos;
+    }
+  }
+
+  /**
+   * Comments, CDATA sections, processing instructions and declarations.
+   * @return The position after the markup at pos.
+   */
+  size_t DbClientXmlTransactionReader::skipMarkup(size_t pos) {
+    const char* terminator = ">";
+    if (lookingAt(pos, "<!--"))
+      terminator = "-->";
+    else if (lookingAt(pos, "<![CDATA["))
+      terminator = "]]>";
+    else if (lookingAt(pos, "<?"))
+      terminator = "?>";
+    size_t end = find(terminator, pos + 2);
+    checkRuntimeError(end != std::string::npos, "Unterminated markup at offset " << m_offset + pos);
+    return end + std::strlen(terminator);
+  }
+
+  /**
+   * @return The position after the start or empty element tag at pos.
+   */
+  size_t DbClientXmlTransactionReader::scanTag(size_t pos) {
+    char quote = '\0';
+    for (size_t i = pos + 1; available(i); i++) {
+      char c = m_buffer[i];
+      if (quote != '\0') {
+        if (c == quote)
+          quote = '\0';
+      }
+      else if (c == '"' || c == '\'')
+        quote = c;
+      else if (c == '>')
+        return i + 1;
+    }
+    checkRuntimeError(false, "Unterminated tag at offset " << m_offset + pos);
+    return std::string::npos;
+  }
+
+  /**
+   * @return The position after the end of the element that starts at pos.
+   */
+  size_t DbClientXmlTransactionReader::scanElement(size_t pos) {
+    unsigned int depth = 0;
+    size_t i = pos;
+    do {
+      if (lookingAt(i, "<!") || lookingAt(i, "<?"))
+        i = skipMarkup(i);
+      else if (lookingAt(i, "</")) {
+        size_t end = find(">", i);
+        checkRuntimeError(end != std::string::npos, "Unterminated tag at offset " << m_offset + i);
+        depth--;
+        i = end + 1;
+      }
+      else if (lookingAt(i, "<")) {
+        i = scanTag(i);
+        if (m_buffer[i - 2] != '/')
+          depth++;
+      }
+      else {
+        i = find("<", i);
+        checkRuntimeError(i != std::string::npos, "Unterminated element at offset " << m_offset + pos);
+      }
+    } while (depth > 0);
+    return i;
+  }
+
+  std::string DbClientXmlTransactionReader::tagName(size_t pos) {
+    size_t end = pos;
+    while (available(end) && m_buffer[end] != '>' && m_buffer[end] != '/' &&
+           !std::isspace(static_cast<unsigned char>(m_buffer[end])))
+      end++;
+    return m_buffer.substr(pos, end - pos);
+  }
+}
@@ -0,0 +1,297 @@
+#ifndef H_DbClientTransactionStream
+#define H_DbClientTransactionStream
+
+#include "DbClientListener.hh"
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @file DbClientTransactionStream.hh
+ * @brief Compact binary encoding of transactions, for logs too large to keep as xml.
+ *
+ * A stream is a sequence of length-prefixed records. Each transaction is a record holding its kind
+ * and its operands: names, token paths, variable references and domains. Names, types and symbolic
+ * values are interned: each distinct string is written once, as a symbol record, before the first
+ * transaction that uses it. A begin record resets the symbol table, so streams written separately
+ * can be appended to one another.
+ *
+ * Also declares DbClientXmlTransactionReader, which reads xml transactions incrementally.
+ */
+
+namespace EUROPA {
+
+  class TiXmlElement;
+  class TiXmlDocument;
+  class DbClientTransactionReader;
+
+  /**
+   * @brief A transaction read from a binary stream. Operands are read in the order they were written,
+   * straight from the stream.
+   * @see DbClientTransactionWriter
+   */
+  class DbClientTransactionRecord {
+  public:
+    enum Kind {
+      VARIABLE_CREATED = 1,
+      VARIABLE_DELETED,
+      OBJECT_CREATED,
+      OBJECT_DELETED,
+      CLOSED,
+      TYPE_CLOSED,
+      GOAL_CREATED,
+      FACT_CREATED,
+      TOKEN_DELETED,
+      CONSTRAINED,
+      FREED,
+      ACTIVATED,
+      MERGED,
+      REJECTED,
+      CANCELLED,
+      CONSTRAINT_CREATED,
+      CONSTRAINT_DELETED,
+      VARIABLE_SPECIFIED,
+      VARIABLE_RESTRICTED,
+      VARIABLE_RESET
+    };
+
+    /* How a variable operand is identified */
+    enum VariableReference {
+      TOKEN_VARIABLE = 1, /*!< A token path and the index of the variable in the token */
+      OBJECT_VARIABLE, /*!< An object name and the index of the variable in the object */
+      INDEXED_VARIABLE, /*!< The index the client gave the variable, for any variable without a name */
+      GLOBAL_VARIABLE, /*!< The name of a global variable */
+      LOCAL_VARIABLE /*!< A token path, the variable name and which of the token's locals of that name */
+    };
+
+    /* The forms of a domain operand, which starts with the name of its type */
+    enum DomainForm {
+      SINGLETON_DOMAIN = 1, /*!< One value */
+      ENUMERATED_DOMAIN, /*!< A count and the values */
+      INTERVAL_DOMAIN /*!< Two numbers */
+    };
+
+    /* How the values of a domain operand are written */
+    enum ValueKind {
+      NUMBER_VALUE = 1, /*!< A number */
+      SYMBOL_VALUE, /*!< A symbol holding the value's string */
+      OBJECT_VALUE /*!< A symbol holding the object's name */
+    };
+
+    DbClientTransactionRecord();
+
+    Kind getKind() const {return m_kind;}
+
+    unsigned char readByte();
+    unsigned int readInt();
+    double readNumber();
+    std::string readString();
+
+    /**
+     * @brief Read a symbol without copying it.
+     * @param str Set to the start of the symbol, which is not null terminated.
+     */
+    void readSymbol(const char*& str, unsigned int& length);
+
+    /**
+     * @brief True once every operand has been read.
+     */
+    bool atEnd() const {return m_pos == m_end;}
+
+  private:
+    friend class DbClientTransactionReader;
+
+    const DbClientTransactionReader* m_reader;
+    const char* m_pos;
+    const char* m_end;
+    Kind m_kind;
+  };
+
+  /**
+   * @brief Records the transactions of a client in binary form as they happen, and buffers them until
+   * they are flushed.
+   *
+   * With chronological backtracking, retracting the last buffered decision removes it from the buffer,
+   * as DbClientTransactionLog does: free after constrain, cancel after activate, merge or reject, and
+   * reset after specify. Any other retraction is recorded and played as such. Tokens are written as
+   * their paths, so transaction logging must be enabled on the client.
+   */
+  class DbClientTransactionWriter: public DbClientListener {
+  public:
+    DbClientTransactionWriter(const DbClientId client, bool chronologicalBacktracking = true);
+    ~DbClientTransactionWriter();
+
+    void notifyObjectCreated(const ObjectId object);
+    void notifyObjectCreated(const ObjectId object, const std::vector<const Domain*>& arguments);
+    void notifyObjectDeleted(const ObjectId object);
+    void notifyClosed();
+    void notifyClosed(const std::string& objectType);
+    void notifyTokenCreated(const TokenId token);
+    void notifyTokenDeleted(const TokenId token, const std::string& name);
+    void notifyConstrained(const ObjectId object, const TokenId predecessor, const TokenId successor);
+    void notifyFreed(const ObjectId object, const TokenId predecessor, const TokenId successor);
+    void notifyActivated(const TokenId token);
+    void notifyMerged(const TokenId token, const TokenId activeToken);
+    void notifyRejected(const TokenId token);
+    void notifyCancelled(const TokenId token);
+    void notifyConstraintCreated(const ConstraintId constraint);
+    void notifyConstraintDeleted(const ConstraintId constraint);
+    void notifyVariableCreated(const ConstrainedVariableId variable);
+    void notifyVariableDeleted(const ConstrainedVariableId variable);
+    void notifyVariableSpecified(const ConstrainedVariableId variable);
+    void notifyVariableRestricted(const ConstrainedVariableId variable);
+    void notifyVariableReset(const ConstrainedVariableId variable);
+
+    /**
+     * @brief Write the buffered transactions to an output stream and clear the buffer. Each flush is
+     * a stream of its own, so flushing to the same file appends to it.
+     */
+    void flush(std::ostream& os);
+
+    /**
+     * @brief Write the buffered transactions to an output stream, keeping the buffer.
+     */
+    void write(std::ostream& os) const;
+
+    /**
+     * @brief The number of buffered transactions.
+     */
+    unsigned int getTransactionCount() const {return static_cast<unsigned int>(m_transactions.size());}
+
+  private:
+    DbClientTransactionWriter(const DbClientTransactionWriter&);
+    DbClientTransactionWriter& operator=(const DbClientTransactionWriter&);
+
+    /* A buffered transaction record, and the symbol records written for it */
+    struct BufferedTransaction {
+      size_t symbolOffset; /*!< Where its symbol records start in the buffer */
+      size_t recordOffset;
+      size_t symbolCount; /*!< The number of symbols interned before it */
+    };
+
+    void beginTransaction(DbClientTransactionRecord::Kind kind);
+    void endTransaction();
+    bool retractLast(DbClientTransactionRecord::Kind kind);
+    bool retractLast(DbClientTransactionRecord::Kind kind1, DbClientTransactionRecord::Kind kind2,
+                     DbClientTransactionRecord::Kind kind3);
+
+    void writeByte(unsigned char value);
+    void writeInt(unsigned int value);
+    void writeNumber(double value);
+    void writeSymbol(const std::string& str);
+    void writeToken(const TokenId token);
+    void writeVariable(const ConstrainedVariableId variable);
+    void writeDomain(const Domain& domain);
+    void writeValue(const Domain& domain, DbClientTransactionRecord::ValueKind kind, edouble value);
+
+    unsigned int intern(const std::string& str);
+    void appendRecord(unsigned char kind, const std::string& payload);
+
+    bool m_chronologicalBacktracking;
+    std::string m_buffer; /*!< Records not yet flushed */
+    std::string m_record; /*!< The transaction being encoded */
+    BufferedTransaction m_pending; /*!< Where the transaction being encoded starts */
+    std::vector<BufferedTransaction> m_transactions;
+    std::map<std::string, unsigned int> m_symbols;
+    std::vector<std::map<std::string, unsigned int>::iterator> m_symbolOrder; /*!< By symbol number */
+    int m_tokensCreated;
+    std::map<eint, TokenId> m_localVariableTokens; /*!< By the key of the rule instance that made the variable */
+  };
+
+  /**
+   * @brief Reads transactions from a file written by a DbClientTransactionWriter.
+   *
+   * The file is memory mapped where the platform supports it. Records and symbols refer into the
+   * mapping, so nothing is copied until the player asks for it.
+   */
+  class DbClientTransactionReader {
+  public:
+    DbClientTransactionReader(const std::string& fileName);
+    ~DbClientTransactionReader();
+
+    /**
+     * @brief Advance to the next transaction.
+     * @return false if there are no more transactions.
+     */
+    bool next(DbClientTransactionRecord& transaction);
+
+    const std::string& getFileName() const {return m_fileName;}
+
+  private:
+    friend class DbClientTransactionRecord;
+
+    DbClientTransactionReader(const DbClientTransactionReader&);
+    DbClientTransactionReader& operator=(const DbClientTransactionReader&);
+
+    unsigned int readInt(const char*& pos, const char* end) const;
+
+    std::string m_fileName;
+    const char* m_data;
+    size_t m_size;
+    size_t m_pos;
+    std::vector<char> m_buffer; /*!< Holds the file where it can't be mapped */
+    std::vector<std::pair<const char*, unsigned int> > m_symbols;
+  };
+
+  /**
+   * @brief Pulls xml transactions from an input stream one element at a time.
+   *
+   * Only the text of the transaction being parsed is buffered, so memory is bounded by the largest
+   * transaction rather than by the size of the input. An nddl element is not parsed as a whole: its
+   * start and end are reported as events, and its children are returned as transactions in turn.
+   * Processing instructions, comments and text between transactions are skipped.
+   */
+  class DbClientXmlTransactionReader {
+  public:
+    enum Event {
+      TRANSACTION, /*!< A transaction was parsed */
+      BEGIN_GROUP, /*!< An nddl element was opened */
+      END_GROUP, /*!< The innermost open nddl element was closed */
+      END /*!< The input is exhausted */
+    };
+
+    /**
+     * @param is The source. Must remain valid for the life of the reader.
+     * @param bufferSize The number of bytes read from is at a time.
+     */
+    DbClientXmlTransactionReader(std::istream& is, unsigned int bufferSize = 65536);
+    ~DbClientXmlTransactionReader();
+
+    /**
+     * @brief Advance to the next event.
+     * @param transaction Set to the parsed transaction for TRANSACTION events. It is owned by the
+     * reader and only valid until the next call.
+     */
+    Event next(const TiXmlElement*& transaction);
+
+    /**
+     * @brief The number of nddl elements currently open.
+     */
+    unsigned int getDepth() const {return m_depth;}
+
+  private:
+    DbClientXmlTransactionReader(const DbClientXmlTransactionReader&);
+    DbClientXmlTransactionReader& operator=(const DbClientXmlTransactionReader&);
+
+    bool fill();
+    bool available(size_t pos);
+    bool lookingAt(size_t pos, const char* str);
+    size_t find(const char* str, size_t from);
+    size_t skipMarkup(size_t pos);
+    size_t scanTag(size_t pos);
+    size_t scanElement(size_t pos);
+    std::string tagName(size_t pos);
+
+    std::istream& m_is;
+    unsigned int m_bufferSize;
+    std::string m_buffer; /*!< Input from m_pos on has not been consumed */
+    size_t m_pos;
+    size_t m_offset; /*!< Position in the input of the start of m_buffer */
+    unsigned int m_depth;
+    TiXmlDocument* m_document; /*!< Holds the last transaction parsed */
+  };
+}
+
+#endif
@@ -0,0 +1,43 @@
+#include "PlanDatabaseSnapshot.hh"
+#include "DbClient.hh"
+#include "DbClientTransactionPlayer.hh"
+#include "Debug.hh"
+#include "Error.hh"
+
+#include <fstream>
+
+namespace EUROPA {
+
+  void PlanDatabaseSnapshot::save(const DbClientTransactionWriter& writer, const std::string& fileName) {
+    std::ofstream out(fileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    checkRuntimeError(out.good(), "Failed to open " << fileName << " for a snapshot.");
+    writer.write(out);
+    checkRuntimeError(out.good(), "Failed writing a snapshot to " << fileName);
+    debugMsg("PlanDatabaseSnapshot:save",
+             "Saved " << writer.getTransactionCount() << " transactions to " << fileName);
+  }
+
+  bool PlanDatabaseSnapshot::restore(const DbClientId client, const std::string& fileName) {
+    check_error(client.isValid());
+    // Tokens in the snapshot are identified by their path from the tokens created through the client
+    if (!client->isTransactionLoggingEnabled())
+      client->enableTransactionLogging();
+
+    DbClientTransactionReader reader(fileName);
+    DbClientTransactionPlayer player(client);
+    player.setDeferPropagation(true);
+    client->beginBulkLoad();
+    try {
+      player.play(reader);
+    }
+    catch (...) {
+      client->abandonBulkLoad();
+      throw;
+    }
+
+    bool consistent = client->endBulkLoad();
+    debugMsg("PlanDatabaseSnapshot:restore",
+             "Restored " << fileName << (consistent ? "" : ", which is inconsistent"));
+    return consistent;
+  }
+}
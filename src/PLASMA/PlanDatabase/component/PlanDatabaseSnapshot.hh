@@ -0,0 +1,44 @@
+#ifndef H_PlanDatabaseSnapshot
+#define H_PlanDatabaseSnapshot
+
+#include "PlanDatabaseDefs.hh"
+#include "DbClientTransactionStream.hh"
+#include <string>
+
+/**
+ * @file PlanDatabaseSnapshot.hh
+ * @brief Checkpoint and restore of a plan database.
+ */
+
+namespace EUROPA {
+
+  /**
+   * @brief Saves the state of a plan database and rebuilds it in another database with the same schema.
+   *
+   * A snapshot holds the transactions buffered by a DbClientTransactionWriter. With chronological
+   * backtracking, retracted decisions are popped from the writer as they are undone, so the buffer is
+   * what it takes to rebuild objects, tokens and their active, merged or rejected state, specified and
+   * restricted variables, orderings and constraints. Derived domains and rule expansions are not stored.
+   * Restore plays the transactions without propagating after each one, and propagates at the end. A
+   * transaction on a slave or a rule variable that does not exist yet propagates first, so the rule that
+   * makes it fires.
+   * @see DbClientTransactionWriter, DbClientTransactionPlayer::setDeferPropagation
+   */
+  class PlanDatabaseSnapshot {
+  public:
+    /**
+     * @brief Write a snapshot to a file.
+     * @param writer A writer attached to the client before any tokens were created through it.
+     */
+    static void save(const DbClientTransactionWriter& writer, const std::string& fileName);
+
+    /**
+     * @brief Rebuild the state saved in a file.
+     * @param client The client of a database with the same schema, through which no tokens were created.
+     * @return The result of the final propagation.
+     */
+    static bool restore(const DbClientId client, const std::string& fileName);
+  };
+}
+
+#endif
@@ -13,6 +13,9 @@
 #include "HasAncestorConstraint.hh"
 #include "DbClientTransactionLog.hh"
 #include "DbClientTransactionPlayer.hh"
+#include "DbClientTransactionStream.hh"
+#include "PlanDatabaseSnapshot.hh"
+#include "tinyxml.h"
 
 #include "DbClient.hh"
 #include "ObjectType.hh"
@@ -30,11 +33,15 @@
 
 #include "unused.hh"
 
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include <sstream>
 #include <iomanip>
 #include <string>
 #include <boost/cast.hpp>
+#include <unistd.h>
 
 using namespace EUROPA;
 namespace {
@@ -2880,6 +2887,7 @@ public:
     EUROPA_runTest(testAssignment);
     EUROPA_runTest(testFreeAndConstrain);
     EUROPA_runTest(testRemovalOfMasterAndSlave);
+    EUROPA_runTest(testPlanWriters);
 
     /* The archiving algorithm needs to be rewritten in EUROPA. Or better still, taken out of EUROPA. We can keep these tests for reference but they are both
        incomplete and incorrect. CMG
@@ -2893,6 +2901,73 @@ public:
 
 private:
 
+  static bool testPlanWriters(){
+    DEFAULT_SETUP(ce, db, false);
+    DbClientId client = db->getClient();
+    PlanDatabaseDiffWriter* diff = new PlanDatabaseDiffWriter(db);
+
+    ObjectId foo = client->createObject(LabelStr(DEFAULT_OBJECT_TYPE).c_str(), "foo1");
+    client->close();
+    TokenId t0 = client->createToken(LabelStr(DEFAULT_PREDICATE).c_str());
+    TokenId t1 = client->createToken(LabelStr(DEFAULT_PREDICATE).c_str());
+    client->activate(t0);
+    client->activate(t1);
+    client->constrain(foo, t0, t1);
+    client->createVariable(FloatDT::NAME().c_str(), IntervalDomain(0.1, 1e6), "f", false, true);
+    client->createVariable(LabelStr(DEFAULT_OBJECT_TYPE).c_str(), "o");
+    CPPUNIT_ASSERT(client->propagate());
+
+    std::string text = PlanDatabaseWriter::toString(db);
+    CPPUNIT_ASSERT_MESSAGE(text, text.find("End Tokens") != std::string::npos);
+
+    std::ostringstream json;
+    PlanDatabaseWriter::writeJson(db, json);
+    std::ostringstream tokens;
+    tokens << "\"tokens\":[" << t0->getKey() << "," << t1->getKey() << "]";
+    CPPUNIT_ASSERT_MESSAGE(json.str(), json.str().find("{\"objects\":[{\"key\":") == 0);
+    CPPUNIT_ASSERT_MESSAGE(json.str(), json.str().find("\"name\":\"foo1\"") != std::string::npos);
+    CPPUNIT_ASSERT_MESSAGE(json.str(), json.str().find(tokens.str()) != std::string::npos);
+    CPPUNIT_ASSERT_MESSAGE(json.str(), json.str().find("\"state\":\"active\"") != std::string::npos);
+    // Integers, including object keys, are written in full, and other values so they read back the same
+    std::ostringstream objectKey;
+    objectKey << "\"values\":[" << foo->getKey() << "]";
+    CPPUNIT_ASSERT_MESSAGE(json.str(), json.str().find(objectKey.str()) != std::string::npos);
+    CPPUNIT_ASSERT_MESSAGE(json.str(), json.str().find("\"lb\":0.10000000000000001,\"ub\":1000000}") != std::string::npos);
+
+    // Everything so far is new
+    std::ostringstream first;
+    diff->write(first);
+    CPPUNIT_ASSERT_MESSAGE(first.str(), first.str().find("\"name\":\"foo1\"") != std::string::npos);
+    CPPUNIT_ASSERT_MESSAGE(first.str(), first.str().find(tokens.str()) != std::string::npos);
+    CPPUNIT_ASSERT(diff->empty());
+
+    // Freeing t1 from t0 marks both tokens and the object, and t1 is marked again when cancelled
+    client->free(foo, t0, t1);
+    client->cancel(t1);
+    std::ostringstream second;
+    diff->write(second);
+    std::ostringstream t0Key, t1Key;
+    t0Key << "{\"key\":" << t0->getKey() << ",";
+    t1Key << "{\"key\":" << t1->getKey() << ",";
+    CPPUNIT_ASSERT_MESSAGE(second.str(), second.str().find(t0Key.str()) != std::string::npos);
+    CPPUNIT_ASSERT_MESSAGE(second.str(), second.str().find(t1Key.str()) != std::string::npos);
+    CPPUNIT_ASSERT_MESSAGE(second.str(), second.str().find("\"name\":\"foo1\"") != std::string::npos);
+    CPPUNIT_ASSERT_MESSAGE(second.str(), second.str().find("\"state\":\"inactive\"") != std::string::npos);
+    CPPUNIT_ASSERT_MESSAGE(second.str(), second.str().find("\"removedTokens\":[]") != std::string::npos);
+
+    eint key = t1->getKey();
+    client->deleteToken(t1);
+    std::ostringstream third, removed;
+    diff->write(third);
+    removed << "{\"removedObjects\":[],\"objects\":[],\"removedTokens\":[" << key << "],\"tokens\":[]}";
+    CPPUNIT_ASSERT_MESSAGE(third.str(), third.str() == removed.str());
+    CPPUNIT_ASSERT(third.str().find(t0Key.str()) == std::string::npos);
+
+    delete diff;
+    DEFAULT_TEARDOWN();
+    return true;
+  }
+
   static bool testBasicInsertion(){
     DEFAULT_SETUP(ce, db, false);
     Timeline timeline(db, LabelStr(DEFAULT_OBJECT_TYPE), "o2");
@@ -3873,6 +3948,10 @@ public:
     EUROPA_runTest(testBasicAllocation);
     EUROPA_runTest(testPathBasedRetrieval);
     EUROPA_runTest(testGlobalVariables);
+    EUROPA_runTest(testBinaryTransactionLog);
+    EUROPA_runTest(testSnapshot);
+    EUROPA_runTest(testBulkLoad);
+    EUROPA_runTest(testXmlTransactionReader);
     return true;
   }
 private:
@@ -4028,6 +4107,258 @@ private:
     DEFAULT_TEARDOWN();
     return true;
   }
+
+  /**
+   * The binary stream must decode to the same transactions as the xml log.
+   */
+  static bool testXmlTransactionReader(){
+    // A tiny buffer makes every construct straddle a refill
+    std::istringstream is("<?xml version=\"1.0\"?>\n<!-- header -->\n"
+                          "<nddl>\n"
+                          "  <new type=\"Foo\" name=\"a>b\"><value name='x/>'/></new>\n"
+                          "  <nddl><activate><token path=\"1\"/></activate></nddl>\n"
+                          "  <!-- <goal/> --><nddl/>\n"
+                          "</nddl>\n"
+                          "<invoke name=\"close\"/>");
+    DbClientXmlTransactionReader reader(is, 3);
+    const TiXmlElement* tx = NULL;
+
+    CPPUNIT_ASSERT(reader.next(tx) == DbClientXmlTransactionReader::BEGIN_GROUP);
+    CPPUNIT_ASSERT(reader.getDepth() == 1);
+
+    CPPUNIT_ASSERT(reader.next(tx) == DbClientXmlTransactionReader::TRANSACTION);
+    CPPUNIT_ASSERT(std::string(tx->Value()) == "new");
+    CPPUNIT_ASSERT(std::string(tx->Attribute("name")) == "a>b");
+    CPPUNIT_ASSERT(tx->FirstChildElement() != NULL);
+    CPPUNIT_ASSERT(std::string(tx->FirstChildElement()->Attribute("name")) == "x/>");
+
+    CPPUNIT_ASSERT(reader.next(tx) == DbClientXmlTransactionReader::BEGIN_GROUP);
+    CPPUNIT_ASSERT(reader.getDepth() == 2);
+    CPPUNIT_ASSERT(reader.next(tx) == DbClientXmlTransactionReader::TRANSACTION);
+    CPPUNIT_ASSERT(std::string(tx->Value()) == "activate");
+    CPPUNIT_ASSERT(reader.next(tx) == DbClientXmlTransactionReader::END_GROUP);
+    CPPUNIT_ASSERT(reader.getDepth() == 1);
+
+    // An empty nddl element is an ordinary transaction
+    CPPUNIT_ASSERT(reader.next(tx) == DbClientXmlTransactionReader::TRANSACTION);
+    CPPUNIT_ASSERT(std::string(tx->Value()) == "nddl");
+    CPPUNIT_ASSERT(reader.next(tx) == DbClientXmlTransactionReader::END_GROUP);
+    CPPUNIT_ASSERT(reader.getDepth() == 0);
+
+    CPPUNIT_ASSERT(reader.next(tx) == DbClientXmlTransactionReader::TRANSACTION);
+    CPPUNIT_ASSERT(std::string(tx->Value()) == "invoke");
+    CPPUNIT_ASSERT(reader.next(tx) == DbClientXmlTransactionReader::END);
+    CPPUNIT_ASSERT(tx == NULL);
+    return true;
+  }
+
+  /**
+   * Tokens, their state and the numeric domains of their variables, for comparing databases.
+   */
+  static std::string tokenSummary(const DbClientId client, unsigned int tokenCount) {
+    std::ostringstream os;
+    for (unsigned int i = 0; i < tokenCount; i++) {
+      TokenId token = client->getTokenByPath(std::vector<unsigned int>(1, i));
+      CPPUNIT_ASSERT(token.isValid());
+      os << client->getPathAsString(token) << " " << token->getPredicateName() <<
+          (token->isActive() ? " active" : " inactive");
+      for (std::vector<ConstrainedVariableId>::const_iterator it = token->getVariables().begin();
+           it != token->getVariables().end(); ++it)
+        if ((*it)->lastDomain().isNumeric())
+          os << " " << (*it)->lastDomain().toString();
+      os << std::endl;
+    }
+    return os.str();
+  }
+
+  /**
+   * A path for a file the test writes, which the caller removes.
+   */
+  static std::string temporaryFileName(const std::string& prefix) {
+    std::string pattern = "/tmp/" + prefix + "XXXXXX";
+    std::vector<char> name(pattern.begin(), pattern.end());
+    name.push_back('\0');
+    int fd = mkstemp(&name[0]);
+    CPPUNIT_ASSERT_MESSAGE(pattern, fd >= 0);
+    close(fd);
+    return std::string(&name[0]);
+  }
+
+  /**
+   * Transactions written as the client makes them must play back to the same database, without the
+   * decisions that were retracted before they were flushed.
+   */
+  static bool testBinaryTransactionLog(){
+    const std::string fileName = temporaryFileName("binaryTransactions");
+    std::string expected;
+    {
+      DEFAULT_SETUP(ce, db, false);
+      DbClientId client = db->getClient();
+      client->enableTransactionLogging();
+      DbClientTransactionWriter* writer = new DbClientTransactionWriter(client);
+
+      std::vector<const Domain*> arguments;
+      IntervalIntDomain arg0(10);
+      LabelSet arg1(LabelStr("Label"));
+      arguments.push_back(&arg0);
+      arguments.push_back(&arg1);
+      ObjectId foo = client->createObject(LabelStr(DEFAULT_OBJECT_TYPE).c_str(), "foo1");
+      client->createObject(LabelStr(DEFAULT_OBJECT_TYPE).c_str(), "foo2", arguments);
+      client->createVariable(IntDT::NAME().c_str(), "v1");
+      client->close();
+
+      TokenId t0 = client->createToken(LabelStr(DEFAULT_PREDICATE).c_str());
+      TokenId t1 = client->createToken(LabelStr(DEFAULT_PREDICATE).c_str());
+      TokenId t2 = client->createToken(LabelStr(DEFAULT_PREDICATE).c_str());
+      client->createConstraint("eq", makeScope(t0->start(), t0->duration()));
+      client->specify(t0->duration(), 5);
+      client->restrict(t1->start(), IntervalIntDomain(0, 10));
+      client->specify(t0->getObject(), foo->getKey());
+      client->activate(t0);
+      client->activate(t2);
+
+      // Retracting the last decision removes it from the buffer
+      const unsigned int transactionCount = writer->getTransactionCount();
+      client->specify(t1->duration(), 7);
+      client->reset(t1->duration());
+      client->activate(t1);
+      client->cancel(t1);
+      CPPUNIT_ASSERT(writer->getTransactionCount() == transactionCount);
+
+      std::ofstream out(fileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+      writer->flush(out);
+      CPPUNIT_ASSERT(writer->getTransactionCount() == 0);
+
+      // Once flushed, a retraction is written as one
+      client->cancel(t2);
+      CPPUNIT_ASSERT(writer->getTransactionCount() == 1);
+      writer->flush(out);
+      out.close();
+
+      CPPUNIT_ASSERT(client->propagate());
+      expected = tokenSummary(client, 3);
+      delete writer;
+      DEFAULT_TEARDOWN();
+    }
+    {
+      DEFAULT_SETUP(ce, db, false);
+      DbClientId client = db->getClient();
+      client->enableTransactionLogging();
+      DbClientTransactionPlayer player(client);
+      DbClientTransactionReader reader(fileName);
+      player.play(reader);
+
+      CPPUNIT_ASSERT(client->propagate());
+      std::string actual = tokenSummary(client, 3);
+      CPPUNIT_ASSERT_MESSAGE(expected + "\n" + actual, actual == expected);
+      CPPUNIT_ASSERT(db->getObject("foo2").isValid());
+      CPPUNIT_ASSERT(client->getGlobalVariable("v1").isValid());
+      TokenId t0 = client->getTokenByPath(std::vector<unsigned int>(1, 0));
+      CPPUNIT_ASSERT(t0->getObject()->lastDomain().isSingleton());
+      CPPUNIT_ASSERT(t0->getObject()->lastDomain().getSingletonValue() == db->getObject("foo1")->getKey());
+      DEFAULT_TEARDOWN();
+    }
+    std::remove(fileName.c_str());
+    return true;
+  }
+
+  /**
+   * A restored snapshot must reproduce the decisions that were not retracted, and what they propagate to.
+   */
+  static bool testSnapshot(){
+    const std::string fileName = temporaryFileName("snapshot");
+    std::string expected;
+    {
+      DEFAULT_SETUP(ce, db, false);
+      DbClientId client = db->getClient();
+      client->enableTransactionLogging();
+      DbClientTransactionWriter* writer = new DbClientTransactionWriter(client);
+
+      ObjectId foo = client->createObject(LabelStr(DEFAULT_OBJECT_TYPE).c_str(), "foo1");
+      client->close();
+      TokenId t0 = client->createToken(LabelStr(DEFAULT_PREDICATE).c_str());
+      TokenId t1 = client->createToken(LabelStr(DEFAULT_PREDICATE).c_str());
+      TokenId t2 = client->createToken(LabelStr(DEFAULT_PREDICATE).c_str());
+      client->activate(t0);
+      client->activate(t1);
+      client->constrain(foo, t0, t1);
+      client->specify(t0->duration(), 5);
+      client->activate(t2);
+      client->cancel(t2);
+      CPPUNIT_ASSERT(client->propagate());
+      CPPUNIT_ASSERT(t0->duration()->lastDomain().isSingleton());
+
+      expected = tokenSummary(client, 3);
+      PlanDatabaseSnapshot::save(*writer, fileName);
+      delete writer;
+      DEFAULT_TEARDOWN();
+    }
+    {
+      DEFAULT_SETUP(ce, db, false);
+      DbClientId client = db->getClient();
+      CPPUNIT_ASSERT(PlanDatabaseSnapshot::restore(client, fileName));
+      std::string actual = tokenSummary(client, 3);
+      CPPUNIT_ASSERT_MESSAGE(expected + "\n" + actual, actual == expected);
+      CPPUNIT_ASSERT(db->getObject("foo1").isValid());
+      CPPUNIT_ASSERT(db->getTokens().size() == 3);
+      DEFAULT_TEARDOWN();
+    }
+    std::remove(fileName.c_str());
+    return true;
+  }
+
+  /**
+   * Nothing is propagated inside a bulk load scope until the outermost scope closes.
+   */
+  static bool testBulkLoad(){
+    DEFAULT_SETUP(ce, db, true);
+
+    DbClientId client = db->getClient();
+    client->createVariable(IntDT::NAME().c_str(), "v1");
+    client->createVariable(IntDT::NAME().c_str(), "v2");
+    ConstrainedVariableId v1 = client->getGlobalVariable("v1");
+    ConstrainedVariableId v2 = client->getGlobalVariable("v2");
+
+    client->beginBulkLoad();
+    client->beginBulkLoad();
+    CPPUNIT_ASSERT(client->isBulkLoading());
+    CPPUNIT_ASSERT(!ce->getAutoPropagation());
+    client->createConstraint("eq", makeScope(v1, v2));
+    client->specify(v1, 10);
+    CPPUNIT_ASSERT(ce->pending());
+    CPPUNIT_ASSERT(!v2->lastDomain().isSingleton());
+
+    CPPUNIT_ASSERT(client->endBulkLoad());
+    CPPUNIT_ASSERT(client->isBulkLoading());
+    CPPUNIT_ASSERT(ce->pending());
+
+    CPPUNIT_ASSERT(client->endBulkLoad());
+    CPPUNIT_ASSERT(!client->isBulkLoading());
+    CPPUNIT_ASSERT(ce->getAutoPropagation());
+    CPPUNIT_ASSERT(!ce->pending());
+    CPPUNIT_ASSERT(v2->lastDomain().isSingleton() && v2->lastDomain().getSingletonValue() == 10);
+
+    // An inconsistency found by the final propagation is reported
+    client->createVariable(IntDT::NAME().c_str(), "v3");
+    ConstrainedVariableId v3 = client->getGlobalVariable("v3");
+    client->beginBulkLoad();
+    client->createConstraint("neq", makeScope(v2, v3));
+    client->specify(v3, 10);
+    CPPUNIT_ASSERT(!client->endBulkLoad());
+
+    // An abandoned scope restores automatic propagation without propagating
+    client->reset(v3);
+    CPPUNIT_ASSERT(client->propagate());
+    client->beginBulkLoad();
+    client->specify(v3, 10);
+    client->abandonBulkLoad();
+    CPPUNIT_ASSERT(!client->isBulkLoading());
+    CPPUNIT_ASSERT(ce->getAutoPropagation());
+    CPPUNIT_ASSERT(ce->pending());
+
+    DEFAULT_TEARDOWN();
+    return true;
+  }
 };
 
 /**
@@ -10,6 +10,7 @@
 #include "IncrementalFlowProfile.hh"
 #include "TimetableProfile.hh"
 #include "GroundedProfile.hh"
+#include "EnergeticTimetableProfile.hh"
 #include "OpenWorldFVDetector.hh"
 #include "ClosedWorldFVDetector.hh"
 #include "GroundedFVDetector.hh"
@@ -21,6 +22,7 @@
 #include "CESchema.hh"
 
 #include <boost/cast.hpp>
+#include <cstdlib>
 
 namespace EUROPA {
 
@@ -45,7 +47,11 @@ namespace EUROPA {
 void ModuleResource::initialize(EngineId engine) {
   ConstraintEngine* ce = boost::polymorphic_cast<ConstraintEngine*>(engine->getComponent("ConstraintEngine"));
   Schema* schema = boost::polymorphic_cast<Schema*>(engine->getComponent("Schema"));
-  new ProfilePropagator("Resource", ce->getId());
+  ProfilePropagator* propagator = new ProfilePropagator("Resource", ce->getId());
+  // "resource.recomputeThreads" allows for recomputing independent profiles concurrently
+  int recomputeThreads = std::atoi(engine->getConfig()->getProperty("resource.recomputeThreads").c_str());
+  if(recomputeThreads > 1)
+    propagator->setRecomputeThreadCount(static_cast<unsigned int>(recomputeThreads));
 
   ObjectTypeId objectOT = schema->getObjectType(Schema::rootObject());
   ObjectType* ot;
@@ -111,6 +117,7 @@ void ModuleResource::initialize(EngineId engine) {
   // REGISTER_PROFILE(pfm,FlowProfile, FlowProfile);
   // REGISTER_PROFILE(pfm,IncrementalFlowProfile, IncrementalFlowProfile );
   REGISTER_PROFILE(pfm,GroundedProfile, GroundedProfile );
+  REGISTER_PROFILE(pfm,EnergeticTimetableProfile, EnergeticTimetableProfile );
 
   // Solver
   FactoryMgr* fvdfm = new FactoryMgr();
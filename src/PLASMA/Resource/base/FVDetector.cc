@@ -6,4 +6,37 @@ namespace EUROPA {
     {
     	return m_res->getPlanDatabase()->getConstraintEngine()->getAllowViolations();
     }
+
+    bool FVDetector::flushNotifications()
+    {
+    	bool complete = true;
+    	m_buffering = false;
+    	for(std::vector<Notification>::const_iterator it = m_notifications.begin(); it != m_notifications.end(); ++it) {
+    		switch(it->type) {
+    		case RESET:
+    			if(it->inst.isId())
+    				m_res->resetViolations(it->inst);
+    			else
+    				m_res->resetViolations();
+    			break;
+    		case VIOLATED:
+    			if(!m_res->getPlanDatabase()->getConstraintEngine()->provenInconsistent())
+    				m_res->notifyViolated(it->inst, it->problem);
+    			else
+    				complete = false;
+    			break;
+    		case NO_LONGER_VIOLATED:
+    			m_res->notifyNoLongerViolated(it->inst);
+    			break;
+    		case FLAWED:
+    			m_res->notifyFlawed(it->inst);
+    			break;
+    		case NO_LONGER_FLAWED:
+    			m_res->notifyNoLongerFlawed(it->inst);
+    			break;
+    		}
+    	}
+    	m_notifications.clear();
+    	return complete;
+    }
 }
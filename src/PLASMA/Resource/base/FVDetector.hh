@@ -13,6 +13,8 @@
 #include "Resource.hh"
 #include "Factory.hh"
 
+#include <vector>
+
 namespace EUROPA {
 
     class FVDetectorFactoryMgr;
@@ -32,7 +34,7 @@ namespace EUROPA {
        * @brief Constructor
        * @param res The Resource to be notified when a flaw or violation is detected.
        */
-      FVDetector(const ResourceId res) : m_id(this), m_res(res) {}
+      FVDetector(const ResourceId res) : m_id(this), m_res(res), m_buffering(false), m_notifications() {}
 
       virtual ~FVDetector() {m_id.remove();}
 
@@ -40,12 +42,12 @@ namespace EUROPA {
        * @brief Initialize a detection run with the given instant data
        * @param inst The source of the level data.
        */
-      virtual void initialize(const InstantId inst) {if(m_res.isValid()) m_res->resetViolations(inst);}
+      virtual void initialize(const InstantId inst) {if(m_res.isValid() && !buffer(RESET, inst)) m_res->resetViolations(inst);}
 
       /**
        * @brief Initialize a detection run with no data.  Used when the first Instant in the recalculation interval is the first Instant.
        */
-      virtual void initialize() {if(m_res.isValid()) m_res->resetViolations();}
+      virtual void initialize() {if(m_res.isValid() && !buffer(RESET, InstantId::noId())) m_res->resetViolations();}
 
       /**
        * @brief Detect flaws and violations at an instant.
@@ -72,22 +74,55 @@ namespace EUROPA {
       /**
        * @brief Inform the Resource that there is a violation at an Instant.
        */
-      void notifyOfViolation(const InstantId inst, Resource::ProblemType problem) {if(m_res.isValid()) m_res->notifyViolated(inst,problem);}
+      void notifyOfViolation(const InstantId inst, Resource::ProblemType problem) {if(m_res.isValid() && !buffer(VIOLATED, inst, problem)) m_res->notifyViolated(inst,problem);}
 
-      void notifyNoLongerViolated(const InstantId inst) {if(m_res.isValid()) m_res->notifyNoLongerViolated(inst);}
+      void notifyNoLongerViolated(const InstantId inst) {if(m_res.isValid() && !buffer(NO_LONGER_VIOLATED, inst)) m_res->notifyNoLongerViolated(inst);}
 
       /**
        * @brief Inform the Resource that there is a flaw at an Instant.
        */
-      void notifyOfFlaw(const InstantId inst) {if(m_res.isValid()) m_res->notifyFlawed(inst);}
+      void notifyOfFlaw(const InstantId inst) {if(m_res.isValid() && !buffer(FLAWED, inst)) m_res->notifyFlawed(inst);}
 
-      void notifyNoLongerFlawed(const InstantId inst) {if(m_res.isValid()) m_res->notifyNoLongerFlawed(inst);}
+      void notifyNoLongerFlawed(const InstantId inst) {if(m_res.isValid() && !buffer(NO_LONGER_FLAWED, inst)) m_res->notifyNoLongerFlawed(inst);}
 
       bool allowViolations() const;
 
+      /**
+       * @brief Hold back the notifications to the Resource made by initialize and detect until flushNotifications,
+       * so the profile can be recomputed on another thread.
+       */
+      void bufferNotifications() {m_buffering = true;}
+
+      /**
+       * @brief Make the held back notifications, in the order they were held back.  Violations are dropped once the
+       * ConstraintEngine is proven inconsistent, rather than emptying further quantities.
+       * @return false if a violation was dropped.
+       */
+      bool flushNotifications();
+
     protected:
       FVDetectorId m_id;
       ResourceId m_res;
+
+    private:
+      enum NotificationType {RESET, VIOLATED, NO_LONGER_VIOLATED, FLAWED, NO_LONGER_FLAWED};
+
+      struct Notification {
+        NotificationType type;
+        InstantId inst;
+        Resource::ProblemType problem;
+      };
+
+      bool buffer(NotificationType type, const InstantId inst, Resource::ProblemType problem = Resource::NoProblem) {
+        if(!m_buffering)
+          return false;
+        Notification notification = {type, inst, problem};
+        m_notifications.push_back(notification);
+        return true;
+      }
+
+      bool m_buffering;
+      std::vector<Notification> m_notifications;
     };
 
     class FVDetectorArgs : public FactoryArgs
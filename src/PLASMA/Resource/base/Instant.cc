@@ -11,7 +11,7 @@ Instant::Instant(const eint time, const ProfileId prof)
       m_maxPrevProduction(0), m_maxPrevConsumption(0), m_minPrevProduction(0), m_minPrevConsumption(0),
   m_upperFlawMagnitude(0), m_lowerFlawMagnitude(0),
   m_violated(false), m_flawed(false), m_upperFlaw(false), m_lowerFlaw(false),
-  m_transactions(), m_endingTransactions(), m_startingTransactions() {}
+  m_endingTransactions(), m_startingTransactions() {}
 
     Instant::~Instant() {
       m_id.remove();
@@ -19,44 +19,24 @@ Instant::Instant(const eint time, const ProfileId prof)
 
     eint Instant::getTime() const {return m_time;}
 
-    const std::set<TransactionId>& Instant::getTransactions() const {return m_transactions;}
+    const std::set<TransactionId>& Instant::getTransactions() const {return m_profile->getOverlappingTransactions(m_id);}
+    const std::set<TransactionId>& Instant::getOverlappingTransactions() const {return m_profile->getOverlappingTransactions(m_id);}
     const std::set<TransactionId>& Instant::getEndingTransactions() const {return m_endingTransactions;}
     const std::set<TransactionId>& Instant::getStartingTransactions() const {return m_startingTransactions;}
 
-    void Instant::addTransaction(const TransactionId t) {
-      checkError(m_transactions.find(t) == m_transactions.end(), "Instant for time " << m_time << " already has transaction " << t);
-      checkError(t->time()->lastDomain().isMember(m_time), "Attempted to add a transaction spanning time " <<
-                 t->time()->toString() << " to instant for " << m_time);
-
-      debugMsg("Instant:addTransaction", "Adding transaction to instant (" << getId() << ") for time " << t->time()->toString() << " with quantity " << t->quantity()->toString());
-      m_transactions.insert(t);
-
-      if(t->time()->lastDomain().getLowerBound() == m_time )
-        m_startingTransactions.insert(t);
-
-      if(t->time()->lastDomain().getUpperBound() == m_time)
-        m_endingTransactions.insert(t);
+    void Instant::addStartingTransaction(const TransactionId t) {
+      checkError(m_startingTransactions.find(t) == m_startingTransactions.end(), "Instant for time " << m_time << " already starts transaction " << t);
+      debugMsg("Instant:addTransaction", "Adding transaction starting at instant (" << getId() << ") for time " << t->time()->toString() << " with quantity " << t->quantity()->toString());
+      m_startingTransactions.insert(t);
     }
 
-    void Instant::updateTransaction(const TransactionId t) {
-      checkError(t->time()->lastDomain().isMember(m_time), "Attempted to update a transaction spanning time " <<
-                 t->time()->toString() << " to instant for " << m_time);
-
-      debugMsg("Instant:updateTransaction", "Updating transaction to instant (" << getId() << ") for time " << t->time()->toString() << " with quantity " << t->quantity()->toString());
-
-      if(t->time()->lastDomain().getLowerBound() == m_time )
-        m_startingTransactions.insert(t);
-      else
-        m_startingTransactions.erase(t);
-
-      if(t->time()->lastDomain().getUpperBound() == m_time)
-          m_endingTransactions.insert(t);
-      else
-          m_endingTransactions.erase(t);
+    void Instant::addEndingTransaction(const TransactionId t) {
+      checkError(m_endingTransactions.find(t) == m_endingTransactions.end(), "Instant for time " << m_time << " already ends transaction " << t);
+      debugMsg("Instant:addTransaction", "Adding transaction ending at instant (" << getId() << ") for time " << t->time()->toString() << " with quantity " << t->quantity()->toString());
+      m_endingTransactions.insert(t);
     }
 
     void Instant::removeTransaction(const TransactionId t) {
-      m_transactions.erase(t);
       m_endingTransactions.erase(t);
       m_startingTransactions.erase(t);
     }
@@ -100,16 +80,8 @@ Instant::Instant(const eint time, const ProfileId prof)
       m_maxPrevProduction = maxPrevProduction;
     }
 
-    bool Instant::containsStartOrEnd() {
-      bool retval = false;
-      for(std::set<TransactionId>::const_iterator it = m_transactions.begin(); it != m_transactions.end(); ++it) {
-        TransactionId trans = *it;
-        if(trans->time()->lastDomain().getLowerBound() == m_time || trans->time()->lastDomain().getUpperBound() == m_time) {
-          retval = true;
-          break;
-        }
-      }
-      return retval;
+    bool Instant::containsStartOrEnd() const {
+      return !m_startingTransactions.empty() || !m_endingTransactions.empty();
     }
 
     void Instant::applyBoundsDelta(const edouble& lbDelta, const edouble& ubDelta)
@@ -120,7 +92,8 @@ Instant::Instant(const eint time, const ProfileId prof)
 
     std::string Instant::toString() const {
       std::stringstream sstr;
-      for(std::set<TransactionId>::const_iterator it = m_transactions.begin(); it != m_transactions.end(); ++it)
+      const std::set<TransactionId>& transactions = getTransactions();
+      for(std::set<TransactionId>::const_iterator it = transactions.begin(); it != transactions.end(); ++it)
         sstr << " " << m_time << ": " << (*it) << " " << (*it)->time()->toString() << " " << (*it)->quantity()->toString() <<
           ((*it)->isConsumer() ? " (C)" : " (P)") << std::endl;
       return sstr.str();
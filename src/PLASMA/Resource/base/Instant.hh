@@ -21,8 +21,9 @@ namespace EUROPA {
      * @brief A class representing an instantaneous change in resource level.
      *
      * The Instant class represents a moment in time at which the level of a resource may change,
-     * which are the only times of interest for profile calculation.  Each Instant maintains
-     * a set of Transactions that overlap the time in some way.
+     * which are the only times of interest for profile calculation.  Each Instant records only the
+     * Transactions whose time starts or ends at it.  The Transactions that overlap the time are
+     * derived by the Profile on demand, so memory stays linear in the number of Transactions.
      */
     class Instant : public Entity {
     public:
@@ -40,7 +41,8 @@ namespace EUROPA {
 
       /**
        * @brief Get the complete set of transactions that overlap this Instant.
-       * @return A const ref to the set of transactions.
+       * @return A const ref to the set of transactions, computed by the profile.  It remains valid until
+       * the transactions of another Instant on the same profile are requested, or the profile changes.
        */
       const std::set<TransactionId>& getTransactions() const;
 
@@ -57,7 +59,7 @@ namespace EUROPA {
       const std::set<TransactionId>& getStartingTransactions() const;
 
       /**
-       * @brief Get the set of transactions whose time overlaps this instant.
+       * @brief Get the set of transactions whose time overlaps this instant.  The same as getTransactions().
        * @return A const ref to the set of transactions.
        */
       const std::set<TransactionId>& getOverlappingTransactions() const;
@@ -218,27 +220,28 @@ namespace EUROPA {
       Instant(const eint time, const ProfileId prof);
 
       /**
-       * @brief Adds a transaction to the set overlapping this time.
+       * @brief Records a transaction whose time starts at this Instant.
        * @param t The transaction.
        */
-      void addTransaction(const TransactionId t);
+      void addStartingTransaction(const TransactionId t);
+
       /**
-       * @brief Updates a transaction already in the set overlapping this time.
+       * @brief Records a transaction whose time ends at this Instant.
        * @param t The transaction.
        */
-      void updateTransaction(const TransactionId t);
+      void addEndingTransaction(const TransactionId t);
 
       /**
-       * @brief Removes a transaction from the set overlapping this time.
+       * @brief Removes a transaction from the transactions starting and ending at this Instant.
        * @param t The transaction.
        */
       void removeTransaction(const TransactionId t);
 
       /**
-       * @brief Determines if this Instant is at the start or end of a transaction.  Used to decide if an Instant that has transactions should be deleted.
-       * @return True if the time of the Instant is equal to one of the bounds of one of the times of the transactions overlapping this instant.
+       * @brief Determines if this Instant is at the start or end of a transaction.  Used to decide if an Instant should be deleted.
+       * @return True if some transaction starts or ends at this Instant.
        */
-      bool containsStartOrEnd();
+      bool containsStartOrEnd() const;
 
       /*
        * @ brief applies delta to upper and lower bounds
@@ -254,7 +257,6 @@ namespace EUROPA {
       edouble m_maxPrevProduction, m_maxPrevConsumption, m_minPrevProduction, m_minPrevConsumption; /**< The bounds on consumption and production necessarily before this instant*/
       edouble m_upperFlawMagnitude, m_lowerFlawMagnitude; /**< The magnitude of the differences between the levels and the limits */
       bool m_violated, m_flawed, m_upperFlaw, m_lowerFlaw; /**< Flaw and violation flags */
-      std::set<TransactionId> m_transactions; /**< The complete set of transactions */
       std::set<TransactionId> m_endingTransactions; /**< The set of transactions whose upper bound is equal to the current time. */
       std::set<TransactionId> m_startingTransactions; /**< The set of transactions whose lower bound is equal to the current time. */
     };
@@ -22,6 +22,13 @@ namespace EUROPA {
 		virtual PSResourceProfile* getFDLevels() = 0;
 		virtual PSResourceProfile* getVDLevels() = 0;
 
+		// Aggregate queries over the usage profile, answered without building a PSResourceProfile
+		virtual double getMinUsage(TimePoint start, TimePoint end) = 0;
+		virtual double getMaxUsage(TimePoint start, TimePoint end) = 0;
+		// The first time not before from at which the usage can (or, if necessarily, must) be below level.
+		// PLUS_INFINITY if there is none.
+		virtual TimePoint getFirstTimeUsageBelow(double level, TimePoint from, bool necessarily) = 0;
+
 		virtual PSList<PSEntityKey> getOrderingChoices(TimePoint t) = 0;
 
 		static PSResource* asPSResource(PSObject* obj);
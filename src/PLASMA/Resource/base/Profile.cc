@@ -12,6 +12,7 @@
 
 #include <algorithm>
 #include <functional>
+#include <limits>
 
 namespace EUROPA {
 
@@ -30,7 +31,19 @@ Profile::Profile(const PlanDatabaseId db, const FVDetectorId flawDetector)
     , m_temporalConstraints()
     , m_removalListener()
     , m_instants()
+    , m_transactionBounds()
+    , m_overlappingTransactions()
+    , m_overlapInstant()
+    , m_levels()
+    , m_levelInstants()
+    , m_levelsStale(false)
+    , m_levelTree()
+    , m_levelTreeSize(0)
+    , m_levelTreeDirtyLb(std::numeric_limits<unsigned long>::max())
+    , m_levelTreeDirtyUb(0)
     , m_recomputeInterval()
+    , m_dirtyWindows()
+    , m_instantsRecomputed(0)
     {
     	m_removalListener = (new ConstraintRemovalListener(db->getConstraintEngine(), m_id))->getId();
     }
@@ -67,20 +80,9 @@ InstantId Profile::getInstant(const eint time) const {
       debugMsg("Profile:addTransaction", "Adding " << (t->isConsumer() ? "consumer " : "producer ") << "transaction " << t << " for time " <<
                t->time()->toString() << " with quantity " << t->quantity()->toString());
 
-      eint startTime = static_cast<eint>(t->time()->lastDomain().getLowerBound());
-      eint endTime = static_cast<eint>(t->time()->lastDomain().getUpperBound());
-
-      //if instants for the start and end time don't already exist, add them
+      //record the transaction at the instants for its start and end time, adding them if they don't already exist
       addInstantsForBounds(t);
-
-      //add the transaction to the set of instants
-      ProfileIterator profIt(m_id, startTime, endTime);
-      while(!profIt.done()) {
-        debugMsg("Profile:addTransaction", "Adding transaction " << t << " to instant for time " << profIt.getInstant()->getTime());
-        profIt.getInstant()->addTransaction(t);
-        profIt.next();
-      }
-
+      markDirty(m_transactionBounds[t].first, m_transactionBounds[t].second);
 
       //add listener
       m_variableListeners.insert(std::make_pair(t,
@@ -118,30 +120,9 @@ void Profile::removeTransaction(const TransactionId t) {
   debugMsg("Profile:removeTransaction",
            "Removing transaction " << t << " for time " << t->time()->toString() <<
            " with quantity " << t->quantity()->toString());
-  eint startTime =
-      static_cast<eint>((t->time()->lastDomain().isEmpty() ?
-                         t->time()->baseDomain() : t->time()->lastDomain()).getLowerBound());
-  eint endTime =
-      static_cast<eint>((t->time()->lastDomain().isEmpty() ?
-                         t->time()->baseDomain() : t->time()->lastDomain()).getUpperBound());
-  checkError(startTime <= endTime, startTime << " > " << endTime);
-  ProfileIterator profIt(m_id, startTime, endTime);
-  std::vector<eint> emptyInstants;
   //remove the transaction from its instants
-  while(!profIt.done()) {
-    debugMsg("Profile:removeTransaction",
-             "Removing transaction " << t << " from instant for time " <<
-             profIt.getInstant()->getTime());
-    profIt.getInstant()->removeTransaction(t);
-    //if the instant contains no transactions or doesn't represent the start or end of a transaction, it is empty and should be deleted.
-    if(profIt.getInstant()->getTransactions().empty() ||
-       !containsChange(profIt.getInstant())) {
-      debugMsg("Profile:removeTransaction",
-               "Instant for time " << profIt.getInstant()->getTime() << " is empty.");
-      emptyInstants.push_back(profIt.getInstant()->getTime());
-    }
-    profIt.next();
-  }
+  std::pair<eint, eint> bounds = removeInstantsForBounds(t);
+  markDirty(bounds.first, bounds.second);
 
   //remove any constraints on the transaction from the profile.
   std::vector<std::pair<ConstraintId, unsigned long> > removals;
@@ -172,21 +153,13 @@ void Profile::removeTransaction(const TransactionId t) {
   m_variableListeners.erase(t);
   handleTransactionVariableDeletion(t);
 
-  for(std::vector<eint>::const_iterator it = emptyInstants.begin(); it != emptyInstants.end(); ++it) {
-    std::map<eint, InstantId>::iterator instIt = m_instants.find(*it);
-    //this can't be an error because the discard above constitues a relaxation of the variable, which will get handled in-situ
-    //and may remove instants in the emptyInstants vector.
-    //checkError(instIt != m_instants.end(), "Computed empty instant at " << *it << " but there is no such instant in the profile.");
-    if(instIt == m_instants.end())
-      continue;
-    InstantId inst = instIt->second;
-    debugMsg("Profile:removeTransaction", "Removing instant at time " << inst->getTime());
-    condDebugMsg(inst->getTransactions().empty(), "Profile:removeTransaction", "because it has no transactions.");
-    condDebugMsg(!containsChange(inst), "Profile:removeTransaction", "because it does not mark a change.");
-    m_instants.erase(*it);
-    m_detector->notifyDeleted(inst);
-    delete static_cast<Instant*>(inst);
-  }
+  //if the instants for the bounds don't represent the start or end of another transaction, they should be deleted.
+  //this can't require them to exist because the discard above constitues a relaxation of the variable, which will get handled in-situ
+  //and may remove them.
+  if(m_instants.find(bounds.first) != m_instants.end())
+    removeInstant(bounds.first);
+  if(bounds.second != bounds.first && m_instants.find(bounds.second) != m_instants.end())
+    removeInstant(bounds.second);
   m_changeCount++;
   m_needsRecompute = true;
   handleTransactionRemoved(t);
@@ -206,96 +179,25 @@ void Profile::transactionTimeChanged(const TransactionId e,
   checkError(e.isValid(), "Invalid transaction.");
   checkError(m_transactions.find(e) != m_transactions.end(), "Unknown transaction " << e->time()->toString() << " " << e->quantity()->toString());
 
-  eint startTime = static_cast<eint>(e->time()->lastDomain().getLowerBound());
-  eint endTime = static_cast<eint>(e->time()->lastDomain().getUpperBound());
   switch(change) {
     case DomainListener::UPPER_BOUND_DECREASED:
     case DomainListener::LOWER_BOUND_INCREASED:
     case DomainListener::BOUNDS_RESTRICTED:
     case DomainListener::RESTRICT_TO_SINGLETON:
-    case DomainListener::SET_TO_SINGLETON: {
-      debugMsg("Profile:handleTimeChanged", "Handling restriction of transaction " << e << " at time " << e->time()->toString() << " with quantity " << e->quantity()->toString());
-      eint first, last;
-      std::map<eint, InstantId>::iterator it;
-      for(it = m_instants.begin(); it != m_instants.end(); ++it)
-        if(it->second->getTransactions().find(e) != it->second->getTransactions().end())
-          break;
-      checkError(it != m_instants.end(), "No instant containing this transaction.");
-      first = it->second->getTime();
-      it = m_instants.upper_bound(first);
-      if(it != m_instants.end())
-        for(; it != m_instants.end(); ++it)
-          if(it->second->getTransactions().find(e) == it->second->getTransactions().end())
-            break;
-      --it;
-      last = it->second->getTime();
-      debugMsg("Profile:handleTimeChanged", "Possibly removing transaction " << e << " from Instants in range [" << first << " " << last << "]");
-      ProfileIterator profIt(m_id, first, last);
-      std::vector<eint> emptyInstants;
-      while(!profIt.done()) {
-        InstantId inst = profIt.getInstant();
-        if(!e->time()->lastDomain().isMember(inst->getTime())) {
-          debugMsg("Profile:handleTimeChanged", "Removing transaction " << e << " from Instant at time " << inst->getTime());
-          inst->removeTransaction(e);
-          if(inst->getTransactions().empty() || !containsChange(inst))
-            emptyInstants.push_back(inst->getTime());
-        }
-        else
-          inst->updateTransaction(e);
-        profIt.next();
-      }
-
-      //add instants for start and end and add overlapping transactions to them
-      addInstantsForBounds(e);
-
-      for(std::vector<eint>::iterator emptyIt = emptyInstants.begin();
-          emptyIt != emptyInstants.end(); ++emptyIt) {
-        std::map<eint, InstantId>::iterator instIt = m_instants.find(*emptyIt);
-        checkError(instIt != m_instants.end(),
-                   "Computed empty instant at time " << *emptyIt << " but no such instant exists.");
-        InstantId inst = instIt->second;
-        debugMsg("Profile:handleTimeChanged", "Removing instant at time " << inst->getTime());
-        condDebugMsg(inst->getTransactions().empty(),
-                     "Profile:handleTimeChanged", "because it has no transactions.");
-        condDebugMsg(!containsChange(inst),
-                     "Profile:handleTimeChanged", "because it does not mark a change.");
-        m_instants.erase(*emptyIt);
-        m_detector->notifyDeleted(inst);
-        delete static_cast<Instant*>(inst);
-      }
-    }
-      break;
+    case DomainListener::SET_TO_SINGLETON:
     case DomainListener::RESET:
     case DomainListener::RELAXED: {
-      debugMsg("Profile:handleTimeChanged",
-               "Handling relaxation of transaction " << e << " at time " <<
-               e->time()->toString() << " with quantity " << e->quantity()->toString());
-      ProfileIterator it(m_id, startTime, endTime);
+      debugMsg("Profile:handleTimeChanged", "Handling " << (change == DomainListener::RESET || change == DomainListener::RELAXED ? "relaxation" : "restriction") <<
+               " of transaction " << e << " at time " << e->time()->toString() << " with quantity " << e->quantity()->toString());
+      //move the transaction to the instants for its new bounds, then remove the instants for its old bounds
+      //if they no longer mark a change.  the transactions overlapping the instants in between are derived from these.
+      std::pair<eint, eint> bounds = removeInstantsForBounds(e);
       addInstantsForBounds(e);
-      std::vector<eint> emptyInstants;
-      while(!it.done()) {
-        InstantId inst = it.getInstant();
-        if(!containsChange(inst))
-          emptyInstants.push_back(inst->getTime());
-        else if(inst->getTransactions().find(e) == inst->getTransactions().end())
-          inst->addTransaction(e);
-        else
-          inst->updateTransaction(e);
-        it.next();
-      }
-      for(std::vector<eint>::iterator emptyIt = emptyInstants.begin();
-          emptyIt != emptyInstants.end(); ++emptyIt) {
-        std::map<eint, InstantId>::iterator instIt = m_instants.find(*emptyIt);
-        checkError(instIt != m_instants.end(),
-                   "Computed empty instant at time " << *emptyIt << " but no such instant exists.");
-        InstantId inst = instIt->second;
-        debugMsg("Profile:handleTimeChanged", "Removing instant at time " << inst->getTime());
-        condDebugMsg(inst->getTransactions().empty(), "Profile:handleTimeChanged", "because it has no transactions.");
-        condDebugMsg(!containsChange(inst), "Profile:handleTimeChanged", "because it does not mark a change.");
-        m_instants.erase(*emptyIt);
-        m_detector->notifyDeleted(inst);
-        delete static_cast<Instant*>(inst);
-      }
+      markDirty(bounds.first, bounds.second);
+      markDirty(m_transactionBounds[e].first, m_transactionBounds[e].second);
+      removeInstant(bounds.first);
+      if(bounds.second != bounds.first)
+        removeInstant(bounds.second);
     }
       break;
     case DomainListener::REFTIME_CHANGED:
@@ -322,6 +224,9 @@ void Profile::transactionTimeChanged(const TransactionId e,
     }
 
     void Profile::transactionQuantityChanged(const TransactionId e, const DomainListener::ChangeType& change) {
+      std::map<TransactionId, std::pair<eint, eint> >::const_iterator bounds = m_transactionBounds.find(e);
+      if(bounds != m_transactionBounds.end())
+        markDirty(bounds->second.first, bounds->second.second);
       m_changeCount++;
       m_needsRecompute = true;
       handleTransactionQuantityChanged(e, change);
@@ -436,6 +341,12 @@ void Profile::handleConstraintMessage(const ConstraintId c,
         setUpdateRequired(true);
 }
 
+void Profile::scheduleExecution(const ConstraintId constraint) {
+  id_cast<ProfilePropagator>(m_planDatabase->getConstraintEngine()->
+                             getPropagatorByName(ProfilePropagator::PROPAGATOR_NAME()))->
+      schedule(constraint);
+}
+
 void Profile::temporalConstraintAdded(const ConstraintId c,
                                       const ConstrainedVariableId var,
                                       unsigned int argIndex) {
@@ -479,19 +390,82 @@ void Profile::handleTransactionVariableDeletion(const TransactionId t){
     void Profile::getLevel(const eint time, IntervalDomain& dest) {
     	if(needsRecompute())
     		handleRecompute();
-    	std::map<eint, InstantId>::iterator it = getGreatestInstant(time);
+    	updateLevels();
+    	unsigned long index = getLevelIndex(time);
     	IntervalDomain result;
 
-    	if(it == m_instants.end()) {
+    	if(index == 0) {
     		result.intersect(getInitCapacityLb(),getInitCapacityUb());
     	}
     	else {
-    		InstantId inst = getGreatestInstant(time)->second;
-    		result.intersect(inst->getLowerLevel(), inst->getUpperLevel());
+    		const LevelRecord& record = m_levels[index - 1];
+    		result.intersect(record.lowerLevel, record.upperLevel);
     	}
     	dest = result;
     }
 
+    const std::vector<Profile::LevelRecord>& Profile::getLevels() {
+      if(needsRecompute())
+        handleRecompute();
+      updateLevels();
+      return m_levels;
+    }
+
+void Profile::getLevelRange(const eint lb, const eint ub, IntervalDomain& dest) {
+  checkError(lb <= ub, "Attempted to get the levels over an empty interval [" << lb << " " << ub << "]");
+  if(needsRecompute())
+    handleRecompute();
+  updateLevels();
+  updateLevelTree();
+
+  // The record in effect at lb is the last one at or before it, or the initial capacity if there is none
+  unsigned long first = getLevelIndex(lb);
+  LevelSummary summary = summarizeLevels(first == 0 ? 0 : first - 1, getLevelIndex(ub));
+  if(first == 0) {
+    summary.minLower = std::min(summary.minLower, getInitCapacityLb());
+    summary.maxUpper = std::max(summary.maxUpper, getInitCapacityUb());
+  }
+
+  IntervalDomain result;
+  result.intersect(summary.minLower, summary.maxUpper);
+  dest = result;
+}
+
+eint Profile::getFirstTimeBelow(const edouble level, const eint from, const bool necessarily) {
+  if(needsRecompute())
+    handleRecompute();
+  updateLevels();
+  updateLevelTree();
+
+  unsigned long index = getLevelIndex(from);
+  if(index == 0) {
+    if((necessarily ? getInitCapacityUb() : getInitCapacityLb()) < level)
+      return from;
+    if(m_levels.empty())
+      return PLUS_INFINITY;
+  }
+  else
+    --index;
+
+  // Climb from the leaf until a subtree to the right holds a record below the level, then descend into it
+  const unsigned long leaves = m_levelTree.size() / 2;
+  unsigned long node = leaves + index;
+  while((necessarily ? m_levelTree[node].minUpper : m_levelTree[node].minLower) >= level) {
+    while((node & 1) != 0) {
+      node >>= 1;
+      if(node == 0)
+        return PLUS_INFINITY;
+    }
+    ++node;
+  }
+  while(node < leaves) {
+    node *= 2;
+    if((necessarily ? m_levelTree[node].minUpper : m_levelTree[node].minLower) >= level)
+      ++node;
+  }
+  return std::max(from, m_levels[node - leaves].time);
+}
+
     //i should really re-name these.
     std::map<eint, InstantId>::iterator Profile::getGreatestInstant(const eint time) {
     	debugMsg("Profile:getGreatestInstant", "Greatest Instant not greater than " << time);
@@ -536,6 +510,16 @@ void Profile::handleTransactionVariableDeletion(const TransactionId t){
         handleRecompute();
     }
 
+void Profile::flushNotifications() {
+  if(m_detector->flushNotifications())
+    return;
+  if(m_recomputeInterval.isValid())
+    delete static_cast<ProfileIterator*>(m_recomputeInterval);
+  m_recomputeInterval = (new ProfileIterator(getId()))->getId();
+  markDirty(MINUS_INFINITY, PLUS_INFINITY);
+  m_needsRecompute = true;
+}
+
 void Profile::handleRecompute() {
   checkError(m_recomputeInterval.isValid(),
              "Attempted to recompute levels over an invalid interval.");
@@ -546,18 +530,25 @@ void Profile::handleRecompute() {
   eint endTime = MINUS_INFINITY;
   std::pair<edouble,edouble> endDiff(0.0,0.0);
 
-  if(!m_recomputeInterval->done()) {
+  if(canResumeRecompute() && !m_planDatabase->getConstraintEngine()->getAllowViolations())
+    recomputeDirtyWindows();
+  else if(!m_recomputeInterval->done()) {
     InstantId prev = InstantId::noId();
     bool violation = false;
     endTime = m_recomputeInterval->getEndTime();
 
+    // The interval only locates the first Instant; the sweep itself runs over the level records
+    updateLevels();
+    unsigned long index = getLevelIndex(m_recomputeInterval->getInstant()->getTime()) - 1;
+    check_error(m_levelInstants[index] == m_recomputeInterval->getInstant());
+
     //if there is no preceding instant, do a clean init
-    if(m_recomputeInterval->getInstant()->getTime() == m_instants.begin()->first) {
+    if(index == 0) {
       initRecompute();
       m_detector->initialize();
     }
     else {
-      InstantId inst = m_recomputeInterval->getInstant();
+      InstantId inst = m_levelInstants[index];
 
       if (inst->getTime() == endTime) {
         endDiff.first = inst->getLowerLevel();
@@ -572,42 +563,38 @@ void Profile::handleRecompute() {
         endDiff.second = inst->getUpperLevel() - endDiff.second;
       }
 
-      std::map<eint, InstantId>::iterator it = getGreatestInstant(inst->getTime() - 1);
-      if(it != m_instants.end()) {
-        prev = it->second;
-      }
-
-      // initRecompute(inst) above also recomputes the levels for the inst, so move forward:
-      // violation = m_detector->detect(inst);
-
-
-      // prev = inst;
-      // m_recomputeInterval->next();
+      prev = m_levelInstants[index - 1];
     }
 
-    while(!m_recomputeInterval->done()
-          &&
-          !violation ) {
-      InstantId inst = m_recomputeInterval->getInstant();
+    prepareLevels(index, getLevelIndex(endTime));
+    m_dirtyWindows.clear();
 
-      if (inst->getTime() == endTime) {
+    for(; index < m_levels.size() && m_levels[index].time <= endTime && !violation; ++index) {
+      InstantId inst = m_levelInstants[index];
+
+      if (m_levels[index].time == endTime) {
         endDiff.first = inst->getLowerLevel();
         endDiff.second = inst->getUpperLevel();
       }
 
-      debugMsg("Profile:recompute", "Recomputing levels at instant " << inst->getTime());
+      debugMsg("Profile:recompute", "Recomputing levels at instant " << m_levels[index].time);
       check_error(inst.isValid());
       recomputeLevels( prev, inst);
 
-      if (inst->getTime() == endTime) {
+      if (m_levels[index].time == endTime) {
         endDiff.first = inst->getLowerLevel() - endDiff.first;
         endDiff.second = inst->getUpperLevel() - endDiff.second;
       }
 
       violation = m_detector->detect(inst);
+      recordLevels(index);
+      ++m_instantsRecomputed;
+
+      // the Instants after a violation are left as they were, so they have to be recomputed next time
+      if(violation)
+        markDirty(m_levels[index].time, PLUS_INFINITY);
 
       prev = inst;
-      m_recomputeInterval->next();
     }
   }
 
@@ -630,40 +617,249 @@ void Profile::postHandleRecompute(const eint& endTime,
 
   // Apply endDiff to (endTime,PLUS_INFINITY)
   bool violation = false;
-  std::map<eint, InstantId>::iterator it = m_instants.upper_bound(endTime);
-  for (;(it != m_instants.end()) && !violation;++it) {
-    InstantId inst = it->second;
+  updateLevels();
+  for (unsigned long index = getLevelIndex(endTime); index < m_levels.size() && !violation; ++index) {
+    InstantId inst = m_levelInstants[index];
     inst->applyBoundsDelta(endDiff.first,endDiff.second);
     violation = m_detector->detect(inst);
+    recordLevels(index);
   }
 }
 
-void Profile::addInstantsForBounds(const TransactionId t) {
-  eint first = static_cast<eint>(t->time()->lastDomain().getLowerBound());
-  eint last =  static_cast<eint>(t->time()->lastDomain().getUpperBound());
-
-  {
-    std::map<eint, InstantId>::iterator ite = m_instants.find( first );
+void Profile::recomputeDirtyWindows() {
+  updateLevels();
+  std::map<eint, eint> windows;
+  windows.swap(m_dirtyWindows);
+  std::map<eint, eint>::const_iterator window = windows.begin();
+  unsigned long index = (window == windows.end() ? m_levels.size() : getLeastLevelIndex(window->first));
+  bool violation = false;
 
-    if( ite == m_instants.end() ) {
-      addInstant(first);
+  while(index < m_levels.size() && !violation) {
+    // the Instants before the window are unchanged, so pick up from the last of them
+    InstantId prev = InstantId::noId();
+    if(index == 0) {
+      initRecompute();
+      m_detector->initialize();
     }
     else {
-      InstantId inst = (*ite).second;
-      inst->updateTransaction( t );
+      prev = m_levelInstants[index - 1];
+      resumeRecompute(prev);
+      m_detector->initialize(prev);
     }
+    debugMsg("Profile:recomputeDirtyWindows", "Recomputing from instant " << m_levels[index].time);
+    prepareLevels(index, m_levels.size());
+
+    for(; index < m_levels.size(); ++index) {
+      InstantId inst = m_levelInstants[index];
+      const eint time = m_levels[index].time;
+      const unsigned char flags = m_levels[index].flags;
+      while(window != windows.end() && window->second < time)
+        ++window;
+      bool inWindow = (window != windows.end() && window->first <= time);
+
+      recomputeLevels(prev, inst);
+      violation = m_detector->detect(inst);
+      recordLevels(index);
+      ++m_instantsRecomputed;
+      prev = inst;
+
+      if(violation) {
+        markDirty(time, PLUS_INFINITY);
+        break;
+      }
+
+      // past the windows, an Instant that comes out the same leaves every Instant after it the same
+      if(!inWindow && !levelsChanged() && m_levels[index].flags == flags) {
+        debugMsg("Profile:recomputeDirtyWindows", "Levels converged at instant " << time);
+        index = (window == windows.end() ? m_levels.size() : std::max(index + 1, getLeastLevelIndex(window->first)));
+        break;
+      }
+    }
+  }
+}
+
+void Profile::resumeRecompute(InstantId) {
+  checkError(ALWAYS_FAIL, "Profile " << getId() << " can't resume a recomputation");
+}
+
+void Profile::markDirty(const eint lb, const eint ub) {
+  eint first = lb, last = ub;
+  std::map<eint, eint>::iterator it = m_dirtyWindows.upper_bound(first);
+  if(it != m_dirtyWindows.begin()) {
+    std::map<eint, eint>::iterator prev = it;
+    --prev;
+    if(prev->second >= first) {
+      first = prev->first;
+      last = std::max(last, prev->second);
+      it = prev;
+    }
+  }
+  while(it != m_dirtyWindows.end() && it->first <= last) {
+    last = std::max(last, it->second);
+    m_dirtyWindows.erase(it++);
+  }
+  m_dirtyWindows.insert(std::make_pair(first, last));
+}
+
+void Profile::prepareLevels(const unsigned long, const unsigned long) {}
+
+void Profile::updateLevels() {
+  if(!m_levelsStale)
+    return;
+
+  debugMsg("Profile:updateLevels", "Rebuilding the level records for " << m_instants.size() << " instants");
+  m_levels.resize(m_instants.size());
+  m_levelInstants.resize(m_instants.size());
+  unsigned long index = 0;
+  for(std::map<eint, InstantId>::const_iterator it = m_instants.begin(); it != m_instants.end(); ++it, ++index) {
+    m_levelInstants[index] = it->second;
+    recordLevels(index);
   }
+  m_levelsStale = false;
+}
 
-  {
-    std::map<eint, InstantId>::iterator ite = m_instants.find( last );
-    if( ite == m_instants.end() ) {
-      addInstant(last);
+void Profile::recordLevels(const unsigned long index) {
+  m_levelTreeDirtyLb = std::min(m_levelTreeDirtyLb, index);
+  m_levelTreeDirtyUb = std::max(m_levelTreeDirtyUb, index + 1);
+  InstantId inst = m_levelInstants[index];
+  LevelRecord& record = m_levels[index];
+  record.time = inst->getTime();
+  record.lowerLevel = inst->getLowerLevel();
+  record.upperLevel = inst->getUpperLevel();
+  record.flags = static_cast<unsigned char>((inst->isFlawed() ? FLAWED : 0) |
+                                            (inst->isViolated() ? VIOLATED : 0) |
+                                            (inst->hasLowerLevelFlaw() ? LOWER_FLAW : 0) |
+                                            (inst->hasUpperLevelFlaw() ? UPPER_FLAW : 0));
+}
+
+void Profile::updateLevelTree() {
+  const unsigned long size = m_levels.size();
+  unsigned long leaves = m_levelTree.size() / 2;
+
+  // Keep the leaves a power of two no more than twice the records, rebuilding the whole tree when that changes
+  if(leaves == 0 || leaves < size || (leaves > 1 && leaves / 2 >= size)) {
+    leaves = 1;
+    while(leaves < size)
+      leaves *= 2;
+    debugMsg("Profile:updateLevelTree", "Rebuilding the level tree with " << leaves << " leaves for " << size << " records");
+    m_levelTree.resize(2 * leaves);
+    m_levelTreeDirtyLb = 0;
+    m_levelTreeDirtyUb = leaves;
+  }
+  else if(m_levelTreeSize != size) {
+    m_levelTreeDirtyLb = std::min(m_levelTreeDirtyLb, std::min(m_levelTreeSize, size));
+    m_levelTreeDirtyUb = std::max(m_levelTreeDirtyUb, std::max(m_levelTreeSize, size));
+  }
+  m_levelTreeSize = size;
+
+  if(m_levelTreeDirtyLb >= m_levelTreeDirtyUb)
+    return;
+
+  for(unsigned long index = m_levelTreeDirtyLb; index < m_levelTreeDirtyUb; ++index) {
+    LevelSummary& leaf = m_levelTree[leaves + index];
+    if(index < size) {
+      leaf.minLower = m_levels[index].lowerLevel;
+      leaf.maxUpper = m_levels[index].upperLevel;
+      leaf.minUpper = m_levels[index].upperLevel;
     }
     else {
-      InstantId inst = (*ite).second;
-      inst->updateTransaction( t );
+      leaf.minLower = std::numeric_limits<edouble>::infinity();
+      leaf.maxUpper = std::numeric_limits<edouble>::minus_infinity();
+      leaf.minUpper = std::numeric_limits<edouble>::infinity();
     }
   }
+
+  // Only the ancestors of the changed leaves need to be merged again
+  unsigned long first = (leaves + m_levelTreeDirtyLb) / 2;
+  unsigned long last = (leaves + m_levelTreeDirtyUb - 1) / 2;
+  for(; first > 0; first /= 2, last /= 2) {
+    for(unsigned long node = first; node <= last; ++node) {
+      m_levelTree[node] = m_levelTree[2 * node];
+      m_levelTree[node].merge(m_levelTree[2 * node + 1]);
+    }
+  }
+
+  m_levelTreeDirtyLb = std::numeric_limits<unsigned long>::max();
+  m_levelTreeDirtyUb = 0;
+}
+
+Profile::LevelSummary Profile::summarizeLevels(unsigned long first, unsigned long last) const {
+  LevelSummary result;
+  result.minLower = std::numeric_limits<edouble>::infinity();
+  result.maxUpper = std::numeric_limits<edouble>::minus_infinity();
+  result.minUpper = std::numeric_limits<edouble>::infinity();
+
+  const unsigned long leaves = m_levelTree.size() / 2;
+  for(first += leaves, last += leaves; first < last; first /= 2, last /= 2) {
+    if((first & 1) != 0)
+      result.merge(m_levelTree[first++]);
+    if((last & 1) != 0)
+      result.merge(m_levelTree[--last]);
+  }
+  return result;
+}
+
+unsigned long Profile::getLeastLevelIndex(const eint time) const {
+  unsigned long index = getLevelIndex(time);
+  return (index > 0 && m_levels[index - 1].time == time ? index - 1 : index);
+}
+
+unsigned long Profile::getLevelIndex(const eint time) const {
+  unsigned long size = m_levels.size();
+  if(size == 0)
+    return 0;
+
+  // Halve the range without branching on the comparison, so the search is a fixed number of
+  // conditional moves rather than a chain of mispredicted branches.
+  const LevelRecord* first = &m_levels[0];
+  const LevelRecord* base = first;
+  while(size > 1) {
+    unsigned long half = size / 2;
+    base = (base[half].time <= time ? base + half : base);
+    size -= half;
+  }
+  return static_cast<unsigned long>(base - first) + (base->time <= time ? 1 : 0);
+}
+
+void Profile::addInstantsForBounds(const TransactionId t) {
+  checkError(m_transactionBounds.find(t) == m_transactionBounds.end(), "Transaction " << t << " is already recorded at its bounds.");
+  eint first = static_cast<eint>(t->time()->lastDomain().getLowerBound());
+  eint last =  static_cast<eint>(t->time()->lastDomain().getUpperBound());
+
+  std::map<eint, InstantId>::iterator ite = m_instants.find( first );
+  if( ite == m_instants.end() ) {
+    addInstant(first);
+    ite = m_instants.find( first );
+  }
+  ite->second->addStartingTransaction( t );
+
+  ite = m_instants.find( last );
+  if( ite == m_instants.end() ) {
+    addInstant(last);
+    ite = m_instants.find( last );
+  }
+  ite->second->addEndingTransaction( t );
+
+  m_transactionBounds.insert(std::make_pair(t, std::make_pair(first, last)));
+  m_overlapInstant = InstantId::noId();
+}
+
+std::pair<eint, eint> Profile::removeInstantsForBounds(const TransactionId t) {
+  std::map<TransactionId, std::pair<eint, eint> >::iterator boundsIt = m_transactionBounds.find(t);
+  checkError(boundsIt != m_transactionBounds.end(), "Transaction " << t << " isn't recorded at any instant.");
+  std::pair<eint, eint> bounds = boundsIt->second;
+  m_transactionBounds.erase(boundsIt);
+
+  debugMsg("Profile:removeInstantsForBounds", "Removing transaction " << t << " from instants at times " << bounds.first << " and " << bounds.second);
+  std::map<eint, InstantId>::iterator ite = m_instants.find(bounds.first);
+  checkError(ite != m_instants.end(), "No instant for the start of transaction " << t << " at " << bounds.first);
+  ite->second->removeTransaction(t);
+  ite = m_instants.find(bounds.second);
+  checkError(ite != m_instants.end(), "No instant for the end of transaction " << t << " at " << bounds.second);
+  ite->second->removeTransaction(t);
+
+  m_overlapInstant = InstantId::noId();
+  return bounds;
 }
 
     void Profile::addInstant(const eint time) {
@@ -671,16 +867,7 @@ void Profile::addInstantsForBounds(const TransactionId t) {
       debugMsg("Profile:addInstant", "Adding instant for time " << time);
       InstantId inst = (new Instant(time, m_id))->getId();
       m_instants.insert(std::pair<eint, InstantId>(time, inst));
-
-      for(std::set<TransactionId>::const_iterator it = m_transactions.begin(); it != m_transactions.end(); ++it) {
-        TransactionId trans = *it;
-        check_error(trans.isValid());
-        check_error(trans->time().isValid());
-        if(trans->time()->lastDomain().isMember(time)) {
-          debugMsg("Profile:addInstant", "Adding transaction " << trans << " spanning " << trans->time()->toString() << " to instant at time " << time);
-          inst->addTransaction(trans);
-        }
-      }
+      m_levelsStale = true;
     }
 
 void Profile::removeInstant(const eint time) {
@@ -691,12 +878,51 @@ void Profile::removeInstant(const eint time) {
     debugMsg("Profile:removeInstant",
              "Removing instant at time " << inst->getTime()
              << " because it does not mark a change.");
+    if(inst == m_overlapInstant)
+      m_overlapInstant = InstantId::noId();
     m_instants.erase(pit);
+    m_levelsStale = true;
     m_detector->notifyDeleted(inst);
     delete static_cast<Instant*>(inst);
   }
 }
 
+const std::set<TransactionId>& Profile::getOverlappingTransactions(const InstantId inst) const {
+  check_error(inst.isValid());
+  if(inst == m_overlapInstant)
+    return m_overlappingTransactions;
+
+  std::map<eint, InstantId>::const_iterator next = m_instants.end();
+  if(m_overlapInstant.isId())
+    next = m_instants.upper_bound(m_overlapInstant->getTime());
+
+  if(next != m_instants.end() && next->second == inst) {
+    //step from the preceding instant: the transactions ending there no longer overlap, the ones starting here do
+    const std::set<TransactionId>& ending = m_overlapInstant->getEndingTransactions();
+    for(std::set<TransactionId>::const_iterator it = ending.begin(); it != ending.end(); ++it)
+      m_overlappingTransactions.erase(*it);
+    m_overlappingTransactions.insert(inst->getStartingTransactions().begin(), inst->getStartingTransactions().end());
+  }
+  else {
+    debugMsg("Profile:getOverlappingTransactions", "Rebuilding the transactions overlapping time " << inst->getTime());
+    const eint time = inst->getTime();
+    m_overlappingTransactions.clear();
+    for(std::map<TransactionId, std::pair<eint, eint> >::const_iterator it = m_transactionBounds.begin();
+        it != m_transactionBounds.end(); ++it)
+      if(it->second.first <= time && time <= it->second.second)
+        m_overlappingTransactions.insert(m_overlappingTransactions.end(), it->first);
+  }
+  m_overlapInstant = inst;
+  return m_overlappingTransactions;
+}
+
+void Profile::getOverlappingTransactions(const eint lb, const eint ub, std::vector<TransactionId>& results) const {
+  for(std::map<TransactionId, std::pair<eint, eint> >::const_iterator it = m_transactionBounds.begin();
+      it != m_transactionBounds.end(); ++it)
+    if(it->second.first <= ub && lb <= it->second.second)
+      results.push_back(it->first);
+}
+
     void Profile::getTransactionsToOrder(const InstantId inst, std::vector<TransactionId>& results) {
       check_error(inst.isValid());
       check_error(results.empty());
@@ -21,8 +21,10 @@
 #include "Engine.hh"
 #include "Factory.hh"
 
+#include <algorithm>
 #include <map>
 #include <utility>
+#include <vector>
 
 #include <boost/smart_ptr/shared_ptr.hpp>
 
@@ -88,6 +90,29 @@ class Profile : public FactoryObj {
    */
   void recompute();
 
+  /**
+   * @brief Gets the number of Instants whose levels have been recomputed over the life of the profile.  The difference
+   * across a propagation measures how much of the profile it visited.
+   */
+  unsigned long getInstantsRecomputed() const {return m_instantsRecomputed;}
+
+  /**
+   * @brief True if recompute() reads no state shared with other profiles, and so can run on another thread while
+   * the detector's notifications are buffered.
+   */
+  virtual bool canRecomputeConcurrently() const {return false;}
+
+  /**
+   * @brief Hold back the detector's notifications to the Resource until flushNotifications.
+   */
+  void bufferNotifications() {m_detector->bufferNotifications();}
+
+  /**
+   * @brief Make the detector's held back notifications, in order.  If a violation couldn't be reported, the profile
+   * is marked to be recomputed from scratch so it is found again.
+   */
+  void flushNotifications();
+
   const PlanDatabaseId getPlanDatabase() const {return m_planDatabase;}
 
 
@@ -111,6 +136,72 @@ class Profile : public FactoryObj {
       
   InstantId getInstant(const eint time) const;
 
+  /**
+   * @brief Gets the Transactions whose time overlaps an Instant.  Instants only record the Transactions
+   * that start or end at them; the overlap is derived from those as the profile is swept, so stepping
+   * from one Instant to the next only applies the Transactions that start or end in between.
+   * Requesting an Instant out of order rebuilds the set from the bounds of all the Transactions.
+   * @param inst An Instant on this profile.
+   * @return A const ref to the set of Transactions.  It remains valid until the Transactions of another
+   * Instant are requested, or the profile changes.
+   */
+  const std::set<TransactionId>& getOverlappingTransactions(const InstantId inst) const;
+
+  /**
+   * @brief Gets the Transactions whose time overlaps the interval [lb ub].
+   * @param lb The start of the interval.
+   * @param ub The end of the interval.
+   * @param results The vector to which the Transactions are appended.
+   */
+  void getOverlappingTransactions(const eint lb, const eint ub, std::vector<TransactionId>& results) const;
+
+  /**
+   * @brief Flags recording the flaw and violation state of an Instant in a LevelRecord.
+   */
+  enum LevelFlags {
+    FLAWED = 1,
+    VIOLATED = 2,
+    LOWER_FLAW = 4,
+    UPPER_FLAW = 8
+  };
+
+  /**
+   * @brief The levels and flaw state computed at an Instant, kept apart from the Instant so the
+   * timeline can be swept and searched without visiting the Instants themselves.
+   */
+  struct LevelRecord {
+    eint time;
+    edouble lowerLevel;
+    edouble upperLevel;
+    unsigned char flags; /**< A combination of LevelFlags */
+  };
+
+  /**
+   * @brief Gets the levels at every Instant, in time order.  Calling this method may cause recalculation.
+   * @return A const ref to the records.  It remains valid until the profile changes.
+   */
+  const std::vector<LevelRecord>& getLevels();
+
+  /**
+   * @brief Gets the bounds of the profile over an interval of time: the least lower bound and the greatest upper bound
+   * of the level at any time in [lb ub].  Costs O(log n) in the number of Instants once the profile is computed.
+   * Calling this method may cause recalculation.
+   * @param lb The start of the interval.
+   * @param ub The end of the interval.
+   * @param dest The interval into which the bounds are stored.
+   */
+  void getLevelRange(const eint lb, const eint ub, IntervalDomain& dest);
+
+  /**
+   * @brief Finds the first time, not before a given one, at which the level drops below a value.  Costs O(log n) in the
+   * number of Instants once the profile is computed.  Calling this method may cause recalculation.
+   * @param level The value.
+   * @param from The time from which to search.
+   * @param necessarily If true, find where the level must be below the value, rather than where it can be.
+   * @return The time, or PLUS_INFINITY if the level never drops below the value.
+   */
+  eint getFirstTimeBelow(const edouble level, const eint from, const bool necessarily = false);
+
  private:
   friend class ProfilePropagator;
   friend class ProfileIterator;
@@ -177,6 +268,21 @@ class Profile : public FactoryObj {
   bool hasConstraint(const ConstraintId constr) const;
 
  protected:
+  /**
+   * @brief The bounds of the level over a run of LevelRecords, as kept in the nodes of m_levelTree.
+   */
+  struct LevelSummary {
+    edouble minLower; /**< The least lower bound */
+    edouble maxUpper; /**< The greatest upper bound */
+    edouble minUpper; /**< The least upper bound */
+
+    void merge(const LevelSummary& other) {
+      minLower = std::min(minLower, other.minLower);
+      maxUpper = std::max(maxUpper, other.maxUpper);
+      minUpper = std::min(minUpper, other.minUpper);
+    }
+  };
+
   ProfileId m_id;
   unsigned int m_changeCount; /**< The number of times that the profile has changed.  Used to detect stale iterators.*/
   bool m_needsRecompute; /**< A flag indicating the necessity of profile recomputation*/
@@ -190,7 +296,19 @@ class Profile : public FactoryObj {
   ConstraintSet m_temporalConstraints;
   ConstraintEngineListenerId m_removalListener;
   std::map<eint, InstantId> m_instants; /**< A map from times to Instants. */
+  std::map<TransactionId, std::pair<eint, eint> > m_transactionBounds; /**< The bounds at which each Transaction is recorded in the Instants. */
+  mutable std::set<TransactionId> m_overlappingTransactions; /**< The Transactions overlapping m_overlapInstant. */
+  mutable InstantId m_overlapInstant; /**< The Instant at which the overlap was last computed. */
+  std::vector<LevelRecord> m_levels; /**< The levels at each Instant in m_instants, in time order. */
+  std::vector<InstantId> m_levelInstants; /**< The Instant for each record in m_levels. */
+  bool m_levelsStale; /**< True if Instants have been added or removed since m_levels was built. */
+  std::vector<LevelSummary> m_levelTree; /**< A segment tree over m_levels.  Node i summarizes nodes 2i and 2i+1; the leaves start at half its size. */
+  unsigned long m_levelTreeSize; /**< The number of records in m_levels when the leaves were last filled. */
+  unsigned long m_levelTreeDirtyLb; /**< The first record changed since the tree was last updated. */
+  unsigned long m_levelTreeDirtyUb; /**< One past the last record changed since the tree was last updated. */
   ProfileIteratorId m_recomputeInterval; /**< The stored interval of recomputation.*/
+  std::map<eint, eint> m_dirtyWindows; /**< Disjoint intervals, from start to end, in which Transactions changed since the last recomputation. */
+  unsigned long m_instantsRecomputed; /**< The number of Instants recomputed over the life of the profile. */
 
   bool hasTransactions() {return !m_transactions.empty();}
 
@@ -224,12 +342,41 @@ class Profile : public FactoryObj {
    */
   virtual void initRecompute() = 0;
 
+  /**
+   * @brief True if the levels at an Instant follow only from those carried out of the Instant before it and the bounds
+   * of the Transactions at it.  Such profiles are recomputed only over m_dirtyWindows: from the last Instant before a
+   * window, with resumeRecompute, up to the first Instant past it at which levelsChanged is false.  This is not used
+   * while violations are allowed, as detecting them starts by resetting all of them.
+   */
+  virtual bool canResumeRecompute() const {return false;}
+
+  /**
+   * @brief Initialize a recomputation to continue after the given Instant, with the levels its recomputation last
+   * carried out of it.  Only called if canResumeRecompute().
+   */
+  virtual void resumeRecompute(InstantId inst);
+
+  /**
+   * @brief True unless the last call to recomputeLevels left the Instant, and the levels carried out of it, as they
+   * were.  Only called if canResumeRecompute().
+   */
+  virtual bool levelsChanged() const {return true;}
+
   /**
    * @brief Recompute the levels for a particular Instant.
    * @param inst The Instant to be recomputed.
    */
   virtual void recomputeLevels( InstantId prev, InstantId inst ) = 0;
 
+  /**
+   * @brief Called once the recomputation is initialized and before the Instants in m_levelInstants from first up to
+   * last are recomputed in turn, so subclasses can compute their levels in bulk.  recomputeLevels is still called for
+   * each Instant, and the sweep may stop early if a violation is detected.
+   * @param first The index of the first Instant to be recomputed.
+   * @param last The index one past the last Instant to be recomputed.
+   */
+  virtual void prepareLevels(const unsigned long first, const unsigned long last);
+
   /**
    * @brief Helper method for subclasses to respond to a transaction being added.
    * @param e The Transaction that was added
@@ -283,6 +430,13 @@ class Profile : public FactoryObj {
 
   bool needsRecompute() const {return m_needsRecompute;}
 
+  /**
+   * @brief Queues a constraint for execution by the Resource propagator, for subclasses that restrict the variables of
+   * their Transactions from what they compute.
+   * @param constraint A constraint on the Resource propagator.
+   */
+  void scheduleExecution(const ConstraintId constraint);
+
   std::string toString() const;
 
   // PHM Some refactoring needed so that customized subclass can
@@ -296,20 +450,29 @@ class Profile : public FactoryObj {
    */
   virtual bool containsChange(const InstantId instant);
   /**
-   * @brief Conditionally adds Instants for the upper and lower
-   * bounds of the Transaction's time.
+   * @brief Records the Transaction at the Instants for the upper and
+   * lower bounds of its time, adding the Instants if necessary.
    *
    * @param t The transaction
    */
   virtual void addInstantsForBounds(const TransactionId t);
 
+  /**
+   * @brief Removes the Transaction from the Instants it was recorded
+   * at.  The Instants are not deleted, even if they no longer mark a change.
+   *
+   * @param t The transaction
+   * @return The bounds at which the Transaction was recorded.
+   */
+  std::pair<eint, eint> removeInstantsForBounds(const TransactionId t);
+
   /**
    * @brief Create an instant for a time.
    * @param time The time
    */
   void addInstant(const eint time);
   /**
-   * @brief Eliminate an instant for a time.
+   * @brief Eliminate the instant for a time if it no longer marks a change.
    * @param time The time
    */
   void removeInstant(const eint time);
@@ -318,6 +481,50 @@ class Profile : public FactoryObj {
 
   edouble getInitCapacityUb() const;
 
+  /**
+   * @brief Rebuilds m_levels and m_levelInstants from the Instants if any have been added or removed.
+   */
+  void updateLevels();
+
+  /**
+   * @brief Copies the levels and flaw state of an Instant into its record.
+   * @param index The position of the Instant in m_levelInstants.
+   */
+  void recordLevels(const unsigned long index);
+
+  /**
+   * @brief Brings m_levelTree up to date with the records changed since it was last updated.  Refreshing k records
+   * costs O(k + log n), so a recomputation that only touches part of the profile only touches part of the tree.
+   */
+  void updateLevelTree();
+
+  /**
+   * @brief Records that the levels may have changed over [lb ub], merging it into m_dirtyWindows.
+   */
+  void markDirty(const eint lb, const eint ub);
+
+  /**
+   * @brief Recomputes the Instants over m_dirtyWindows, stopping at each Instant past a window whose levels are unchanged.
+   */
+  void recomputeDirtyWindows();
+
+  /**
+   * @brief Summarizes the records in [first last) from m_levelTree.
+   */
+  LevelSummary summarizeLevels(unsigned long first, unsigned long last) const;
+
+  /**
+   * @brief Finds the position of a time in m_levels.
+   * @param time The time
+   * @return The number of records at or before time, which is also the index of the first record after it.
+   */
+  unsigned long getLevelIndex(const eint time) const;
+
+  /**
+   * @brief Finds the position of the first record in m_levels not before a time.
+   */
+  unsigned long getLeastLevelIndex(const eint time) const;
+
  private:
   /** 
    * @brief Handle an addition or removal message on a temporal constraint.
@@ -4,11 +4,162 @@
 #include "ConstraintEngine.hh"
 #include "Debug.hh"
 #include "ResourceTokenRelation.hh"
+#include "Mutex.hh"
 
 #include <numeric>
+#include <pthread.h>
 
 namespace EUROPA {
-  
+
+/**
+ * Recomputes profiles on a pool of threads and the calling thread.  Each thread is dealt an even share of the
+ * profiles, and once its own share runs out it steals from the end of the others'.
+ */
+class ProfileRecomputePool {
+ public:
+  ProfileRecomputePool(const unsigned int threadCount)
+      : m_threads(), m_shares(), m_profiles(NULL), m_round(0), m_running(0),
+        m_started(0), m_stopping(false), m_error(NULL) {
+    pthread_mutex_init(&m_mutex, NULL);
+    pthread_cond_init(&m_start, NULL);
+    pthread_cond_init(&m_finish, NULL);
+    m_threads.resize(threadCount - 1);
+    unsigned int started = 0;
+    for(; started < m_threads.size(); ++started) {
+      if(pthread_create(&m_threads[started], NULL, &ProfileRecomputePool::work, this) != 0)
+        break;
+    }
+    m_threads.resize(started);
+    m_shares.resize(started + 1);
+    for(std::vector<Share>::iterator it = m_shares.begin(); it != m_shares.end(); ++it)
+      pthread_mutex_init(&it->mutex, NULL);
+  }
+
+  ~ProfileRecomputePool() {
+    {
+      MutexGrabber grabber(m_mutex);
+      m_stopping = true;
+      pthread_cond_broadcast(&m_start);
+    }
+    for(std::vector<pthread_t>::const_iterator it = m_threads.begin(); it != m_threads.end(); ++it)
+      pthread_join(*it, NULL);
+    for(std::vector<Share>::iterator it = m_shares.begin(); it != m_shares.end(); ++it)
+      pthread_mutex_destroy(&it->mutex);
+    pthread_cond_destroy(&m_finish);
+    pthread_cond_destroy(&m_start);
+    pthread_mutex_destroy(&m_mutex);
+  }
+
+  /**
+   * Recompute every one of profiles, returning when they're all done.  Rethrows the first Error a thread met.
+   */
+  void recompute(const std::vector<ProfileId>& profiles) {
+    m_profiles = &profiles;
+    for(size_t i = 0; i < m_shares.size(); ++i) {
+      m_shares[i].next = profiles.size() * i / m_shares.size();
+      m_shares[i].end = profiles.size() * (i + 1) / m_shares.size();
+    }
+    {
+      MutexGrabber grabber(m_mutex);
+      ++m_round;
+      m_running = static_cast<unsigned int>(m_threads.size());
+      pthread_cond_broadcast(&m_start);
+    }
+    run(0);
+    {
+      MutexGrabber grabber(m_mutex);
+      while(m_running > 0)
+        pthread_cond_wait(&m_finish, &m_mutex);
+    }
+    m_profiles = NULL;
+    if(m_error != NULL) {
+      Error error(*m_error);
+      delete m_error;
+      m_error = NULL;
+      throw error;
+    }
+  }
+
+ private:
+  ProfileRecomputePool(const ProfileRecomputePool&);
+  ProfileRecomputePool& operator=(const ProfileRecomputePool&);
+
+  struct Share {
+    pthread_mutex_t mutex;
+    size_t next; /*!< The index of the next profile its owner takes */
+    size_t end; /*!< One past the last profile left in it, which is the next one stolen */
+  };
+
+  static void* work(void* arg) {
+    ProfileRecomputePool* self = static_cast<ProfileRecomputePool*>(arg);
+    unsigned int worker = 0;
+    unsigned long round = 0;
+    {
+      MutexGrabber grabber(self->m_mutex);
+      worker = ++self->m_started;
+    }
+    while(true) {
+      {
+        MutexGrabber grabber(self->m_mutex);
+        while(self->m_round == round && !self->m_stopping)
+          pthread_cond_wait(&self->m_start, &self->m_mutex);
+        if(self->m_stopping)
+          return NULL;
+        round = self->m_round;
+      }
+      self->run(worker);
+      {
+        MutexGrabber grabber(self->m_mutex);
+        if(--self->m_running == 0)
+          pthread_cond_signal(&self->m_finish);
+      }
+    }
+  }
+
+  void run(const unsigned int worker) {
+    size_t index = 0;
+    while(take(worker, index)) {
+      try {
+        (*m_profiles)[index]->recompute();
+      }
+      catch(const Error& error) {
+        MutexGrabber grabber(m_mutex);
+        if(m_error == NULL)
+          m_error = new Error(error);
+      }
+      catch(...) {
+        MutexGrabber grabber(m_mutex);
+        if(m_error == NULL)
+          m_error = new Error("recompute()", "Unexpected exception recomputing a profile", __FILE__, __LINE__);
+      }
+    }
+  }
+
+  bool take(const unsigned int worker, size_t& index) {
+    for(size_t i = 0; i < m_shares.size(); ++i) {
+      Share& share = m_shares[(worker + i) % m_shares.size()];
+      MutexGrabber grabber(share.mutex);
+      if(share.next == share.end)
+        continue;
+      index = (i == 0 ? share.next++ : --share.end);
+      return true;
+    }
+    return false;
+  }
+
+  std::vector<pthread_t> m_threads;
+  std::vector<Share> m_shares; /*!< One per thread; the calling thread's is the first */
+  const std::vector<ProfileId>* m_profiles;
+  pthread_mutex_t m_mutex;
+  pthread_cond_t m_start;
+  pthread_cond_t m_finish;
+  unsigned long m_round; /*!< The number of calls to recompute so far */
+  unsigned int m_running; /*!< The number of pool threads still working on this round */
+  unsigned int m_started;
+  bool m_stopping;
+  Error* m_error;
+};
+
 ProfilePropagator::ProfilePropagator(const std::string& name,
                                      const ConstraintEngineId constraintEngine)
     : DefaultPropagator(name, constraintEngine)
@@ -17,10 +168,23 @@ ProfilePropagator::ProfilePropagator(const std::string& name,
     , m_updateRequired(false)
     , m_inBatchMode(false)
     , m_batchListener(NULL)
+    , m_recomputeThreadCount(1)
+    , m_recomputePool(NULL)
 {
 }
 
-ProfilePropagator::~ProfilePropagator(){}
+ProfilePropagator::~ProfilePropagator(){
+  delete m_recomputePool;
+}
+
+void ProfilePropagator::setRecomputeThreadCount(const unsigned int count) {
+  checkError(count > 0, "Profiles must be recomputed by at least one thread.");
+  if(count == m_recomputeThreadCount)
+    return;
+  delete m_recomputePool;
+  m_recomputePool = NULL;
+  m_recomputeThreadCount = count;
+}
 
 void ProfilePropagator::addProfile(const ProfileId profile) {
   m_profiles.insert(profile);
@@ -41,7 +205,8 @@ void ProfilePropagator::handleConstraintAdded(const ConstraintId) {
   // DefaultPropagator::handleConstraintAdded(constraint);
 }
 
-void ProfilePropagator::handleConstraintRemoved(const ConstraintId) {
+void ProfilePropagator::handleConstraintRemoved(const ConstraintId constraint) {
+  m_agenda.erase(constraint);
   // check_error(constraint.isValid());
   // if(m_newConstraints.erase(constraint) > 0)
   //   m_updateRequired = true;
@@ -91,10 +256,49 @@ void ProfilePropagator::execute() {
   //   m_profiles.insert(listener->getProfile());
   // }
 
+  recomputeProfiles();
+
+  m_updateRequired = false;
+  debugMsg("ProfilePropagator:execute", "Executed ProfilePropagator");
+}
+
+void ProfilePropagator::recomputeProfiles() {
+  std::vector<ProfileId> concurrent;
+  if(m_recomputeThreadCount > 1 && !getConstraintEngine()->provenInconsistent()) {
+    for(std::set<ProfileId>::const_iterator it = m_profiles.begin(); it != m_profiles.end(); ++it) {
+      if((*it)->needsRecompute() && (*it)->canRecomputeConcurrently())
+        concurrent.push_back(*it);
+    }
+  }
+
+  if(concurrent.size() > 1) {
+    debugMsg("ProfilePropagator:execute", "Recomputing " << concurrent.size() << " profiles concurrently");
+    if(m_recomputePool == NULL)
+      m_recomputePool = new ProfileRecomputePool(m_recomputeThreadCount);
+    for(std::vector<ProfileId>::const_iterator it = concurrent.begin(); it != concurrent.end(); ++it)
+      (*it)->bufferNotifications();
+    try {
+      m_recomputePool->recompute(concurrent);
+    }
+    catch(...) {
+      for(std::vector<ProfileId>::const_iterator it = concurrent.begin(); it != concurrent.end(); ++it)
+        (*it)->flushNotifications();
+      throw;
+    }
+  }
+  else
+    concurrent.clear();
+
+  // Notifications from the concurrent recomputations are made in the order the profiles would have been recomputed in
+  std::vector<ProfileId>::const_iterator next = concurrent.begin();
   for(std::set<ProfileId>::iterator it = m_profiles.begin(); it != m_profiles.end(); ++it) {
     ProfileId profile = *it;
     check_error(profile.isValid());
-    if( !getConstraintEngine()->provenInconsistent()
+    if(next != concurrent.end() && *next == profile) {
+      profile->flushNotifications();
+      ++next;
+    }
+    else if( !getConstraintEngine()->provenInconsistent()
         &&
         profile->needsRecompute()) {
       condDebugMsg(profile->getResource() != ResourceId::noId(),
@@ -106,13 +310,11 @@ void ProfilePropagator::execute() {
       profile->recompute();
     }
   }
-
-  m_updateRequired = false;
-  debugMsg("ProfilePropagator:execute", "Executed ProfilePropagator");
 }
 
-void ProfilePropagator::execute(const ConstraintId) {
-  // Propagator::execute(constraint);
+void ProfilePropagator::execute(const ConstraintId constraint) {
+  // Of the Resource constraints, only those profiles schedule restrict anything; the rest execute as no-ops
+  Propagator::execute(constraint);
   // if(constraint->getName() == Profile::VariableListener::CONSTRAINT_NAME()) {
   //   Profile::VariableListener* listener = id_cast<Profile::VariableListener>(constraint);
   //   if(listener->getProfile()->needsRecompute())
@@ -121,6 +323,8 @@ void ProfilePropagator::execute(const ConstraintId) {
 }
 
 bool ProfilePropagator::updateRequired() const {
+  if(!m_agenda.empty())
+    return true;
   //TODO: Make this a one-liner
   for(std::set<ProfileId>::const_iterator it = m_profiles.begin();
       it != m_profiles.end(); ++it) {
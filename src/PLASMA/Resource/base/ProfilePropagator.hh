@@ -7,6 +7,8 @@
 #include "ResourceDefs.hh"
 
 namespace EUROPA {
+class ProfileRecomputePool;
+
 class ProfilePropagator : public DefaultPropagator {
 private:
   ProfilePropagator(const ProfilePropagator&);
@@ -28,13 +30,22 @@ private:
   }
   void addProfile(const ProfileId profile);
   void removeProfile(const ProfileId profile);
+
+  /**
+   * @brief Sets the number of threads, counting the propagating one, that recompute the profiles that can be
+   * recomputed concurrently.  1, the default, recomputes every profile in turn.
+   */
+  void setRecomputeThreadCount(const unsigned int count);
+  unsigned int getRecomputeThreadCount() const {return m_recomputeThreadCount;}
  protected:
   friend class Profile;
   void setUpdateRequired(const bool update) {m_updateRequired = update;}
+  void schedule(const ConstraintId constraint) {m_agenda.insert(constraint);}
  private:
   void execute();
   void execute(const ConstraintId constraint);
   bool updateRequired() const;
+  void recomputeProfiles();
   void handleConstraintAdded(const ConstraintId constraint);
   void handleConstraintRemoved(const ConstraintId constraint);
 
@@ -43,6 +54,8 @@ private:
   bool m_updateRequired;
   bool m_inBatchMode;
   ConstraintEngineListener* m_batchListener;
+  unsigned int m_recomputeThreadCount;
+  ProfileRecomputePool* m_recomputePool; /**< Started the first time profiles are recomputed concurrently. */
 };
 }
 
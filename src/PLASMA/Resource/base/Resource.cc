@@ -716,6 +716,22 @@ void Resource::getOrderingChoices(const InstantId inst,
     return m_detector->getVDLevelProfile();
   }
 
+double Resource::getMinUsage(TimePoint start, TimePoint end) {
+  IntervalDomain dom;
+  getProfile()->getLevelRange(static_cast<eint>(start), static_cast<eint>(end), dom);
+  return cast_double(dom.getLowerBound());
+}
+
+double Resource::getMaxUsage(TimePoint start, TimePoint end) {
+  IntervalDomain dom;
+  getProfile()->getLevelRange(static_cast<eint>(start), static_cast<eint>(end), dom);
+  return cast_double(dom.getUpperBound());
+}
+
+TimePoint Resource::getFirstTimeUsageBelow(double level, TimePoint from, bool necessarily) {
+  return cast_basis(getProfile()->getFirstTimeBelow(level, static_cast<eint>(from), necessarily));
+}
+
 PSList<PSEntityKey> Resource::getOrderingChoices(TimePoint t) {
   PSList<PSEntityKey> retval;
 
@@ -184,6 +184,10 @@ namespace EUROPA {
       virtual PSResourceProfile* getFDLevels();
       virtual PSResourceProfile* getVDLevels();
 
+      virtual double getMinUsage(TimePoint start, TimePoint end);
+      virtual double getMaxUsage(TimePoint start, TimePoint end);
+      virtual TimePoint getFirstTimeUsageBelow(double level, TimePoint from, bool necessarily);
+
       virtual PSList<PSEntityKey> getOrderingChoices(TimePoint t);
 
     protected:
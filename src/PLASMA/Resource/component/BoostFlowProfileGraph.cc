@@ -149,7 +149,7 @@ void BoostFlowProfileGraph::addTransactionToGraph(const TransactionId t) {
 
 void BoostFlowProfileGraph::enableTransaction(const TransactionId t,
                                               const InstantId inst,
-                                              TransactionId2InstantId ) {
+                                              TransactionId2InstantId& ) {
   debugMsg("BoostFlowProfileGraph:enableTransaction", 
            (isLowerLevel() ? "<lower>" : "<upper>") << "Enabling " << 
            (t->isConsumer() ? "consumer " : "producer ") << t << "" << t->toString() <<
@@ -252,5 +252,15 @@ void BoostFlowProfileGraph::reset() {
   initializeGraph(getTransaction(m_source), getTransaction(m_sink));
 }
 
+void BoostFlowProfileGraph::clear() {
+  reset();
+  m_activeTransactions.clear();
+  m_recalculate = false;
+}
+
+void BoostFlowProfileGraph::reserve(const unsigned int transactions) {
+  m_activeTransactions.reserve(transactions);
+}
+
 }
 
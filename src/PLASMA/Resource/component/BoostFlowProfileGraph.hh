@@ -48,7 +48,7 @@ class BoostFlowProfileGraph : public FlowProfileGraph {
    * \endverbatim
    */
   void enableTransaction(const TransactionId transaction, const InstantId inst,
-                         TransactionId2InstantId contributions);
+                         TransactionId2InstantId& contributions);
   /**
    * @brief Returns true if \a transaction is enabled in the invoking
    * instance
@@ -100,7 +100,7 @@ class BoostFlowProfileGraph : public FlowProfileGraph {
    * contributions, which maps a TransactionId to a InstantId is maps every transaction associated with a disabled
    * node to \a instant.
    */
-  edouble disableReachableResidualGraph( TransactionId2InstantId, const InstantId  ) {return 0.0;}
+  edouble disableReachableResidualGraph( TransactionId2InstantId&, const InstantId  ) {return 0.0;}
   /**
    * @brief Removes transaction \a id from the network.
    */
@@ -113,6 +113,16 @@ class BoostFlowProfileGraph : public FlowProfileGraph {
    *
    */
   void reset();
+
+  /**
+   * @brief Removes every transaction, leaving the source and the sink.
+   */
+  void clear();
+
+  /**
+   * @brief Reserves room for \a transactions active transactions.
+   */
+  void reserve(const unsigned int transactions);
   /**
    * @brief Restore flow invokes the maximum flow algorithm without resetting the existing distances
    * and existing flows on the nodes.
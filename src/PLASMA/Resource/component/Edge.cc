@@ -16,11 +16,18 @@
 
 namespace EUROPA
 {
-    Edge::Edge( Node* source, Node* target, edouble capacity, bool enabled ):
+    Edge::Edge( Node* source, Node* target, edouble capacity, bool enabled, unsigned int index ):
       m_Capacity( capacity ),
       m_Enabled( enabled ),
-      m_Source( source ),
-      m_Target( target )
+      m_Source( 0 ),
+      m_Target( 0 ),
+      m_Reverse( 0 ),
+      m_Index( index )
+    {
+      reset( source, target, capacity, enabled );
+    }
+
+    void Edge::reset( Node* source, Node* target, edouble capacity, bool enabled )
     {
       checkError( 0 != source, "Null not allowed as input for source" );
       checkError( 0 != target, "Null not allowed as input for target" );
@@ -28,8 +35,11 @@ namespace EUROPA
 		  << capacity << "' larger than maximum capacity '"
 		  << getMaxCapacity() << "'");
 
-      m_Source->addOutEdge( this );
-      m_Target->addInEdge( this );
+      m_Capacity = capacity;
+      m_Enabled = enabled;
+      m_Source = source;
+      m_Target = target;
+      m_Reverse = 0;
     }
 
     Edge::~Edge()
@@ -22,14 +22,15 @@ private:
   friend class Node;
  public:
   /**
-   * @brief Constructor
+   * @brief Constructor. The graph owning the edge adds it to the edges of \a source and \a target.
    * @arg source
    * @arg target
    * @arg capacity
    * @arg enabled
+   * @arg index The dense index of the edge in the graph owning it
    *
    */
-  Edge( Node* source, Node* target, edouble capacity, bool enabled = true );
+  Edge( Node* source, Node* target, edouble capacity, bool enabled, unsigned int index );
   /**
    * @brief Destructor
    *
@@ -59,6 +60,15 @@ private:
    * @brief Returns the target of the invoking edge
    */
   inline Node* getTarget() const;
+  /**
+   * @brief Returns the edge going from the target to the source of the invoking edge, or 0 if there is none
+   */
+  inline Edge* getReverse() const;
+  /**
+   * @brief The index of the invoking edge, unique among the edges of its graph and less than
+   * Graph::getEdgeCapacity().
+   */
+  inline unsigned int getIndex() const;
   /**
    * @brief Enables the invoking edge
    *
@@ -89,12 +99,18 @@ private:
    */
   static EdgeIdentity getIdentity( Node* source, Node* target );
  private:
+  /**
+   * @brief Makes an edge the graph had released into an edge from \a source to \a target.
+   */
+  void reset( Node* source, Node* target, edouble capacity, bool enabled );
 
   edouble m_Capacity;
   bool m_Enabled;
 
   Node* m_Source;
   Node* m_Target;
+  Edge* m_Reverse;
+  unsigned int m_Index;
 };
 
     std::ostream& operator<<( std::ostream& os, const Edge& fe );
@@ -119,6 +135,16 @@ private:
       return m_Target;
     }
 
+    Edge* Edge::getReverse() const
+    {
+      return m_Reverse;
+    }
+
+    unsigned int Edge::getIndex() const
+    {
+      return m_Index;
+    }
+
     bool Edge::isEnabled() const
     {
       return m_Enabled && m_Target->isEnabled();
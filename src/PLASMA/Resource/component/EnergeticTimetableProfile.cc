@@ -0,0 +1,364 @@
+#include "EnergeticTimetableProfile.hh"
+#include "Resource.hh"
+#include "Transaction.hh"
+#include "ConstrainedVariable.hh"
+#include "ConstraintEngine.hh"
+#include "PlanDatabase.hh"
+#include "Token.hh"
+#include "TokenVariable.hh"
+#include "Debug.hh"
+
+#include <algorithm>
+#include <cmath>
+
+namespace EUROPA {
+
+ResourceTimeBounds::ResourceTimeBounds(const ConstraintEngineId constraintEngine,
+                                       const std::vector<ConstrainedVariableId>& scope,
+                                       EnergeticTimetableProfile* profile)
+    : Constraint(CONSTRAINT_NAME(), PROPAGATOR_NAME(), constraintEngine, scope)
+    , m_profile(profile)
+    , m_earliestStart(MINUS_INFINITY)
+    , m_latestEnd(PLUS_INFINITY)
+    , m_infeasible(false)
+{
+  checkError(scope.size() == 3, "Require the start, end and quantity variables, in that order.");
+}
+
+void ResourceTimeBounds::restrict(const edouble earliestStart, const edouble latestEnd, const bool infeasible) {
+  m_earliestStart = std::max(m_earliestStart, earliestStart);
+  m_latestEnd = std::min(m_latestEnd, latestEnd);
+  m_infeasible = m_infeasible || infeasible;
+}
+
+const std::vector<ConstrainedVariableId>&
+ResourceTimeBounds::getModifiedVariables(const ConstrainedVariableId) const {
+  return m_profile->getActivityTimes();
+}
+
+const std::vector<ConstrainedVariableId>&
+ResourceTimeBounds::getModifiedVariables() const {
+  return m_profile->getActivityTimes();
+}
+
+bool ResourceTimeBounds::canIgnore(const ConstrainedVariableId,
+                                   unsigned int,
+                                   const DomainListener::ChangeType& changeType) {
+  // Relaxation resets the variables to what the other constraints allow, so the bounds are inferred again
+  if(changeType == DomainListener::RESET || changeType == DomainListener::RELAXED) {
+    m_earliestStart = MINUS_INFINITY;
+    m_latestEnd = PLUS_INFINITY;
+    m_infeasible = false;
+  }
+  return true;
+}
+
+void ResourceTimeBounds::handleExecute() {
+  Domain& start = getCurrentDomain(m_variables[START_VAR]);
+  Domain& end = getCurrentDomain(m_variables[END_VAR]);
+  debugMsg("ResourceTimeBounds:handleExecute",
+           "Restricting " << start.toString() << " to start after " << m_earliestStart <<
+           " and " << end.toString() << " to end before " << m_latestEnd << (m_infeasible ? ", infeasible" : ""));
+
+  if(m_infeasible || m_earliestStart > start.getUpperBound()) {
+    start.empty();
+    return;
+  }
+  if(m_earliestStart > start.getLowerBound())
+    start.intersect(m_earliestStart, start.getUpperBound());
+
+  if(m_latestEnd < end.getLowerBound()) {
+    end.empty();
+    return;
+  }
+  if(m_latestEnd < end.getUpperBound())
+    end.intersect(end.getLowerBound(), m_latestEnd);
+}
+
+EnergeticTimetableProfile::EnergeticTimetableProfile(const PlanDatabaseId db, const FVDetectorId flawDetector)
+    : TimetableProfile(db, flawDetector)
+    , m_activities()
+    , m_completeActivities(0)
+    , m_activityTimes()
+{
+}
+
+EnergeticTimetableProfile::~EnergeticTimetableProfile() {
+  // When purging the constraint engine deletes the constraints itself
+  if(Entity::isPurging())
+    return;
+  for(std::map<ConstrainedVariableId, Activity>::const_iterator it = m_activities.begin(); it != m_activities.end(); ++it) {
+    if(it->second.bounds.isId())
+      delete static_cast<Constraint*>(it->second.bounds);
+  }
+}
+
+void EnergeticTimetableProfile::handleTransactionAdded(const TransactionId e) {
+  TimetableProfile::handleTransactionAdded(e);
+
+  Activity& activity = m_activities[e->quantity()];
+  TransactionId& slot = (e->isConsumer() ? activity.start : activity.end);
+  if(slot.isId()) {
+    debugMsg("EnergeticTimetableProfile:handleTransactionAdded",
+             "Transaction " << e << " shares its quantity with another " << (e->isConsumer() ? "consumer" : "producer") <<
+             ", so activities can't be filtered");
+    return;
+  }
+  slot = e;
+
+  if(activity.start.isId() && activity.end.isId()) {
+    std::vector<ConstrainedVariableId> scope;
+    scope.push_back(activity.start->time());
+    scope.push_back(activity.end->time());
+    scope.push_back(e->quantity());
+    activity.bounds = (new ResourceTimeBounds(m_planDatabase->getConstraintEngine(), scope, this))->getId();
+    m_completeActivities++;
+    updateActivityTimes();
+  }
+}
+
+void EnergeticTimetableProfile::handleTransactionRemoved(const TransactionId e) {
+  std::map<ConstrainedVariableId, Activity>::iterator it = m_activities.find(e->quantity());
+  if(it != m_activities.end()) {
+    Activity& activity = it->second;
+    TransactionId& slot = (e->isConsumer() ? activity.start : activity.end);
+    if(slot == e) {
+      if(activity.bounds.isId()) {
+        // Deleting the constraint relaxes every activity it may have been used to restrict
+        ResourceTimeBoundsId bounds = activity.bounds;
+        activity.bounds = ResourceTimeBoundsId::noId();
+        delete static_cast<Constraint*>(bounds);
+        m_completeActivities--;
+        updateActivityTimes();
+      }
+      slot = TransactionId::noId();
+      if(activity.start.isNoId() && activity.end.isNoId())
+        m_activities.erase(it);
+    }
+  }
+
+  TimetableProfile::handleTransactionRemoved(e);
+}
+
+void EnergeticTimetableProfile::updateActivityTimes() {
+  m_activityTimes.clear();
+  for(std::map<ConstrainedVariableId, Activity>::const_iterator it = m_activities.begin(); it != m_activities.end(); ++it) {
+    if(it->second.bounds.isId()) {
+      m_activityTimes.push_back(it->second.start->time());
+      m_activityTimes.push_back(it->second.end->time());
+    }
+  }
+}
+
+void EnergeticTimetableProfile::postHandleRecompute(const eint& endTime,
+                                                    const std::pair<edouble,edouble>& endDiff) {
+  TimetableProfile::postHandleRecompute(endTime, endDiff);
+  if(!m_planDatabase->getConstraintEngine()->provenInconsistent())
+    filter();
+}
+
+edouble EnergeticTimetableProfile::getAvailability() const {
+  ResourceId resource = getResource();
+  if(resource.isNoId())
+    return PLUS_INFINITY;
+
+  typedef std::map<eint, std::pair<edouble, edouble> > Values;
+  edouble capacity = MINUS_INFINITY;
+  const Values& capacities = resource->getCapacityProfile()->getValues();
+  for(Values::const_iterator it = capacities.begin(); it != capacities.end(); ++it)
+    capacity = std::max(capacity, it->second.second);
+
+  edouble limit = PLUS_INFINITY;
+  const Values& limits = resource->getLimitProfile()->getValues();
+  for(Values::const_iterator it = limits.begin(); it != limits.end(); ++it)
+    limit = std::min(limit, it->second.first);
+
+  if(capacity >= PLUS_INFINITY || limit <= MINUS_INFINITY)
+    return PLUS_INFINITY;
+  return capacity - limit;
+}
+
+namespace {
+  /**
+   * The bounds of an activity, as doubles so intervals can be measured.  Infinite bounds stay infinite.
+   */
+  struct ActivityBounds {
+    ResourceTimeBoundsId bounds;
+    double est, lst, eet, let; /**< Earliest and latest start, earliest and latest end */
+    double duration; /**< The least duration */
+    double quantity; /**< The least quantity */
+    double newEst, newLet;
+    bool infeasible;
+  };
+
+  /**
+   * A stretch of time over which the compulsory parts use a constant amount.
+   */
+  struct Segment {
+    double start, end, height;
+  };
+
+  bool isFinite(const double value) {
+    return value > cast_double(MINUS_INFINITY) && value < cast_double(PLUS_INFINITY);
+  }
+
+  /**
+   * The least an activity spends in [t1 t2): the overlap of its duration with the interval when it is shifted as far from
+   * it as its bounds allow.
+   */
+  double minimalIntersection(const ActivityBounds& a, const double t1, const double t2) {
+    if(!isFinite(a.est) || !isFinite(a.let))
+      return 0.0;
+    double leftShift = std::max(0.0, a.duration - std::max(0.0, t1 - a.est));
+    double rightShift = std::max(0.0, a.duration - std::max(0.0, a.let - t2));
+    return a.quantity * std::max(0.0, std::min(t2 - t1, std::min(leftShift, rightShift)));
+  }
+
+  /**
+   * The least duration of the token whose start and end the Transactions are, or 0 if they aren't.
+   */
+  double getLeastDuration(const TransactionId start, const TransactionId end) {
+    EntityId startParent = start->time()->parent();
+    if(startParent.isNoId() || startParent != end->time()->parent() || !TokenId::convertable(startParent))
+      return 0.0;
+    TokenId token = startParent;
+    return std::max(0.0, cast_double(token->duration()->lastDomain().getLowerBound()));
+  }
+}
+
+void EnergeticTimetableProfile::filter() {
+  if(m_completeActivities == 0 || m_transactions.size() != 2 * m_completeActivities)
+    return;
+  edouble availability = getAvailability();
+  if(availability >= PLUS_INFINITY)
+    return;
+  const double capacity = cast_double(availability);
+
+  std::vector<ActivityBounds> activities;
+  for(std::map<ConstrainedVariableId, Activity>::const_iterator it = m_activities.begin(); it != m_activities.end(); ++it) {
+    const Activity& activity = it->second;
+    if(activity.bounds.isNoId())
+      continue;
+    ActivityBounds a;
+    a.bounds = activity.bounds;
+    a.est = cast_double(activity.start->time()->lastDomain().getLowerBound());
+    a.lst = cast_double(activity.start->time()->lastDomain().getUpperBound());
+    a.eet = cast_double(activity.end->time()->lastDomain().getLowerBound());
+    a.let = cast_double(activity.end->time()->lastDomain().getUpperBound());
+    a.duration = getLeastDuration(activity.start, activity.end);
+    a.quantity = cast_double(activity.start->quantity()->lastDomain().getLowerBound());
+    a.newEst = a.est;
+    a.newLet = a.let;
+    a.infeasible = false;
+    if(a.quantity > 0)
+      activities.push_back(a);
+  }
+
+  // Timetable reasoning, against the profile of the compulsory parts
+  std::vector<std::pair<double, double> > events;
+  for(std::vector<ActivityBounds>::const_iterator it = activities.begin(); it != activities.end(); ++it) {
+    if(it->lst < it->eet) {
+      events.push_back(std::make_pair(it->lst, it->quantity));
+      events.push_back(std::make_pair(it->eet, -it->quantity));
+    }
+  }
+  std::sort(events.begin(), events.end());
+  std::vector<Segment> segments;
+  double height = 0;
+  for(std::vector<std::pair<double, double> >::const_iterator it = events.begin(); it != events.end(); ++it) {
+    height += it->second;
+    std::vector<std::pair<double, double> >::const_iterator next = it + 1;
+    if(next != events.end() && next->first > it->first && height > 0) {
+      Segment segment = {it->first, next->first, height};
+      segments.push_back(segment);
+    }
+  }
+
+  for(std::vector<ActivityBounds>::iterator a = activities.begin(); a != activities.end() && !segments.empty(); ++a) {
+    if(a->duration <= 0)
+      continue;
+    // The segments are split at the activity's own compulsory part, so each is either wholly in it or wholly out of it
+    if(isFinite(a->est)) {
+      double start = a->est;
+      for(std::vector<Segment>::const_iterator s = segments.begin(); s != segments.end() && s->start < start + a->duration; ++s) {
+        double others = s->height - (s->start >= a->lst && s->end <= a->eet ? a->quantity : 0);
+        if(s->end > start && others + a->quantity > capacity)
+          start = s->end;
+      }
+      a->newEst = start;
+    }
+    if(isFinite(a->let)) {
+      double end = a->let;
+      for(std::vector<Segment>::const_reverse_iterator s = segments.rbegin(); s != segments.rend() && s->end > end - a->duration; ++s) {
+        double others = s->height - (s->start >= a->lst && s->end <= a->eet ? a->quantity : 0);
+        if(s->start < end && others + a->quantity > capacity)
+          end = s->start;
+      }
+      a->newLet = end;
+    }
+  }
+
+  // Energetic reasoning, over the intervals from an earliest start to a latest end
+  std::vector<double> starts, ends;
+  for(std::vector<ActivityBounds>::const_iterator it = activities.begin(); it != activities.end(); ++it) {
+    if(isFinite(it->est) && isFinite(it->let) && it->duration > 0) {
+      starts.push_back(it->est);
+      ends.push_back(it->let);
+    }
+  }
+  std::sort(starts.begin(), starts.end());
+  starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+  std::sort(ends.begin(), ends.end());
+  ends.erase(std::unique(ends.begin(), ends.end()), ends.end());
+
+  std::vector<double> intersections(activities.size());
+  bool infeasible = false;
+  for(std::vector<double>::const_iterator t1 = starts.begin(); t1 != starts.end() && !infeasible; ++t1) {
+    for(std::vector<double>::const_iterator t2 = std::upper_bound(ends.begin(), ends.end(), *t1);
+        t2 != ends.end() && !infeasible; ++t2) {
+      const double length = *t2 - *t1;
+      double energy = 0;
+      for(unsigned long i = 0; i < activities.size(); ++i) {
+        intersections[i] = minimalIntersection(activities[i], *t1, *t2);
+        energy += intersections[i];
+      }
+      if(energy <= 0)
+        continue;
+      if(energy > capacity * length) {
+        debugMsg("EnergeticTimetableProfile:filter",
+                 "Activities need " << energy << " in [" << *t1 << " " << *t2 << "), more than " << capacity * length);
+        for(unsigned long i = 0; i < activities.size() && !infeasible; ++i)
+          infeasible = activities[i].infeasible = (intersections[i] > 0);
+        break;
+      }
+      for(unsigned long i = 0; i < activities.size(); ++i) {
+        ActivityBounds& a = activities[i];
+        if(a.duration <= 0)
+          continue;
+        const double slack = capacity * length - (energy - intersections[i]);
+        if(isFinite(a.est)) {
+          double leftShift = a.quantity * std::min(length, std::max(0.0, a.duration - std::max(0.0, *t1 - a.est)));
+          if(leftShift > slack)
+            a.newEst = std::max(a.newEst, *t2 - std::floor(slack / a.quantity));
+        }
+        if(isFinite(a.let)) {
+          double rightShift = a.quantity * std::min(length, std::max(0.0, a.duration - std::max(0.0, a.let - *t2)));
+          if(rightShift > slack)
+            a.newLet = std::min(a.newLet, *t1 + std::floor(slack / a.quantity));
+        }
+      }
+    }
+  }
+
+  for(std::vector<ActivityBounds>::const_iterator it = activities.begin(); it != activities.end(); ++it) {
+    if(it->infeasible || it->newEst > it->est || it->newLet < it->let) {
+      debugMsg("EnergeticTimetableProfile:filter",
+               "Restricting " << it->bounds->toString() << " to [" << it->newEst << " " << it->newLet << "]" <<
+               (it->infeasible ? ", infeasible" : ""));
+      it->bounds->restrict(it->newEst, it->newLet, it->infeasible);
+      scheduleExecution(it->bounds);
+    }
+  }
+}
+
+}
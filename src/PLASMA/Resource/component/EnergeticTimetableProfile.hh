@@ -0,0 +1,138 @@
+#ifndef H_EnergeticTimetableProfile
+#define H_EnergeticTimetableProfile
+
+#include "ResourceDefs.hh"
+#include "TimetableProfile.hh"
+#include "Constraint.hh"
+
+#include <map>
+#include <vector>
+
+/**
+ * @file EnergeticTimetableProfile.hh
+ * @brief A TimetableProfile for reusable resources that also tightens the times of the activities using it
+ * @ingroup Resource
+ *
+ * The other profiles only find flaws and violations at Instants.  This one also filters the times of the activities on the
+ * resource, the pairs of a consuming and a producing Transaction that share a quantity variable, as Reusable, CBReusable and
+ * Unary resources create them.  Each time it is recomputed it applies:
+ * - Timetable reasoning: an activity can't start (end) where its minimum duration would overlap a stretch that the compulsory
+ *   parts of the others, the times every feasible placement of them covers, leave too little capacity for it.
+ * - Energetic reasoning: over the intervals between earliest starts and latest ends, the energy the activities must spend in an
+ *   interval can't exceed what the resource has, and an activity is pushed out of an interval that can't hold the part it
+ *   would spend there if it started as early (ended as late) as it can.  This subsumes the detection and adjustments of
+ *   edge-finding.
+ *
+ * The bounds it infers are applied by a ResourceTimeBounds constraint on each activity, so they go through the constraint
+ * engine like any other propagation, and are undone when the activities they were inferred from are relaxed.
+ *
+ * Select it for a resource with the profile name "EnergeticTimetableProfile".  It assumes the resource's capacity and limits
+ * don't change once it has filtered with them.
+ */
+
+namespace EUROPA {
+
+class EnergeticTimetableProfile;
+class ResourceTimeBounds;
+typedef Id<ResourceTimeBounds> ResourceTimeBoundsId;
+
+/**
+ * @class ResourceTimeBounds
+ * @brief Restricts the start and end of an activity on an EnergeticTimetableProfile to the bounds the profile inferred.
+ * It is executed only when the profile schedules it.
+ */
+class ResourceTimeBounds : public Constraint {
+ public:
+  ResourceTimeBounds(const ConstraintEngineId constraintEngine,
+                     const std::vector<ConstrainedVariableId>& scope,
+                     EnergeticTimetableProfile* profile);
+
+  static const std::string& CONSTRAINT_NAME() {
+    static const std::string sl_const("resourceTimeBounds");
+    return sl_const;
+  }
+  static const std::string& PROPAGATOR_NAME() {
+    static const std::string sl_const("Resource");
+    return sl_const;
+  }
+  static const int START_VAR = 0;
+  static const int END_VAR = 1;
+  static const int QTY_VAR = 2;
+
+  /**
+   * @brief Records bounds to restrict to when next executed.  Bounds only ever tighten until the variables are relaxed.
+   * @param earliestStart The earliest the activity can start.
+   * @param latestEnd The latest the activity can end.
+   * @param infeasible True if the activity can't be placed at all.
+   */
+  void restrict(const edouble earliestStart, const edouble latestEnd, const bool infeasible);
+
+  /**
+   * @brief Any of the profile's activities may have been restricted from the times of this one.
+   */
+  virtual const std::vector<ConstrainedVariableId>& getModifiedVariables(const ConstrainedVariableId variable) const;
+  virtual const std::vector<ConstrainedVariableId>& getModifiedVariables() const;
+
+ private:
+  void handleExecute();
+  bool canIgnore(const ConstrainedVariableId variable,
+                 unsigned int argIndex,
+                 const DomainListener::ChangeType& changeType);
+
+  EnergeticTimetableProfile* m_profile;
+  edouble m_earliestStart;
+  edouble m_latestEnd;
+  bool m_infeasible;
+};
+
+class EnergeticTimetableProfile : public TimetableProfile {
+ public:
+  EnergeticTimetableProfile(const PlanDatabaseId db, const FVDetectorId flawDetector);
+  virtual ~EnergeticTimetableProfile();
+
+  /**
+   * @brief Filtering schedules constraints on the propagator, so this profile is always recomputed in turn.
+   */
+  bool canRecomputeConcurrently() const {return false;}
+
+  /**
+   * @brief Gets the start and end variables of every activity on this profile.
+   */
+  const std::vector<ConstrainedVariableId>& getActivityTimes() const {return m_activityTimes;}
+
+ protected:
+  void handleTransactionAdded(const TransactionId e);
+  void handleTransactionRemoved(const TransactionId e);
+  void postHandleRecompute(const eint& endTime, const std::pair<edouble,edouble>& endDiff);
+
+ private:
+  /**
+   * @brief The Transactions sharing a quantity variable, and the constraint on them once both are on the profile.
+   */
+  struct Activity {
+    Activity() : start(), end(), bounds() {}
+    TransactionId start;
+    TransactionId end;
+    ResourceTimeBoundsId bounds;
+  };
+
+  /**
+   * @brief Infers bounds for the activities' times and schedules the constraints of the ones that tighten.
+   */
+  void filter();
+
+  /**
+   * @brief The most the activities can use at once: the highest capacity less the lowest limit.
+   */
+  edouble getAvailability() const;
+
+  void updateActivityTimes();
+
+  std::map<ConstrainedVariableId, Activity> m_activities; /**< Keyed by quantity variable */
+  unsigned int m_completeActivities; /**< The number of activities with both Transactions on the profile */
+  std::vector<ConstrainedVariableId> m_activityTimes;
+};
+
+}
+
+#endif
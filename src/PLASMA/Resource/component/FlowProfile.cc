@@ -28,7 +28,15 @@
 #include "Utils.hh"
 #include "Variable.hh"
 
+#include <algorithm>
+
 namespace EUROPA {
+namespace {
+// orders by instant, then transaction, as the overlapping transactions are collected
+bool earlierCandidate(const std::pair<eint, TransactionId>& a, const std::pair<eint, TransactionId>& b) {
+  return a.first < b.first || (a.first == b.first && a.second < b.second);
+}
+}
     //-------------------------------
 
 FlowProfile::FlowProfile( const PlanDatabaseId db, const FVDetectorId flawDetector):
@@ -45,7 +53,9 @@ FlowProfile::FlowProfile( const PlanDatabaseId db, const FVDetectorId flawDetect
     m_orderings(),
     m_orderedAt(),
     m_lowerLevelContribution(),
-    m_upperLevelContribution()
+    m_upperLevelContribution(),
+    m_overlapping(),
+    m_candidates()
 {
   m_recomputeInterval = (new ProfileIterator(getId()))->getId();
 
@@ -83,73 +93,50 @@ FlowProfile::FlowProfile( const PlanDatabaseId db, const FVDetectorId flawDetect
 bool FlowProfile::getEarliestLowerLevelInstant(const TransactionId t, InstantId& i) {
   check_error( t.isValid());
 
-  if(t->isConsumer()) {
+  if(t->isConsumer())
     i = getInstant(t->time()->lastDomain().getLowerBound());
-    return true;
-  }
-  else {
-    std::map<eint, InstantId>::const_iterator end = 
-        m_instants.upper_bound(t->time()->lastDomain().getUpperBound());
-    for(std::map<eint, InstantId>::const_iterator start = 
-            m_instants.lower_bound(t->time()->lastDomain().getLowerBound());
-        start != end; ++start) {
-      InstantId inst = start->second;
-      for(std::set<TransactionId>::const_iterator it = 
-              inst->getTransactions().begin();
-          it != inst->getTransactions().end(); ++it) {
-        if((*it)->isConsumer()) {
-          switch(getOrdering(t, *it)) {
-            case BEFORE_OR_AT:
-            case STRICTLY_AT:
-              i = inst;
-              return true;
-            case AFTER_OR_AT:
-            case NOT_ORDERED:
-            case UNKNOWN:
-              break;
-          }
-        }
-      }
-    }
-    i = getInstant(t->time()->lastDomain().getUpperBound());
-    return true;
-  }
+  else
+    i = getEarliestOrderedInstant(t, true);
+  return true;
 }
 
 bool FlowProfile::getEarliestUpperLevelInstant(const TransactionId t, InstantId& i) {
   check_error( t.isValid());
 
-  if(!t->isConsumer()) {
+  if(!t->isConsumer())
     i = getInstant(t->time()->lastDomain().getLowerBound());
-    return true;
+  else
+    i = getEarliestOrderedInstant(t, false);
+  return true;
+}
+
+InstantId FlowProfile::getEarliestOrderedInstant(const TransactionId t, const bool consumers) {
+  eint lb = static_cast<eint>(t->time()->lastDomain().getLowerBound());
+  eint ub = static_cast<eint>(t->time()->lastDomain().getUpperBound());
+
+  m_overlapping.clear();
+  getOverlappingTransactions(lb, ub, m_overlapping);
+
+  // the first instant in the time of t that another transaction overlaps is at the later of their lower bounds
+  m_candidates.clear();
+  for(std::vector<TransactionId>::const_iterator it = m_overlapping.begin(); it != m_overlapping.end(); ++it) {
+    if((*it)->isConsumer() == consumers)
+      m_candidates.push_back(std::make_pair(std::max(lb, static_cast<eint>((*it)->time()->lastDomain().getLowerBound())), *it));
   }
-  else {
-    std::map<eint, InstantId>::const_iterator end = 
-        m_instants.upper_bound(t->time()->lastDomain().getUpperBound());
-    for(std::map<eint, InstantId>::const_iterator start = 
-            m_instants.lower_bound(t->time()->lastDomain().getLowerBound());
-        start != end; ++start) {
-      InstantId inst = start->second;
-      for(std::set<TransactionId>::const_iterator it = 
-              inst->getTransactions().begin();
-          it != inst->getTransactions().end(); ++it) {
-        if(!(*it)->isConsumer()) {
-          switch(getOrdering(t, *it)) {
-            case BEFORE_OR_AT:
-            case STRICTLY_AT:
-              i = inst;
-              return true;
-            case AFTER_OR_AT:
-            case NOT_ORDERED:
-            case UNKNOWN:
-              break;
-          }
-        }
-      }
+  std::sort(m_candidates.begin(), m_candidates.end(), earlierCandidate);
+
+  for(std::vector<std::pair<eint, TransactionId> >::const_iterator it = m_candidates.begin(); it != m_candidates.end(); ++it) {
+    switch(getOrdering(t, it->second)) {
+      case BEFORE_OR_AT:
+      case STRICTLY_AT:
+        return getInstant(it->first);
+      case AFTER_OR_AT:
+      case NOT_ORDERED:
+      case UNKNOWN:
+        break;
     }
-    i = getInstant(t->time()->lastDomain().getUpperBound());
-    return true;
   }
+  return getInstant(ub);
 }
 
 
@@ -189,6 +176,9 @@ void FlowProfile::initRecompute(InstantId inst) {
     	if( m_recalculateUpperLevel )
     		m_upperLevelGraph->reset();
 
+    	m_lowerLevelGraph->reserve( m_transactions.size() );
+    	m_upperLevelGraph->reserve( m_transactions.size() );
+
     	// initial level
     	m_lowerClosedLevel = getInitCapacityLb();
     	m_upperClosedLevel = getInitCapacityUb();
@@ -92,22 +92,35 @@ private:
    */
   bool getEarliestUpperLevelInstant( const TransactionId t, InstantId& i );
   /**
-   * @brief Deletes pre-existing FlowProfileGraphs for the lower and upper level and allocates new ones.
+   * @brief Retrieves the earliest instant in the time of t at which a consumer (or producer)
+   * overlaps t and is ordered at or after it. Returns the instant for the upper bound of t
+   * if there is no such transaction.
+   */
+  InstantId getEarliestOrderedInstant( const TransactionId t, const bool consumers );
+  /**
+   * @brief Makes the graphs for the lower and upper level empty FlowGraphTypes, with room for the transactions
+   * on the profile. Graphs that already are FlowGraphTypes are cleared, keeping their storage, others are deleted
+   * and new ones allocated.
    */
   template<typename FlowGraphType>
   void initializeGraphs() {
-    if(m_lowerLevelGraph != NULL)
+    if(dynamic_cast<FlowGraphType*>(m_lowerLevelGraph) != NULL)
+      m_lowerLevelGraph->clear();
+    else {
       delete m_lowerLevelGraph;
-    m_lowerLevelGraph = new FlowGraphType(m_dummySourceTransaction,
-                                          m_dummySinkTransaction, true);
-
-    if(m_upperLevelGraph != NULL)
+      m_lowerLevelGraph = new FlowGraphType(m_dummySourceTransaction,
+                                            m_dummySinkTransaction, true);
+    }
+    if(dynamic_cast<FlowGraphType*>(m_upperLevelGraph) != NULL)
+      m_upperLevelGraph->clear();
+    else {
       delete m_upperLevelGraph;
-    m_upperLevelGraph = new FlowGraphType(m_dummySourceTransaction,
-                                          m_dummySinkTransaction, false);
+      m_upperLevelGraph = new FlowGraphType(m_dummySourceTransaction,
+                                            m_dummySinkTransaction, false);
+    }
+    m_lowerLevelGraph->reserve(m_transactions.size());
+    m_upperLevelGraph->reserve(m_transactions.size());
   }
-
-
  protected:
   virtual void postHandleRecompute(const eint& endTime, const std::pair<edouble,edouble>& endDiff);
   /**
@@ -180,6 +193,10 @@ private:
 
   TransactionId2InstantId m_lowerLevelContribution;
   TransactionId2InstantId m_upperLevelContribution;
+
+  // scratch for getEarliestOrderedInstant, kept to reuse its storage
+  std::vector<TransactionId> m_overlapping;
+  std::vector<std::pair<eint, TransactionId> > m_candidates;
 };
 }
 
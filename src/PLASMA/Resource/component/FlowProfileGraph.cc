@@ -18,7 +18,7 @@ FlowProfileGraph::FlowProfileGraph(const TransactionId ,
 FlowProfileGraphImpl::FlowProfileGraphImpl(const TransactionId source, 
                                            const TransactionId sink, bool lowerLevel)
     : FlowProfileGraph(source, sink, lowerLevel), m_maxflow(NULL), m_graph( 0 ),
-      m_source( 0 ), m_sink( 0 ) {
+      m_source( 0 ), m_sink( 0 ), m_visit( 0 ) {
   m_graph = new Graph();
   m_source = m_graph->createNode( source );
   m_sink = m_graph->createNode( sink );
@@ -84,7 +84,7 @@ bool FlowProfileGraphImpl::isEnabled(  const TransactionId transaction ) const
   return 0 == node ? false : node->isEnabled();
 }
 
-void FlowProfileGraphImpl::enableTransaction( const TransactionId t, const InstantId i, TransactionId2InstantId contributions )
+void FlowProfileGraphImpl::enableTransaction( const TransactionId t, const InstantId i, TransactionId2InstantId& contributions )
 {
   debugMsg("FlowProfileGraph:enableTransaction","Transaction ("
            << t->getId() << ") "
@@ -157,6 +157,28 @@ void FlowProfileGraphImpl::reset()
   m_source->setEnabled();
 }
 
+void FlowProfileGraphImpl::clear()
+{
+  const TransactionId source = m_source->getIdentity();
+  const TransactionId sink = m_sink->getIdentity();
+
+  m_recalculate = false;
+
+  m_graph->clear();
+
+  m_source = m_graph->createNode( source );
+  m_sink = m_graph->createNode( sink );
+
+  m_maxflow->setTerminals( m_source, m_sink );
+}
+
+void FlowProfileGraphImpl::reserve( const unsigned int transactions )
+{
+  // a node for each transaction, with an edge to the source or the sink and its reverse,
+  // and room for as many edges again for orderings between them
+  m_graph->reserve( transactions + 2, 4 * transactions );
+}
+
 
 edouble FlowProfileGraphImpl::getResidualFromSource()
 {
@@ -222,11 +244,12 @@ void FlowProfileGraphImpl::pushFlow( const TransactionId id )
 
 void FlowProfileGraphImpl::restoreFlow()
 {
-  m_maxflow->execute( false );
+  // a flow for a graph that has changed since it was calculated can't be restored, only calculated again
+  m_maxflow->execute( m_recalculate );
 }
 
 
-edouble FlowProfileGraphImpl::disableReachableResidualGraph( TransactionId2InstantId contributions, const InstantId instant )
+edouble FlowProfileGraphImpl::disableReachableResidualGraph( TransactionId2InstantId& contributions, const InstantId instant )
 {
   debugMsg("FlowProfileGraph:disableReachableResidualGraph","Lower level: "
            << std::boolalpha << m_lowerLevel );
@@ -240,19 +263,18 @@ edouble FlowProfileGraphImpl::disableReachableResidualGraph( TransactionId2Insta
 
     m_maxflow->execute();
 
-    Node2Bool visited;
+    ++m_visit;
 
-    visited[ m_source ] = true;
+    m_source->setVisit( m_visit );
 
-    visitNeighbors( m_source, residual, visited, contributions, instant );
+    visitNeighbors( m_source, residual, contributions, instant );
   }
 
   return residual;
 }
 
 void FlowProfileGraphImpl::visitNeighbors(const Node* node, edouble& residual,
-                                      Node2Bool& visited, 
-                                      TransactionId2InstantId contributions,
+                                      TransactionId2InstantId& contributions,
                                       const InstantId instant) {
   EdgeOutIterator ite( *node );
 
@@ -262,11 +284,11 @@ void FlowProfileGraphImpl::visitNeighbors(const Node* node, edouble& residual,
 
     Node* target = edge->getTarget();
 
-    if( false == visited[ target ] )
+    if( m_visit != target->getVisit() )
     {
       if( 0 != m_maxflow->getResidual( edge ) )
       {
-        visited[ target ] = true;
+        target->setVisit( m_visit );
 
         if( target != m_source && target != m_sink )
         {
@@ -307,7 +329,7 @@ void FlowProfileGraphImpl::visitNeighbors(const Node* node, edouble& residual,
             residual += sign * t->quantity()->lastDomain().getLowerBound();
           }
 
-          visitNeighbors( target, residual, visited, contributions, instant );
+          visitNeighbors( target, residual, contributions, instant );
         }
       }
     }
@@ -50,7 +50,7 @@ class FlowProfileGraph
    *   ---------------------------------------------------------------------------------------------------------
    * \endverbatim
    */
-  virtual void enableTransaction( const TransactionId transaction, const InstantId inst, TransactionId2InstantId contributions ) = 0;
+  virtual void enableTransaction( const TransactionId transaction, const InstantId inst, TransactionId2InstantId& contributions ) = 0;
   /**
    * @brief Returns true if \a transaction is enabled in the invoking
    * instance
@@ -101,7 +101,7 @@ class FlowProfileGraph
    * contributions, which maps a TransactionId to a InstantId is maps every transaction associated with a disabled
    * node to \a instant.
    */
-  virtual edouble disableReachableResidualGraph( TransactionId2InstantId contributions, const InstantId instant  ) = 0;
+  virtual edouble disableReachableResidualGraph( TransactionId2InstantId& contributions, const InstantId instant  ) = 0;
   /**
    * @brief Returns true if the invoking instance calculates the lower level, otherwise returns false which indicates
    * the invoking instance is calculating the upper level.
@@ -119,6 +119,18 @@ class FlowProfileGraph
    *
    */
   virtual void reset() = 0;
+
+  /**
+   * @brief Removes every transaction from the invoking instance, leaving it as it was constructed.
+   *
+   * Unlike deleting the instance and constructing another, keeps the storage it has allocated.
+   */
+  virtual void clear() = 0;
+
+  /**
+   * @brief Reserves room in the invoking instance for \a transactions transactions.
+   */
+  virtual void reserve( const unsigned int transactions ) = 0;
   /**
    * @brief Restore flow invokes the maximum flow algorithm without resetting the existing distances
    * and existing flows on the nodes.
@@ -148,7 +160,7 @@ private:
   void enableAt( const TransactionId t1, const TransactionId t2 );
   void enableAtOrBefore(const TransactionId t1, const TransactionId t2);
   void enableTransaction(const TransactionId transaction, const InstantId inst,
-                         TransactionId2InstantId contributions);
+                         TransactionId2InstantId& contributions);
   bool isEnabled(const TransactionId transaction) const;
   void disable(const TransactionId transaction);
   void pushFlow( const TransactionId transaction );
@@ -158,15 +170,17 @@ private:
     return getResidualFromSource();
   }
 
-  edouble disableReachableResidualGraph(TransactionId2InstantId contributions, const InstantId instant);
+  edouble disableReachableResidualGraph(TransactionId2InstantId& contributions, const InstantId instant);
   void removeTransaction(const TransactionId id);
   void reset();
+  void clear();
+  void reserve(const unsigned int transactions);
   void restoreFlow();
  private:
   /**
    * @brief Helper function for disableReachableResidualGraph
    */
-  void visitNeighbors( const Node* node, edouble& residual, Node2Bool& visited, TransactionId2InstantId contributions, const InstantId instant  );
+  void visitNeighbors( const Node* node, edouble& residual, TransactionId2InstantId& contributions, const InstantId instant  );
 
   MaximumFlowAlgorithm* m_maxflow;
   /*!
@@ -181,7 +195,10 @@ private:
    * @brief Sink for the maximum flow problem
    */
   Node* m_sink;
-
+  /*!
+   * @brief Marks the nodes visited by the latest disableReachableResidualGraph (see Node::getVisit)
+   */
+  int m_visit;
 };
 
 }
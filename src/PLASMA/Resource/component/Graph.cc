@@ -19,28 +19,65 @@
 
 namespace EUROPA
 {
-Graph::Graph() : m_Nodes() {}
+namespace
+{
+  bool lessIdentity( const std::pair< NodeIdentity, Node* >& entry, const NodeIdentity& identity )
+  {
+    return entry.first < identity;
+  }
+}
+
+Graph::Graph() : m_Nodes(), m_NodePool(), m_FreeNodes(), m_EdgePool(), m_FreeEdges() {}
 
     Graph::~Graph()
     {
       {
-	NodeIdentity2Node::iterator ite = m_Nodes.begin();
-	NodeIdentity2Node::iterator end = m_Nodes.end();
+	NodeList::iterator ite = m_NodePool.begin();
+	NodeList::iterator end = m_NodePool.end();
 
 	for( ; ite != end; ++ite )
 	  {
-	    delete (*ite).second;
+	    delete (*ite);
 	  }
       }
+
+      {
+	EdgeList::iterator ite = m_EdgePool.begin();
+	EdgeList::iterator end = m_EdgePool.end();
+
+	for( ; ite != end; ++ite )
+	  {
+	    delete (*ite);
+	  }
+      }
+    }
+
+    void Graph::reserve( unsigned int nodes, unsigned int edges )
+    {
+      m_Nodes.reserve( nodes );
+      m_NodePool.reserve( nodes );
+      m_FreeNodes.reserve( nodes );
+      m_EdgePool.reserve( edges );
+      m_FreeEdges.reserve( edges );
+    }
+
+    NodeIdentity2Node::iterator Graph::findNode( const NodeIdentity& identity )
+    {
+      return std::lower_bound( m_Nodes.begin(), m_Nodes.end(), identity, lessIdentity );
+    }
+
+    NodeIdentity2Node::const_iterator Graph::findNode( const NodeIdentity& identity ) const
+    {
+      return std::lower_bound( m_Nodes.begin(), m_Nodes.end(), identity, lessIdentity );
     }
 
     Node* Graph::getNode( const NodeIdentity& identity ) const
     {
       Node* node = 0;
 
-      NodeIdentity2Node::const_iterator ite = m_Nodes.find( identity );
+      NodeIdentity2Node::const_iterator ite = findNode( identity );
 
-      if( m_Nodes.end() != ite )
+      if( m_Nodes.end() != ite && (*ite).first == identity )
 	node = (*ite).second;
 
       return node;
@@ -48,17 +85,35 @@ Graph::Graph() : m_Nodes() {}
 
     Node* Graph::createNode( const NodeIdentity& identity, bool enabled )
     {
-      Node* node = getNode( identity );
+      NodeIdentity2Node::iterator ite = findNode( identity );
 
-      if( 0 == node )
+      Node* node = 0;
+
+      if( m_Nodes.end() != ite && (*ite).first == identity )
 	{
+	  node = (*ite).second;
+	}
+      else
+	{
+	  if( m_FreeNodes.empty() )
+	    {
+	      node = new Node( identity, m_NodePool.size() );
+
+	      m_NodePool.push_back( node );
+	    }
+	  else
+	    {
+	      node = m_FreeNodes.back();
 
-	  node = new Node( identity );
+	      m_FreeNodes.pop_back();
+
+	      node->reset( identity );
+	    }
 
 	  graphDebug("Created node "
 		     << *node << " initially " << (enabled ? "enabled" : "disabled"));
 
-	  m_Nodes[ identity ] = node;
+	  m_Nodes.insert( ite, std::make_pair( identity, node ) );
 	}
 
       if( enabled ) {
@@ -73,9 +128,9 @@ Graph::Graph() : m_Nodes() {}
 
     void Graph::removeNode( const NodeIdentity& identity )
     {
-      NodeIdentity2Node::iterator ite = m_Nodes.find( identity );
+      NodeIdentity2Node::iterator ite = findNode( identity );
 
-      if( m_Nodes.end() != ite )
+      if( m_Nodes.end() != ite && (*ite).first == identity )
 	{
 	  Node* node = (*ite).second;
 
@@ -84,10 +139,85 @@ Graph::Graph() : m_Nodes() {}
 	  graphDebug("Removed node "
 		     << *node );
 
-	  delete node;
+	  {
+	    EdgeList::const_iterator eIte = node->getOutEdges().begin();
+	    EdgeList::const_iterator eEnd = node->getOutEdges().end();
+
+	    for( ; eIte != eEnd; ++eIte )
+	      {
+		Edge* edge = (*eIte);
+
+		edge->getTarget()->removeInEdge( edge );
+
+		releaseEdge( edge );
+	      }
+	  }
+
+	  {
+	    EdgeList::const_iterator eIte = node->getInEdges().begin();
+	    EdgeList::const_iterator eEnd = node->getInEdges().end();
+
+	    for( ; eIte != eEnd; ++eIte )
+	      {
+		Edge* edge = (*eIte);
+
+		edge->getSource()->removeOutEdge( edge );
+
+		releaseEdge( edge );
+	      }
+	  }
+
+	  releaseNode( node );
 	}
     }
 
+    void Graph::releaseNode( Node* node )
+    {
+      node->reset( NodeIdentity::noId() );
+
+      m_FreeNodes.push_back( node );
+    }
+
+    void Graph::releaseEdge( Edge* edge )
+    {
+      if( 0 != edge->m_Reverse )
+	edge->m_Reverse->m_Reverse = 0;
+
+      edge->m_Reverse = 0;
+
+      m_FreeEdges.push_back( edge );
+    }
+
+    void Graph::clear()
+    {
+      graphDebug("Clearing whole graph.")
+
+      NodeIdentity2Node::iterator ite = m_Nodes.begin();
+      NodeIdentity2Node::iterator end = m_Nodes.end();
+
+      for( ; ite != end; ++ite )
+	{
+	  Node* node = (*ite).second;
+
+	  // every edge is the out-edge of exactly one node
+	  EdgeList::const_iterator eIte = node->getOutEdges().begin();
+	  EdgeList::const_iterator eEnd = node->getOutEdges().end();
+
+	  for( ; eIte != eEnd; ++eIte )
+	    {
+	      (*eIte)->m_Reverse = 0;
+
+	      m_FreeEdges.push_back( *eIte );
+	    }
+	}
+
+      for( ite = m_Nodes.begin(); ite != end; ++ite )
+	{
+	  releaseNode( (*ite).second );
+	}
+
+      m_Nodes.clear();
+    }
 
     void Graph::createEdge( const NodeIdentity& source, const NodeIdentity& target, edouble capacity, bool enabled )
     {
@@ -109,12 +239,35 @@ Graph::Graph() : m_Nodes() {}
 
       if( 0 == edge )
 	{
-	  edge = new Edge( source, target, capacity, enabled );
+	  if( m_FreeEdges.empty() )
+	    {
+	      edge = new Edge( source, target, capacity, enabled, m_EdgePool.size() );
+
+	      m_EdgePool.push_back( edge );
+	    }
+	  else
+	    {
+	      edge = m_FreeEdges.back();
+
+	      m_FreeEdges.pop_back();
+
+	      edge->reset( source, target, capacity, enabled );
+	    }
+
+	  source->addOutEdge( edge );
+	  target->addInEdge( edge );
+
+	  Edge* reverse = getEdge( target, source );
+
+	  if( 0 != reverse )
+	    {
+	      edge->m_Reverse = reverse;
+	      reverse->m_Reverse = edge;
+	    }
 
 	  graphDebug("Created edge "
 		     << *edge << " with capacity "
 		     << capacity );
-
 	}
       else
 	{
@@ -134,6 +287,7 @@ Graph::Graph() : m_Nodes() {}
     void Graph::setDisabled()
     {
       graphDebug("Disabling whole graph.")
+
       NodeIdentity2Node::iterator ite = m_Nodes.begin();
       NodeIdentity2Node::iterator end = m_Nodes.end();
 
@@ -143,15 +297,14 @@ Graph::Graph() : m_Nodes() {}
 
 	  node->setDisabled();
 
-	  EdgeOutIterator outIte( *node );
+	  // all the out-edges, as ones to nodes disabled before this one would be skipped by an
+	  // EdgeOutIterator; we do not have todo the in-edges because we go over all nodes
+	  EdgeList::const_iterator eIte = node->getOutEdges().begin();
+	  EdgeList::const_iterator eEnd = node->getOutEdges().end();
 
-	  for( ; outIte.ok(); ++outIte )
+	  for( ; eIte != eEnd; ++eIte )
 	    {
-	      Edge* edge = (*outIte);
-
-	      edge->setDisabled();
-	      // we do not have todo the in-edges because we go
-	      // over all nodes
+	      (*eIte)->setDisabled();
 	    }
 	}
     }
@@ -15,6 +15,15 @@
 
 namespace EUROPA
 {
+    /**
+     * @brief A directed graph owning its nodes and edges.
+     *
+     * Nodes and edges are allocated from pools the graph keeps for its lifetime: removing them, or
+     * clearing the graph, returns them to the pool, and creating them takes them from it before
+     * allocating. Each has a dense index, so algorithms on the graph can keep their state in vectors
+     * indexed by getIndex() rather than in maps. A graph that is cleared and rebuilt to no more than
+     * its earlier size does not allocate.
+     */
     class Graph
     {
       friend class NodeIterator;
@@ -31,12 +40,46 @@ namespace EUROPA
        * @brief Disables all the nodes and edges of the invoking graph
        */
       void setDisabled();
+      /*!
+       * @brief Removes all the nodes and edges of the invoking graph, keeping them for reuse
+       */
+      void clear();
+      /*!
+       * @brief Reserves room for \a nodes nodes and \a edges edges
+       */
+      void reserve( unsigned int nodes, unsigned int edges );
+      /*!
+       * @brief Every node index is less than this
+       */
+      inline unsigned int getNodeCapacity() const;
+      /*!
+       * @brief Every edge index is less than this
+       */
+      inline unsigned int getEdgeCapacity() const;
     private:
       Edge* createEdge( Node* source, Node* target, edouble capacity, bool enabled = true );
+      NodeIdentity2Node::iterator findNode( const NodeIdentity& identity );
+      NodeIdentity2Node::const_iterator findNode( const NodeIdentity& identity ) const;
+      void releaseNode( Node* node );
+      void releaseEdge( Edge* edge );
 
       NodeIdentity2Node m_Nodes;
+      NodeList m_NodePool; /**< Every node allocated, by index */
+      NodeList m_FreeNodes;
+      EdgeList m_EdgePool; /**< Every edge allocated, by index */
+      EdgeList m_FreeEdges;
     };
 
+    unsigned int Graph::getNodeCapacity() const
+    {
+      return m_NodePool.size();
+    }
+
+    unsigned int Graph::getEdgeCapacity() const
+    {
+      return m_EdgePool.size();
+    }
+
     const NodeIdentity2Node& Graph::getNodes() const
     {
       return m_Nodes;
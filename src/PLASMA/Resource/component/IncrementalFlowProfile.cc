@@ -67,8 +67,9 @@ namespace EUROPA
 
       initializeGraphs<FlowProfileGraphImpl>();
 
-      std::set<TransactionId> enabledLower;
-      std::set<TransactionId> enabledUpper;
+      // transactions are visited in order, so these stay sorted as the sets they replace did
+      m_enabledLower.clear();
+      m_enabledUpper.clear();
 
       // we got to put all the transactions which are pending at this instant but are not yet contributing
       // to the levels back into the maximum flow!
@@ -97,7 +98,7 @@ namespace EUROPA
                 !isContributingToLowerLevel )
               {
                 m_lowerLevelGraph->enableTransaction( transaction, inst, m_lowerLevelContribution );
-                enabledLower.insert( transaction );
+                m_enabledLower.push_back( transaction );
               }
 
             if( ( isContributingToUpperLevel
@@ -107,20 +108,20 @@ namespace EUROPA
                 !isContributingToUpperLevel )
               {
                 m_upperLevelGraph->enableTransaction( transaction, inst, m_upperLevelContribution );
-                enabledUpper.insert( transaction );
+                m_enabledUpper.push_back( transaction );
               }
           }
       }
 
       {
-        std::set<TransactionId>::const_iterator iter = enabledLower.begin();
-        std::set<TransactionId>::const_iterator end = enabledLower.end();
+        std::vector<TransactionId>::const_iterator iter = m_enabledLower.begin();
+        std::vector<TransactionId>::const_iterator end = m_enabledLower.end();
 
         for( ; iter != end; ++iter )
           {
             const TransactionId transaction1 = (*iter);
 
-            std::set<TransactionId>::const_iterator iter2 = iter;
+            std::vector<TransactionId>::const_iterator iter2 = iter;
 
             for( ; iter2 != end; ++iter2 )
               {
@@ -155,14 +156,14 @@ namespace EUROPA
       }
 
       {
-        std::set<TransactionId>::const_iterator iter = enabledUpper.begin();
-        std::set<TransactionId>::const_iterator end = enabledUpper.end();
+        std::vector<TransactionId>::const_iterator iter = m_enabledUpper.begin();
+        std::vector<TransactionId>::const_iterator end = m_enabledUpper.end();
 
         for( ; iter != end; ++iter )
           {
             const TransactionId transaction1 = (*iter);
 
-            std::set<TransactionId>::const_iterator iter2 = iter;
+            std::vector<TransactionId>::const_iterator iter2 = iter;
 
             for( ; iter2 != end; ++iter2 )
               {
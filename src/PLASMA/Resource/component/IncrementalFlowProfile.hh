@@ -26,6 +26,9 @@ namespace EUROPA
     private:
       void recomputeLevels( InstantId inst, edouble lowerLevel, edouble upperLevel );
 
+      // the transactions initRecompute enabled in either graph, kept to reuse their storage
+      std::vector<TransactionId> m_enabledLower;
+      std::vector<TransactionId> m_enabledUpper;
 
     };
 }
@@ -17,7 +17,6 @@ namespace EUROPA
 {
 MaximumFlowAlgorithm::MaximumFlowAlgorithm( Graph* g, Node* source, Node* sink  ):
     m_CurrentOutEdgeOnNode(),
-    m_EndOutEdgeOnNode(),
     m_ExcessOnNode(),
     m_DistanceOnNode(),
     m_OnEdge(),
@@ -25,7 +24,7 @@ MaximumFlowAlgorithm::MaximumFlowAlgorithm( Graph* g, Node* source, Node* sink
     m_Graph( g ),
     m_Source( source ),
     m_Sink( sink ),
-    m_NodeListIterator( m_Nodes.end() )
+    m_NodeListPosition( 0 )
 {
   checkError( g != 0, "Null not allowed as input for g" );
   checkError( source != 0, "Null not allowed as input for source" );
@@ -38,38 +37,19 @@ MaximumFlowAlgorithm::MaximumFlowAlgorithm( Graph* g, Node* source, Node* sink
              << *sink );
 }
 
-void MaximumFlowAlgorithm::print( std::ostream& ) const
+void MaximumFlowAlgorithm::setTerminals( Node* source, Node* sink )
 {
+  checkError( m_Graph->getNode( source->getIdentity() ) == source, "Source is not part of the graph" );
+  checkError( m_Graph->getNode( sink->getIdentity() ) == sink, "Sink is not part of the graph");
 
+  m_Source = source;
+  m_Sink = sink;
+  m_Nodes.clear();
+  m_NodeListPosition = 0;
 }
 
-eint MaximumFlowAlgorithm::distanceOnNode(Node* n) const {
-  Node2Long::const_iterator it = m_DistanceOnNode.find(n);
-  checkError(it != m_DistanceOnNode.end(), "Failed to find distance for " << *n);
-  return it->second;
-}
-
-//edouble MaximumFlowAlgorithm::flow(Edge* e) const {
-//}
-
-edouble MaximumFlowAlgorithm::getExcess(Node* n) const {
-  Node2Double::const_iterator it = m_ExcessOnNode.find(n);
-  checkError(it != m_ExcessOnNode.end(), "Failed to find excess for " << *n);
-  return it->second;
-}
-
-EdgeList::const_iterator MaximumFlowAlgorithm::currentOutEdgeOnNode(Node* n) const {
-  Node2EdgeListIteratorMap::const_iterator it = m_CurrentOutEdgeOnNode.find(n);
-  checkError(it != m_CurrentOutEdgeOnNode.end(), 
-             "Failed to find a current out-edge iterator for " << *n);
-  return it->second;
-}
-
-EdgeList::const_iterator MaximumFlowAlgorithm::endOutEdgeOnNode(Node* n) const {
-  Node2EdgeListIteratorMap::const_iterator it = m_EndOutEdgeOnNode.find(n);
-  checkError(it != m_EndOutEdgeOnNode.end(), 
-             "Failed to find an end out-edge iterator for " << *n);
-  return it->second;
+void MaximumFlowAlgorithm::print( std::ostream& ) const
+{
 }
 
 }
@@ -15,7 +15,8 @@
 #include "NodeIterator.hh"
 #include "EdgeIterator.hh"
 
-#include <boost/unordered_map.hpp>
+#include <algorithm>
+#include <vector>
 
 #ifndef LONG_MAX
 // Would prefer to declare a static const variable, but that would be
@@ -26,6 +27,13 @@
 
 namespace EUROPA
 {
+/**
+ * @brief Push-relabel (relabel-to-front) maximum flow on a Graph.
+ *
+ * Distances, excesses and flows are kept in vectors indexed by Node::getIndex() and Edge::getIndex(),
+ * which keep their size between executions, so solving a graph no larger than one solved before does
+ * not allocate.
+ */
 class MaximumFlowAlgorithm
 {
 private:
@@ -36,6 +44,10 @@ private:
   Graph* getGraph() const { return m_Graph; }
   Node* getSource() const { return m_Source; }
   Node* getSink() const { return m_Sink; }
+  /**
+   * @brief Sets the source and sink, after the graph was cleared and they were created again.
+   */
+  void setTerminals( Node* source, Node* sink );
   inline void execute( bool reset = true );
   void print( std::ostream& os ) const;
   inline edouble getMaxFlow() const;
@@ -44,11 +56,8 @@ private:
   inline edouble getResidual( Edge* edge ) const;
  private:
 
-  eint distanceOnNode(Node* n) const;
-  //inline edouble flow(Edge* e) const;
-  edouble getExcess(Node* n) const;
-  EdgeList::const_iterator currentOutEdgeOnNode(Node* n) const;
-  EdgeList::const_iterator endOutEdgeOnNode(Node* n) const;
+  inline eint distanceOnNode(Node* n) const;
+  inline edouble getExcess(Node* n) const;
 
    inline void disCharge( Node* node );
    inline void initializePre( bool reset = true );
@@ -58,40 +67,32 @@ private:
    inline Node* getNextInList();
    inline void resetToFront();
 
- #ifdef _MSC_VER
-   typedef map< Node*, EdgeList::const_iterator > Node2EdgeListIteratorMap;
- #else
-   typedef boost::unordered_map< Node*, EdgeList::const_iterator, NodeHash > Node2EdgeListIteratorMap;
- #endif //_MSC_VER
-
-   Node2EdgeListIteratorMap m_CurrentOutEdgeOnNode;
-   Node2EdgeListIteratorMap m_EndOutEdgeOnNode;
+   std::vector<unsigned int> m_CurrentOutEdgeOnNode; /**< Position in the out-edges of the node */
 
-   Node2Double m_ExcessOnNode;
-   Node2Long m_DistanceOnNode;
-   Edge2DoubleMap m_OnEdge;
+   std::vector<edouble> m_ExcessOnNode;
+   std::vector<eint> m_DistanceOnNode;
+   std::vector<edouble> m_OnEdge;
 
    NodeList m_Nodes;
    Graph* m_Graph;
    Node* m_Source;
    Node* m_Sink;
 
-   NodeList::iterator m_NodeListIterator;
+   unsigned int m_NodeListPosition; /**< Position in m_Nodes, m_Nodes.size() before the first */
  };
 
  edouble MaximumFlowAlgorithm::getMaxFlow() const
  {
-   if( m_ExcessOnNode.find(  m_Sink ) == m_ExcessOnNode.end() )
+   if( m_Sink->getIndex() >= m_ExcessOnNode.size() )
      return 0.0;
 
-   return m_ExcessOnNode.find(  m_Sink )->second;
+   return m_ExcessOnNode[ m_Sink->getIndex() ];
  }
 
  edouble MaximumFlowAlgorithm::getFlow( Edge* edge  ) const
  {
-   Edge2DoubleMap::const_iterator it = m_OnEdge.find(edge);
-   checkError(it != m_OnEdge.end(), "Failed to find flow for edge " << *edge);
-   return it->second;
+   checkError(edge->getIndex() < m_OnEdge.size(), "Failed to find flow for edge " << *edge);
+   return m_OnEdge[ edge->getIndex() ];
  }
 
  edouble MaximumFlowAlgorithm::getResidual( Edge* edge ) const
@@ -99,47 +100,53 @@ private:
    return edge->getCapacity() - getFlow( edge );
  }
 
+ eint MaximumFlowAlgorithm::distanceOnNode(Node* n) const
+ {
+   checkError(n->getIndex() < m_DistanceOnNode.size(), "Failed to find distance for " << *n);
+   return m_DistanceOnNode[ n->getIndex() ];
+ }
+
+ edouble MaximumFlowAlgorithm::getExcess(Node* n) const
+ {
+   checkError(n->getIndex() < m_ExcessOnNode.size(), "Failed to find excess for " << *n);
+   return m_ExcessOnNode[ n->getIndex() ];
+ }
 
  Node* MaximumFlowAlgorithm::getNextInList()
  {
    Node* node = NULL;
 
-   if( m_NodeListIterator == m_Nodes.end() )
+   if( m_NodeListPosition == m_Nodes.size() )
    {
-     m_NodeListIterator = m_Nodes.begin();
+     m_NodeListPosition = 0;
    }
    else
    {
-     ++m_NodeListIterator;
+     ++m_NodeListPosition;
    }
 
-   NodeList::iterator end = m_Nodes.end();
-
-   while( m_NodeListIterator != end &&
-          !(*m_NodeListIterator)->isEnabled() )
+   while( m_NodeListPosition != m_Nodes.size() &&
+          !m_Nodes[ m_NodeListPosition ]->isEnabled() )
    {
-     ++m_NodeListIterator;
+     ++m_NodeListPosition;
    }
 
-   if( m_NodeListIterator != end )
-     node = *m_NodeListIterator;
+   if( m_NodeListPosition != m_Nodes.size() )
+     node = m_Nodes[ m_NodeListPosition ];
 
    return node;
  }
 
  void MaximumFlowAlgorithm::resetToFront()
  {
-   if( m_NodeListIterator != m_Nodes.end() )
+   if( m_NodeListPosition != m_Nodes.size() )
    {
-     Node* n = (*m_NodeListIterator);
-     m_Nodes.erase( m_NodeListIterator );
-     m_Nodes.push_front( n );
+     std::rotate( m_Nodes.begin(), m_Nodes.begin() + m_NodeListPosition, m_Nodes.begin() + m_NodeListPosition + 1 );
 
-     m_NodeListIterator = m_Nodes.end();
+     m_NodeListPosition = m_Nodes.size();
    }
  }
 
-
  void MaximumFlowAlgorithm::execute( bool reset )
  {
    graphDebug("Start execute, reset is " << std::boolalpha << reset );
@@ -173,15 +180,19 @@ private:
    checkError( m_Source->isEnabled(),"Source '" << *m_Source << "' is not enabled.");
    checkError( m_Sink->isEnabled(),"Sink '" << *m_Sink << "' is not enabled." );
 
-   if( reset )
+   // only grows, when the graph has allocated more nodes or edges than it had before
+   if( m_ExcessOnNode.size() < m_Graph->getNodeCapacity() )
    {
-     m_CurrentOutEdgeOnNode.clear();
-     m_EndOutEdgeOnNode.clear();
-     m_DistanceOnNode.clear();
-     m_ExcessOnNode.clear();
+     m_CurrentOutEdgeOnNode.resize( m_Graph->getNodeCapacity(), 0 );
+     m_ExcessOnNode.resize( m_Graph->getNodeCapacity(), 0.0 );
+     m_DistanceOnNode.resize( m_Graph->getNodeCapacity(), 1 );
+   }
 
-     m_OnEdge.clear();
+   if( m_OnEdge.size() < m_Graph->getEdgeCapacity() )
+     m_OnEdge.resize( m_Graph->getEdgeCapacity(), 0.0 );
 
+   if( reset )
+   {
      m_Nodes.clear();
    }
 
@@ -199,12 +210,7 @@ private:
 
      if( node->isEnabled() )
      {
-       m_CurrentOutEdgeOnNode[ node ] = node->getOutEdges().begin();
-       m_EndOutEdgeOnNode[ node ] = node->getOutEdges().end();
-
-       while( m_CurrentOutEdgeOnNode[ node ] != m_EndOutEdgeOnNode[ node ] && 
-              !(*m_CurrentOutEdgeOnNode[ node ])->getTarget()->isEnabled() )
-         ++m_CurrentOutEdgeOnNode[ node ];
+       m_CurrentOutEdgeOnNode[ node->getIndex() ] = 0;
 
        if( reset )
        {
@@ -214,8 +220,8 @@ private:
          graphDebug("Setting distance and excess for node "
                     << *node << " to 1 and 0.0");
 
-         m_DistanceOnNode[ node ] = 1;
-         m_ExcessOnNode[ node ] = 0.0;
+         m_DistanceOnNode[ node->getIndex() ] = 1;
+         m_ExcessOnNode[ node->getIndex() ] = 0.0;
 
          const EdgeList& outEdges = node->getOutEdges();
 
@@ -231,24 +237,24 @@ private:
             graphDebug("Initializing flow on edge "
                        << *edge << " to be 0");
 
-            m_OnEdge[ edge ] = 0.0;
+            m_OnEdge[ edge->getIndex() ] = 0.0;
 
-            checkError( 0 !=  m_Graph->getEdge( edge->getTarget(), edge->getSource() )
+            checkError( 0 != edge->getReverse()
                         &&
-                        m_Graph->getEdge( edge->getTarget(), edge->getSource() )->isEnabled(),
+                        edge->getReverse()->isEnabled(),
                         "No (enabled) reverse edge for edge '" << *edge << "'");
 
-            m_OnEdge[ m_Graph->getEdge( edge->getTarget(), edge->getSource() ) ] = 0.0;
+            m_OnEdge[ edge->getReverse()->getIndex() ] = 0.0;
           }
         }
       }
     }
   }
 
-  m_DistanceOnNode[ m_Sink ] = 0;
-  m_DistanceOnNode[ m_Source ] = static_cast<long>(m_Nodes.size());
+  m_DistanceOnNode[ m_Sink->getIndex() ] = 0;
+  m_DistanceOnNode[ m_Source->getIndex() ] = static_cast<long>(m_Nodes.size());
 
-  m_NodeListIterator = m_Nodes.end();
+  m_NodeListPosition = m_Nodes.size();
 
   EdgeOutIterator edgeOutIte( *m_Source );
 
@@ -257,7 +263,6 @@ private:
     Edge* edge = *edgeOutIte;
 
     // check edge is enabled
-
     edouble flow = getFlow(edge);
     edouble residual = edge->getCapacity() - flow;
 
@@ -269,24 +274,22 @@ private:
 
     if( residual != 0 )
     {
-      m_OnEdge[ edge ] = flow + residual;
-      m_OnEdge[ m_Graph->getEdge( edge->getTarget(), edge->getSource() ) ] = - (flow + residual);
-
+      m_OnEdge[ edge->getIndex() ] = flow + residual;
+      m_OnEdge[ edge->getReverse()->getIndex() ] = - (flow + residual);
 
       Node* target = edge->getTarget();
 
       edouble excess = getExcess(target);
 
-      m_ExcessOnNode[ target ] = excess + residual;
+      m_ExcessOnNode[ target->getIndex() ] = excess + residual;
 
       graphDebug("Initializing flow on edge "
                  << *edge << " to be "
                  << getFlow(edge) << " (reverse flow "
-                 << getFlow(m_Graph->getEdge( edge->getTarget(), edge->getSource() )) <<
+                 << getFlow(edge->getReverse()) <<
                  ") and excess on node "
                  << *target << " to be "
                  << getExcess(target) );
-
     }
   }
 
@@ -302,63 +305,40 @@ void MaximumFlowAlgorithm::disCharge( Node* node )
              << *node << " witch excess "
              << getExcess(node) );
 
-  while( getExcess(node) != 0 )
-  {
-    Edge* edge = NULL;
-
-    EdgeList::const_iterator ite = currentOutEdgeOnNode(node);
+  const EdgeList& outEdges = node->getOutEdges();
 
-    if( ite != endOutEdgeOnNode(node) )
-      edge = (*ite);
+  unsigned int& current = m_CurrentOutEdgeOnNode[ node->getIndex() ];
 
-    assert( edge != NULL );
+  while( getExcess(node) != 0 )
+  {
+    // relabel only once every edge has been found not to be admissible
+    if( current >= outEdges.size() )
+    {
+      reLabel( node );
 
-    if( isAdmissible( edge ) )
+      current = 0;
+    }
+    else if( outEdges[ current ]->isEnabled() && isAdmissible( outEdges[ current ] ) )
     {
-      push( edge );
+      push( outEdges[ current ] );
     }
     else
     {
-      reLabel( node );
-
-      ++ite;
-
-      if( ite == endOutEdgeOnNode(node) )
-      {
-        ite = node->getOutEdges().begin();
-      }
-
-      while(ite != endOutEdgeOnNode(node) && !(*ite)->getTarget()->isEnabled())
-        ++ite;
-
-      m_CurrentOutEdgeOnNode[node] = ite;
+      ++current;
     }
   }
-
 }
 
 bool MaximumFlowAlgorithm::isAdmissible( Edge* edge ) const
 {
-  Edge2DoubleMap::const_iterator flowIt = m_OnEdge.find(edge);
-  Node2Long::const_iterator sourceDistanceIt = 
-      m_DistanceOnNode.find(edge->getSource());
-  Node2Long::const_iterator targetDistanceIt =
-      m_DistanceOnNode.find(edge->getTarget());
-  checkError(flowIt != m_OnEdge.end(), 
-             "Failed to find flow for " << *edge);
-  checkError(sourceDistanceIt != m_DistanceOnNode.end(),
-             "Failed to find distance for source node " << *(edge->getSource()));
-  checkError(targetDistanceIt != m_DistanceOnNode.end(),
-             "Failed to find distance for target node " << *(edge->getTarget()));
   graphDebug("Checking edge "
              << *edge << " if admissable, flow is "
-             << flowIt->second << " distance of source is "
-             << sourceDistanceIt->second << " distance of target is "
-             << targetDistanceIt->second);
-
+             << getFlow(edge) << " distance of source is "
+             << distanceOnNode(edge->getSource()) << " distance of target is "
+             << distanceOnNode(edge->getTarget()));
 
-  return (flowIt->second < edge->getCapacity()) &&
-      (sourceDistanceIt->second == targetDistanceIt->second + 1);
+  return (getFlow(edge) < edge->getCapacity()) &&
+      (distanceOnNode(edge->getSource()) == distanceOnNode(edge->getTarget()) + 1);
 }
 
 void MaximumFlowAlgorithm::pushFlowBack( Node* node )
@@ -375,9 +355,10 @@ void MaximumFlowAlgorithm::pushFlowBack( Node* node )
 
     if( flow_pushed_back > 0 && edge->getCapacity() != 0 )
     {
-      m_ExcessOnNode[ source ] = getExcess(source) + flow_pushed_back;
-      m_OnEdge[ edge ] = 0.0;
-      m_OnEdge[ m_Graph->getEdge( edge->getTarget(), edge->getSource() ) ] = 0.0;
+      m_ExcessOnNode[ source->getIndex() ] = getExcess(source) + flow_pushed_back;
+
+      m_OnEdge[ edge->getIndex() ] = 0.0;
+      m_OnEdge[ edge->getReverse()->getIndex() ] = 0.0;
     }
   }
 }
@@ -395,11 +376,12 @@ void MaximumFlowAlgorithm::push( Edge* edge )
   edouble delta = (excess > residual ) ? residual : excess;
 
   edouble newFlow = getFlow(edge) + delta;
-  m_OnEdge[ edge ] = newFlow;
-  m_OnEdge[ m_Graph->getEdge( edge->getTarget(), edge->getSource() ) ] = - newFlow;
 
-  m_ExcessOnNode[ target ] = getExcess(target) + delta;
-  m_ExcessOnNode[ source ] = getExcess(source) - delta;
+  m_OnEdge[ edge->getIndex() ] = newFlow;
+  m_OnEdge[ edge->getReverse()->getIndex() ] = - newFlow;
+
+  m_ExcessOnNode[ target->getIndex() ] = getExcess(target) + delta;
+  m_ExcessOnNode[ source->getIndex() ] = getExcess(source) - delta;
 
   graphDebug("Pushed flow "
              << delta << " on edge "
@@ -408,8 +390,6 @@ void MaximumFlowAlgorithm::push( Edge* edge )
              << getExcess(source) << " and on "
              << *target << " "
              << getExcess(target) );
-
-
 }
 
 void MaximumFlowAlgorithm::reLabel( Node* n )
@@ -431,7 +411,7 @@ void MaximumFlowAlgorithm::reLabel( Node* n )
                << *n << " checking edge "
                << *edge << " to relabel, flow on edge is "
                << getFlow(edge) );
-    //m_OnEdge[ edge ] < edge->getCapacity()
+
     if( getResidual( edge ) > 0  )
     {
       eint label = distanceOnNode( target );
@@ -448,7 +428,7 @@ void MaximumFlowAlgorithm::reLabel( Node* n )
   }
 
   //at this point all distance-labels for the connected nodes are smaller or equal to node n
-  m_DistanceOnNode[ n ] = minLabel + 1;
+  m_DistanceOnNode[ n->getIndex() ] = minLabel + 1;
 
   graphDebug("(Re)labeled node "
              << *n << " to have distance "
@@ -16,10 +16,11 @@
 
 namespace EUROPA
 {
-    Node::Node( const NodeIdentity& identity ):
+    Node::Node( const NodeIdentity& identity, unsigned int index ):
       m_Enabled( true ),
       m_Visit( -1 ),
       m_Identity( identity ),
+      m_Index( index ),
       m_InEdges(),
       m_OutEdges()
     {
@@ -27,33 +28,15 @@ namespace EUROPA
 
     Node::~Node()
     {
-      {
-	EdgeList::iterator ite = m_OutEdges.begin();
-	EdgeList::iterator end = m_OutEdges.end();
-
-	for( ; ite != end; ++ite )
-	  {
-	    Edge* edge = (*ite );
-
-	    edge->getTarget()->removeInEdge( edge );
-
-	    delete edge;
-	  }
-      }
-
-      {
-	EdgeList::iterator ite = m_InEdges.begin();
-	EdgeList::iterator end = m_InEdges.end();
-
-	for( ; ite != end; ++ite )
-	  {
-	    Edge* edge = (*ite );
-
-	    edge->getSource()->removeOutEdge( edge );
+    }
 
-	    delete edge;
-	  }
-      }
+    void Node::reset( const NodeIdentity& identity )
+    {
+      m_Enabled = true;
+      m_Visit = -1;
+      m_Identity = identity;
+      m_InEdges.clear();
+      m_OutEdges.clear();
     }
 
     void Node::addOutEdge( Edge* edge )
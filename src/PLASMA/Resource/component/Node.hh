@@ -25,16 +25,22 @@ namespace EUROPA
     public:
       /**
        * @brief Constructor
+       * @arg identity
+       * @arg index The dense index of the node in the graph owning it
        */
-      Node( const NodeIdentity& identity );
+      Node( const NodeIdentity& identity, unsigned int index );
       /**
-       * @brief Destructor
+       * @brief Destructor. The graph owning the node deletes its edges.
        */
       ~Node();
       /**
        * @brief This node.
        */
       inline const NodeIdentity& getIdentity() const;
+      /**
+       * @brief The index of this node, unique among the nodes of its graph and less than Graph::getNodeCapacity().
+       */
+      inline unsigned int getIndex() const;
       /**
        * @brief Returns true if the invoking node is enabled otherwise returns false.
        */
@@ -65,9 +71,15 @@ namespace EUROPA
 
       void removeInEdge( Edge* edge );
 
+      /**
+       * @brief Makes a node the graph had released into a node for \a identity, without edges.
+       */
+      void reset( const NodeIdentity& identity );
+
       bool m_Enabled;
       int m_Visit;
       NodeIdentity m_Identity;
+      unsigned int m_Index;
       EdgeList m_InEdges;
       EdgeList m_OutEdges;
     };
@@ -94,6 +106,10 @@ namespace EUROPA
       return m_Identity;
     }
 
+    unsigned int Node::getIndex() const {
+      return m_Index;
+    }
+
     bool Node::isEnabled() const {
       return m_Enabled;
     }
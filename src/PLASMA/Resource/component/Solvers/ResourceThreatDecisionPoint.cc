@@ -6,8 +6,13 @@
 #include "FlowProfile.hh"
 #include "Constraint.hh"
 #include "DbClient.hh"
+#include "PlanDatabase.hh"
+#include "TemporalAdvisor.hh"
+#include "TokenVariable.hh"
 #include "tinyxml.h"
 
+#include <algorithm>
+#include <limits>
 #include <boost/cast.hpp>
 
 namespace EUROPA {
@@ -59,11 +64,11 @@ private:
  public:
   DefaultChoiceFilter(Profile* profile, const std::string& explanation, 
                       const InstantId inst)
-      : ChoiceFilter(), m_profile(profile), m_explanation(explanation), m_inst(inst),
+      : ChoiceFilter(), m_profile(profile), m_explanation(explanation), m_instTime(inst->getTime()),
         m_treatAsLowerFlaw(true) {
     debugMsg("ResourceThreatDecisionPoint:filter", "Creating filter for " << inst->getTime() << " on " << inst->getProfile()->getResource()->toString());
     //if there are flaws at both levels
-    if(m_inst->hasLowerLevelFlaw() && m_inst->hasUpperLevelFlaw()) {
+    if(inst->hasLowerLevelFlaw() && inst->hasUpperLevelFlaw()) {
       debugMsg("ResourceThreatDecisionPoint:filter", "Instant is flawed on both levels.");
       //  if we were chosen out of a lower level preference, behave like that
       if(m_explanation == "lowerLevelFlaw" || m_explanation.find("Lower") != std::string::npos) {
@@ -79,13 +84,13 @@ private:
       //    pick level with greatest magnitude, treat as a flaw on that level
       //    if the level magnitude is equal, arbitrarily choose lower level
       else {
-        m_treatAsLowerFlaw = m_inst->getLowerFlawMagnitude() >= m_inst->getUpperFlawMagnitude();
+        m_treatAsLowerFlaw = inst->getLowerFlawMagnitude() >= inst->getUpperFlawMagnitude();
         debugMsg("ResourceThreatDecisionPoint:filter", "Treating as " << (m_treatAsLowerFlaw ? "lower" : "upper") <<
-                 " flaw because of magnitude.  Lower: " << m_inst->getLowerFlawMagnitude() << " Upper: " << m_inst->getUpperFlawMagnitude());
+                 " flaw because of magnitude.  Lower: " << inst->getLowerFlawMagnitude() << " Upper: " << inst->getUpperFlawMagnitude());
       }
     }
     else {
-      m_treatAsLowerFlaw = m_inst->hasLowerLevelFlaw() && !m_inst->hasUpperLevelFlaw();
+      m_treatAsLowerFlaw = inst->hasLowerLevelFlaw() && !inst->hasUpperLevelFlaw();
       debugMsg("ResourceThreatDecisionPoint:filter", "Instant is only flawed on the " << (m_treatAsLowerFlaw ? "lower" : "upper") << " level.");
     }
   }
@@ -96,7 +101,7 @@ private:
  protected:
   Profile* m_profile;
   std::string m_explanation;
-  InstantId m_inst;
+  eint m_instTime; /*!< The flawed Instant may be gone by the time later choices are filtered */
   bool m_treatAsLowerFlaw;
 };
 
@@ -141,10 +146,10 @@ class PredecessorNotContributingChoiceFilter : public DefaultChoiceFilter {
     checkError(contributing,
                "Should always have an instant for transaction " << 
                p.first->toString());
-    condDebugMsg(inst->getTime() <= m_inst->getTime(), 
+    condDebugMsg(inst->getTime() <= m_instTime, 
                  "ResourceThreatDecisionPoint:filter:predecessorNot",
                  "Rejecting choice because predecessor is contributing at this instant.");
-    return inst->getTime() > m_inst->getTime();
+    return inst->getTime() > m_instTime;
   }
   std::string toString() const {return "PredecessorNotContributingFilter";}
 };
@@ -181,9 +186,9 @@ class SuccessorContributingChoiceFilter : public DefaultChoiceFilter {
           boost::polymorphic_cast<FlowProfile*>(m_profile)->getEarliestUpperLevelInstant(p.second, inst);
     }
     checkError(contributing, "Should always have an instant for transaction " << p.second->toString());
-    condDebugMsg(inst->getTime() > m_inst->getTime(), "ResourceThreatDecisionPoint:filter:successor",
+    condDebugMsg(inst->getTime() > m_instTime, "ResourceThreatDecisionPoint:filter:successor",
                  "Rejecting choice because successor is not contributing at this instant.");
-    return inst->getTime() <= m_inst->getTime();
+    return inst->getTime() <= m_instTime;
   }
   std::string toString() const {return "SuccessorContributingFilter";}
 };
@@ -201,6 +206,10 @@ class SuccessorContributingChoiceFilter : public DefaultChoiceFilter {
         return "";
       }
       virtual ChoiceComparator* copy() const = 0;
+      /**
+       * True if comparing two pairs with the same predecessor depends on that predecessor.
+       */
+      virtual bool comparesPairs() const {return false;}
     private:
     };
 
@@ -248,6 +257,12 @@ class SuccessorContributingChoiceFilter : public DefaultChoiceFilter {
         debugMsg("ResourceThreatDecisionPoint:sort", "Adding comparator " << cmp->toString());
         m_cmps.push_back(cmp);
       }
+      bool comparesPairs() const {
+        for(std::list<ChoiceComparator*>::const_iterator it = m_cmps.begin(); it != m_cmps.end(); ++it)
+          if((*it)->comparesPairs())
+            return true;
+        return false;
+      }
     private:
       std::list<ChoiceComparator*> m_cmps;
     };
@@ -302,6 +317,7 @@ class SuccessorContributingChoiceFilter : public DefaultChoiceFilter {
       ChoiceComparator* copy() const {
         return (new LeastImpactComparator());
       }
+      bool comparesPairs() const {return true;}
     private:
       inline edouble pseudoAbs(edouble value) const {
         return (value < 0 ? 0 : value);
@@ -368,6 +384,219 @@ class SuccessorContributingChoiceFilter : public DefaultChoiceFilter {
     };
 
 
+    /**
+     * Generates the ordering choices for a flawed Instant in ChoiceOrder order, one at a time.  The candidates are
+     * the pairs Resource::getOrderingChoices considers, merged from one row per predecessor with a heap holding the
+     * next pair of each row.  The temporal distances and ChoiceFilters that rule candidates out are only consulted
+     * for the candidates that reach the top of the heap.
+     */
+    class ChoiceGenerator {
+    private:
+      ChoiceGenerator(const ChoiceGenerator&);
+      ChoiceGenerator& operator=(const ChoiceGenerator&);
+    public:
+      ChoiceGenerator(const InstantId inst, ChoiceFilters* filters, ChoiceOrder* order)
+          : m_filters(filters), m_order(order),
+            m_temporalAdvisor(inst->getProfile()->getPlanDatabase()->getTemporalAdvisor()),
+            m_transactions(inst->getProfile()->getAllTransactions().begin(), inst->getProfile()->getAllTransactions().end()),
+            m_times(), m_atInstant(), m_sorted(), m_sortedAtInstant(), m_rows(), m_heap(), m_distances() {
+        const std::set<TransactionId>& overlapping = inst->getTransactions();
+        for(std::vector<TransactionId>::const_iterator it = m_transactions.begin(); it != m_transactions.end(); ++it) {
+          m_times.push_back(TimeVarId((*it)->time()));
+          m_atInstant.push_back(overlapping.find(*it) != overlapping.end());
+        }
+
+        // Unless the order looks at both sides of a pair, every row orders its successors the same way
+        if(!m_order->comparesPairs() && !m_transactions.empty()) {
+          for(size_t i = 0; i < m_transactions.size(); ++i)
+            m_sorted.push_back(i);
+          std::sort(m_sorted.begin(), m_sorted.end(), SuccessorOrder(this, 0));
+          for(std::vector<size_t>::const_iterator it = m_sorted.begin(); it != m_sorted.end(); ++it)
+            if(m_atInstant[*it])
+              m_sortedAtInstant.push_back(*it);
+        }
+
+        m_rows.reserve(m_transactions.size());
+        for(size_t i = 0; i < m_transactions.size(); ++i) {
+          Row row(i);
+          if(start(row)) {
+            m_heap.push_back(m_rows.size());
+            m_rows.push_back(row);
+          }
+        }
+        std::make_heap(m_heap.begin(), m_heap.end(), RowOrder(this));
+        debugMsg("ResourceThreatDecisionPoint:generate", "Merging " << m_heap.size() << " rows of candidates.");
+      }
+
+      ~ChoiceGenerator() {
+        delete m_filters;
+        delete m_order;
+      }
+
+      /**
+       * Gets the next choice.
+       * @return false if there are no more.
+       */
+      bool next(std::pair<TransactionId, TransactionId>& choice) {
+        while(!m_heap.empty()) {
+          std::pop_heap(m_heap.begin(), m_heap.end(), RowOrder(this));
+          Row& row = m_rows[m_heap.back()];
+          const size_t predecessor = row.predecessor;
+          const size_t successor = row.successor;
+          if(advance(row))
+            std::push_heap(m_heap.begin(), m_heap.end(), RowOrder(this));
+          else
+            m_heap.pop_back();
+
+          std::pair<TransactionId, TransactionId> candidate(m_transactions[predecessor], m_transactions[successor]);
+          if(isChoice(predecessor, successor) && (*m_filters)(candidate)) {
+            choice = candidate;
+            return true;
+          }
+        }
+        return false;
+      }
+
+    private:
+      /**
+       * The candidates with one predecessor.  They are successors at the Instant, or every other successor if the
+       * predecessor is at the Instant.
+       */
+      struct Row {
+        Row(const size_t pred) : predecessor(pred), successor(0), position(0), successors() {}
+        size_t predecessor;
+        size_t successor; /*!< The successor of the row's next candidate */
+        size_t position; /*!< The position of the next candidate's successor in the row's order */
+        std::vector<size_t> successors; /*!< The order of the rest of the row, for orders that compare pairs */
+      };
+
+      class SuccessorOrder {
+      public:
+        SuccessorOrder(const ChoiceGenerator* generator, const size_t predecessor)
+            : m_generator(generator), m_predecessor(predecessor) {}
+        bool operator()(const size_t s1, const size_t s2) const {
+          const std::vector<TransactionId>& transactions = m_generator->m_transactions;
+          return (*m_generator->m_order)(std::make_pair(transactions[m_predecessor], transactions[s1]),
+                                         std::make_pair(transactions[m_predecessor], transactions[s2]));
+        }
+      private:
+        const ChoiceGenerator* m_generator;
+        size_t m_predecessor;
+      };
+
+      // Puts the row with the least candidate at the top of the heap
+      class RowOrder {
+      public:
+        RowOrder(const ChoiceGenerator* generator) : m_generator(generator) {}
+        bool operator()(const size_t r1, const size_t r2) const {
+          const std::vector<TransactionId>& transactions = m_generator->m_transactions;
+          const Row& row1 = m_generator->m_rows[r1];
+          const Row& row2 = m_generator->m_rows[r2];
+          return (*m_generator->m_order)(std::make_pair(transactions[row2.predecessor], transactions[row2.successor]),
+                                         std::make_pair(transactions[row1.predecessor], transactions[row1.successor]));
+        }
+      private:
+        const ChoiceGenerator* m_generator;
+      };
+
+      bool isCandidate(const size_t predecessor, const size_t successor) const {
+        return predecessor != successor && (m_atInstant[predecessor] || m_atInstant[successor]);
+      }
+
+      // Finds the row's first candidate
+      bool start(Row& row) {
+        if(!m_order->comparesPairs()) {
+          row.position = 0;
+          return seek(row);
+        }
+        // The rest of the row is only ordered once the first candidate has been taken
+        SuccessorOrder order(this, row.predecessor);
+        bool found = false;
+        for(size_t i = 0; i < m_transactions.size(); ++i) {
+          if(isCandidate(row.predecessor, i) && (!found || order(i, row.successor))) {
+            row.successor = i;
+            found = true;
+          }
+        }
+        return found;
+      }
+
+      // Moves the row to its next candidate
+      bool advance(Row& row) {
+        if(!m_order->comparesPairs()) {
+          ++row.position;
+          return seek(row);
+        }
+        if(row.position == 0 && row.successors.empty()) {
+          for(size_t i = 0; i < m_transactions.size(); ++i)
+            if(i != row.successor && isCandidate(row.predecessor, i))
+              row.successors.push_back(i);
+          std::sort(row.successors.begin(), row.successors.end(), SuccessorOrder(this, row.predecessor));
+        }
+        else
+          ++row.position;
+        if(row.position == row.successors.size())
+          return false;
+        row.successor = row.successors[row.position];
+        return true;
+      }
+
+      // Moves a row over a shared order to the first candidate at or after its position
+      bool seek(Row& row) {
+        const std::vector<size_t>& successors = (m_atInstant[row.predecessor] ? m_sorted : m_sortedAtInstant);
+        if(row.position < successors.size() && successors[row.position] == row.predecessor)
+          ++row.position;
+        if(row.position == successors.size())
+          return false;
+        row.successor = successors[row.position];
+        return true;
+      }
+
+      // The test Resource::getOrderingChoices makes of a pair, from whichever side is at the Instant
+      bool isChoice(const size_t predecessor, const size_t successor) {
+        if(!m_times[predecessor]->lastDomain().intersects(m_times[successor]->lastDomain())) {
+          debugMsg("ResourceThreatDecisionPoint:generate", "Rejected pair because successor does not overlap predecessor.");
+          return false;
+        }
+        if(m_atInstant[predecessor]) {
+          const Distances& distances = getDistances(predecessor);
+          if(distances.second[successor] >= 0 && distances.first[successor] < 0)
+            return true;
+        }
+        if(m_atInstant[successor]) {
+          const Distances& distances = getDistances(successor);
+          if(distances.first[predecessor] <= 0 && distances.second[predecessor] > 0)
+            return true;
+        }
+        debugMsg("ResourceThreatDecisionPoint:generate", "Rejected pair because predecessor cannot precede successor or is already constrained to.");
+        return false;
+      }
+
+      typedef std::pair<std::vector<eint>, std::vector<eint> > Distances;
+
+      // The signs of the temporal distances from a transaction to every other
+      const Distances& getDistances(const size_t from) {
+        std::map<size_t, Distances>::iterator it = m_distances.find(from);
+        if(it == m_distances.end()) {
+          it = m_distances.insert(std::make_pair(from, Distances())).first;
+          m_temporalAdvisor->getTemporalDistanceSigns(m_times[from], m_times, it->second.first, it->second.second);
+        }
+        return it->second;
+      }
+
+      ChoiceFilters* m_filters;
+      ChoiceOrder* m_order;
+      TemporalAdvisorId m_temporalAdvisor;
+      std::vector<TransactionId> m_transactions; /*!< Every transaction on the profile */
+      std::vector<ConstrainedVariableId> m_times;
+      std::vector<bool> m_atInstant;
+      std::vector<size_t> m_sorted; /*!< The order of successors, for orders that don't compare pairs */
+      std::vector<size_t> m_sortedAtInstant; /*!< The same, for successors at the Instant */
+      std::vector<Row> m_rows;
+      std::vector<size_t> m_heap; /*!< The rows with candidates left */
+      std::map<size_t, Distances> m_distances;
+    };
+
     bool ResourceThreatDecisionPoint::test(const EntityId entity) {
       return InstantId::convertable(entity);
     }
@@ -406,7 +635,7 @@ ResourceThreatDecisionPoint::ResourceThreatDecisionPoint(const DbClientId client
                                                          const TiXmlElement& configData,
                                                          const std::string& explanation)
     : DecisionPoint(client, flawedInstant->getKey(), explanation), 
-      m_flawedInstant(flawedInstant), m_choices(), m_choiceCount(0), m_index(0),
+      m_flawedInstant(flawedInstant), m_choices(), m_generator(NULL), m_index(0),
       m_constr(), m_instTime(flawedInstant->getTime()), 
       m_resName(m_flawedInstant->getProfile()->getResource()->getName()),
       m_order(), m_filter(), m_constraintOrder(), m_constraintNames(), 
@@ -441,7 +670,29 @@ ResourceThreatDecisionPoint::ResourceThreatDecisionPoint(const DbClientId client
       checkError(m_constraintOrder == "pairFirst" || m_constraintOrder == "constraintFirst", "Expected 'pairFirst' or 'constraintFirst' for iterate attribute.");
     }
 
-    ResourceThreatDecisionPoint::~ResourceThreatDecisionPoint() {}
+    ResourceThreatDecisionPoint::~ResourceThreatDecisionPoint() {
+      delete m_generator;
+    }
+
+    const std::vector<std::pair<TransactionId, TransactionId> >& ResourceThreatDecisionPoint::getChoices() {
+      generateChoices(std::numeric_limits<unsigned long>::max());
+      return m_choices;
+    }
+
+    void ResourceThreatDecisionPoint::generateChoices(const unsigned long count) {
+      std::pair<TransactionId, TransactionId> choice;
+      while(m_generator != NULL && m_choices.size() < count) {
+        if(m_generator->next(choice)) {
+          debugMsg("ResourceThreatDecisionPoint:generate", "Choice " << (m_choices.size() + 1) << " is " << toString(choice));
+          m_choices.push_back(choice);
+        }
+        else {
+          debugMsg("ResourceThreatDecisionPoint:generate", "Found all " << m_choices.size() << " choices.");
+          delete m_generator;
+          m_generator = NULL;
+        }
+      }
+    }
 
     void ResourceThreatDecisionPoint::createFilter(ChoiceFilters& filters, const std::string& filter, ProfileId profile) {
       checkError(filter == "none" || filter == "predecessorNot" || filter == "successor" || filter == "both",
@@ -468,20 +719,20 @@ ResourceThreatDecisionPoint::ResourceThreatDecisionPoint(const DbClientId client
       std::stringstream os;
       os << "INSTANT=" << m_instTime << " on " << m_resName << " : ";
 
-      if (m_choiceCount == 0) {
+      if (m_choices.empty()) {
     	os << "NO CHOICES";
     	return os.str();
       }
 
       TransactionId predecessor = m_choices[m_index].first;
       TransactionId successor = m_choices[m_index].second;
-      os << "  DECISION (CHOICE=" << (m_index+1) << " of MAX_CHOICE=" << m_choiceCount<< ") "
+      os << "  DECISION (CHOICE=" << (m_index+1) << " of MAX_CHOICE=" << m_choices.size() << (m_generator == NULL ? "" : "+") << ") "
          << predecessor->toString()
          << " to be before " << successor->toString()
          << " : ";
 
       os << "  CHOICES ";
-      for(unsigned int i = 0; i < m_choiceCount; i++)
+      for(unsigned int i = 0; i < m_choices.size(); i++)
         os << " : " << (i+1) << " " << toString(m_choices[i]);
       return os.str();
     }
@@ -494,42 +745,23 @@ ResourceThreatDecisionPoint::ResourceThreatDecisionPoint(const DbClientId client
 
     void ResourceThreatDecisionPoint::handleInitialize() {
       check_error(m_flawedInstant.isValid());
-      m_flawedInstant->getProfile()->getResource()->getOrderingChoices(m_flawedInstant, m_choices);
-
-      debugMsg("ResourceThreatDecisionPoint:handleInitialize", "Found " << m_choices.size() << " choices before filtering.");
-
-      //filter based on the configuration
-      ChoiceFilters filter;
-      createFilter(filter, m_filter, static_cast<ProfileId>(m_flawedInstant->getProfile()));
-      //order based ont he configuration
-      ChoiceOrder order;
-      createOrder(order);
-
-      std::set<std::pair<TransactionId, TransactionId>, ChoiceOrder> sort(order);
-
-      std::insert_iterator<std::set<std::pair<TransactionId, TransactionId>, ChoiceOrder > > choiceIt =
-        inserter(sort, sort.begin());
-//       std::back_insert_iterator<std::vector<std::pair<TransactionId, TransactionId> > > choiceIt =
-//         std::back_inserter(m_choices);
-
-      for(std::vector<std::pair<TransactionId, TransactionId> >::iterator it = m_choices.begin();
-          it != m_choices.end(); ++it) {
-        if(filter(*it))
-          *choiceIt++ = *it;
+      if(m_flawedInstant->getProfile()->getPlanDatabase()->getConstraintEngine()->propagate()) {
+        //filter and order based on the configuration
+        ChoiceFilters* filter = new ChoiceFilters();
+        createFilter(*filter, m_filter, static_cast<ProfileId>(m_flawedInstant->getProfile()));
+        ChoiceOrder* order = new ChoiceOrder();
+        createOrder(*order);
+        m_generator = new ChoiceGenerator(m_flawedInstant, filter, order);
+        generateChoices(1);
+      }
+      else {
+        debugMsg("ResourceThreatDecisionPoint:handleInitialize", "No choices: the constraint network is inconsistent.");
       }
-
-      //       std::sort(m_choices.begin(), m_choices.end(), order);
-      m_choices.clear();
-      m_choices.insert(m_choices.end(), sort.begin(), sort.end());
-      m_choiceCount = m_choices.size();
-      debugMsg("ResourceThreatDecisionPoint:handleInitialize", "Found " << m_choiceCount << " choices after filtering.");
-      //for some reason, std::sort copies the comparator object, so I'm going to try this with a set.
-      //std::sort(m_choices.begin(), m_choices.end(), order);
       m_flawedInstant = InstantId::noId();
     }
 
     bool ResourceThreatDecisionPoint::hasNext() const {
-      return m_index < m_choiceCount && m_constraintIt != m_constraintNames.end();
+      return m_index < m_choices.size() && m_constraintIt != m_constraintNames.end();
     }
 
     bool ResourceThreatDecisionPoint::canUndo() const {
@@ -538,7 +770,9 @@ ResourceThreatDecisionPoint::ResourceThreatDecisionPoint(const DbClientId client
 
     void ResourceThreatDecisionPoint::handleExecute() {
       check_error(m_constr.isNoId());
-      checkError(m_index < m_choiceCount, "Tried to execute past available choices:" << m_index << ">=" << m_choiceCount);
+      checkError(m_index < m_choices.size(), "Tried to execute past available choices:" << m_index << ">=" << m_choices.size());
+      // hasNext is asked after undo, when the database isn't propagated, so the next choice is found now
+      generateChoices(m_index + 2);
       TransactionId predecessor = m_choices[m_index].first;
       TransactionId successor = m_choices[m_index].second;
       debugMsg("SolverDecisionPoint:handleExecute", "For " << m_instTime << " on " << m_resName << ", assigning " <<
@@ -563,6 +797,7 @@ ResourceThreatDecisionPoint::ResourceThreatDecisionPoint(const DbClientId client
       else if(m_constraintOrder == "pairFirst") {
         m_index++;
         if(m_index == m_choices.size()) {
+          check_error(m_generator == NULL);
           m_index = 0;
           m_constraintIt++;
         }
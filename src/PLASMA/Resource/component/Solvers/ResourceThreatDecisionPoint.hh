@@ -12,6 +12,7 @@ namespace EUROPA {
 
     class ChoiceOrder;
     class ChoiceFilters;
+    class ChoiceGenerator;
 
     class ResourceThreatDecisionPoint : public SOLVERS::DecisionPoint {
     public:
@@ -21,7 +22,11 @@ namespace EUROPA {
       virtual std::string toShortString() const;
       void execute() {DecisionPoint::execute();}
       void undo() {DecisionPoint::undo();}
-      const std::vector<std::pair<TransactionId, TransactionId> >& getChoices() {return m_choices;}
+      /**
+       * @brief Gets all the choices.  They are otherwise generated as they're needed, so this should only be
+       * called while the database is propagated.
+       */
+      const std::vector<std::pair<TransactionId, TransactionId> >& getChoices();
       virtual void handleInitialize();
       virtual bool hasNext() const;
       virtual bool canUndo() const;
@@ -33,10 +38,11 @@ namespace EUROPA {
       std::string toString(const std::pair<TransactionId, TransactionId>& choice) const;
       void createFilter(ChoiceFilters& filters, const std::string& filter, ProfileId profile);
       void createOrder(ChoiceOrder& order);
+      void generateChoices(const unsigned long count);
     protected:
       InstantId m_flawedInstant;
-      std::vector<std::pair<TransactionId, TransactionId> > m_choices;
-      unsigned long m_choiceCount;
+      std::vector<std::pair<TransactionId, TransactionId> > m_choices; /*!< The choices generated so far */
+      ChoiceGenerator* m_generator; /*!< Generates the rest of the choices, until there are none left */
       unsigned long m_index;
       ConstraintId m_constr;
       eint m_instTime;
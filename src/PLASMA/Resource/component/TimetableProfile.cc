@@ -4,7 +4,175 @@
 #include "ConstrainedVariable.hh"
 #include "Debug.hh"
 
+#include <algorithm>
+#include <limits>
+
+// Bulk level computation uses SSE2 and AVX2 where the compiler can target them per function, chosen at runtime.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define TIMETABLE_SIMD
+#include <immintrin.h>
+#endif
+
 namespace EUROPA {
+
+  namespace {
+    // The lanes of an event's flags.  Each group of four bits selects lanes of one of the sums, in the order
+    // they are passed to Instant::update.
+    const unsigned int INSTANT_SHIFT = 0;     // min/max instant consumption, min/max instant production
+    const unsigned int LEVEL_SHIFT = 4;       // lower level min/max, upper level min/max
+    const unsigned int CUMULATIVE_SHIFT = 8;  // min/max cumulative consumption, min/max cumulative production
+    const unsigned int PREV_SHIFT = 12;       // min/max previous consumption, min/max previous production
+    const unsigned int CONSUMER = 1 << 16;
+
+    const unsigned int LEVELS_PER_INSTANT = 20; // the 16 arguments to Instant::update, then the previous sums after it
+    const unsigned long MIN_BATCH = 16; // runs shorter than this aren't worth gathering
+    const unsigned long MAX_BATCH = 256;
+
+#ifdef TIMETABLE_SIMD
+    /*
+     * The kernels keep each sum in its own lane and add to it in the same order as the scalar code, so the
+     * results are the same to the bit.  Additions saturate at infinity as edouble's do; if a sum leaves
+     * [-infinity, infinity] the run is abandoned, so edouble can report the overflow.
+     */
+
+    __attribute__((target("sse2")))
+    inline __m128d selectLanes(const __m128d mask, const __m128d a, const __m128d b) {
+      return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+    }
+
+    __attribute__((target("sse2")))
+    inline __m128d addLanes(const __m128d a, const __m128d b, const __m128d mask, const __m128d inf, const __m128d minf,
+                            __m128d& overflow) {
+      __m128d sum = _mm_add_pd(a, b);
+      __m128d pos = _mm_or_pd(_mm_and_pd(_mm_cmpge_pd(a, inf), _mm_cmpgt_pd(b, minf)),
+                              _mm_and_pd(_mm_cmpge_pd(b, inf), _mm_cmpgt_pd(a, minf)));
+      __m128d neg = _mm_or_pd(_mm_and_pd(_mm_cmple_pd(a, minf), _mm_cmplt_pd(b, inf)),
+                              _mm_and_pd(_mm_cmple_pd(b, minf), _mm_cmplt_pd(a, inf)));
+      __m128d saturated = _mm_or_pd(pos, neg);
+      overflow = _mm_or_pd(overflow,
+                           _mm_andnot_pd(saturated, _mm_and_pd(mask, _mm_or_pd(_mm_cmpgt_pd(sum, inf), _mm_cmplt_pd(sum, minf)))));
+      sum = selectLanes(pos, inf, selectLanes(neg, minf, sum));
+      return selectLanes(mask, sum, a);
+    }
+
+    __attribute__((target("sse2")))
+    bool computeLevelsSSE2(const double* start, const double* quantities, const unsigned int* flags,
+                           const unsigned int* counts, const unsigned long instants, double* out) {
+      const __m128d inf = _mm_set1_pd(cast_double(std::numeric_limits<edouble>::infinity()));
+      const __m128d minf = _mm_set1_pd(cast_double(std::numeric_limits<edouble>::minus_infinity()));
+      const __m128d all = _mm_castsi128_pd(_mm_set1_epi32(-1));
+      const __m128d masks[4] = {_mm_setzero_pd(), _mm_castsi128_pd(_mm_set_epi32(0, 0, -1, -1)),
+                                _mm_castsi128_pd(_mm_set_epi32(-1, -1, 0, 0)), all};
+      __m128d overflow = _mm_setzero_pd();
+      __m128d levels[2] = {_mm_loadu_pd(start), _mm_loadu_pd(start + 2)};
+      __m128d prev[2] = {_mm_loadu_pd(start + 4), _mm_loadu_pd(start + 6)};
+
+      for(unsigned long i = 0; i < instants; ++i, out += LEVELS_PER_INSTANT) {
+        __m128d instant[2] = {_mm_setzero_pd(), _mm_setzero_pd()};
+        __m128d cumulative[2] = {prev[0], prev[1]};
+        _mm_storeu_pd(out + 12, prev[0]);
+        _mm_storeu_pd(out + 14, prev[1]);
+
+        for(const unsigned int* end = flags + counts[i]; flags != end; ++flags, quantities += 2) {
+          const unsigned int f = *flags;
+          const __m128d q = _mm_loadu_pd(quantities);
+          const __m128d l = ((f & CONSUMER) ? _mm_set_pd(-quantities[0], -quantities[1]) : q);
+          for(unsigned int h = 0; h < 2; ++h) {
+            const unsigned int shift = 2 * h;
+            instant[h] = addLanes(instant[h], q, masks[(f >> (INSTANT_SHIFT + shift)) & 3], inf, minf, overflow);
+            levels[h] = addLanes(levels[h], l, masks[(f >> (LEVEL_SHIFT + shift)) & 3], inf, minf, overflow);
+            cumulative[h] = addLanes(cumulative[h], q, masks[(f >> (CUMULATIVE_SHIFT + shift)) & 3], inf, minf, overflow);
+            prev[h] = addLanes(prev[h], q, masks[(f >> (PREV_SHIFT + shift)) & 3], inf, minf, overflow);
+          }
+        }
+
+        // the maximum cumulative sums include the maximum instant sums
+        for(unsigned int h = 0; h < 2; ++h) {
+          cumulative[h] = addLanes(cumulative[h], instant[h], masks[2], inf, minf, overflow);
+          _mm_storeu_pd(out + 2 * h, levels[h]);
+          _mm_storeu_pd(out + 4 + 2 * h, instant[h]);
+          _mm_storeu_pd(out + 8 + 2 * h, cumulative[h]);
+          _mm_storeu_pd(out + 16 + 2 * h, prev[h]);
+        }
+      }
+      return _mm_movemask_pd(overflow) == 0;
+    }
+
+    __attribute__((target("avx2")))
+    inline __m256d addLanes(const __m256d a, const __m256d b, const __m256d mask, const __m256d inf, const __m256d minf,
+                            __m256d& overflow) {
+      __m256d sum = _mm256_add_pd(a, b);
+      __m256d pos = _mm256_or_pd(_mm256_and_pd(_mm256_cmp_pd(a, inf, _CMP_GE_OQ), _mm256_cmp_pd(b, minf, _CMP_GT_OQ)),
+                                 _mm256_and_pd(_mm256_cmp_pd(b, inf, _CMP_GE_OQ), _mm256_cmp_pd(a, minf, _CMP_GT_OQ)));
+      __m256d neg = _mm256_or_pd(_mm256_and_pd(_mm256_cmp_pd(a, minf, _CMP_LE_OQ), _mm256_cmp_pd(b, inf, _CMP_LT_OQ)),
+                                 _mm256_and_pd(_mm256_cmp_pd(b, minf, _CMP_LE_OQ), _mm256_cmp_pd(a, inf, _CMP_LT_OQ)));
+      __m256d outOfRange = _mm256_or_pd(_mm256_cmp_pd(sum, inf, _CMP_GT_OQ), _mm256_cmp_pd(sum, minf, _CMP_LT_OQ));
+      overflow = _mm256_or_pd(overflow, _mm256_andnot_pd(_mm256_or_pd(pos, neg), _mm256_and_pd(mask, outOfRange)));
+      sum = _mm256_blendv_pd(_mm256_blendv_pd(sum, minf, neg), inf, pos);
+      return _mm256_blendv_pd(a, sum, mask);
+    }
+
+    __attribute__((target("avx2")))
+    inline __m256d laneMask(const unsigned int lanes, const __m256i bits) {
+      return _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x(lanes), bits), bits));
+    }
+
+    __attribute__((target("avx2")))
+    bool computeLevelsAVX2(const double* start, const double* quantities, const unsigned int* flags,
+                           const unsigned int* counts, const unsigned long instants, double* out) {
+      const __m256d inf = _mm256_set1_pd(cast_double(std::numeric_limits<edouble>::infinity()));
+      const __m256d minf = _mm256_set1_pd(cast_double(std::numeric_limits<edouble>::minus_infinity()));
+      const __m256d sign = _mm256_set1_pd(-0.0);
+      const __m256i bits = _mm256_set_epi64x(8, 4, 2, 1);
+      const __m256d maxLanes = laneMask(10, bits);
+      __m256d overflow = _mm256_setzero_pd();
+      __m256d levels = _mm256_loadu_pd(start);
+      __m256d prev = _mm256_loadu_pd(start + 4);
+
+      for(unsigned long i = 0; i < instants; ++i, out += LEVELS_PER_INSTANT) {
+        __m256d instant = _mm256_setzero_pd();
+        __m256d cumulative = prev;
+        _mm256_storeu_pd(out + 12, prev);
+
+        for(const unsigned int* end = flags + counts[i]; flags != end; ++flags, quantities += 2) {
+          const unsigned int f = *flags;
+          const __m128d bounds = _mm_loadu_pd(quantities);
+          const __m256d q = _mm256_insertf128_pd(_mm256_castpd128_pd256(bounds), bounds, 1);
+          const __m256d l = ((f & CONSUMER) ? _mm256_xor_pd(_mm256_permute_pd(q, 5), sign) : q);
+          instant = addLanes(instant, q, laneMask((f >> INSTANT_SHIFT) & 15, bits), inf, minf, overflow);
+          levels = addLanes(levels, l, laneMask((f >> LEVEL_SHIFT) & 15, bits), inf, minf, overflow);
+          cumulative = addLanes(cumulative, q, laneMask((f >> CUMULATIVE_SHIFT) & 15, bits), inf, minf, overflow);
+          prev = addLanes(prev, q, laneMask((f >> PREV_SHIFT) & 15, bits), inf, minf, overflow);
+        }
+
+        // the maximum cumulative sums include the maximum instant sums
+        cumulative = addLanes(cumulative, instant, maxLanes, inf, minf, overflow);
+        _mm256_storeu_pd(out, levels);
+        _mm256_storeu_pd(out + 4, instant);
+        _mm256_storeu_pd(out + 8, cumulative);
+        _mm256_storeu_pd(out + 16, prev);
+      }
+      return _mm256_movemask_pd(overflow) == 0;
+    }
+#endif
+
+    TimetableProfile::LevelKernel bestLevelKernel() {
+#ifdef TIMETABLE_SIMD
+      __builtin_cpu_init();
+      if(__builtin_cpu_supports("avx2"))
+        return TimetableProfile::AVX2;
+      if(__builtin_cpu_supports("sse2"))
+        return TimetableProfile::SSE2;
+#endif
+      return TimetableProfile::SCALAR;
+    }
+
+    TimetableProfile::LevelKernel& levelKernel() {
+      static TimetableProfile::LevelKernel s_kernel = bestLevelKernel();
+      return s_kernel;
+    }
+  }
+
     TimetableProfile::TimetableProfile(const PlanDatabaseId db, const FVDetectorId flawDetector)
     	: Profile(db, flawDetector)
     	, m_lowerLevelMin(0)
@@ -15,9 +183,28 @@ namespace EUROPA {
     	, m_maxPrevConsumption(0)
     	, m_minPrevProduction(0)
     	, m_maxPrevProduction(0)
+    	, m_batchQuantities()
+    	, m_batchFlags()
+    	, m_batchCounts()
+    	, m_batchLevels()
+    	, m_batchNext(0)
+    	, m_batchFirst(0)
+    	, m_batchLast(0)
+    	, m_batchEnd(0)
+    	, m_levelsChanged(true)
     {
     }
 
+    TimetableProfile::LevelKernel TimetableProfile::getLevelKernel() {
+      return levelKernel();
+    }
+
+    TimetableProfile::LevelKernel TimetableProfile::setLevelKernel(const LevelKernel kernel) {
+      LevelKernel best = bestLevelKernel();
+      levelKernel() = (kernel > best ? best : kernel);
+      return levelKernel();
+    }
+
     void TimetableProfile::initRecompute(InstantId inst) {
       checkError(m_recomputeInterval.isValid(), "Attempted to initialize recomputation without a valid starting point!");
       m_lowerLevelMin = inst->getLowerLevel();
@@ -41,9 +228,128 @@ namespace EUROPA {
 		m_maxPrevProduction = 0;
     }
 
+void TimetableProfile::resumeRecompute(InstantId inst) {
+  initRecompute(inst);
+  carryEndingTransactions(inst);
+}
+
+void TimetableProfile::prepareLevels(const unsigned long first, const unsigned long last) {
+  m_batchNext = m_batchFirst = m_batchLast = first;
+  m_batchEnd = (getLevelKernel() != SCALAR && last > first && last - first >= MIN_BATCH ? last : first);
+}
+
+bool TimetableProfile::computeBatch() {
+  m_batchFirst = m_batchNext;
+  m_batchLast = std::min(m_batchEnd, m_batchFirst + MAX_BATCH);
+  m_batchQuantities.clear();
+  m_batchFlags.clear();
+  m_batchCounts.clear();
+
+  for(unsigned long index = m_batchFirst; index < m_batchLast; ++index) {
+    InstantId inst = m_levelInstants[index];
+    const std::set<TransactionId>& transactions(inst->getTransactions());
+    const std::set<TransactionId>& ending(inst->getEndingTransactions());
+    std::set<TransactionId>::const_iterator endIt = ending.begin();
+
+    // the same sums as recomputeLevels, recorded as flags so they can be added in bulk
+    for(std::set<TransactionId>::const_iterator it = transactions.begin(); it != transactions.end(); ++it) {
+      TransactionId trans = *it;
+      edouble lb, ub;
+      trans->quantity()->lastDomain().getBounds(lb, ub);
+      const Domain& time = trans->time()->lastDomain();
+      bool isConsumer = trans->isConsumer();
+
+      unsigned int flags = (isConsumer ? CONSUMER | (2 << INSTANT_SHIFT) : 8 << INSTANT_SHIFT);
+      if(time.isSingleton())
+        flags |= (isConsumer ? 1 : 4) << INSTANT_SHIFT;
+      if(time.getLowerBound() == inst->getTime())
+        flags |= (isConsumer ? 3 : 12) << LEVEL_SHIFT;
+      if(time.getUpperBound() == inst->getTime())
+        flags |= (isConsumer ? (12 << LEVEL_SHIFT) | (1 << CUMULATIVE_SHIFT) : (3 << LEVEL_SHIFT) | (4 << CUMULATIVE_SHIFT));
+      if(endIt != ending.end() && *endIt == trans) {
+        flags |= (isConsumer ? 3 : 12) << PREV_SHIFT;
+        ++endIt;
+      }
+
+      m_batchQuantities.push_back(cast_double(lb));
+      m_batchQuantities.push_back(cast_double(ub));
+      m_batchFlags.push_back(flags);
+    }
+
+    if(endIt != ending.end())
+      return false;
+    m_batchCounts.push_back(static_cast<unsigned int>(transactions.size()));
+  }
+
+  m_batchLevels.resize(m_batchCounts.size() * LEVELS_PER_INSTANT);
+  const double start[8] = {cast_double(m_lowerLevelMin), cast_double(m_lowerLevelMax),
+                           cast_double(m_upperLevelMin), cast_double(m_upperLevelMax),
+                           cast_double(m_minPrevConsumption), cast_double(m_maxPrevConsumption),
+                           cast_double(m_minPrevProduction), cast_double(m_maxPrevProduction)};
+  const double* quantities = (m_batchQuantities.empty() ? NULL : &m_batchQuantities[0]);
+  const unsigned int* flags = (m_batchFlags.empty() ? NULL : &m_batchFlags[0]);
+  bool computed = false;
+
+  switch(getLevelKernel()) {
+#ifdef TIMETABLE_SIMD
+  case AVX2:
+    computed = computeLevelsAVX2(start, quantities, flags, &m_batchCounts[0], m_batchCounts.size(), &m_batchLevels[0]);
+    break;
+  case SSE2:
+    computed = computeLevelsSSE2(start, quantities, flags, &m_batchCounts[0], m_batchCounts.size(), &m_batchLevels[0]);
+    break;
+#endif
+  default:
+    break;
+  }
+
+  debugMsg("TimetableProfile:computeBatch", (computed ? "Computed" : "Couldn't compute") << " levels for " <<
+           m_batchCounts.size() << " instants from " << m_levelInstants[m_batchFirst]->getTime() << " with " <<
+           m_batchFlags.size() << " transactions");
+  return computed;
+}
+
 void TimetableProfile::recomputeLevels( InstantId, InstantId inst) {
   check_error(inst.isValid());
 
+  // the levels and sums carried into the next Instant follow from these, as the Transactions ending here haven't changed
+  // unless the Instant is in a dirty window
+  const edouble previous[] = {inst->getLowerLevel(), inst->getLowerLevelMax(), inst->getUpperLevelMin(), inst->getUpperLevel(),
+                              inst->getMinPrevConsumption(), inst->getMaxPrevConsumption(),
+                              inst->getMinPrevProduction(), inst->getMaxPrevProduction()};
+  computeLevels(inst);
+  m_levelsChanged = !(previous[0] == inst->getLowerLevel() && previous[1] == inst->getLowerLevelMax() &&
+                      previous[2] == inst->getUpperLevelMin() && previous[3] == inst->getUpperLevel() &&
+                      previous[4] == inst->getMinPrevConsumption() && previous[5] == inst->getMaxPrevConsumption() &&
+                      previous[6] == inst->getMinPrevProduction() && previous[7] == inst->getMaxPrevProduction());
+}
+
+void TimetableProfile::computeLevels(InstantId inst) {
+  if(m_batchNext < m_batchEnd) {
+    if(m_levelInstants[m_batchNext] == inst && (m_batchNext < m_batchLast || computeBatch())) {
+      const double* levels = &m_batchLevels[(m_batchNext - m_batchFirst) * LEVELS_PER_INSTANT];
+      ++m_batchNext;
+      m_lowerLevelMin = levels[0];
+      m_lowerLevelMax = levels[1];
+      m_upperLevelMin = levels[2];
+      m_upperLevelMax = levels[3];
+      inst->update(m_lowerLevelMin, m_lowerLevelMax, m_upperLevelMin, m_upperLevelMax,
+                   levels[4], levels[5], levels[6], levels[7],
+                   levels[8], levels[9], levels[10], levels[11],
+                   levels[12], levels[13], levels[14], levels[15]);
+      m_minPrevConsumption = levels[16];
+      m_maxPrevConsumption = levels[17];
+      m_minPrevProduction = levels[18];
+      m_maxPrevProduction = levels[19];
+      debugMsg("TimetableProfile:recompute", "Batch computed values for time " << inst->getTime() << ":" << std::endl <<
+               "    Lower level (min, max): (" << m_lowerLevelMin << ", " << m_lowerLevelMax << ")" << std::endl <<
+               "    Upper level (min, max): (" << m_upperLevelMin << ", " << m_upperLevelMax << ")" << std::endl);
+      return;
+    }
+    // compute the rest one Instant at a time
+    m_batchEnd = m_batchNext;
+  }
+
   edouble maxInstantProduction(0), minInstantProduction(0), maxInstantConsumption(0), minInstantConsumption(0);
   edouble maxCumulativeProduction(m_maxPrevProduction), minCumulativeProduction(m_minPrevProduction);
   edouble maxCumulativeConsumption(m_maxPrevConsumption), minCumulativeConsumption(m_minPrevConsumption);
@@ -103,6 +409,10 @@ void TimetableProfile::recomputeLevels( InstantId, InstantId inst) {
                minCumulativeConsumption, maxCumulativeConsumption, minCumulativeProduction, maxCumulativeProduction,
                m_minPrevConsumption, m_maxPrevConsumption, m_minPrevProduction, m_maxPrevProduction);
 
+  carryEndingTransactions(inst);
+}
+
+void TimetableProfile::carryEndingTransactions(InstantId inst) {
   //update the values for production and consumption that must have happened by the next transaction
   for(std::set<TransactionId>::const_iterator it = inst->getEndingTransactions().begin(); it != inst->getEndingTransactions().end(); ++it) {
     TransactionId trans = *it;
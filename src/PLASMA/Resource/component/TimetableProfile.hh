@@ -5,6 +5,8 @@
 #include "Profile.hh"
 #include "DomainListener.hh"
 
+#include <vector>
+
 namespace EUROPA {
 
     class TimetableProfile : public Profile {
@@ -12,10 +14,46 @@ namespace EUROPA {
       TimetableProfile(const PlanDatabaseId db, const FVDetectorId flawDetector);
 
       void getTransactionsToOrder(const InstantId inst, std::vector<TransactionId>& results);
+
+      /**
+       * @brief Levels depend only on the bounds of this profile's Transactions, so profiles can be recomputed concurrently.
+       */
+      bool canRecomputeConcurrently() const {return true;}
+
+      /**
+       * @brief Levels are swept forward from the levels carried out of the Instant before, so only the dirty windows
+       * are recomputed.
+       */
+      bool canResumeRecompute() const {return true;}
+
+      /**
+       * @brief The ways levels can be computed.  SCALAR computes them one Instant at a time; the others compute
+       * runs of Instants in bulk with the named instruction set, with results identical to SCALAR.
+       */
+      enum LevelKernel {
+        SCALAR,
+        SSE2,
+        AVX2
+      };
+
+      /**
+       * @brief Gets the way levels are computed.  Defaults to the best the CPU supports.
+       */
+      static LevelKernel getLevelKernel();
+
+      /**
+       * @brief Sets the way levels are computed, for all TimetableProfiles.
+       * @param kernel The kernel to use.  Kernels the CPU doesn't support are replaced by the best one it does.
+       * @return The kernel in use.
+       */
+      static LevelKernel setLevelKernel(const LevelKernel kernel);
+
     protected:
 
     	/**
     	 * @brief Compute level changes when transaction starts at the current instant.
+    	 * Levels computed in bulk don't call this or handleTransactionEnd, so subclasses that override them
+    	 * should compute levels with the SCALAR kernel.
     	 */
     	virtual void handleTransactionStart(bool isConsumer, const edouble & lb, const edouble & ub);
 
@@ -32,9 +70,41 @@ namespace EUROPA {
     private:
       void initRecompute(InstantId inst);
       void initRecompute();
+      void resumeRecompute(InstantId inst);
+      bool levelsChanged() const {return m_levelsChanged;}
 
     protected:
       virtual void recomputeLevels( InstantId prev, InstantId inst);
+
+      void prepareLevels(const unsigned long first, const unsigned long last);
+
+    private:
+      /**
+       * @brief Computes the levels for an Instant from the current levels, and carries them past it.
+       */
+      void computeLevels(InstantId inst);
+
+      /**
+       * @brief Adds the quantities of the Transactions ending at an Instant to the production and consumption that must
+       * have happened after it.
+       */
+      void carryEndingTransactions(InstantId inst);
+
+      /**
+       * @brief Computes the levels for the next run of Instants in the batch, from the current levels.
+       * @return false if the run can't be computed in bulk and must be computed one Instant at a time.
+       */
+      bool computeBatch();
+
+      std::vector<double> m_batchQuantities; /**< The quantity bounds of the Transactions overlapping each Instant in the current run. */
+      std::vector<unsigned int> m_batchFlags; /**< The sums each of those Transactions contributes to. */
+      std::vector<unsigned int> m_batchCounts; /**< The number of Transactions overlapping each Instant in the current run. */
+      std::vector<double> m_batchLevels; /**< The values computed for each Instant in the current run. */
+      unsigned long m_batchNext; /**< The index of the next Instant to be recomputed in the batch. */
+      unsigned long m_batchFirst; /**< The index of the first Instant in the current run. */
+      unsigned long m_batchLast; /**< The index one past the last Instant in the current run. */
+      unsigned long m_batchEnd; /**< The index one past the last Instant in the batch. */
+      bool m_levelsChanged; /**< False if the last Instant recomputed came out as it was. */
     };
 }
 
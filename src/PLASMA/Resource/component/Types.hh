@@ -23,8 +23,8 @@
 #include <cassert>
 #include <iostream>
 #include <map>
-#include <list>
 #include <sstream>
+#include <vector>
 
 #include "Error.hh"
 #include "Instant.hh"
@@ -56,42 +56,13 @@ namespace EUROPA
 
   typedef std::pair< NodeIdentity, NodeIdentity > EdgeIdentity;
 
-  typedef std::map< NodeIdentity, Node* > NodeIdentity2Node;
-  typedef std::map< EdgeIdentity, Edge* > EdgeIdentity2Edge;
+  /**
+   * @brief The nodes of a graph, kept sorted on identity.
+   */
+  typedef std::vector< std::pair< NodeIdentity, Node* > > NodeIdentity2Node;
 
-  typedef std::list< Edge* > EdgeList;
-  typedef std::list< Node* > NodeList;
-
-class NodeHash
-#ifdef _MSC_VER
-    : public hash_compare< Node * >
-#endif //_MSC_VER
-{
- public:
-  typedef Node* argument_type;
-  typedef size_t result_type;
-  size_t operator()(Node* n) const
-  {
-    boost::hash<long> H;
-    return H( reinterpret_cast<long>(n));
-  }
-};
-
-  class EdgeHash
-#ifdef _MSC_VER
-      : public hash_compare< Edge * >
-#endif //_MSC_VER
-  {
-   public:
-    typedef Edge* argument_type;
-    typedef size_t result_type;
-    size_t operator()(Edge* n) const
-    {
-      boost::hash<long> H;
-      return H( reinterpret_cast<long>(n) );
-    }
-    
-  };
+  typedef std::vector< Edge* > EdgeList;
+  typedef std::vector< Node* > NodeList;
 
   class TransactionIdHash
 #ifdef _MSC_VER
@@ -111,20 +82,8 @@ class NodeHash
 
 //TODO: Do we need to keep this MSC_VER branch?
 #ifdef _MSC_VER
-  typedef map< Node*, bool > Node2Bool;
-  typedef map< Node*, eint > Node2Int;
-  typedef map< Node*, eint > Node2Long;
-  typedef map< Node*, edouble > Node2Double;
-
-  typedef map< Edge*, edouble > Edge2DoubleMap;
   typedef map< TransactionId, InstantId > TransactionId2InstantId;
 #else
-typedef boost::unordered_map< Node*, bool, NodeHash > Node2Bool;
-typedef boost::unordered_map< Node*, eint, NodeHash > Node2Int;
-typedef boost::unordered_map< Node*, eint, NodeHash > Node2Long;
-typedef boost::unordered_map< Node*, edouble, NodeHash > Node2Double;
-
-typedef boost::unordered_map< Edge*, edouble, EdgeHash > Edge2DoubleMap;
 typedef boost::unordered_map< TransactionId, InstantId, TransactionIdHash > TransactionId2InstantId;
 #endif
 /**
@@ -0,0 +1,379 @@
+
+#include "ModuleConstraintEngine.hh"
+#include "ModulePlanDatabase.hh"
+#include "ModuleRulesEngine.hh"
+#include "ModuleTemporalNetwork.hh"
+#include "ModuleSolvers.hh"
+#include "ModuleResource.hh"
+
+#include "FVDetector.hh"
+#include "GenericFVDetector.hh"
+#include "Instant.hh"
+#include "Profile.hh"
+#include "Reservoir.hh"
+#include "Reusable.hh"
+#include "InstantTokens.hh"
+#include "DurativeTokens.hh"
+
+#include "ConstraintEngine.hh"
+#include "Domains.hh"
+#include "Engine.hh"
+#include "Factory.hh"
+#include "PlanDatabase.hh"
+#include "Schema.hh"
+#include "TokenVariable.hh"
+#include "Utils.hh"
+
+#include <boost/cast.hpp>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * @file Times profile recomputation on generated reservoirs and reusables, for every combination of profile and
+ * flaw and violation detector, and writes one CSV row per combination.
+ *
+ * Usage: rs-benchmark [name=value ...]
+ *
+ *   resources=Reservoir,Reusable     the kinds of resource to generate
+ *   profiles=TimetableProfile,...    the profiles to run, by registered name
+ *   detectors=ClosedWorldFVDetector,...  the detectors to run, by registered name; GenericFVDetector is registered
+ *                                    here, as a detector that only checks consumption and production
+ *   transactions=50,200              the numbers of transactions to generate
+ *   flexibility=50                   the width of the time bounds of each transaction
+ *   minQuantity=1 maxQuantity=10     each transaction's quantity is [q, maxQuantity] for a q drawn from the range
+ *   capacity=40                      the capacity of a reusable, and half the upper limit of a reservoir
+ *   rounds=20                        the number of changes made to time the recomputes
+ *   seed=42                          the seed, so that every combination sees the same problems
+ *   csv=rs-benchmark.csv             the file the results are written to
+ *
+ * A reservoir is given alternating producers and consumers, each consumer following a producer, so its level stays
+ * around its initial capacity.  A reusable is given uses of a fixed duration, two transactions each.  Transaction i
+ * may happen in [10 * i, 10 * i + flexibility], so the flexibility sets how many transactions can overlap.
+ *
+ * Each row records whether the problem propagated without violation, the number of instants and of flawed instants,
+ * the time to propagate the problem once it is built, the mean time of the propagations that follow a change (each
+ * round fixes the start of a random token and then resets it) and the peak heap use above the empty engine.  Times are
+ * CPU time; the heap is measured by replacing the global operator new in this program only.
+ */
+
+namespace {
+  // the size of each block is kept in front of it so that the live bytes can be tracked on delete
+  const std::size_t s_header = 16;
+  std::size_t s_liveBytes = 0;
+  std::size_t s_peakBytes = 0;
+
+  void* allocate(std::size_t size) {
+    char* block = static_cast<char*>(std::malloc(size + s_header));
+    if(block == NULL)
+      return NULL;
+    *reinterpret_cast<std::size_t*>(block) = size;
+    s_liveBytes += size;
+    if(s_liveBytes > s_peakBytes)
+      s_peakBytes = s_liveBytes;
+    return block + s_header;
+  }
+
+  void deallocate(void* p) {
+    if(p == NULL)
+      return;
+    char* block = static_cast<char*>(p) - s_header;
+    s_liveBytes -= *reinterpret_cast<std::size_t*>(block);
+    std::free(block);
+  }
+}
+
+void* operator new(std::size_t size) throw(std::bad_alloc) {
+  void* p = allocate(size);
+  if(p == NULL)
+    throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](std::size_t size) throw(std::bad_alloc) {
+  return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) throw() {
+  return allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) throw() {
+  return allocate(size);
+}
+
+void operator delete(void* p) throw() {
+  deallocate(p);
+}
+
+void operator delete[](void* p) throw() {
+  deallocate(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) throw() {
+  deallocate(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) throw() {
+  deallocate(p);
+}
+
+using namespace EUROPA;
+
+/**
+ * GenericFVDetector leaves the level bounds to its subclasses.  This one takes them to be the limits, so it finds no
+ * level flaws and its rows time the consumption and production checks that the other detectors share.
+ */
+class LimitLevelFVDetector : public GenericFVDetector {
+ public:
+  LimitLevelFVDetector(const ResourceId res) : GenericFVDetector(res) {}
+ protected:
+  void getFDLevelBounds(const InstantId inst, edouble& lb, edouble& ub) const {getLimitBounds(inst, lb, ub);}
+  void getVDLevelBounds(const InstantId inst, edouble& lb, edouble& ub) const {getLimitBounds(inst, lb, ub);}
+};
+
+class ResourceBenchmarkEngine : public EngineBase {
+ public:
+  ResourceBenchmarkEngine() {
+    addModule((new ModuleConstraintEngine())->getId());
+    addModule((new ModuleConstraintLibrary())->getId());
+    addModule((new ModulePlanDatabase())->getId());
+    addModule((new ModuleRulesEngine())->getId());
+    addModule((new ModuleTemporalNetwork())->getId());
+    addModule((new ModuleSolvers())->getId());
+    addModule((new ModuleResource())->getId());
+    doStart();
+    Schema* schema = boost::polymorphic_cast<Schema*>(getComponent("Schema"));
+    schema->addObjectType("Resource");
+    FactoryMgr* fvdfm = boost::polymorphic_cast<FactoryMgr*>(getComponent("FVDetectorFactoryMgr"));
+    REGISTER_FVDETECTOR(fvdfm, LimitLevelFVDetector, GenericFVDetector);
+  }
+  ~ResourceBenchmarkEngine() {doShutdown();}
+};
+
+struct BenchmarkOptions {
+  std::vector<std::string> resources;
+  std::vector<std::string> profiles;
+  std::vector<std::string> detectors;
+  std::vector<int> transactions;
+  int flexibility;
+  int minQuantity;
+  int maxQuantity;
+  int capacity;
+  int rounds;
+  unsigned int seed;
+  std::string csv;
+};
+
+struct BenchmarkResult {
+  bool consistent;
+  int instants;
+  int flaws;
+  double buildTime;
+  double recomputeTime;
+  std::size_t peakBytes;
+};
+
+static const int s_spacing = 10;
+
+static double seconds() {
+  return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+}
+
+static std::vector<std::string> split(const std::string& value) {
+  std::vector<std::string> result;
+  tokenize(value, result, ",");
+  return result;
+}
+
+static bool parseOptions(int argc, const char** argv, BenchmarkOptions& options) {
+  options.resources = split("Reservoir,Reusable");
+  options.profiles = split("TimetableProfile,FlowProfile,IncrementalFlowProfile,GroundedProfile");
+  options.detectors = split("ClosedWorldFVDetector,OpenWorldFVDetector,GroundedFVDetector,GenericFVDetector");
+  options.transactions.push_back(50);
+  options.transactions.push_back(200);
+  options.flexibility = 50;
+  options.minQuantity = 1;
+  options.maxQuantity = 10;
+  options.capacity = 40;
+  options.rounds = 20;
+  options.seed = 42;
+  options.csv = "rs-benchmark.csv";
+
+  for(int i = 1; i < argc; ++i) {
+    const std::string arg(argv[i]);
+    const std::string::size_type eq = arg.find('=');
+    if(eq == std::string::npos) {
+      std::cerr << "Expected name=value, got " << arg << std::endl;
+      return false;
+    }
+    const std::string name = arg.substr(0, eq);
+    const std::string value = arg.substr(eq + 1);
+    if(name == "resources")
+      options.resources = split(value);
+    else if(name == "profiles")
+      options.profiles = split(value);
+    else if(name == "detectors")
+      options.detectors = split(value);
+    else if(name == "transactions") {
+      const std::vector<std::string> counts = split(value);
+      options.transactions.clear();
+      for(std::vector<std::string>::const_iterator it = counts.begin(); it != counts.end(); ++it)
+        options.transactions.push_back(toValue<int>(*it));
+    }
+    else if(name == "flexibility")
+      options.flexibility = toValue<int>(value);
+    else if(name == "minQuantity")
+      options.minQuantity = toValue<int>(value);
+    else if(name == "maxQuantity")
+      options.maxQuantity = toValue<int>(value);
+    else if(name == "capacity")
+      options.capacity = toValue<int>(value);
+    else if(name == "rounds")
+      options.rounds = toValue<int>(value);
+    else if(name == "seed")
+      options.seed = toValue<unsigned int>(value);
+    else if(name == "csv")
+      options.csv = value;
+    else {
+      std::cerr << "Unknown option " << name << std::endl;
+      return false;
+    }
+  }
+  if(options.minQuantity > options.maxQuantity) {
+    std::cerr << "minQuantity must not exceed maxQuantity" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+static int drawQuantity(const BenchmarkOptions& options) {
+  return options.minQuantity + std::rand() % (options.maxQuantity - options.minQuantity + 1);
+}
+
+/**
+ * @brief Builds the resource and its tokens, propagates them and times the propagations after a number of changes.
+ */
+static BenchmarkResult run(const BenchmarkOptions& options, const std::string& resourceType,
+                           const std::string& profileName, const std::string& detectorName,
+                           const int transactionCount) {
+  ResourceBenchmarkEngine engine;
+  ConstraintEngine& ce = *boost::polymorphic_cast<ConstraintEngine*>(engine.getComponent("ConstraintEngine"));
+  PlanDatabase& db = *boost::polymorphic_cast<PlanDatabase*>(engine.getComponent("PlanDatabase"));
+
+  BenchmarkResult result;
+  s_peakBytes = s_liveBytes;
+  const std::size_t baseBytes = s_liveBytes;
+  std::srand(options.seed);
+
+  Resource* resource = NULL;
+  std::vector<Token*> tokens;
+  if(resourceType == "Reservoir") {
+    resource = new Reservoir(db.getId(), "Reservoir", "Bench", detectorName, profileName,
+                             options.capacity, options.capacity, 0, 2 * options.capacity);
+    for(int i = 0; i < transactionCount; ++i) {
+      const IntervalIntDomain time(s_spacing * i, s_spacing * i + options.flexibility);
+      const IntervalDomain quantity(drawQuantity(options), options.maxQuantity);
+      if(i % 2 == 0)
+        tokens.push_back(new ProducerToken(db.getId(), "Reservoir.produce", time, quantity));
+      else
+        tokens.push_back(new ConsumerToken(db.getId(), "Reservoir.consume", time, quantity));
+      tokens.back()->getObject()->specify(resource->getKey());
+    }
+  }
+  else {
+    checkError(resourceType == "Reusable", "Unknown resource type " << resourceType);
+    resource = new Reusable(db.getId(), "Reusable", "Bench", detectorName, profileName,
+                            options.capacity, options.capacity, 0);
+    const int duration = 2 * s_spacing;
+    for(int i = 0; i < transactionCount; i += 2) {
+      tokens.push_back(new ReusableToken(db.getId(), "Reusable.uses",
+                                         IntervalIntDomain(s_spacing * i, s_spacing * i + options.flexibility),
+                                         IntervalIntDomain(s_spacing * i + duration,
+                                                           s_spacing * i + duration + options.flexibility),
+                                         IntervalIntDomain(duration),
+                                         IntervalDomain(drawQuantity(options), options.maxQuantity),
+                                         "Bench"));
+    }
+  }
+
+  double start = seconds();
+  result.consistent = ce.propagate();
+  result.buildTime = seconds() - start;
+
+  result.recomputeTime = 0;
+  if(result.consistent) {
+    int propagations = 0;
+    for(int i = 0; i < options.rounds; ++i) {
+      Token* token = tokens[std::rand() % tokens.size()];
+      token->start()->specify(token->start()->lastDomain().getLowerBound());
+      start = seconds();
+      ce.propagate();
+      result.recomputeTime += seconds() - start;
+      token->start()->reset();
+      start = seconds();
+      ce.propagate();
+      result.recomputeTime += seconds() - start;
+      propagations += 2;
+    }
+    if(propagations > 0)
+      result.recomputeTime /= propagations;
+  }
+
+  result.instants = 0;
+  for(ProfileIterator it(resource->getProfile()); !it.done(); it.next())
+    ++result.instants;
+  std::vector<InstantId> flawed;
+  resource->getFlawedInstants(flawed);
+  result.flaws = flawed.size();
+  result.peakBytes = s_peakBytes - baseBytes;
+
+  for(std::vector<Token*>::const_iterator it = tokens.begin(); it != tokens.end(); ++it)
+    delete *it;
+  delete resource;
+  return result;
+}
+
+int main(int argc, const char** argv) {
+  BenchmarkOptions options;
+  if(!parseOptions(argc, argv, options))
+    return 1;
+
+  std::ofstream csv(options.csv.c_str());
+  if(!csv) {
+    std::cerr << "Can't write " << options.csv << std::endl;
+    return 1;
+  }
+  const std::string header = "resource,profile,detector,transactions,flexibility,min_quantity,max_quantity,capacity,"
+      "consistent,instants,flaws,build_ms,recompute_ms,peak_kb";
+  csv << header << std::endl;
+  std::cout << header << std::endl;
+
+  for(std::vector<std::string>::const_iterator resourceType = options.resources.begin();
+      resourceType != options.resources.end(); ++resourceType) {
+    for(std::vector<int>::const_iterator count = options.transactions.begin();
+        count != options.transactions.end(); ++count) {
+      for(std::vector<std::string>::const_iterator profile = options.profiles.begin();
+          profile != options.profiles.end(); ++profile) {
+        for(std::vector<std::string>::const_iterator detector = options.detectors.begin();
+            detector != options.detectors.end(); ++detector) {
+          const BenchmarkResult result = run(options, *resourceType, *profile, *detector, *count);
+          std::stringstream row;
+          row << *resourceType << "," << *profile << "," << *detector << "," << *count << ","
+              << options.flexibility << "," << options.minQuantity << "," << options.maxQuantity << ","
+              << options.capacity << "," << (result.consistent ? 1 : 0) << "," << result.instants << ","
+              << result.flaws << "," << 1000 * result.buildTime << "," << 1000 * result.recomputeTime << ","
+              << result.peakBytes / 1024;
+          csv << row.str() << std::endl;
+          std::cout << row.str() << std::endl;
+        }
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,164 @@
+
+#include "ModuleConstraintEngine.hh"
+#include "ModulePlanDatabase.hh"
+#include "ModuleRulesEngine.hh"
+#include "ModuleTemporalNetwork.hh"
+#include "ModuleSolvers.hh"
+#include "ModuleResource.hh"
+
+#include "FVDetector.hh"
+#include "FlowProfile.hh"
+#include "IncrementalFlowProfile.hh"
+#include "Transaction.hh"
+
+#include "ConstraintEngine.hh"
+#include "Domains.hh"
+#include "Engine.hh"
+#include "PlanDatabase.hh"
+#include "Variable.hh"
+
+#include <boost/cast.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+#include <string>
+#include <vector>
+
+/**
+ * @file Counts the heap allocations a FlowProfile and an IncrementalFlowProfile make per recompute once warmed up.
+ *
+ * Usage: rs-flow-allocations [transactions] [recomputes]
+ *
+ * The profiles are built over transactions with flexible times and quantities.  Each recompute follows a change to
+ * the quantity of one transaction, alternately specifying and resetting it, so the set of instants stays the same
+ * and only the levels have to be recomputed.  Allocations are counted by replacing the global operator new in this
+ * program only, and only while Profile::recompute() runs.
+ */
+
+namespace {
+  bool s_counting = false;
+  unsigned long s_allocations = 0;
+}
+
+void* operator new(std::size_t size) throw(std::bad_alloc) {
+  if(s_counting)
+    ++s_allocations;
+  void* p = std::malloc(size == 0 ? 1 : size);
+  if(p == NULL)
+    throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](std::size_t size) throw(std::bad_alloc) {
+  return operator new(size);
+}
+
+void operator delete(void* p) throw() {
+  std::free(p);
+}
+
+void operator delete[](void* p) throw() {
+  std::free(p);
+}
+
+using namespace EUROPA;
+
+class FlowAllocationEngine : public EngineBase {
+ public:
+  FlowAllocationEngine() {
+    addModule((new ModuleConstraintEngine())->getId());
+    addModule((new ModuleConstraintLibrary())->getId());
+    addModule((new ModulePlanDatabase())->getId());
+    addModule((new ModuleRulesEngine())->getId());
+    addModule((new ModuleTemporalNetwork())->getId());
+    addModule((new ModuleSolvers())->getId());
+    addModule((new ModuleResource())->getId());
+    doStart();
+  }
+  ~FlowAllocationEngine() {doShutdown();}
+};
+
+class NoFlawDetector : public FVDetector {
+ public:
+  NoFlawDetector() : FVDetector(ResourceId::noId()) {}
+  bool detect(const InstantId) {return false;}
+  void initialize(const InstantId) {}
+  void initialize() {}
+  PSResourceProfile* getFDLevelProfile() {return NULL;}
+  PSResourceProfile* getVDLevelProfile() {return NULL;}
+};
+
+static double seconds() {
+  return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+}
+
+template<class ProfileType>
+static void run(const std::string& name, const int transactionCount, const int recomputeCount) {
+  FlowAllocationEngine engine;
+  ConstraintEngine& ce = *boost::polymorphic_cast<ConstraintEngine*>(engine.getComponent("ConstraintEngine"));
+  PlanDatabase& db = *boost::polymorphic_cast<PlanDatabase*>(engine.getComponent("PlanDatabase"));
+  db.close();
+
+  NoFlawDetector detector;
+  ProfileType* profile = new ProfileType(db.getId(), detector.getId());
+
+  std::srand(42);
+  std::vector<ConstrainedVariableId> variables;
+  std::vector<Transaction*> transactions;
+  const int horizon = transactionCount * 4;
+  for(int i = 0; i < transactionCount; ++i) {
+    const int start = std::rand() % horizon;
+    const int width = std::rand() % 40;
+    const int quantity = 1 + std::rand() % 10;
+    ConstrainedVariableId time =
+        (new Variable<IntervalIntDomain>(ce.getId(), IntervalIntDomain(start, start + width)))->getId();
+    ConstrainedVariableId qty =
+        (new Variable<IntervalDomain>(ce.getId(), IntervalDomain(quantity, quantity + 5)))->getId();
+    variables.push_back(time);
+    variables.push_back(qty);
+    transactions.push_back(new Transaction(time, qty, i % 2 == 1, EntityId::noId()));
+    profile->addTransaction(transactions.back()->getId());
+  }
+  profile->recompute();
+
+  // the first rounds size the pools; count only the ones after them
+  const int warmUp = std::min(recomputeCount, 2 * transactionCount);
+  unsigned long allocations = 0;
+  double elapsed = 0;
+  for(int i = 0; i < warmUp + recomputeCount; ++i) {
+    const ConstrainedVariableId qty = transactions[(i / 2) % transactionCount]->quantity();
+    if(i % 2 == 0)
+      qty->specify(qty->lastDomain().getLowerBound());
+    else
+      qty->reset();
+
+    const double start = seconds();
+    s_allocations = 0;
+    s_counting = true;
+    profile->recompute();
+    s_counting = false;
+    if(i >= warmUp) {
+      allocations += s_allocations;
+      elapsed += seconds() - start;
+    }
+  }
+
+  std::printf("%s transactions=%d recomputes=%d allocations/recompute=%.2f time/recompute=%.3fms\n",
+              name.c_str(), transactionCount, recomputeCount,
+              static_cast<double>(allocations) / recomputeCount, 1000 * elapsed / recomputeCount);
+
+  delete profile;
+  for(std::vector<Transaction*>::const_iterator it = transactions.begin(); it != transactions.end(); ++it)
+    delete *it;
+  for(std::vector<ConstrainedVariableId>::const_iterator it = variables.begin(); it != variables.end(); ++it)
+    delete static_cast<ConstrainedVariable*>(*it);
+}
+
+int main(int argc, const char** argv) {
+  const int transactionCount = argc > 1 ? std::atoi(argv[1]) : 200;
+  const int recomputeCount = argc > 2 ? std::atoi(argv[2]) : 200;
+  run<FlowProfile>("FlowProfile", transactionCount, recomputeCount);
+  run<IncrementalFlowProfile>("IncrementalFlowProfile", transactionCount, recomputeCount);
+  return 0;
+}
@@ -53,6 +53,7 @@
 #include <iostream>
 #include <string>
 #include <list>
+#include <cstring>
 
 #include <boost/cast.hpp>
 #include <boost/shared_ptr.hpp>
@@ -268,6 +269,9 @@ public:
     //other tests
     EUROPA_runTest(testPointProfileQueries);
     EUROPA_runTest(testGnats3244);
+    EUROPA_runTest(testOverlappingTransactions);
+    EUROPA_runTest(testLevelKernels);
+    EUROPA_runTest(testDirtyWindowRecompute);
     return true;
   }
 private:
@@ -1035,6 +1039,40 @@ private:
 	  result = d;
   }
 
+  static void checkLevelQueries(const ProfileId profile) {
+    IntervalDomain result;
+    const std::vector<Profile::LevelRecord>& levels = profile->getLevels();
+    for(eint lb = -1; lb <= 11; ++lb) {
+      for(eint ub = lb; ub <= 11; ++ub) {
+        IntervalDomain expected;
+        profile->getLevel(lb, expected);
+        edouble minLower = expected.getLowerBound(), maxUpper = expected.getUpperBound();
+        for(std::vector<Profile::LevelRecord>::const_iterator it = levels.begin(); it != levels.end(); ++it) {
+          if(it->time > lb && it->time <= ub) {
+            minLower = std::min(minLower, it->lowerLevel);
+            maxUpper = std::max(maxUpper, it->upperLevel);
+          }
+        }
+        profile->getLevelRange(lb, ub, result);
+        CPPUNIT_ASSERT(result == IntervalDomain(minLower, maxUpper));
+      }
+      for(edouble level = -10; level <= 6; level += 5) {
+        eint mayBe = PLUS_INFINITY, mustBe = PLUS_INFINITY;
+        for(eint time = 11; time >= lb; --time) {
+          IntervalDomain dom;
+          profile->getLevel(time, dom);
+          if(dom.getLowerBound() < level)
+            mayBe = time;
+          if(dom.getUpperBound() < level)
+            mustBe = time;
+        }
+        // The level past the last instant holds forever
+        CPPUNIT_ASSERT(profile->getFirstTimeBelow(level, lb) == mayBe);
+        CPPUNIT_ASSERT(profile->getFirstTimeBelow(level, lb, true) == mustBe);
+      }
+    }
+  }
+
   static bool testPointProfileQueries()
   {
     // Define input constrains for the resource spec
@@ -1082,6 +1120,29 @@ private:
     getLevel(r, 1000, result);
     CPPUNIT_ASSERT(result.isSingleton() && result.getSingletonValue() == (initialCapacity + 5 - 10));
 
+    // The level records mirror the instants, in time order
+    const std::vector<Profile::LevelRecord>& levels = r.getProfile()->getLevels();
+    CPPUNIT_ASSERT(levels.size() == r.getProfile()->getInstants().size());
+    std::map<eint, InstantId>::const_iterator instIt = r.getProfile()->getInstants().begin();
+    for(std::vector<Profile::LevelRecord>::const_iterator it = levels.begin(); it != levels.end(); ++it, ++instIt) {
+      CPPUNIT_ASSERT(it->time == instIt->first);
+      CPPUNIT_ASSERT(it->lowerLevel == instIt->second->getLowerLevel());
+      CPPUNIT_ASSERT(it->upperLevel == instIt->second->getUpperLevel());
+      CPPUNIT_ASSERT(((it->flags & Profile::FLAWED) != 0) == instIt->second->isFlawed());
+    }
+
+    // The aggregate queries agree with the levels at the instants they span
+    ProfileId profile = r.getProfile();
+    checkLevelQueries(profile);
+    CPPUNIT_ASSERT(profile->getFirstTimeBelow(-9, 0) == 2);
+    CPPUNIT_ASSERT(profile->getFirstTimeBelow(-9, 0, true) == PLUS_INFINITY);
+    CPPUNIT_ASSERT(r.getMinUsage(0, 1000) == -10 && r.getMaxUsage(0, 1000) == 5);
+
+    // And remain so as recomputation updates them
+    t3.restrictBaseDomain(IntervalIntDomain(8, 10));
+    checkLevelQueries(profile);
+    CPPUNIT_ASSERT(profile->getFirstTimeBelow(-4, 5) == 8);
+
     // There should be no violations, only flaws
     CPPUNIT_ASSERT(ce.propagate());
 
@@ -1178,6 +1239,212 @@ private:
     RESOURCE_DEFAULT_TEARDOWN();
     return true;
   }
+  static bool checkOverlap(const InstantId inst, const std::set<TransactionId>& expected) {
+    return inst->getTransactions() == expected;
+  }
+
+  static bool testOverlappingTransactions() {
+    RESOURCE_DEFAULT_SETUP(ce, db, false);
+    DummyDetector detector(ResourceId::noId());
+    DummyProfile profile(db.getId(), detector.getId());
+    BareTransactionDeleter deleter(profile);
+
+    Variable<IntervalIntDomain> t1(ce.getId(), IntervalIntDomain(0, 10), false, true, "t1");
+    Variable<IntervalIntDomain> t2(ce.getId(), IntervalIntDomain(10, 15), false, true, "t2");
+    Variable<IntervalIntDomain> t3(ce.getId(), IntervalIntDomain(5, 15), false, true, "t3");
+    Variable<IntervalDomain> q1(ce.getId(), IntervalDomain(1, 1), false, true, "q1");
+    Variable<IntervalDomain> q2(ce.getId(), IntervalDomain(1, 1), false, true, "q2");
+    Variable<IntervalDomain> q3(ce.getId(), IntervalDomain(1, 1), false, true, "q3");
+
+    TransactionPtr trans1(new Transaction(t1.getId(), q1.getId(), false, EntityId::noId()), deleter);
+    TransactionPtr trans2(new Transaction(t2.getId(), q2.getId(), true, EntityId::noId()), deleter);
+    TransactionPtr trans3(new Transaction(t3.getId(), q3.getId(), true, EntityId::noId()), deleter);
+
+    profile.addTransaction(trans1->getId());
+    profile.addTransaction(trans2->getId());
+    profile.addTransaction(trans3->getId());
+
+    std::set<TransactionId> at0, at5, at10, at15;
+    at0.insert(trans1->getId());
+    at5.insert(trans1->getId());
+    at5.insert(trans3->getId());
+    at10.insert(trans1->getId());
+    at10.insert(trans2->getId());
+    at10.insert(trans3->getId());
+    at15.insert(trans2->getId());
+    at15.insert(trans3->getId());
+
+    // out of order, then swept
+    CPPUNIT_ASSERT(checkOverlap(profile.getInstant(10), at10));
+    CPPUNIT_ASSERT(checkOverlap(profile.getInstant(0), at0));
+    CPPUNIT_ASSERT(checkOverlap(profile.getInstant(5), at5));
+    CPPUNIT_ASSERT(checkOverlap(profile.getInstant(10), at10));
+    CPPUNIT_ASSERT(checkOverlap(profile.getInstant(15), at15));
+    CPPUNIT_ASSERT(profile.getInstant(5)->getOverlappingTransactions() == at5);
+
+    std::vector<TransactionId> window;
+    profile.getOverlappingTransactions(11, 12, window);
+    CPPUNIT_ASSERT(std::set<TransactionId>(window.begin(), window.end()) == at15);
+
+    // restricting t3 moves it to a new instant, and removes the one it no longer starts at
+    t3.restrictBaseDomain(IntervalIntDomain(12, 15));
+    CPPUNIT_ASSERT(ce.propagate());
+    CPPUNIT_ASSERT(profile.getInstants().size() == 4);
+    CPPUNIT_ASSERT(profile.getInstants().find(5) == profile.getInstants().end());
+    at10.erase(trans3->getId());
+    CPPUNIT_ASSERT(checkOverlap(profile.getInstant(0), at0));
+    CPPUNIT_ASSERT(checkOverlap(profile.getInstant(10), at10));
+    CPPUNIT_ASSERT(checkOverlap(profile.getInstant(12), at15));
+    CPPUNIT_ASSERT(checkOverlap(profile.getInstant(15), at15));
+
+    RESOURCE_DEFAULT_TEARDOWN();
+    return true;
+  }
+
+  // Computes a profile of the transactions with the given kernel, and appends every value of every instant to levels
+  static void computeLevels(ConstraintEngine& ce, PlanDatabase& db, const TimetableProfile::LevelKernel kernel,
+                            const std::vector<TransactionId>& transactions, std::vector<double>& levels) {
+    TimetableProfile::setLevelKernel(kernel);
+    DummyDetector detector(ResourceId::noId());
+    TimetableProfile profile(db.getId(), detector.getId());
+
+    // the second half is added after the first is computed, to recompute from the middle of the profile
+    for(unsigned int i = 0; i < transactions.size(); ++i) {
+      profile.addTransaction(transactions[i]);
+      if(i == transactions.size() / 2 || i == transactions.size() - 1) {
+        CPPUNIT_ASSERT(ce.propagate());
+        profile.recompute();
+      }
+    }
+
+    getInstantValues(profile, levels);
+
+    for(unsigned int i = 0; i < transactions.size(); ++i)
+      profile.removeTransaction(transactions[i]);
+  }
+
+  static void getInstantValues(Profile& profile, std::vector<double>& levels) {
+    for(std::map<eint, InstantId>::const_iterator it = profile.getInstants().begin(); it != profile.getInstants().end(); ++it) {
+      InstantId inst = it->second;
+      edouble values[] = {inst->getLowerLevel(), inst->getLowerLevelMax(), inst->getUpperLevelMin(), inst->getUpperLevel(),
+                          inst->getMinInstantConsumption(), inst->getMaxInstantConsumption(),
+                          inst->getMinInstantProduction(), inst->getMaxInstantProduction(),
+                          inst->getMinCumulativeConsumption(), inst->getMaxCumulativeConsumption(),
+                          inst->getMinCumulativeProduction(), inst->getMaxCumulativeProduction(),
+                          inst->getMinPrevConsumption(), inst->getMaxPrevConsumption(),
+                          inst->getMinPrevProduction(), inst->getMaxPrevProduction()};
+      levels.push_back(cast_double(inst->getTime()));
+      for(unsigned int i = 0; i < sizeof(values) / sizeof(values[0]); ++i)
+        levels.push_back(cast_double(values[i]));
+    }
+  }
+
+  static bool testLevelKernels() {
+    RESOURCE_DEFAULT_SETUP(ce, db, false);
+    TimetableProfile::LevelKernel best = TimetableProfile::getLevelKernel();
+
+    // fractional quantities, so a change in the order of any sum would show
+    std::list<ConstrainedVariableId> variables;
+    std::list<TransactionPtr> transactionPtrs;
+    std::vector<TransactionId> transactions;
+    for(int i = 0; i < 60; ++i) {
+      int lb = (i < 30 ? (i * 7) % 50 : 40 + (i * 7) % 30);
+      int ub = (i % 5 == 0 ? lb : lb + (i * 13) % 30);
+      edouble qlb = 0.1 * (i % 7);
+      edouble qub = (i % 11 == 0 ? edouble(PLUS_INFINITY) : qlb + 0.3 * (i % 4));
+      ConstrainedVariableId t = (new Variable<IntervalIntDomain>(ce.getId(), IntervalIntDomain(lb, ub)))->getId();
+      ConstrainedVariableId q = (new Variable<IntervalDomain>(ce.getId(), IntervalDomain(qlb, qub)))->getId();
+      variables.push_back(t);
+      variables.push_back(q);
+      transactionPtrs.push_back(TransactionPtr(new Transaction(t, q, i % 2 == 1, EntityId::noId())));
+      transactions.push_back(transactionPtrs.back()->getId());
+    }
+
+    std::vector<double> scalar;
+    computeLevels(ce, db, TimetableProfile::SCALAR, transactions, scalar);
+    CPPUNIT_ASSERT(scalar.size() > 17 * 32);
+
+    // the bulk kernels must agree with the scalar one to the bit
+    TimetableProfile::LevelKernel kernels[] = {TimetableProfile::SSE2, TimetableProfile::AVX2};
+    for(unsigned int i = 0; i < sizeof(kernels) / sizeof(kernels[0]); ++i) {
+      if(TimetableProfile::setLevelKernel(kernels[i]) != kernels[i])
+        continue;
+      std::vector<double> levels;
+      computeLevels(ce, db, kernels[i], transactions, levels);
+      CPPUNIT_ASSERT(levels.size() == scalar.size());
+      CPPUNIT_ASSERT(std::memcmp(&levels[0], &scalar[0], scalar.size() * sizeof(double)) == 0);
+    }
+
+    TimetableProfile::setLevelKernel(best);
+    transactionPtrs.clear();
+    for(std::list<ConstrainedVariableId>::iterator it = variables.begin(); it != variables.end(); ++it)
+      delete static_cast<ConstrainedVariable*>(*it);
+    RESOURCE_DEFAULT_TEARDOWN();
+    return true;
+  }
+
+  static bool testDirtyWindowRecompute() {
+    RESOURCE_DEFAULT_SETUP(ce, db, false);
+    std::list<ConstrainedVariableId> variables;
+    std::list<TransactionPtr> transactionPtrs;
+    std::vector<TransactionId> transactions;
+    for(int i = 0; i < 100; ++i) {
+      ConstrainedVariableId t = (new Variable<IntervalIntDomain>(ce.getId(), IntervalIntDomain(10 * i, 10 * i + 5)))->getId();
+      ConstrainedVariableId q = (new Variable<IntervalDomain>(ce.getId(), IntervalDomain(1, 2)))->getId();
+      variables.push_back(t);
+      variables.push_back(q);
+      transactionPtrs.push_back(TransactionPtr(new Transaction(t, q, i % 2 == 1, EntityId::noId())));
+      transactions.push_back(transactionPtrs.back()->getId());
+    }
+
+    {
+      DummyDetector detector(ResourceId::noId());
+      TimetableProfile profile(db.getId(), detector.getId());
+      for(unsigned int i = 0; i < transactions.size(); ++i)
+        profile.addTransaction(transactions[i]);
+      CPPUNIT_ASSERT(ce.propagate());
+      profile.recompute();
+      CPPUNIT_ASSERT(profile.getInstantsRecomputed() == profile.getInstants().size());
+
+      // the levels are the same again past the old bounds, so only the instants for the new ones and the next are visited
+      unsigned long visited = profile.getInstantsRecomputed();
+      transactions[50]->time()->restrictBaseDomain(IntervalIntDomain(502, 503));
+      CPPUNIT_ASSERT(ce.propagate());
+      profile.recompute();
+      CPPUNIT_ASSERT(profile.getInstantsRecomputed() - visited == 3);
+
+      // whereas what must have been consumed by the end of a transaction carries on to the end of the profile
+      visited = profile.getInstantsRecomputed();
+      transactions[70]->quantity()->restrictBaseDomain(IntervalDomain(1.5, 2));
+      CPPUNIT_ASSERT(ce.propagate());
+      profile.recompute();
+      CPPUNIT_ASSERT(profile.getInstantsRecomputed() - visited ==
+                     static_cast<unsigned long>(std::distance(profile.getInstants().find(700), profile.getInstants().end())));
+
+      // a temporal constraint doesn't change the levels of a timetable
+      visited = profile.getInstantsRecomputed();
+      ConstraintId precedes = db.getClient()->createConstraint("precedes", makeScope(transactions[10]->time(), transactions[20]->time()));
+      CPPUNIT_ASSERT(ce.propagate());
+      profile.recompute();
+      CPPUNIT_ASSERT(profile.getInstantsRecomputed() == visited);
+      delete static_cast<Constraint*>(precedes);
+
+      // and the levels are those of a profile computed from scratch
+      std::vector<double> levels, expected;
+      getInstantValues(profile, levels);
+      computeLevels(ce, db, TimetableProfile::getLevelKernel(), transactions, expected);
+      CPPUNIT_ASSERT(levels == expected);
+
+      for(unsigned int i = 0; i < transactions.size(); ++i)
+        profile.removeTransaction(transactions[i]);
+    }
+
+    transactionPtrs.clear();
+    for(std::list<ConstrainedVariableId>::iterator it = variables.begin(); it != variables.end(); ++it)
+      delete static_cast<ConstrainedVariable*>(*it);
+    RESOURCE_DEFAULT_TEARDOWN();
+    return true;
+  }
 };
 
 class ResourceTest {
@@ -1189,6 +1456,8 @@ public:
     EUROPA_runTest(testReusable);
     EUROPA_runTest(testReservoirRemove);
     EUROPA_runTest(testDanglingTransaction);
+    EUROPA_runTest(testConcurrentRecompute);
+    EUROPA_runTest(testEnergeticReasoning);
     return true;
   }
 private:
@@ -1407,6 +1676,104 @@ private:
     return true;
   }
 
+  static bool testConcurrentRecompute() {
+    RESOURCE_DEFAULT_SETUP(ce, db, false);
+    ProfilePropagator* propagator =
+        id_cast<ProfilePropagator>(ce.getPropagatorByName(ProfilePropagator::PROPAGATOR_NAME()));
+    propagator->setRecomputeThreadCount(4);
+
+    // The consumers on even reservoirs may overlap, which is a flaw
+    std::vector<Reservoir*> reservoirs;
+    std::vector<ConsumerToken*> consumers;
+    for(int i = 0; i < 8; ++i) {
+      std::stringstream name;
+      name << "Battery" << i;
+      reservoirs.push_back(new Reservoir(db.getId(), "Reservoir", name.str(), "OpenWorldFVDetector", "TimetableProfile",
+                                         10, 10, 0, 1000, 0, 5));
+      consumers.push_back(new ConsumerToken(db.getId(), "Reservoir.consume", IntervalIntDomain(0, 10), IntervalDomain(3, 5)));
+      consumers.push_back(new ConsumerToken(db.getId(), "Reservoir.consume",
+                                            (i % 2 == 0 ? IntervalIntDomain(0, 10) : IntervalIntDomain(20, 30)),
+                                            IntervalDomain(3, 5)));
+      consumers[2 * i]->getObject()->specify(reservoirs[i]->getKey());
+      consumers[2 * i + 1]->getObject()->specify(reservoirs[i]->getKey());
+    }
+
+    CPPUNIT_ASSERT(ce.propagate());
+    for(int i = 0; i < 8; ++i)
+      CPPUNIT_ASSERT(reservoirs[i]->hasTokensToOrder() == (i % 2 == 0));
+
+    // Making the consumers on two reservoirs overlap violates them, and the others keep their flaws
+    for(int i = 4; i < 10; ++i)
+      if(i != 6 && i != 7)
+        consumers[i]->getTime()->specify(5);
+    CPPUNIT_ASSERT(!ce.propagate());
+    for(int i = 4; i < 10; ++i)
+      if(i != 6 && i != 7)
+        consumers[i]->getTime()->reset();
+    CPPUNIT_ASSERT(ce.propagate());
+    for(int i = 0; i < 8; ++i)
+      CPPUNIT_ASSERT(reservoirs[i]->hasTokensToOrder() == (i % 2 == 0));
+
+    // Separating them resolves the flaw
+    consumers[0]->getTime()->specify(0);
+    consumers[1]->getTime()->specify(10);
+    CPPUNIT_ASSERT(ce.propagate());
+    CPPUNIT_ASSERT(!reservoirs[0]->hasTokensToOrder());
+    CPPUNIT_ASSERT(reservoirs[2]->hasTokensToOrder());
+
+    for(std::vector<ConsumerToken*>::const_iterator it = consumers.begin(); it != consumers.end(); ++it)
+      delete *it;
+    for(std::vector<Reservoir*>::const_iterator it = reservoirs.begin(); it != reservoirs.end(); ++it)
+      delete *it;
+    propagator->setRecomputeThreadCount(1);
+    RESOURCE_DEFAULT_TEARDOWN();
+    return true;
+  }
+
+  static bool testEnergeticReasoning() {
+    RESOURCE_DEFAULT_SETUP(ce, db, false);
+    Reusable crane(db.getId(), "Reusable", "Crane", "ClosedWorldFVDetector", "EnergeticTimetableProfile", 1, 1, 0);
+    Reusable drill(db.getId(), "Reusable", "Drill", "ClosedWorldFVDetector", "EnergeticTimetableProfile", 1, 1, 0);
+
+    // Once a is fixed, b can't overlap it, and can again when a is relaxed
+    ReusableToken a(db.getId(), "Reusable.uses", IntervalIntDomain(0, 10), IntervalIntDomain(10, 20), IntervalIntDomain(10),
+                    IntervalDomain(1), "Crane");
+    ReusableToken b(db.getId(), "Reusable.uses", IntervalIntDomain(0, 20), IntervalIntDomain(5, 25), IntervalIntDomain(5),
+                    IntervalDomain(1), "Crane");
+    CPPUNIT_ASSERT(ce.propagate());
+    CPPUNIT_ASSERT(b.start()->lastDomain().getLowerBound() == 0);
+    a.start()->specify(0);
+    CPPUNIT_ASSERT(ce.propagate());
+    CPPUNIT_ASSERT(b.start()->lastDomain().getLowerBound() == 10);
+    CPPUNIT_ASSERT(b.end()->lastDomain().getLowerBound() == 15);
+    a.start()->reset();
+    CPPUNIT_ASSERT(ce.propagate());
+    CPPUNIT_ASSERT(b.start()->lastDomain().getLowerBound() == 0);
+
+    // c and d have no compulsory parts, but between them they fill [0 10), so e must start after it
+    ReusableToken c(db.getId(), "Reusable.uses", IntervalIntDomain(0, 5), IntervalIntDomain(5, 10), IntervalIntDomain(5),
+                    IntervalDomain(1), "Drill");
+    ReusableToken d(db.getId(), "Reusable.uses", IntervalIntDomain(0, 5), IntervalIntDomain(5, 10), IntervalIntDomain(5),
+                    IntervalDomain(1), "Drill");
+    ReusableToken e(db.getId(), "Reusable.uses", IntervalIntDomain(0, 20), IntervalIntDomain(5, 25), IntervalIntDomain(5),
+                    IntervalDomain(1), "Drill");
+    CPPUNIT_ASSERT(ce.propagate());
+    CPPUNIT_ASSERT(e.start()->lastDomain().getLowerBound() == 10);
+    CPPUNIT_ASSERT(c.start()->lastDomain().getLowerBound() == 0);
+    CPPUNIT_ASSERT(d.start()->lastDomain().getLowerBound() == 0);
+
+    // A third activity in [0 10) can't fit
+    ReusableToken* f = new ReusableToken(db.getId(), "Reusable.uses", IntervalIntDomain(0, 5), IntervalIntDomain(5, 10),
+                                         IntervalIntDomain(5), IntervalDomain(1), "Drill");
+    CPPUNIT_ASSERT(!ce.propagate());
+    delete f;
+    CPPUNIT_ASSERT(ce.propagate());
+    CPPUNIT_ASSERT(e.start()->lastDomain().getLowerBound() == 10);
+
+    RESOURCE_DEFAULT_TEARDOWN();
+    return true;
+  }
+
   static bool testDanglingTransaction() {
     RESOURCE_DEFAULT_SETUP(unused(ce), db, false);
     rte.getConfig()->setProperty("nddl.includePath", ".:../component/NDDL");
@@ -1578,9 +1945,17 @@ class ResourceSolverTest {
     ResourceThreatDecisionPoint dp1(client, flawedInstants[0], dummy);
 
     dp1.initialize();
+    CPPUNIT_ASSERT(dp1.hasNext());
 
     CPPUNIT_ASSERT(dp1.getChoices().size() == 8);
 
+    // The choices are generated as they're needed, but they're still the ones the resource offers
+    typedef std::set<std::pair<TransactionId, TransactionId> > ChoiceSet;
+    std::vector<std::pair<TransactionId, TransactionId> > orderingChoices;
+    static_cast<Resource&>(reusable).getOrderingChoices(flawedInstants[0], orderingChoices);
+    CPPUNIT_ASSERT(ChoiceSet(orderingChoices.begin(), orderingChoices.end()) ==
+                   ChoiceSet(dp1.getChoices().begin(), dp1.getChoices().end()));
+
     std::string noFilter = "<FlawHandler component=\"ResourceThreatDecisionPoint\" filter=\"none\"/>";
     TiXmlElement* noFilterXml = initXml(noFilter);
     ResourceThreatDecisionPoint dp2(client, flawedInstants[0], *noFilterXml);
@@ -5,6 +5,7 @@
 #include "Rule.hh"
 #include "RulesEngine.hh"
 #include "RuleVariableListener.hh"
+#include "RuleGuardPropagator.hh"
 #include "Constraints.hh"
 #include "Propagators.hh"
 #include "CESchema.hh"
@@ -38,9 +39,9 @@ void ModuleRulesEngine::initialize(EngineId engine) {
   RulesEngine* re = new RulesEngine(rs->getId(),pdb->getId());
   engine->addComponent("RulesEngine",re);
 
-  // Allocate an instance of Default Propagator to handle rule related constraint propagation.
+  // Allocate a propagator to handle rule related constraint propagation, watching guard variables.
   // Will be cleaned up automatically by the ConstraintEngine
-  new DefaultPropagator("RulesEngine", pdb->getConstraintEngine(), SYSTEM_PRIORITY);
+  new RuleGuardPropagator("RulesEngine", pdb->getConstraintEngine(), SYSTEM_PRIORITY);
 
   CESchema* ces = boost::polymorphic_cast<CESchema*>(engine->getComponent("CESchema"));
   REGISTER_SYSTEM_CONSTRAINT(ces,ProxyVariableRelation, "proxyRelation", "Default");
@@ -0,0 +1,127 @@
+#include "RuleGuardPropagator.hh"
+#include "RuleVariableListener.hh"
+#include "Constraint.hh"
+#include "ConstraintEngine.hh"
+#include "ConstrainedVariable.hh"
+#include "Debug.hh"
+
+namespace EUROPA {
+
+RuleGuardPropagator::RuleGuardPropagator(const std::string& name,
+                                         const ConstraintEngineId constraintEngine,
+                                         int priority)
+    : DefaultPropagator(name, constraintEngine, priority), m_watchLists(), m_watchAgenda() {}
+
+bool RuleGuardPropagator::isGuardListener(const ConstraintId constraint) {
+  return constraint->getName() == RuleVariableListener::CONSTRAINT_NAME();
+}
+
+void RuleGuardPropagator::handleConstraintAdded(const ConstraintId constraint) {
+  // Newly added listeners still go on the agenda, so the guard is tested once on creation
+  DefaultPropagator::handleConstraintAdded(constraint);
+
+  if(!isGuardListener(constraint))
+    return;
+
+  const std::vector<ConstrainedVariableId>& scope = constraint->getScope();
+  for(unsigned int i = 0; i < scope.size(); i++)
+    m_watchLists[scope[i]->getKey()].push_back(std::make_pair(constraint, i));
+}
+
+void RuleGuardPropagator::handleConstraintRemoved(const ConstraintId constraint) {
+  DefaultPropagator::handleConstraintRemoved(constraint);
+
+  if(!isGuardListener(constraint))
+    return;
+
+  const std::vector<ConstrainedVariableId>& scope = constraint->getScope();
+  for(std::vector<ConstrainedVariableId>::const_iterator it = scope.begin(); it != scope.end(); ++it){
+    std::map<eint, WatchList>::iterator watchIt = m_watchLists.find((*it)->getKey());
+    if(watchIt == m_watchLists.end())
+      continue;
+
+    WatchList& watchList = watchIt->second;
+    WatchList::iterator entry = watchList.begin();
+    while(entry != watchList.end()) {
+      if(entry->first == constraint)
+        entry = watchList.erase(entry);
+      else
+        ++entry;
+    }
+
+    if(watchList.empty()) {
+      m_watchAgenda.erase(watchIt->first);
+      m_watchLists.erase(watchIt);
+    }
+  }
+}
+
+void RuleGuardPropagator::handleNotification(const ConstrainedVariableId variable,
+                                             unsigned int argIndex,
+                                             const ConstraintId constraint,
+                                             const DomainListener::ChangeType& changeType) {
+  if(!isGuardListener(constraint)) {
+    DefaultPropagator::handleNotification(variable, argIndex, constraint, changeType);
+    return;
+  }
+
+  debugMsg("RuleGuardPropagator:handleNotification",
+           "Watching " << variable->toString() << " because of " <<
+           DomainListener::toString(changeType));
+
+  std::pair<ConstrainedVariableId, bool>& entry = m_watchAgenda[variable->getKey()];
+  entry.first = variable;
+  entry.second = entry.second || RuleVariableListener::isRelaxation(changeType);
+}
+
+void RuleGuardPropagator::execute() {
+  if(m_watchAgenda.empty()) {
+    DefaultPropagator::execute();
+    return;
+  }
+
+  check_error(!getConstraintEngine()->provenInconsistent());
+
+  // Drain all watched variables in one pass. Swap first since executing may generate new notifications.
+  std::map<eint, std::pair<ConstrainedVariableId, bool> > agenda;
+  agenda.swap(m_watchAgenda);
+
+  std::set<eint> executed;
+  for(std::map<eint, std::pair<ConstrainedVariableId, bool> >::const_iterator it = agenda.begin();
+      it != agenda.end() && !getConstraintEngine()->provenInconsistent(); ++it)
+    executeWatchList(it->second.first, it->second.second, executed);
+
+  debugMsg("RuleGuardPropagator:execute",
+           "Executed " << executed.size() << " guard listeners for " << agenda.size() << " guard variables");
+
+  if(getConstraintEngine()->provenInconsistent() && !getConstraintEngine()->canContinuePropagation())
+    m_watchAgenda.clear();
+}
+
+void RuleGuardPropagator::executeWatchList(const ConstrainedVariableId variable, bool relaxed,
+                                           std::set<eint>& executed) {
+  std::map<eint, WatchList>::const_iterator watchIt = m_watchLists.find(variable->getKey());
+  if(watchIt == m_watchLists.end())
+    return;
+
+  // Executing a listener only schedules its rule instance with the RulesEngine, so the list is stable here
+  const WatchList& watchList = watchIt->second;
+  for(unsigned int i = 0; i < watchList.size(); i++){
+    const ConstraintId constraint = watchList[i].first;
+    if(!constraint->isActive() || executed.find(constraint->getKey()) != executed.end())
+      continue;
+
+    RuleVariableListener* listener = id_cast<RuleVariableListener>(constraint);
+    if(!listener->isWatchedChange(variable, watchList[i].second, relaxed))
+      continue;
+
+    executed.insert(constraint->getKey());
+    Propagator::execute(constraint);
+  }
+}
+
+bool RuleGuardPropagator::updateRequired() const {
+  return !m_watchAgenda.empty() || DefaultPropagator::updateRequired();
+}
+
+}
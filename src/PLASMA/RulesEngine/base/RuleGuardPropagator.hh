@@ -0,0 +1,57 @@
+#ifndef H_RuleGuardPropagator
+#define H_RuleGuardPropagator
+
+/**
+ * @file RuleGuardPropagator.hh
+ * @brief Declares the propagator managing rule guard listeners
+ * @ingroup RulesEngine
+ */
+
+#include "RulesEngineDefs.hh"
+#include "Propagators.hh"
+
+#include <map>
+#include <vector>
+
+namespace EUROPA {
+
+  /**
+   * @class RuleGuardPropagator
+   * @brief Propagator for rule related constraints which batches guard listeners on a watch list per guard variable.
+   *
+   * Rather than placing every RuleVariableListener on the agenda individually, a change to a guard variable that
+   * is watched by any of its listeners puts the variable on the agenda once. On execution, the whole agenda is
+   * drained in one pass, testing each listener in the watch list of a changed variable.
+   * Constraints other than RuleVariableListener instances are handled as in the DefaultPropagator.
+   * @see RuleVariableListener, RuleInstance::isWatchedChange
+   */
+  class RuleGuardPropagator: public DefaultPropagator {
+  public:
+    RuleGuardPropagator(const std::string& name, const ConstraintEngineId constraintEngine,
+                        int priority = SYSTEM_PRIORITY);
+
+    void execute();
+    bool updateRequired() const;
+
+  private:
+    void handleConstraintAdded(const ConstraintId constraint);
+    void handleConstraintRemoved(const ConstraintId constraint);
+    void handleNotification(const ConstrainedVariableId variable,
+                            unsigned int argIndex,
+                            const ConstraintId constraint,
+                            const DomainListener::ChangeType& changeType);
+
+    /**
+     * @brief Test the guard listeners watching the given variable, executing those for which the change is relevant.
+     */
+    void executeWatchList(const ConstrainedVariableId variable, bool relaxed, std::set<eint>& executed);
+
+    static bool isGuardListener(const ConstraintId constraint);
+
+    typedef std::vector<std::pair<ConstraintId, unsigned int> > WatchList;
+
+    std::map<eint, WatchList> m_watchLists; /*!< Guard listeners and argument positions, by guard variable key */
+    std::map<eint, std::pair<ConstrainedVariableId, bool> > m_watchAgenda; /*!< Changed guard variables, flagged if relaxed */
+  };
+}
+#endif
@@ -12,10 +12,22 @@
 #include "ProxyVariableRelation.hh"
 #include "Domains.hh"
 #include <sstream>
+#include <algorithm>
 
 #include <boost/algorithm/string.hpp>
+#include <boost/scoped_ptr.hpp>
 namespace EUROPA {
 
+PendingSlave::PendingSlave(const std::string& name, const std::string& predicateType,
+                           const std::string& relation)
+    : m_name(name), m_predicateType(predicateType), m_relation(relation), m_constraints() {}
+
+PendingSlave::~PendingSlave() {}
+
+void PendingSlave::addConstraint(const std::string& name, const std::string& delimitedVars) {
+  m_constraints.push_back(std::make_pair(name, delimitedVars));
+}
+
 RuleInstance::RuleInstance(const RuleId rule, const TokenId token, 
                            const PlanDatabaseId planDb)
     : m_id(this), m_rule(rule), m_token(token), m_planDb(planDb), m_rulesEngine(), 
@@ -23,7 +35,8 @@ RuleInstance::RuleInstance(const RuleId rule, const TokenId token,
       m_guardDomain(0), m_guardListener(), m_isExecuted(false), m_isPositive(true),
       m_constraints(), m_childRules(), m_variables(), m_slaves(), 
       m_variablesByName(), m_slavesByName(),
-      m_constraintsByName() {
+      m_constraintsByName(),
+      m_pendingSlaves(), m_pendingSlavesByName(), m_lazySlaves(false) {
   check_error(rule.isValid(), "Parent must be a valid rule id.");
   check_error(isValid());
   commonInit();
@@ -36,7 +49,8 @@ RuleInstance::RuleInstance(const RuleId rule, const TokenId token,
       m_parent(), m_guards(),
       m_guardDomain(0), m_guardListener(), m_isExecuted(false), m_isPositive(true),
       m_constraints(), m_childRules(), m_variables(), m_slaves(), m_variablesByName(),
-      m_slavesByName(), m_constraintsByName() {
+      m_slavesByName(), m_constraintsByName(),
+      m_pendingSlaves(), m_pendingSlavesByName(), m_lazySlaves(false) {
   check_error(isValid());
   setGuard(guards);
   commonInit();
@@ -49,7 +63,8 @@ RuleInstance::RuleInstance(const RuleId rule, const TokenId token,
       m_parent(), m_guards(),
       m_guardDomain(0), m_guardListener(), m_isExecuted(false), m_isPositive(true),
       m_constraints(), m_childRules(), m_variables(), m_slaves(), m_variablesByName(), 
-      m_slavesByName(), m_constraintsByName() {
+      m_slavesByName(), m_constraintsByName(),
+      m_pendingSlaves(), m_pendingSlavesByName(), m_lazySlaves(false) {
   check_error(isValid());
   setGuard(guard, domain);
   commonInit();
@@ -64,7 +79,8 @@ RuleInstance::RuleInstance(const RuleInstanceId parent,
       m_planDb(parent->getPlanDatabase()),m_rulesEngine() , m_parent(parent), 
       m_guards(), m_guardDomain(0), m_guardListener(), m_isExecuted(false),
       m_isPositive(true), m_constraints(), m_childRules(), m_variables(), m_slaves(), 
-      m_variablesByName(), m_slavesByName(), m_constraintsByName() {
+      m_variablesByName(), m_slavesByName(), m_constraintsByName(),
+      m_pendingSlaves(), m_pendingSlavesByName(), m_lazySlaves(parent->hasLazySlaves()) {
   check_error(isValid());
   setGuard(guards);
 }
@@ -79,7 +95,8 @@ RuleInstance::RuleInstance(const RuleInstanceId parent,
       m_planDb(parent->getPlanDatabase()), m_rulesEngine(), m_parent(parent), 
       m_guards(), m_guardDomain(0), m_guardListener(), m_isExecuted(false),
       m_isPositive(positive), m_constraints(), m_childRules(), m_variables(),
-      m_slaves(), m_variablesByName(), m_slavesByName(), m_constraintsByName() {
+      m_slaves(), m_variablesByName(), m_slavesByName(), m_constraintsByName(),
+      m_pendingSlaves(), m_pendingSlavesByName(), m_lazySlaves(parent->hasLazySlaves()) {
   check_error(isValid());
   setGuard(guards);
 }
@@ -93,7 +110,8 @@ RuleInstance::RuleInstance(const RuleInstanceId parent,
       m_planDb(parent->getPlanDatabase()), m_rulesEngine(), m_parent(parent),
       m_guards(), m_guardDomain(0), m_guardListener(), m_isExecuted(false),
       m_isPositive(true), m_constraints(), m_childRules(), m_variables(), m_slaves(),
-      m_variablesByName(), m_slavesByName(), m_constraintsByName() {
+      m_variablesByName(), m_slavesByName(), m_constraintsByName(),
+      m_pendingSlaves(), m_pendingSlavesByName(), m_lazySlaves(parent->hasLazySlaves()) {
   check_error(isValid());
   setGuard(guard, domain);
 }
@@ -108,7 +126,8 @@ RuleInstance::RuleInstance(const RuleInstanceId parent,
       m_planDb(parent->getPlanDatabase()), m_rulesEngine(), m_parent(parent), 
       m_guards(), m_guardDomain(0), m_guardListener(), m_isExecuted(false),
       m_isPositive(positive), m_constraints(), m_childRules(), m_variables(), 
-      m_slaves(), m_variablesByName(), m_slavesByName(), m_constraintsByName() {
+      m_slaves(), m_variablesByName(), m_slavesByName(), m_constraintsByName(),
+      m_pendingSlaves(), m_pendingSlavesByName(), m_lazySlaves(parent->hasLazySlaves()) {
   check_error(isValid());
   setGuard(guard, domain);
 }
@@ -121,7 +140,8 @@ RuleInstance::RuleInstance(const RuleInstanceId parent,
       m_planDb(parent->getPlanDatabase()), m_rulesEngine(), m_parent(parent), 
       m_guards(), m_guardDomain(0), m_guardListener(), m_isExecuted(false),
       m_isPositive(positive), m_constraints(), m_childRules(), m_variables(), 
-      m_slaves(), m_variablesByName(), m_slavesByName(), m_constraintsByName() {
+      m_slaves(), m_variablesByName(), m_slavesByName(), m_constraintsByName(),
+      m_pendingSlaves(), m_pendingSlavesByName(), m_lazySlaves(parent->hasLazySlaves()) {
   check_error(isValid());
   setGuard(guard, domain, guardComponents);
 }
@@ -138,6 +158,8 @@ RuleInstance::RuleInstance(const RuleInstanceId parent,
     m_id.remove();
   }
 
+  void RuleInstance::handleUndo(){}
+
   void RuleInstance::handleDiscard(){
     checkError(m_token.isValid(), m_token);
 
@@ -167,8 +189,12 @@ RuleInstance::RuleInstance(const RuleInstanceId parent,
 
   const TokenId RuleInstance::getToken() const {return m_token;}
 
-  const std::vector<TokenId> RuleInstance::getSlaves() const
-  {return std::vector<TokenId>(m_slaves);}
+  const std::vector<TokenId> RuleInstance::getSlaves() const {
+    RuleInstance* self = const_cast<RuleInstance*>(this);
+    while(!self->m_pendingSlaves.empty())
+      self->materialize(self->m_pendingSlaves.front());
+    return std::vector<TokenId>(m_slaves);
+  }
 
   bool RuleInstance::isExecuted() const {
     return m_isExecuted;
@@ -258,6 +284,29 @@ RuleInstance::RuleInstance(const RuleInstanceId parent,
     return test(m_guards);
   }
 
+  /**
+   * Cases for WATCHED CHANGES (mirror the cases for TEST):
+   * 1. Already executed - only a relaxation can make the test fail and cause an undo.
+   * 2. Explicit guard on the first variable - a positive test needs a singleton, a negative
+   *    test may change on any restriction.
+   * 3. Implied singleton guards and guard components - need to be specified or have a singleton base domain.
+   */
+  bool RuleInstance::isWatchedChange(const ConstrainedVariableId guard,
+                                     unsigned int guardIndex,
+                                     bool relaxed) const {
+    checkError(guard.isValid(), guard);
+    checkError(guardIndex < m_guards.size(),
+               "Guard index " << guardIndex << " out of range for " << toString());
+
+    if(isExecuted())
+      return relaxed;
+
+    if(m_guardDomain != 0 && guardIndex == 0)
+      return !m_isPositive || guard->lastDomain().isSingleton();
+
+    return guard->isSpecified() || guard->baseDomain().isSingleton();
+  }
+
   void RuleInstance::prepare() {
     if(!isExecuted())
       m_rulesEngine->scheduleForExecution(getId());
@@ -285,6 +334,11 @@ void RuleInstance::undo() {
   //discardAll(m_childRules);
   cleanup(m_childRules);
 
+  // Pending slaves were never created, so there is nothing to retract for them
+  discardPendingSlaves();
+
+  handleUndo();
+
   if(!Entity::isPurging()){
     m_rulesEngine->notifyUndone(getId());
     // Clear slave lookups
@@ -473,13 +527,82 @@ void RuleInstance::clearLoopVar(const std::string& loopVarName){
   TokenId RuleInstance::addSlave(Token* slave, const std::string& name){
 
     // As with adding variables, we have to handle case of re-use of name when executing the inner
-    // loop of 'foreach'
+    // loop of 'foreach'. A pending slave of the same name is created first so it is not lost.
+    std::map<std::string, PendingSlave*>::iterator pending = m_pendingSlavesByName.find(name);
+    if(pending != m_pendingSlavesByName.end())
+      materialize(pending->second);
+
     m_slavesByName.erase(name);
 
     m_slavesByName.insert(std::make_pair(name, slave->getId()));
     return addSlave(slave);
   }
 
+void RuleInstance::addPendingSlave(PendingSlave* slave){
+  checkError(m_lazySlaves, "Slaves of " << toString() << " are not lazy.");
+  checkError(isExecuted(), "Only an executed rule instance can record slaves.");
+
+  // A name re-used by 'foreach' is only ever pending for one descriptor
+  std::map<std::string, PendingSlave*>::iterator it = m_pendingSlavesByName.find(slave->getName());
+  if(it != m_pendingSlavesByName.end())
+    materialize(it->second);
+
+  m_slavesByName.erase(slave->getName());
+  m_pendingSlaves.push_back(slave);
+  m_pendingSlavesByName.insert(std::make_pair(slave->getName(), slave));
+  debugMsg("RuleInstance:addPendingSlave",
+           "Recorded pending slave " << slave->getName() << " of type " << slave->getPredicateType());
+}
+
+TokenId RuleInstance::materializeSlave(const PendingSlave& slave){
+  TokenId token = m_planDb->createSlaveToken(m_token, slave.getPredicateType(), slave.getRelation());
+  addSlave(token, slave.getName());
+
+  const std::vector<std::pair<std::string, std::string> >& constraints = slave.getConstraints();
+  for(std::vector<std::pair<std::string, std::string> >::const_iterator it = constraints.begin();
+      it != constraints.end(); ++it)
+    addConstraint(it->first, getVariables(it->second));
+
+  return token;
+}
+
+TokenId RuleInstance::materialize(PendingSlave* slave){
+  boost::scoped_ptr<PendingSlave> owner(slave);
+  m_pendingSlaves.erase(std::find(m_pendingSlaves.begin(), m_pendingSlaves.end(), slave));
+  m_pendingSlavesByName.erase(slave->getName());
+
+  debugMsg("RuleInstance:materialize",
+           "Creating pending slave " << slave->getName() << " of type " << slave->getPredicateType());
+  TokenId token = materializeSlave(*slave);
+  checkError(token.isValid() && getSlave(slave->getName()) == token,
+             "Pending slave " << slave->getName() << " was not registered on creation.");
+  return token;
+}
+
+unsigned int RuleInstance::materializeSlaves(){
+  unsigned int count = 0;
+  while(!m_pendingSlaves.empty()){
+    materialize(m_pendingSlaves.front());
+    ++count;
+  }
+
+  std::vector<RuleInstanceId> childRules = m_childRules;
+  for(std::vector<RuleInstanceId>::const_iterator it = childRules.begin(); it != childRules.end(); ++it){
+    checkError(it->isValid(), *it);
+    count += (*it)->materializeSlaves();
+  }
+
+  return count;
+}
+
+void RuleInstance::discardPendingSlaves(){
+  for(std::vector<PendingSlave*>::const_iterator it = m_pendingSlaves.begin();
+      it != m_pendingSlaves.end(); ++it)
+    delete *it;
+  m_pendingSlaves.clear();
+  m_pendingSlavesByName.clear();
+}
+
 void RuleInstance::addConstraint(const std::string& name, const std::vector<ConstrainedVariableId>& scope){
   ConstraintId constr =  
       getPlanDatabase()->getConstraintEngine()->createConstraint(name,
@@ -534,6 +657,10 @@ TokenId RuleInstance::getSlave(const std::string& name) const {
   std::map<std::string, TokenId>::const_iterator it = m_slavesByName.find(name);
   if(it != m_slavesByName.end())
     return it->second;
+
+  std::map<std::string, PendingSlave*>::const_iterator pending = m_pendingSlavesByName.find(name);
+  if(pending != m_pendingSlavesByName.end())
+    return const_cast<RuleInstance*>(this)->materialize(pending->second);
   else if (!m_parent.isNoId())
     return m_parent->getSlave(name);
   else
@@ -787,7 +914,7 @@ std::string RuleInstance::ruleExecutionContext() const {
   ss << std::endl;
 
   // What slaves are created
-  if(m_slaves.empty())
+  if(m_slaves.empty() && m_pendingSlaves.empty())
     ss << "No Slaves" << std::endl;
   else {
     ss << "Slaves: " << std::endl;
@@ -796,6 +923,8 @@ std::string RuleInstance::ruleExecutionContext() const {
       TokenId token = it->second;
       ss << TAB_DELIMITER << name << "==" << token->toString() << std::endl;
     }
+    for(std::vector<PendingSlave*>::const_iterator it = m_pendingSlaves.begin(); it != m_pendingSlaves.end(); ++it)
+      ss << TAB_DELIMITER << (*it)->getName() << "==" << (*it)->getPredicateType() << " (pending)" << std::endl;
   }
 
   ss << "++++++++++++++++++x+++++++";
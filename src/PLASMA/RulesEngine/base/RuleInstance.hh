@@ -17,6 +17,40 @@
 
 namespace EUROPA{
 
+  /**
+   * @class PendingSlave
+   * @brief A slave recorded by a rule instance with lazy slaves in place of a token. It carries the
+   * predicate and the relation needed to create the token, and the constraints to post once it exists.
+   * @see RuleInstance::addPendingSlave, RuleInstance::materializeSlave
+   */
+  class PendingSlave {
+  public:
+    PendingSlave(const std::string& name, const std::string& predicateType,
+                 const std::string& relation);
+    virtual ~PendingSlave();
+
+    const std::string& getName() const {return m_name;}
+    const std::string& getPredicateType() const {return m_predicateType;}
+    const std::string& getRelation() const {return m_relation;}
+
+    /**
+     * @brief Adds a constraint to post on creation.
+     * @param delimitedVars A ":" delimited scope as for RuleInstance::getVariables. The slave is
+     * referred to by its name, e.g. "this.end:slave.start".
+     */
+    void addConstraint(const std::string& name, const std::string& delimitedVars);
+
+    const std::vector<std::pair<std::string, std::string> >& getConstraints() const {
+      return m_constraints;
+    }
+
+  private:
+    std::string m_name;
+    std::string m_predicateType;
+    std::string m_relation;
+    std::vector<std::pair<std::string, std::string> > m_constraints;
+  };
+
   /**
    * @class RuleInstance
    * @brief Provides the data access and operational interface for a Rule.
@@ -113,11 +147,24 @@ namespace EUROPA{
     const TokenId getToken() const;
 
     /**
-     * @brief Accessor
+     * @brief Accessor. Creates any pending slave first.
      * @return The slave tokens created by Rule execution.
      */
     const std::vector<TokenId> getSlaves() const;
 
+    /**
+     * @brief When set, slaves may be recorded as pending descriptors and only created on first use.
+     * Child rule instances take the setting of their parent.
+     */
+    void setLazySlaves(bool lazy) {m_lazySlaves = lazy;}
+    bool hasLazySlaves() const {return m_lazySlaves;}
+
+    /**
+     * @brief Creates every pending slave of this rule instance and of its child rules.
+     * @return The number of slaves created.
+     */
+    unsigned int materializeSlaves();
+
     const RulesEngineId &getRulesEngine() const;
 
     void setRulesEngine(const RulesEngineId &rulesEngine);
@@ -146,6 +193,18 @@ namespace EUROPA{
      */
     bool test() const;
 
+    /**
+     * @brief Tests if a change on a guard variable could alter the outcome of test(). Only
+     * transitions of a guard into or out of a singleton are watched, so a rule instance is not
+     * re-tested while its guards are still far from being decided.
+     * @param guard The (possibly merged) variable in the guard position that has changed.
+     * @param guardIndex The position of the guard in the scope of the guard listener.
+     * @param relaxed True if the change was a relaxation of the guard domain.
+     */
+    bool isWatchedChange(const ConstrainedVariableId guard,
+                         unsigned int guardIndex,
+                         bool relaxed) const;
+
     /**
      * Tests if the rule has been evaluated and is false
      */
@@ -188,9 +247,29 @@ namespace EUROPA{
      */
     virtual void handleExecute() = 0;
 
+    /**
+     * @brief Called by undo(), before the variables and slaves created by the execution are deleted.
+     */
+    virtual void handleUndo();
+
     /*!< Helper methods */
     TokenId addSlave(Token* slave);
     TokenId addSlave(Token* slave, const std::string& name);
+
+    /**
+     * @brief Records a slave to be created when it is looked up by name, when getSlaves() is called or
+     * when the RulesEngine materializes slaves. If the rule instance is undone first, it is never created.
+     * Takes ownership of the descriptor.
+     */
+    void addPendingSlave(PendingSlave* slave);
+
+    /**
+     * @brief Creates the token for a pending slave and registers it with addSlave under the name of
+     * the descriptor. The default allocates a slave of the predicate type and posts the constraints
+     * of the descriptor.
+     */
+    virtual TokenId materializeSlave(const PendingSlave& slave);
+
     ConstrainedVariableId varfromtok(const TokenId tok, const std::string varstring) ;
 
     /**
@@ -284,6 +363,16 @@ namespace EUROPA{
      */
     bool connectedToToken(const ConstraintId constraint, const TokenId token) const;
 
+    /**
+     * @brief Removes a pending slave from the pending set and creates it.
+     */
+    TokenId materialize(PendingSlave* slave);
+
+    /**
+     * @brief Deletes the pending slaves without creating them.
+     */
+    void discardPendingSlaves();
+
     /** ANALYSIS ROUTINES FOR DEBUGGING **/
     std::string ruleExecutionContext() const;
 
@@ -301,6 +390,9 @@ namespace EUROPA{
     std::map<std::string, ConstrainedVariableId> m_variablesByName; /*!< Context lookup */
     std::map<std::string, TokenId> m_slavesByName; /*!< Context lookup */
     std::map<std::string, ConstraintId> m_constraintsByName; /*!< Context lookup */
+    std::vector<PendingSlave*> m_pendingSlaves; /*!< Slaves recorded but not yet created, in order */
+    std::map<std::string, PendingSlave*> m_pendingSlavesByName; /*!< Context lookup */
+    bool m_lazySlaves; /*!< If true, slaves may be pending until first used */
   };
 }
 #endif
@@ -39,13 +39,14 @@ RuleVariableListener::RuleVariableListener(const ConstraintEngineId constraintEn
   }
 
   /**
-   * @brief Handle all behaviour immediately on set or reset operations
-   * so that rule execution is not subject to the vagaries of propagtion timing
-   * @return true
+   * @brief Guards are watched rather than re-tested on every change. Only a transition of a guard into
+   * a singleton, or out of one on relaxation, can change the outcome of the rule test.
+   * @return true if the change cannot alter the outcome of the rule test.
+   * @see RuleInstance::isWatchedChange
    */
-bool RuleVariableListener::canIgnore(const ConstrainedVariableId,
-                                     unsigned int,
-                                     const DomainListener::ChangeType&){
+bool RuleVariableListener::canIgnore(const ConstrainedVariableId variable,
+                                     unsigned int argIndex,
+                                     const DomainListener::ChangeType& changeType){
   checkError(getRuleInstance().isValid(), getKey() << " has lost its rule instance:" << getRuleInstance());
 
   if(getRuleInstance().isNoId())
@@ -55,7 +56,20 @@ bool RuleVariableListener::canIgnore(const ConstrainedVariableId,
            "Checking canIgnore for guard listener for rule " << getRuleInstance()->getRule()->getName() <<
            " from source " << (m_sourceConstraint.isId() ? m_sourceConstraint->getName() : "NULL"));
 
-  return false;
+  return !isWatchedChange(variable, argIndex, isRelaxation(changeType));
+}
+
+bool RuleVariableListener::isWatchedChange(const ConstrainedVariableId variable,
+                                           unsigned int argIndex,
+                                           bool relaxed){
+  const RuleInstanceId ruleInstance = getRuleInstance();
+  return ruleInstance.isId() && ruleInstance->isWatchedChange(variable, argIndex, relaxed);
+}
+
+bool RuleVariableListener::isRelaxation(const DomainListener::ChangeType& changeType){
+  return changeType == DomainListener::RELAXED ||
+      changeType == DomainListener::RESET ||
+      changeType == DomainListener::OPENED;
 }
 
   const RuleInstanceId RuleVariableListener::getRuleInstance() {
@@ -66,6 +66,7 @@ namespace EUROPA
     virtual bool testIsRedundant(const ConstrainedVariableId var = ConstrainedVariableId::noId()) const;
 
     friend class RuleInstance;
+    friend class RuleGuardPropagator;
 
     /**
      * @brief Constructor used internally by the RuleInstance class when allocating
@@ -81,6 +82,19 @@ namespace EUROPA
 
     void handleExecute();
 
+    /**
+     * @brief Test if a change on the guard in the given position is watched by the rule instance.
+     * @see RuleInstance::isWatchedChange
+     */
+    bool isWatchedChange(const ConstrainedVariableId variable,
+                         unsigned int argIndex,
+                         bool relaxed);
+
+    /**
+     * @brief Test if a change relaxes a guard domain, and so may take it out of a singleton.
+     */
+    static bool isRelaxation(const DomainListener::ChangeType& changeType);
+
     RuleInstanceId m_ruleInstance;
     ConstraintId m_sourceConstraint;
   };
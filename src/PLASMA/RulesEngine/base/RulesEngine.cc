@@ -97,6 +97,14 @@ RulesEngine::~RulesEngine(){
     return ruleInstances;
   }
 
+  unsigned int RulesEngine::materializeSlaves(){
+    unsigned int count = 0;
+    for(std::multimap<eint, RuleInstanceId>::const_iterator it=m_ruleInstancesByToken.begin();it!=m_ruleInstancesByToken.end();++it)
+      count += it->second->materializeSlaves();
+    debugMsg("RulesEngine:materializeSlaves", "Created " << count << " pending slaves");
+    return count;
+  }
+
   void RulesEngine::getRuleInstances(const TokenId token,std::set<RuleInstanceId>& results) const{
     check_error(token.isValid());
     std::multimap<eint, RuleInstanceId>::const_iterator it = m_ruleInstancesByToken.find(token->getKey());
@@ -43,6 +43,13 @@ namespace EUROPA {
     std::set<RuleInstanceId> getRuleInstances() const;
     void getRuleInstances(const TokenId token,std::set<RuleInstanceId>& results) const;
     bool hasPendingRuleInstances(const TokenId token) const;
+
+    /**
+     * @brief Creates the slaves that rule instances with lazy slaves have recorded but not yet created.
+     * @return The number of slaves created.
+     * @see RuleInstance::setLazySlaves
+     */
+    unsigned int materializeSlaves();
     
     const RuleSchemaId getRuleSchema() const;
 
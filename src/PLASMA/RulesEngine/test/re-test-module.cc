@@ -17,15 +17,21 @@
 #include "Constraint.hh"
 #include "CESchema.hh"
 #include "TestUtils.hh"
+#include "DbClient.hh"
+#include "DbClientTransactionStream.hh"
+#include "PlanDatabaseSnapshot.hh"
 
 #include "Constraints.hh"
 #include "ModuleConstraintEngine.hh"
 #include "ModulePlanDatabase.hh"
 #include "ModuleRulesEngine.hh"
 
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
 #include <string>
 #include <boost/cast.hpp>
+#include <unistd.h>
 
 using namespace EUROPA;
 
@@ -62,6 +68,47 @@ private:
   };
 };
 
+/*
+  AllObjects::Predicate {
+    met_by(AllObjects.Predicate slave1);
+    eq(end, slave1.start);
+    met_by(AllObjects.Predicate slave2);
+    eq(end, slave2.start);
+  }
+  with both slaves left pending until first used.
+ */
+class LazySubGoal: public Rule {
+public:
+  LazySubGoal()
+      : Rule("AllObjects.Predicate")
+  {
+  }
+
+  RuleInstanceId createInstance(const TokenId token, const PlanDatabaseId planDb,
+                                const RulesEngineId &rulesEngine) const{
+    RootInstance* rootInstance = new RootInstance(m_id, token, planDb);
+    rootInstance->setLazySlaves(true);
+    rootInstance->setRulesEngine(rulesEngine);
+    return rootInstance->getId();
+  }
+
+private:
+  class RootInstance: public RuleInstance{
+  public:
+    RootInstance(const RuleId rule, const TokenId token, const PlanDatabaseId planDb)
+        : RuleInstance(rule, token, planDb) {}
+
+    void handleExecute(){
+      PendingSlave* slave1 = new PendingSlave("slave1", "AllObjects.Predicate", "met_by");
+      slave1->addConstraint("eq", "this.end:slave1.start");
+      addPendingSlave(slave1);
+      PendingSlave* slave2 = new PendingSlave("slave2", "AllObjects.Predicate", "met_by");
+      slave2->addConstraint("eq", "this.end:slave2.start");
+      addPendingSlave(slave2);
+    }
+  };
+};
+
 /*
   AllObjects::Predicate {
     met_by(AllObjects.Predicate slave1);
@@ -211,6 +258,19 @@ void LocalVariableGuard_0_0::handleExecute(){
   addSlave(new IntervalToken(m_token, "any", "AllObjects.Predicate"));
 }
 
+class PredicateTokenType: public TokenType {
+ public:
+  PredicateTokenType(const ObjectTypeId ot)
+      : TokenType(ot, "AllObjects.Predicate") {}
+ private:
+  TokenId createInstance(const PlanDatabaseId planDb, const std::string& name, bool rejectable, bool isFact) const {
+    return (new IntervalToken(planDb, name, rejectable, isFact))->getId();
+  }
+  TokenId createInstance(const TokenId master, const std::string& name, const std::string& relation) const {
+    return (new IntervalToken(master, relation, name))->getId();
+  }
+};
+
 class RETestEngine : public EngineBase
 {
   public:
@@ -235,10 +295,8 @@ RETestEngine::RETestEngine()
     ObjectType* ot;
 
     ot = new ObjectType("AllObjects",sch->getObjectType(Schema::rootObject()));
-    // TODO:
-    // ot->addTokenFactory((new TokenFactory("AllObjects.Predicate"))->getId());
+    ot->addTokenType((new PredicateTokenType(ot->getId()))->getId());
     sch->registerObjectType(ot->getId());
-    sch->addPredicate("AllObjects.Predicate");
 
     ot = new ObjectType("Objects",sch->getObjectType(Schema::rootObject()));
     ot->addMember(IntDT::instance(),"m_int");
@@ -308,13 +366,16 @@ class RulesEngineTest {
 public:
   static bool test(){
     EUROPA_runTest(testSimpleSubGoal);
+    EUROPA_runTest(testLazySubGoal);
     EUROPA_runTest(testNestedGuards);
     EUROPA_runTest(testNestedGuardsConstraint);
     EUROPA_runTest(testLocalVariable);
+    EUROPA_runTest(testWatchedGuards);
     EUROPA_runTest(testTestRule);
     EUROPA_runTest(testPurge);
     EUROPA_runTest(testGNATS_3157);
     EUROPA_runTest(testProxyVariableRelation);
+    EUROPA_runTest(testSnapshot);
     return true;
   }
 private:
@@ -346,6 +407,68 @@ private:
     return true;
   }
 
+  static bool testLazySubGoal(){
+    RE_DEFAULT_SETUP(ce, db, false);
+    db->close();
+
+    re->getRuleSchema()->registerRule((new LazySubGoal())->getId());
+
+    IntervalToken t0(db,
+		     "AllObjects.Predicate",
+		     true,
+		     false,
+		     IntervalIntDomain(0, 1000),
+		     IntervalIntDomain(0, 1000),
+		     IntervalIntDomain(1, 1000));
+
+    // Firing the rule only records the slaves
+    t0.activate();
+    CPPUNIT_ASSERT(db->getTokens().size() == 1);
+    CPPUNIT_ASSERT(t0.slaves().empty());
+
+    std::set<RuleInstanceId> ruleInstances;
+    re->getRuleInstances(t0.getId(), ruleInstances);
+    CPPUNIT_ASSERT(ruleInstances.size() == 1);
+    RuleInstanceId root = *(ruleInstances.begin());
+    CPPUNIT_ASSERT(root->isExecuted());
+
+    // A lookup creates the slave and posts its pending constraint
+    TokenId slave1 = root->getSlave("slave1");
+    CPPUNIT_ASSERT(slave1.isValid());
+    CPPUNIT_ASSERT(db->getTokens().size() == 2);
+    CPPUNIT_ASSERT(t0.slaves().size() == 1);
+    CPPUNIT_ASSERT(root->getSlave("slave1") == slave1);
+    ce->propagate();
+    CPPUNIT_ASSERT(t0.end()->getDerivedDomain() == slave1->start()->getDerivedDomain());
+
+    // The rest are created on request of the rules engine
+    CPPUNIT_ASSERT(re->materializeSlaves() == 1);
+    CPPUNIT_ASSERT(re->materializeSlaves() == 0);
+    CPPUNIT_ASSERT(db->getTokens().size() == 3);
+    CPPUNIT_ASSERT(root->getSlaves().size() == 2);
+
+    // Slaves still pending when the rule is undone are never created
+    t0.cancel();
+    CPPUNIT_ASSERT(db->getTokens().size() == 1);
+    t0.activate();
+    CPPUNIT_ASSERT(db->getTokens().size() == 1);
+    t0.cancel();
+    CPPUNIT_ASSERT(db->getTokens().size() == 1);
+
+    // Accessing all slaves creates them in order
+    t0.activate();
+    ruleInstances.clear();
+    re->getRuleInstances(t0.getId(), ruleInstances);
+    CPPUNIT_ASSERT(ruleInstances.size() == 1);
+    std::vector<TokenId> slaves = (*ruleInstances.begin())->getSlaves();
+    CPPUNIT_ASSERT(slaves.size() == 2);
+    CPPUNIT_ASSERT(slaves[0] == (*ruleInstances.begin())->getSlave("slave1"));
+    CPPUNIT_ASSERT(db->getTokens().size() == 3);
+
+    RE_DEFAULT_TEARDOWN();
+    return true;
+  }
+
   static bool testNestedGuards(){
     RE_DEFAULT_SETUP(ce, db, false);
     Object o1(db, "AllObjects", "o1");
@@ -502,6 +625,61 @@ private:
     return true;
   }
 
+  static bool testWatchedGuards(){
+    RE_DEFAULT_SETUP(ce, db, false);
+    Object o1(db, "AllObjects", "o1");
+    db->close();
+
+    re->getRuleSchema()->registerRule((new NestedGuards_0())->getId());
+
+    IntervalToken t0(db,
+		     "AllObjects.Predicate",
+		     true,
+		     false,
+		     IntervalIntDomain(0, 10),
+		     IntervalIntDomain(0, 20),
+		     IntervalIntDomain(1, 1000));
+    t0.activate();
+    t0.getObject()->specify(o1.getKey());
+    ce->propagate();
+    CPPUNIT_ASSERT(t0.slaves().size() == 1);
+
+    std::set<RuleInstanceId> ruleInstances;
+    re->getRuleInstances(t0.getId(), ruleInstances);
+    CPPUNIT_ASSERT(ruleInstances.size() == 1);
+    RuleInstanceId root = *(ruleInstances.begin());
+    CPPUNIT_ASSERT(root->isExecuted());
+
+    // Once fired, only a relaxation of the guard can undo the rule
+    CPPUNIT_ASSERT(!root->isWatchedChange(t0.getObject(), 0, false));
+    CPPUNIT_ASSERT(root->isWatchedChange(t0.getObject(), 0, true));
+
+    // The explicit guard on start is only watched once it becomes a singleton
+    CPPUNIT_ASSERT(root->getChildRules().size() == 2);
+    RuleInstanceId startGuarded = root->getChildRules()[0];
+    CPPUNIT_ASSERT(!startGuarded->isExecuted());
+    t0.start()->restrictBaseDomain(IntervalIntDomain(9, 10));
+    ce->propagate();
+    CPPUNIT_ASSERT(!startGuarded->isWatchedChange(t0.start(), 0, false));
+    CPPUNIT_ASSERT(!startGuarded->isExecuted());
+    CPPUNIT_ASSERT(t0.slaves().size() == 1);
+
+    t0.start()->specify(10);
+    CPPUNIT_ASSERT(startGuarded->isWatchedChange(t0.start(), 0, false));
+    ce->propagate();
+    CPPUNIT_ASSERT(startGuarded->isExecuted());
+    CPPUNIT_ASSERT(t0.slaves().size() == 2);
+
+    // Leaving the singleton on reset undoes the rule
+    t0.start()->reset();
+    ce->propagate();
+    CPPUNIT_ASSERT(!startGuarded->isExecuted());
+    CPPUNIT_ASSERT(t0.slaves().size() == 1);
+
+    RE_DEFAULT_TEARDOWN();
+    return true;
+  }
+
   static bool testTestRule(){
     RE_DEFAULT_SETUP(ce, db, false);
     db->close();
@@ -689,6 +867,59 @@ private:
 
     return true;
   }
+
+  /**
+   * A snapshot must restore a decision on a rule variable, which only exists once the rule has fired,
+   * and on the slave that decision guards.
+   */
+  static bool testSnapshot(){
+    char pattern[] = "/tmp/snapshotXXXXXX";
+    int fd = mkstemp(pattern);
+    CPPUNIT_ASSERT(fd >= 0);
+    close(fd);
+    const std::string fileName(pattern);
+
+    std::string expected;
+    {
+      RE_DEFAULT_SETUP(ce, db, false);
+      db->close();
+      re->getRuleSchema()->registerRule((new LocalVariableGuard_0())->getId());
+      DbClientId client = db->getClient();
+      client->enableTransactionLogging();
+      DbClientTransactionWriter writer(client);
+
+      TokenId t0 = client->createToken("AllObjects.Predicate");
+      client->activate(t0);
+      CPPUNIT_ASSERT(client->propagate());
+      client->specify(LocalVariableGuard_0_Root::getGuard(), LabelStr("B"));
+      CPPUNIT_ASSERT(client->propagate());
+      CPPUNIT_ASSERT(t0->slaves().size() == 1);
+      TokenId slave = *(t0->slaves().begin());
+      client->specify(slave->duration(), 7);
+      CPPUNIT_ASSERT(client->propagate());
+
+      expected = slave->duration()->lastDomain().toString();
+      PlanDatabaseSnapshot::save(writer, fileName);
+    }
+    {
+      RE_DEFAULT_SETUP(ce, db, false);
+      db->close();
+      re->getRuleSchema()->registerRule((new LocalVariableGuard_0())->getId());
+      DbClientId client = db->getClient();
+      CPPUNIT_ASSERT(PlanDatabaseSnapshot::restore(client, fileName));
+
+      TokenId t0 = client->getTokenByPath(std::vector<unsigned int>(1, 0));
+      CPPUNIT_ASSERT(t0.isValid() && t0->isActive());
+      CPPUNIT_ASSERT(t0->slaves().size() == 1);
+      ConstrainedVariableId guard = LocalVariableGuard_0_Root::getGuard();
+      CPPUNIT_ASSERT(guard->isSpecified() && guard->getSpecifiedValue() == LabelStr("B"));
+      TokenId slave = *(t0->slaves().begin());
+      CPPUNIT_ASSERT(slave->duration()->isSpecified());
+      CPPUNIT_ASSERT_MESSAGE(expected, slave->duration()->lastDomain().toString() == expected);
+    }
+    std::remove(fileName.c_str());
+    return true;
+  }
 };
 
 /*void RulesEngineModuleTests::runTests(std::string path)
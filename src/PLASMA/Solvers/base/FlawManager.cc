@@ -329,6 +329,12 @@ FlawManager::FlawManager(const TiXmlElement& configData)
       return DecisionPointId::noId();
     }
 
+    void FlawManager::getZeroCommitmentDecisions(std::vector<DecisionPointId>& results){
+      DecisionPointId decision = nextZeroCommitmentDecision();
+      if(decision.isId())
+        results.push_back(decision);
+    }
+
     DecisionPointId FlawManager::next(Priority& bestPriority){
       EntityId flawToResolve;
 
@@ -94,6 +94,14 @@ class ConstraintEngineListener;
        */
       virtual DecisionPointId nextZeroCommitmentDecision();
 
+      /**
+       * @brief Obtains all flaws that are currently forced, so that they can be executed in bulk
+       * before the next propagation.
+       * @param results Uninitialized DecisionPoints are appended to this vector.
+       * @see nextZeroCommitmentDecision
+       */
+      virtual void getZeroCommitmentDecisions(std::vector<DecisionPointId>& results);
+
       /**
        * @brief Primary service provided to the planner. Seeks out the next best decision
        * that is a higher priority than the current best priority.
@@ -0,0 +1,304 @@
+#include "SearchProfiler.hh"
+#include "Solver.hh"
+#include "SolverDecisionPoint.hh"
+#include "FlawHandler.hh"
+#include "Constraint.hh"
+#include "ConstraintEngine.hh"
+#include "Propagator.hh"
+#include "PlanDatabase.hh"
+#include "RulesEngine.hh"
+#include "RuleInstance.hh"
+#include "Rule.hh"
+#include "Debug.hh"
+
+#include <boost/cast.hpp>
+#include <boost/core/demangle.hpp>
+#include <fstream>
+#include <typeinfo>
+
+#ifdef _MSC_VER
+#include <ctime>
+#else
+#include <sys/time.h>
+#endif
+
+/**
+ * @file SearchProfiler.cc
+ * @brief Implementation of the search profiler.
+ */
+
+namespace EUROPA {
+namespace SOLVERS {
+
+namespace {
+void writeJsonString(std::ostream& os, const std::string& str) {
+  os << '"';
+  for(std::string::const_iterator it = str.begin(); it != str.end(); ++it) {
+    if(*it == '"' || *it == '\\')
+      os << '\\';
+    os << *it;
+  }
+  os << '"';
+}
+}
+
+SearchProfiler::Scope::Scope(SearchProfiler* profiler, Phase phase)
+    : m_profiler(profiler), m_depth(0) {
+  if(m_profiler == NULL)
+    return;
+  m_depth = m_profiler->m_frames.size();
+  m_profiler->push(PHASE, getPhaseName(phase));
+  if(phase == PROPAGATE)
+    m_profiler->m_propagationDepth = m_profiler->m_frames.size();
+}
+
+SearchProfiler::Scope::Scope(SearchProfiler* profiler, const DecisionPointId dp)
+    : m_profiler(profiler), m_depth(0) {
+  if(m_profiler == NULL)
+    return;
+  m_depth = m_profiler->m_frames.size();
+  std::map<eint, std::pair<std::string, std::string> >::const_iterator it =
+      m_profiler->m_decisionLabels.find(dp->getKey());
+  if(it != m_profiler->m_decisionLabels.end()) {
+    m_profiler->push(DECISION, it->second.first);
+    m_profiler->push(HANDLER, it->second.second);
+  }
+  else
+    m_profiler->push(DECISION, boost::core::demangle(typeid(*dp).name()));
+}
+
+SearchProfiler::Scope::~Scope() {
+  if(m_profiler != NULL)
+    m_profiler->popTo(m_depth);
+}
+
+SearchProfiler::SearchProfiler(Solver& solver, const PlanDatabaseId db,
+                               const std::string& outputPrefix)
+    : SearchListener(), m_solver(solver), m_outputPrefix(outputPrefix),
+      m_frames(), m_pathLengths(), m_path(solver.getName()), m_propagationDepth(0),
+      m_mark(now()), m_totalTime(0.0), m_stacks(), m_entries(), m_decisionLabels(),
+      m_ceListener(new CeListener(db->getConstraintEngine(), *this)),
+      m_reListener() {
+  EngineComponent* re = db->getEngine()->getComponent("RulesEngine");
+  if(re != NULL)
+    m_reListener.reset(new ReListener(boost::polymorphic_cast<RulesEngine*>(re)->getId(), *this));
+}
+
+SearchProfiler::~SearchProfiler() {}
+
+const SearchProfiler::Entries& SearchProfiler::getEntries(FrameKind kind) const {
+  checkError(kind < FRAME_KINDS, "Invalid frame kind " << kind);
+  return m_entries[kind];
+}
+
+void SearchProfiler::reset() {
+  m_mark = now();
+  m_totalTime = 0.0;
+  m_stacks.clear();
+  for(unsigned int i = 0; i < FRAME_KINDS; i++)
+    m_entries[i].clear();
+}
+
+double SearchProfiler::now() {
+#ifdef _MSC_VER
+  return static_cast<double>(clock()) / CLOCKS_PER_SEC;
+#else
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+#endif
+}
+
+const char* SearchProfiler::getKindName(FrameKind kind) {
+  static const char* sl_names[FRAME_KINDS] = {
+    "phases", "decisionPoints", "flawHandlers", "propagators", "constraints", "rules"
+  };
+  return sl_names[kind];
+}
+
+const char* SearchProfiler::getPhaseName(Phase phase) {
+  static const char* sl_names[] = {"solve", "select", "execute", "propagate", "undo"};
+  return sl_names[phase];
+}
+
+void SearchProfiler::charge() {
+  double t = now();
+  double elapsed = t - m_mark;
+  m_mark = t;
+
+  if(m_frames.empty())
+    return;
+
+  m_totalTime += elapsed;
+  m_stacks[m_path] += elapsed;
+
+  // Inclusive time: every distinct frame on the stack is charged once
+  for(std::vector<Frame>::const_iterator it = m_frames.begin(); it != m_frames.end(); ++it) {
+    bool seen = false;
+    for(std::vector<Frame>::const_iterator prior = m_frames.begin(); prior != it && !seen; ++prior)
+      seen = (prior->kind == it->kind && prior->name == it->name);
+    if(!seen)
+      m_entries[it->kind][it->name].time += elapsed;
+  }
+}
+
+void SearchProfiler::push(FrameKind kind, const std::string& name) {
+  charge();
+  m_frames.push_back(Frame(kind, name));
+  m_pathLengths.push_back(m_path.size());
+  m_path += ';';
+  m_path += name;
+  m_entries[kind][name].count++;
+}
+
+void SearchProfiler::pop() {
+  checkError(!m_frames.empty(), "No frame to pop.");
+  charge();
+  m_frames.pop_back();
+  m_path.resize(m_pathLengths.back());
+  m_pathLengths.pop_back();
+  if(m_frames.size() < m_propagationDepth)
+    m_propagationDepth = 0;
+}
+
+void SearchProfiler::popTo(size_t depth) {
+  while(m_frames.size() > depth)
+    pop();
+}
+
+void SearchProfiler::replaceTop(FrameKind kind, const std::string& name) {
+  checkError(!m_frames.empty(), "No frame to replace.");
+  m_frames.back() = Frame(kind, name);
+  m_path.resize(m_pathLengths.back());
+  m_path += ';';
+  m_path += name;
+}
+
+void SearchProfiler::handleConstraintExecuted(const ConstraintId constraint) {
+  if(m_propagationDepth == 0)
+    return;
+
+  const std::string& propagator = constraint->getPropagator()->getName();
+  if(m_frames.size() > m_propagationDepth &&
+     m_frames[m_propagationDepth].name == propagator)
+    popTo(m_propagationDepth + 1);
+  else {
+    popTo(m_propagationDepth);
+    push(PROPAGATOR, propagator);
+  }
+  push(CONSTRAINT, constraint->getName());
+}
+
+void SearchProfiler::handlePropagationDone() {
+  if(m_propagationDepth != 0)
+    popTo(m_propagationDepth);
+}
+
+/**
+ * Rule instances are executed by their listener constraint, and the event is published once the
+ * rule body has been evaluated. The time since the constraint frame was pushed is charged to the rule.
+ */
+void SearchProfiler::handleRuleExecuted(const RuleInstanceId rule) {
+  const std::string& name = rule->getRule()->getName();
+  if(m_propagationDepth == 0 || m_frames.back().kind != CONSTRAINT) {
+    m_entries[RULE][name].count++;
+    return;
+  }
+
+  Frame constraint = m_frames.back();
+  replaceTop(RULE, name);
+  charge();
+  m_entries[RULE][name].count++;
+  replaceTop(constraint.kind, constraint.name);
+}
+
+void SearchProfiler::notifyCreated(DecisionPointId dp) {
+  std::string handler("unknown");
+  EntityId entity = Entity::getEntity(dp->getFlawedEntityKey());
+  if(entity.isId()) {
+    FlawHandlerId flawHandler = m_solver.getFlawHandler(entity);
+    if(flawHandler.isId())
+      handler = flawHandler->getName();
+  }
+
+  m_decisionLabels[dp->getKey()] =
+      std::make_pair(boost::core::demangle(typeid(*dp).name()), handler);
+}
+
+void SearchProfiler::notifyDeleted(DecisionPointId dp) {
+  m_decisionLabels.erase(dp->getKey());
+}
+
+void SearchProfiler::write() {
+  charge();
+
+  std::string foldedFile = m_outputPrefix + ".folded";
+  std::ofstream folded(foldedFile.c_str());
+  checkError(folded.good(), "Failed to open " << foldedFile);
+  writeFolded(folded);
+
+  std::string jsonFile = m_outputPrefix + ".json";
+  std::ofstream json(jsonFile.c_str());
+  checkError(json.good(), "Failed to open " << jsonFile);
+  writeJson(json);
+
+  debugMsg("SearchProfiler:write", "Wrote " << foldedFile << " and " << jsonFile);
+}
+
+/**
+ * One line per stack, frames separated by ';', followed by the self time in microseconds.
+ */
+void SearchProfiler::writeFolded(std::ostream& os) const {
+  for(std::map<std::string, double>::const_iterator it = m_stacks.begin(); it != m_stacks.end(); ++it) {
+    unsigned long micros = static_cast<unsigned long>(it->second * 1e6 + 0.5);
+    if(micros > 0)
+      os << it->first << " " << micros << std::endl;
+  }
+}
+
+void SearchProfiler::writeJson(std::ostream& os) const {
+  os << "{" << std::endl;
+  os << "  \"solver\": ";
+  writeJsonString(os, m_solver.getName());
+  os << "," << std::endl;
+  os << "  \"steps\": " << m_solver.getStepCount() << "," << std::endl;
+  os << "  \"depth\": " << m_solver.getDepth() << "," << std::endl;
+  os << "  \"totalTime\": " << m_totalTime;
+
+  for(unsigned int i = 0; i < FRAME_KINDS; i++) {
+    os << "," << std::endl << "  \"" << getKindName(static_cast<FrameKind>(i)) << "\": {";
+    const Entries& entries = m_entries[i];
+    for(Entries::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+      os << (it == entries.begin() ? "" : ",") << std::endl << "    ";
+      writeJsonString(os, it->first);
+      os << ": {\"count\": " << it->second.count << ", \"time\": " << it->second.time << "}";
+    }
+    os << (entries.empty() ? "}" : "\n  }");
+  }
+  os << std::endl << "}" << std::endl;
+}
+
+SearchProfiler::CeListener::CeListener(const ConstraintEngineId ce, SearchProfiler& profiler)
+    : ConstraintEngineListener(ce), m_profiler(profiler) {}
+
+void SearchProfiler::CeListener::notifyExecuted(const ConstraintId constraint) {
+  m_profiler.handleConstraintExecuted(constraint);
+}
+
+void SearchProfiler::CeListener::notifyPropagationCompleted() {
+  m_profiler.handlePropagationDone();
+}
+
+void SearchProfiler::CeListener::notifyPropagationPreempted() {
+  m_profiler.handlePropagationDone();
+}
+
+SearchProfiler::ReListener::ReListener(const RulesEngineId re, SearchProfiler& profiler)
+    : RulesEngineListener(re), m_profiler(profiler) {}
+
+void SearchProfiler::ReListener::notifyExecuted(const RuleInstanceId& rule) {
+  m_profiler.handleRuleExecuted(rule);
+}
+
+}
+}
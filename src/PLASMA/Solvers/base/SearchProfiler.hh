@@ -0,0 +1,184 @@
+#ifndef H_SearchProfiler
+#define H_SearchProfiler
+
+/**
+ * @file SearchProfiler.hh
+ * @brief Accumulates search time by decision type, flaw handler, propagator, constraint and rule.
+ * @ingroup Solvers
+ */
+
+#include "SolverDefs.hh"
+#include "SearchListener.hh"
+#include "ConstraintEngineListener.hh"
+#include "RulesEngineListener.hh"
+
+#include <boost/scoped_ptr.hpp>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace EUROPA {
+namespace SOLVERS {
+
+/**
+ * @brief Profiles a Solver by charging elapsed wall time to a stack of frames.
+ *
+ * The Solver pushes frames for the search phases and the decision being worked on. Constraint
+ * and rule frames are pushed from ConstraintEngine and RulesEngine events while a propagation
+ * phase is open. Every stack transition charges the time since the previous transition to the
+ * current stack, so no time is charged twice. The result can be written as folded stacks,
+ * suitable for flame graph tools, and as a JSON summary of inclusive time and counts per
+ * decision point type, flaw handler, propagator, constraint and rule.
+ *
+ * A Solver attaches a profiler when the engine property "Solver.profile" is set. Its value is
+ * used as the prefix for the output files, which are written at the end of every call to solve.
+ *
+ * @see Solver, SearchListener
+ */
+class SearchProfiler : public SearchListener {
+ public:
+  enum FrameKind {
+    PHASE = 0,
+    DECISION,
+    HANDLER,
+    PROPAGATOR,
+    CONSTRAINT,
+    RULE,
+    FRAME_KINDS
+  };
+
+  enum Phase {
+    SOLVE = 0,
+    SELECT,
+    EXECUTE,
+    PROPAGATE,
+    UNDO
+  };
+
+  /**
+   * @brief Accumulated inclusive time (in seconds) and number of entries for a frame.
+   */
+  struct Entry {
+    Entry() : count(0), time(0.0) {}
+    unsigned long count;
+    double time;
+  };
+
+  typedef std::map<std::string, Entry> Entries;
+
+  /**
+   * @brief Pushes frames on construction and pops them on destruction. Does nothing without a profiler.
+   */
+  class Scope {
+   public:
+    Scope(SearchProfiler* profiler, Phase phase);
+    Scope(SearchProfiler* profiler, const DecisionPointId dp);
+    ~Scope();
+   private:
+    Scope(const Scope&);
+    Scope& operator=(const Scope&);
+    SearchProfiler* m_profiler;
+    size_t m_depth;
+  };
+
+  SearchProfiler(Solver& solver, const PlanDatabaseId db, const std::string& outputPrefix);
+  virtual ~SearchProfiler();
+
+  /**
+   * @brief Inclusive time and counts for frames of the given kind.
+   */
+  const Entries& getEntries(FrameKind kind) const;
+
+  /**
+   * @brief Self time per folded stack.
+   */
+  const std::map<std::string, double>& getStacks() const {return m_stacks;}
+
+  /**
+   * @brief Total time charged since construction or the last reset.
+   */
+  double getTotalTime() const {return m_totalTime;}
+
+  /**
+   * @brief Discard all accumulated data.
+   */
+  void reset();
+
+  /**
+   * @brief Write '<prefix>.folded' and '<prefix>.json'.
+   */
+  void write();
+
+  void writeFolded(std::ostream& os) const;
+  void writeJson(std::ostream& os) const;
+
+  /* SearchListener */
+  void notifyCreated(DecisionPointId dp);
+  void notifyDeleted(DecisionPointId dp);
+
+  /**
+   * @brief Current wall clock time, in seconds.
+   */
+  static double now();
+
+  static const char* getKindName(FrameKind kind);
+  static const char* getPhaseName(Phase phase);
+
+ private:
+  struct Frame {
+    Frame(FrameKind k, const std::string& n) : kind(k), name(n) {}
+    FrameKind kind;
+    std::string name;
+  };
+
+  void push(FrameKind kind, const std::string& name);
+  void pop();
+  void popTo(size_t depth);
+  void replaceTop(FrameKind kind, const std::string& name);
+  void charge();
+
+  void handleConstraintExecuted(const ConstraintId constraint);
+  void handlePropagationDone();
+  void handleRuleExecuted(const RuleInstanceId rule);
+
+  class CeListener : public ConstraintEngineListener {
+   public:
+    CeListener(const ConstraintEngineId ce, SearchProfiler& profiler);
+    void notifyExecuted(const ConstraintId constraint);
+    void notifyPropagationCompleted();
+    void notifyPropagationPreempted();
+   private:
+    SearchProfiler& m_profiler;
+  };
+
+  class ReListener : public RulesEngineListener {
+   public:
+    ReListener(const RulesEngineId re, SearchProfiler& profiler);
+    void notifyExecuted(const RuleInstanceId& rule);
+   private:
+    SearchProfiler& m_profiler;
+  };
+
+  friend class CeListener;
+  friend class ReListener;
+
+  Solver& m_solver;
+  std::string m_outputPrefix;
+  std::vector<Frame> m_frames; /*!< The current stack. */
+  std::vector<size_t> m_pathLengths; /*!< Length of m_path before each frame was pushed. */
+  std::string m_path; /*!< The current stack, folded. */
+  size_t m_propagationDepth; /*!< Stack size when the open propagation phase was pushed, 0 if none. */
+  double m_mark; /*!< Time of the last stack transition. */
+  double m_totalTime;
+  std::map<std::string, double> m_stacks;
+  Entries m_entries[FRAME_KINDS];
+  std::map<eint, std::pair<std::string, std::string> > m_decisionLabels; /*!< Type and handler by decision key. */
+  boost::scoped_ptr<CeListener> m_ceListener;
+  boost::scoped_ptr<ReListener> m_reListener;
+};
+
+}
+}
+
+#endif
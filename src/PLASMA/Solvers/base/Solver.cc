@@ -10,8 +10,12 @@
 #include "PlanDatabaseWriter.hh"
 #include "FlawHandler.hh"
 #include "Context.hh"
+#include "SearchProfiler.hh"
+#include "RulesEngine.hh"
 #include "tinyxml.h"
+#include <boost/cast.hpp>
 #include <bitset>
+#include <set>
 
 /**
  * @file Solver.cc
@@ -61,12 +65,14 @@ Solver::Solver(const PlanDatabaseId db, const TiXmlElement& configData)
       m_maxSteps(std::numeric_limits<unsigned int>::max()),
       m_maxDepth(std::numeric_limits<unsigned int>::max()),
 #endif //_MSC_VER
+      m_maxStackMemory(0), m_stackMemory(0), m_compactedDepth(0), m_drainZeroCommitment(false),
       m_masterFlawFilter(configData), 
   m_context(),
   m_flawManagers(),
   m_decisionStack(),
   m_lastExecutedDecision(),
   m_listeners(),
+  m_profiler(),
   m_ceListener(db->getConstraintEngine(), *this),
       m_dbListener(db, *this) {
   checkError(strcmp(configData.Value(), "Solver") == 0,
@@ -75,6 +81,16 @@ Solver::Solver(const PlanDatabaseId db, const TiXmlElement& configData)
   // Extract the name of the Solver
   m_name = extractData(configData, "name");
 
+  // Optional bound on the memory retained for choices on the decision stack
+  const char* maxStackMemoryStr = configData.Attribute("maxStackMemory");
+  if(maxStackMemoryStr != NULL)
+    m_maxStackMemory = static_cast<size_t>(atof(maxStackMemoryStr));
+
+  // Optionally execute forced decisions in bulk
+  const char* drainZeroCommitmentStr = configData.Attribute("drainZeroCommitment");
+  if(drainZeroCommitmentStr != NULL)
+    m_drainZeroCommitment = (strcmp(drainZeroCommitmentStr, "true") == 0);
+
   m_context = ((new Context(m_name + "Context"))->getId());
   // Initialize the common filter
   m_masterFlawFilter.initialize(configData, m_db, m_context);
@@ -101,9 +117,18 @@ Solver::Solver(const PlanDatabaseId db, const TiXmlElement& configData)
       m_flawManagers.push_back(flawManager);
     }
   }
+
+  // Attach a profiler if requested. The property value is the prefix for the output files.
+  const std::string& profile = db->getEngine()->getConfig()->getProperty("Solver.profile");
+  if(!profile.empty()) {
+    m_profiler.reset(new SearchProfiler(*this, m_db, profile));
+    addListener(m_profiler->getId());
+  }
 }
 
 Solver::~Solver(){
+  if(m_profiler)
+    removeListener(m_profiler->getId());
   cleanupDecisions();
   EUROPA::cleanup(m_flawManagers);
   delete static_cast<Context*>(m_context);
@@ -134,7 +159,13 @@ Solver::~Solver(){
       m_noFlawsFound = false;
       m_timedOut = false;
 
-      while(!m_timedOut && !m_exhausted && !m_noFlawsFound) step();
+      {
+        SearchProfiler::Scope scope(m_profiler.get(), SearchProfiler::SOLVE);
+        while(!m_timedOut && !m_exhausted && !m_noFlawsFound) step();
+      }
+
+      if(m_profiler)
+        m_profiler->write();
 
       checkError(!m_exhausted || m_decisionStack.empty(),
                  "If we have exhausted all our options to recover, then we must have no further decision available." <<
@@ -183,6 +214,44 @@ const std::string& Solver::getName() const { return m_name;}
 
     void Solver::setMaxDepth(const unsigned int depth) {m_maxDepth = depth;}
 
+    void Solver::setMaxStackMemory(const size_t bytes) {
+      checkError(m_decisionStack.empty(), "Can only bound stack memory with an empty decision stack.");
+      m_maxStackMemory = bytes;
+    }
+
+    void Solver::pushDecision(const DecisionPointId dp) {
+      m_decisionStack.push_back(dp);
+
+      if(m_maxStackMemory == 0)
+        return;
+
+      // Compact the oldest decisions first, they are the least likely to be revisited. The most recent
+      // decision is left alone.
+      m_stackMemory += dp->getChoiceMemory();
+      while(m_stackMemory > m_maxStackMemory && m_compactedDepth + 1 < m_decisionStack.size()){
+        DecisionPointId oldest = m_decisionStack[m_compactedDepth++];
+        m_stackMemory -= oldest->getChoiceMemory();
+        oldest->compact();
+        m_stackMemory += oldest->getChoiceMemory();
+      }
+
+      debugMsg("Solver:pushDecision", "Retaining " << m_stackMemory << " bytes of choices with " <<
+               m_compactedDepth << " of " << m_decisionStack.size() << " decisions compacted");
+    }
+
+    DecisionPointId Solver::popDecision() {
+      DecisionPointId dp = m_decisionStack.back();
+      m_decisionStack.pop_back();
+
+      if(m_maxStackMemory != 0) {
+        m_stackMemory -= dp->getChoiceMemory();
+        if(m_decisionStack.size() < m_compactedDepth)
+          m_compactedDepth = m_decisionStack.size();
+      }
+
+      return dp;
+    }
+
     /**
      * @brief Provides baseline implementation for chosing the next flaw and allocating the next decision.
      *
@@ -259,6 +328,91 @@ const std::string& Solver::getName() const { return m_name;}
       return DecisionPointId::noId();
     }
 
+    bool Solver::drainZeroCommitmentDecisions(){
+      checkError(m_activeDecision.isNoId(), "Cannot drain forced decisions with an active decision.");
+
+      if(m_maxSteps <= getStepCount() - m_stepCountFloor || m_maxDepth < getDepth() - m_depthFloor)
+        return false;
+
+      std::vector<DecisionPointId> decisions;
+      {
+        SearchProfiler::Scope scope(m_profiler.get(), SearchProfiler::SELECT);
+        std::vector<DecisionPointId> candidates;
+        for(FlawManagers::const_iterator it = m_flawManagers.begin(); it != m_flawManagers.end(); ++it){
+          FlawManagerId fm = *it;
+          fm->getZeroCommitmentDecisions(candidates);
+        }
+
+        // Keep one decision per flaw, and no more than the depth limit allows
+        unsigned long remaining = static_cast<unsigned long>(m_maxDepth) + 1 - (getDepth() - m_depthFloor);
+        std::set<eint> flawedEntities;
+        for(std::vector<DecisionPointId>::const_iterator it = candidates.begin(); it != candidates.end(); ++it){
+          DecisionPointId dp = *it;
+          if(decisions.size() < remaining && flawedEntities.insert(dp->getFlawedEntityKey()).second)
+            decisions.push_back(dp);
+          else
+            delete static_cast<DecisionPoint*>(dp);
+        }
+
+        for(std::vector<DecisionPointId>::const_iterator it = decisions.begin(); it != decisions.end(); ++it){
+          publish(notifyCreated,*it);
+          (*it)->initialize();
+        }
+      }
+
+      // A dead-end, or a single decision, is handled as a regular step
+      for(std::vector<DecisionPointId>::const_iterator it = decisions.begin(); it != decisions.end(); ++it){
+        if(decisions.size() == 1 || (*it)->cut() || !(*it)->hasNext()){
+          m_activeDecision = *it;
+          break;
+        }
+      }
+
+      if(decisions.empty() || m_activeDecision.isId()){
+        for(std::vector<DecisionPointId>::const_iterator it = decisions.begin(); it != decisions.end(); ++it){
+          if(*it != m_activeDecision){
+            publish(notifyDeleted,*it);
+            delete static_cast<DecisionPoint*>(*it);
+          }
+        }
+        return false;
+      }
+
+      debugMsg("Solver:drainZeroCommitmentDecisions", "Executing " << decisions.size() << " forced decisions.");
+
+      for(std::vector<DecisionPointId>::const_iterator it = decisions.begin(); it != decisions.end(); ++it){
+        DecisionPointId dp = *it;
+        m_lastExecutedDecision = dp->toString();
+        SearchProfiler::Scope decisionScope(m_profiler.get(), dp);
+        SearchProfiler::Scope scope(m_profiler.get(), SearchProfiler::EXECUTE);
+        dp->execute();
+      }
+      {
+        SearchProfiler::Scope scope(m_profiler.get(), SearchProfiler::PROPAGATE);
+        m_db->getClient()->propagate();
+      }
+      m_stepCount++;
+
+      if(conflictLevelOk()){
+        for(std::vector<DecisionPointId>::const_iterator it = decisions.begin(); it != decisions.end(); ++it){
+          pushDecision(*it);
+          publish(notifyStepSucceeded,*it);
+        }
+        debugMsg("Solver:printPlan:infrequent", std::endl << PlanDatabaseWriter::toString(m_db));
+        return true;
+      }
+
+      // The failure cannot be attributed to a single decision, so we undo from the most recent
+      for(std::vector<DecisionPointId>::const_iterator it = decisions.begin(); it != decisions.end() - 1; ++it)
+        pushDecision(*it);
+      m_activeDecision = decisions.back();
+      publish(notifyStepFailed,m_activeDecision);
+      debugMsg("Solver:backtrack",
+               "Backtracking because of constraint inconsistency due to " << decisions.size() << " forced decisions");
+      recover();
+      return true;
+    }
+
     bool Solver::isExhausted() const {
       checkError(!m_exhausted || m_decisionStack.empty(),
                  "Cannot be left in an exhausted state if there are still decisions to evaluate.");
@@ -294,7 +448,10 @@ const std::string& Solver::getName() const { return m_name;}
 
       m_baseConflictLevel = m_db->getConstraintEngine()->getViolation();
       debugMsg("Solver:step", "Conflict level prior to propagation: " << m_baseConflictLevel);
-      m_db->getClient()->propagate();
+      {
+        SearchProfiler::Scope scope(m_profiler.get(), SearchProfiler::PROPAGATE);
+        m_db->getClient()->propagate();
+      }
       debugMsg("Solver:step", "Conflict level after propagation: " << m_db->getConstraintEngine()->getViolation());
 
       // If inconsistent, before doing anything, there is no solution.
@@ -314,9 +471,19 @@ const std::string& Solver::getName() const { return m_name;}
       // Reset flag for flaws found
       m_noFlawsFound = false;
 
+      // Forced decisions may be taken together, in which case the step is done
+      if(m_activeDecision.isNoId() && m_drainZeroCommitment && drainZeroCommitmentDecisions())
+        return;
+
       // If we have no active decision to work on, we get one
-      if(m_activeDecision.isNoId())
+      if(m_activeDecision.isNoId()) {
+        SearchProfiler::Scope scope(m_profiler.get(), SearchProfiler::SELECT);
         allocateNewDecisionPoint();
+      }
+
+      // Pending slaves may add flaws, so the search is only complete once they are created
+      if(m_activeDecision.isNoId() && materializeSlaves())
+        return;
 
       if(m_activeDecision.isNoId()){
         m_noFlawsFound = true;
@@ -340,12 +507,19 @@ const std::string& Solver::getName() const { return m_name;}
 
       if(!m_activeDecision->cut() && m_activeDecision->hasNext()){
         m_lastExecutedDecision = m_activeDecision->toString();
-        m_activeDecision->execute();
-        m_db->getClient()->propagate();
+        {
+          SearchProfiler::Scope decisionScope(m_profiler.get(), m_activeDecision);
+          {
+            SearchProfiler::Scope scope(m_profiler.get(), SearchProfiler::EXECUTE);
+            m_activeDecision->execute();
+          }
+          SearchProfiler::Scope scope(m_profiler.get(), SearchProfiler::PROPAGATE);
+          m_db->getClient()->propagate();
+        }
         m_stepCount++;
 
         if(conflictLevelOk()){
-          m_decisionStack.push_back(m_activeDecision);
+          pushDecision(m_activeDecision);
           publish(notifyStepSucceeded,m_activeDecision);
           m_activeDecision = DecisionPointId::noId();
           debugMsg("Solver:printPlan:infrequent", std::endl << PlanDatabaseWriter::toString(m_db));
@@ -362,6 +536,20 @@ const std::string& Solver::getName() const { return m_name;}
       }
 
       // If we get here then we must have to backtrack. so do it!
+      recover();
+    }
+
+    bool Solver::materializeSlaves(){
+      EngineComponent* re = m_db->getEngine()->getComponent("RulesEngine");
+      if(re == NULL)
+        return false;
+
+      unsigned int count = boost::polymorphic_cast<RulesEngine*>(re)->materializeSlaves();
+      debugMsg("Solver:step", "Created " << count << " pending slaves");
+      return count > 0;
+    }
+
+    void Solver::recover(){
       m_exhausted = backtrack();
 
       // If still left in a backtrack state, the deicion stack must be exhausted
@@ -384,8 +572,7 @@ const std::string& Solver::getName() const { return m_name;}
       while(backtracking && (m_activeDecision.isId() || !m_decisionStack.empty())){
         // If we have no active decision, source it from the decision stack
         if(m_activeDecision.isNoId() && !m_decisionStack.empty()){
-          m_activeDecision = m_decisionStack.back();
-          m_decisionStack.pop_back();
+          m_activeDecision = popDecision();
           debugMsg("Solver:backtrack", "Retrieving closed decision. Depth is:" << m_decisionStack.size());
         }
 
@@ -396,6 +583,8 @@ const std::string& Solver::getName() const { return m_name;}
 
         // If the active decision is executed, undo it
         if(m_activeDecision->isExecuted()) {
+          SearchProfiler::Scope decisionScope(m_profiler.get(), m_activeDecision);
+          SearchProfiler::Scope scope(m_profiler.get(), SearchProfiler::UNDO);
           m_activeDecision->undo();
           publish(notifyUndone,m_activeDecision);
           //debugMsg("Solver:printPlan", std::endl << PlanDatabaseWriter::toString(m_db));
@@ -450,7 +639,7 @@ const std::string& Solver::getName() const { return m_name;}
                    "Must have deleted the decision elsewhere." <<
                    " A bug in the Solver or FlawManager. A current assumption since we do not synchronize the stack.");
 
-        m_decisionStack.pop_back();
+        popDecision();
 
         if(node->canUndo()) {
           publish(notifyUndone,node);
@@ -515,6 +704,8 @@ const std::string& Solver::getName() const { return m_name;}
       }
 
       cleanup(m_decisionStack);
+      m_stackMemory = 0;
+      m_compactedDepth = 0;
     }
 
     void Solver::cleanup(DecisionStack& decisionStack){
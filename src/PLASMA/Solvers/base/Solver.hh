@@ -16,9 +16,13 @@
 #include "ConstraintEngineListener.hh"
 #include "PlanDatabaseListener.hh"
 
+#include <boost/scoped_ptr.hpp>
+
 namespace EUROPA {
 namespace SOLVERS {
 
+class SearchProfiler;
+
 /**
  * @brief Defines the main solver interface for identification and resolution of flaws on a plan database.
  *
@@ -154,6 +158,26 @@ class Solver {
    */
   void setMaxDepth(const unsigned int depth);
 
+  /**
+   * @brief Bound the memory, in bytes, retained for choices of decisions on the stack. When exceeded, the
+   * oldest decisions are compacted. 0, the default, means no bound.
+   * @see DecisionPoint::compact
+   */
+  void setMaxStackMemory(const size_t bytes);
+
+  /**
+   * @brief The memory, in bytes, currently retained for choices of decisions on the stack. Only
+   * tracked when a bound is set.
+   */
+  size_t getStackMemory() const {return m_stackMemory;}
+
+  /**
+   * @brief When set, all forced decisions available at the start of a step are executed together, followed
+   * by a single propagation. The step then increases the depth by the number of decisions executed.
+   * @see FlawManager::getZeroCommitmentDecisions
+   */
+  void setDrainZeroCommitment(const bool drain) {m_drainZeroCommitment = drain;}
+
   /**
    * @brief Create an iterator over the set of flaws.
    */
@@ -178,6 +202,11 @@ class Solver {
 
   std::string printOpenDecisions() const;
 
+  /**
+   * @brief The profiler attached through the "Solver.profile" engine property, or NULL.
+   */
+  SearchProfiler* getProfiler() const {return m_profiler.get();}
+
   /**
    * @brief Access the context of this Solver.
    */
@@ -209,8 +238,37 @@ class Solver {
    */
   DecisionPointId getZeroCommitmentDecision();
 
+  /**
+   * @brief Executes all forced decisions from the Flaw Managers with a single propagation.
+   * @return true if the step was taken. false if there were not enough forced decisions, in which case
+   * the active decision may have been set.
+   */
+  bool drainZeroCommitmentDecisions();
+
+  /**
+   * @brief Creates the slaves that rule instances with lazy slaves have not created yet. They are
+   * invisible to the flaw managers until then, so this is done whenever no flaw is left.
+   * @return true if any slave was created.
+   */
+  bool materializeSlaves();
+
   void doStep();
+
+  /**
+   * @brief Backtrack after a failed step, publishing exhaustion if there is nothing left to undo.
+   */
+  void recover();
   bool conflictLevelOk();
+
+  /**
+   * @brief Push an executed decision, compacting the oldest decisions if the memory bound is exceeded.
+   */
+  void pushDecision(const DecisionPointId dp);
+
+  /**
+   * @brief Pop the most recent decision off the stack.
+   */
+  DecisionPointId popDecision();
   double m_baseConflictLevel;  // Keeps track of initial conflict level before a solver step is taken
 
   static void cleanup(DecisionStack& decisionStack);
@@ -266,12 +324,17 @@ class Solver {
   bool m_timedOut;/*!< True of the depth or step limits are exceeded */
   unsigned int m_maxSteps; /*!< The maximum number of steps to take.  Used only for planner control.*/
   unsigned int m_maxDepth; /*!< The maximum depth to search.  Used only for planner control.*/
+  size_t m_maxStackMemory; /*!< Bound on choice memory retained by the decision stack. 0 if unbounded. */
+  size_t m_stackMemory; /*!< Choice memory retained by decisions on the stack. */
+  unsigned long m_compactedDepth; /*!< Decisions below this depth have been compacted. */
+  bool m_drainZeroCommitment; /*!< True if forced decisions are executed in bulk. */
   MasterFilter m_masterFlawFilter; /*!< Used to handle shared filter data across contained flaw managers */
   ContextId m_context; /*!< Used to share data from the Solver on down.*/
   FlawManagers m_flawManagers; /*!< Sequence of flaw managers to include in scope */
   DecisionStack m_decisionStack; /*!< Stack of decisions made */
   std::string m_lastExecutedDecision; /*!< Kept for debugging and UI purposes */
   std::list<SearchListenerId> m_listeners; /*!< The set of listeners for the search */
+  boost::scoped_ptr<SearchProfiler> m_profiler; /*!< Optional profiler, also registered as a listener */
 
   class FlawIterator : public Iterator {
    public:
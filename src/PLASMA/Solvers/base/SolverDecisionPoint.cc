@@ -9,7 +9,7 @@ namespace SOLVERS {
 DecisionPoint::DecisionPoint(const DbClientId client, eint entityKey,
                              const std::string& explanation) 
       : Entity(), m_client(client),  m_entityKey(entityKey), m_id(this), 
-	m_explanation(explanation), m_isExecuted(false), m_initialized(false),
+	m_explanation(explanation), m_isExecuted(false), m_initialized(false), m_compacted(false),
         m_context(), m_maxChoices(0), m_counter(0) {}
 
     DecisionPoint::~DecisionPoint() {m_id.remove();}
@@ -27,6 +27,11 @@ DecisionPoint::DecisionPoint(const DbClientId client, eint entityKey,
       static unsigned int sl_counter(0);
       checkError(isInitialized(), "Trying to execute an uninitialized decision. This is a bug in the Solver.");
       checkError(!isExecuted(), "Cannot execute if already executed. This indicates a bug in the Solver.");
+      if(m_compacted){
+        debugMsg("DecisionPoint:execute", "Restoring choices released on the decision stack.");
+        handleRestore();
+        m_compacted = false;
+      }
       checkError(hasNext(), "Tried to execute past available choices. This indicates a bug in the Solver.");
       debugMsg("DecisionPoint:execute", sl_counter++ << ": Executing current decision. " << toString());
       handleExecute();
@@ -43,6 +48,14 @@ DecisionPoint::DecisionPoint(const DbClientId client, eint entityKey,
       debugMsg("DecisionPoint:undo", "Finished Undoing current decision.");
     }
 
+    void DecisionPoint::compact(){
+      checkError(isExecuted(), "Only executed decisions can be compacted:" << toString());
+      if(!m_compacted)
+        m_compacted = handleCompact();
+    }
+
+    bool DecisionPoint::isCompacted() const {return m_compacted;}
+
     bool DecisionPoint::cut() const {return m_maxChoices > 0 && m_counter >= m_maxChoices;}
 
     bool DecisionPoint::isExecuted() const {return m_isExecuted;}
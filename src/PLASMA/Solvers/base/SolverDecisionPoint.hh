@@ -104,6 +104,26 @@ namespace EUROPA {
        */
       void undo();
 
+      /**
+       * @brief Releases the choices of an executed decision that can be regenerated, retaining only the
+       * executed choice and the position in the choice sequence. The choices are regenerated when the
+       * decision is next executed, at which point chronological backtracking has restored the plan to the
+       * state it was in when the choices were first populated.
+       * @see handleCompact, handleRestore
+       */
+      void compact();
+
+      /**
+       * @brief Tests if the choices of this decision have been released by compact.
+       */
+      bool isCompacted() const;
+
+      /**
+       * @brief Approximate number of bytes held for the choices of this decision. Used by the Solver to
+       * bound the memory retained by the decision stack.
+       */
+      virtual size_t getChoiceMemory() const {return 0;}
+
       /**
        * @brief Test to see if choices should be cut. This will supercede 'hasNext' which can
        * be specialized in a sub-class. Employs a test of number of choices made vs. maxChoices allowed
@@ -134,6 +154,19 @@ namespace EUROPA {
        */
       virtual void handleUndo() = 0;
 
+      /**
+       * @brief Implement this method to release choice data, retaining what is needed to undo and
+       * describe the executed choice.
+       * @return true if anything was released.
+       */
+      virtual bool handleCompact() {return false;}
+
+      /**
+       * @brief Regenerates the choices released by handleCompact. The position in the choice sequence
+       * must be preserved.
+       */
+      virtual void handleRestore() {handleInitialize();}
+
       const DbClientId m_client;
       const eint m_entityKey; /*!< The Key of underlying flawed entity. Store instead of ID so we can test it. */
 
@@ -146,6 +179,7 @@ namespace EUROPA {
       std::string m_explanation;
       bool m_isExecuted; /*!< True if executed has been called, and undo has not */
       bool m_initialized; /*!< True if choices have been set up. Otherwise false.*/
+      bool m_compacted; /*!< True if choices have been released and must be restored before the next execution. */
       ContextId m_context;
       unsigned int m_maxChoices; /*!< Set to bound number of choices */
       unsigned int m_counter; /*!< Increment on execution */
@@ -373,12 +373,8 @@ ThreatDecisionPoint::ThreatDecisionPoint(const DbClientId client, const TokenId
 // 	bool operator==(const ObjectComparator& c){return true;}
 //       };
 
-void ThreatDecisionPoint::handleInitialize() {
-  SOLVERS::ThreatDecisionPoint::handleInitialize();
-  //first order choices by object key
-  // 	ObjectComparator cmp;
-  // 	std::sort<std::vector<std::pair<ObjectId, std::pair<TokenId, TokenId> > >::iterator, ObjectComparator&>(m_choices.begin(), m_choices.end(), cmp);
-  //then order them by the heuristic
+void ThreatDecisionPoint::orderChoices() {
+  //order them by the heuristic
   std::sort<std::vector<std::pair<ObjectId, std::pair<TokenId, TokenId> > >::iterator, ThreatComparator&>(m_choices.begin(), m_choices.end(), *m_comparator);
   debugMsg("ThreatDecisionPoint:handleInitialize", "Final choice order for " << m_tokenToOrder->getKey() << ": " << choicesToString());
 }
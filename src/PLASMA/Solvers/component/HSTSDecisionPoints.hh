@@ -59,9 +59,12 @@ namespace EUROPA {
     class ThreatDecisionPoint : public SOLVERS::ThreatDecisionPoint {
      public:
       ThreatDecisionPoint(const DbClientId client, const TokenId tokenToOrder, const TiXmlElement& configData, const std::string& explanation = "unknown");
-      void handleInitialize();
       ~ThreatDecisionPoint();
       const std::vector<std::pair<ObjectId, std::pair<TokenId, TokenId> > >& getOrderingChoices(){return m_choices;}
+     protected:
+      // The heuristic compares choices on different objects, so all are drawn at once
+      void orderChoices();
+      bool ordersAcrossObjects() const {return true;}
      private:
       ThreatDecisionPoint(const ThreatDecisionPoint&);
       ThreatDecisionPoint& operator=(const ThreatDecisionPoint&);
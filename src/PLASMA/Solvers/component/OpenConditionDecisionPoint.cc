@@ -29,7 +29,8 @@ OpenConditionDecisionPoint::OpenConditionDecisionPoint(const DbClientId client,
       m_mergeCount(0),
       m_choiceCount(0),
       m_mergeIndex(0),
-      m_choiceIndex(0) {
+      m_choiceIndex(0),
+      m_mergeOffset(0) {
 
   // Retrieve policy information from configuration node
 
@@ -109,7 +110,8 @@ void OpenConditionDecisionPoint::handleExecute() {
   }
   else if(m_choices[m_choiceIndex] == Token::MERGED) {
     checkError(m_mergeIndex < m_mergeCount, "Tried to merge past available compatible tokens.");
-    TokenId activeToken = m_compatibleTokens[m_mergeIndex];
+    TokenId activeToken = getCompatibleToken(m_mergeIndex);
+    checkError(activeToken.isId(), "Compatible token " << m_mergeIndex << " has been released.");
     debugMsg("SolverDecisionPoint:handleExecute", "For " << m_flawedToken->getPredicateName() << "(" <<
              m_flawedToken->getKey() << "), assigning MERGED onto " << activeToken->getPredicateName() <<
              "(" << activeToken->getKey() << ").");
@@ -142,6 +144,59 @@ bool OpenConditionDecisionPoint::hasNext() const {
   return m_choiceIndex < m_choiceCount;
 }
 
+/**
+ * @brief Only the compatible token merged onto is retained. The state choices are few and are kept.
+ */
+bool OpenConditionDecisionPoint::handleCompact() {
+  if(m_compatibleTokens.empty())
+    return false;
+
+  if(m_choices[m_choiceIndex] == Token::MERGED) {
+    std::vector<TokenId>(1, getCompatibleToken(m_mergeIndex)).swap(m_compatibleTokens);
+    m_mergeOffset = m_mergeIndex;
+  }
+  else {
+    std::vector<TokenId>().swap(m_compatibleTokens);
+    m_mergeOffset = m_mergeCount;
+  }
+  return true;
+}
+
+/**
+ * @brief The plan is back in the state it was in when the choices were first populated, so they must
+ * come out the same. Only the compatible token merged onto is retained to check against.
+ */
+void OpenConditionDecisionPoint::handleRestore() {
+  const unsigned long mergeCount = m_mergeCount;
+  const unsigned long choiceCount = m_choiceCount;
+  const unsigned long retainedIndex = m_mergeOffset;
+  const TokenId retained = getCompatibleToken(retainedIndex);
+
+  m_choices.clear();
+  m_compatibleTokens.clear();
+  m_mergeOffset = 0;
+  m_mergeCount = 0;
+  handleInitialize();
+
+  checkError(m_choiceCount == choiceCount && m_mergeCount == mergeCount,
+             "Regenerated " << m_choiceCount << " choices and " << m_mergeCount <<
+             " compatible tokens for " << m_flawedToken->getKey() << " where there were " <<
+             choiceCount << " and " << mergeCount);
+  checkError(retained.isNoId() || getCompatibleToken(retainedIndex) == retained,
+             "Compatible token " << retainedIndex << " for " << m_flawedToken->getKey() <<
+             " is not the one merged onto before.");
+}
+
+size_t OpenConditionDecisionPoint::getChoiceMemory() const {
+  return m_compatibleTokens.capacity() * sizeof(TokenId) + m_choices.capacity() * sizeof(LabelStr);
+}
+
+TokenId OpenConditionDecisionPoint::getCompatibleToken(unsigned long mergeIndex) const {
+  if(mergeIndex < m_mergeOffset || mergeIndex - m_mergeOffset >= m_compatibleTokens.size())
+    return TokenId::noId();
+  return m_compatibleTokens[mergeIndex - m_mergeOffset];
+}
+
 std::string OpenConditionDecisionPoint::toShortString() const{
   // This returns the last executed choice
   unsigned long idx = m_choiceIndex;
@@ -150,8 +205,17 @@ std::string OpenConditionDecisionPoint::toShortString() const{
   if(m_choices.empty()) {
     os << "EMPTY";
   }
+  else if(idx >= m_choices.size()) {
+    os << "DONE(" << m_flawedToken->getKey() << ")";
+  }
   else if(m_choices[idx] == Token::MERGED) {
-    os << "MRG(" << m_flawedToken->getKey() << "," << m_compatibleTokens[m_mergeIndex]->getKey() << ")";
+    TokenId activeToken = getCompatibleToken(m_mergeIndex);
+    os << "MRG(" << m_flawedToken->getKey() << ",";
+    if(activeToken.isId())
+      os << activeToken->getKey();
+    else
+      os << "released";
+    os << ")";
   }
   else if(m_choices[idx] == Token::ACTIVE) {
     os << "ACT(" << m_flawedToken->getKey() << ")";
@@ -58,12 +58,21 @@ namespace EUROPA {
        */
       const TokenId getToken() const;
 
+      virtual size_t getChoiceMemory() const;
+
     protected:
       virtual void handleInitialize();
       virtual void handleExecute();
       virtual void handleUndo();
       virtual bool hasNext() const;
       virtual bool canUndo() const;
+      virtual bool handleCompact();
+      virtual void handleRestore();
+
+      /**
+       * @brief The compatible token at the given merge position, or noId if it has been released.
+       */
+      TokenId getCompatibleToken(unsigned long mergeIndex) const;
 
       const TokenId m_flawedToken; /*!< The token to be resolved. */
       std::vector<LabelStr> m_choices; /*!< The sequences list of states to choose. */
@@ -72,6 +81,7 @@ namespace EUROPA {
       unsigned long m_choiceCount; /*!< The size of m_choices. */
       unsigned long m_mergeIndex; /*!< The position of the next choice in m_compatibleTokens. */
       unsigned long m_choiceIndex; /*!< The position of the next choice in m_choices. */
+      unsigned long m_mergeOffset; /*!< Position of m_compatibleTokens[0] among all compatible tokens. Non-zero once compacted. */
 
     };
 
@@ -15,7 +15,7 @@ namespace EUROPA {
 namespace SOLVERS {
 
 OpenConditionManager::OpenConditionManager(const TiXmlElement& configData)
-    : FlawManager(configData), m_flawCandidates() {}
+    : FlawManager(configData), m_flawCandidates(), m_forcedCandidates() {}
 
     void OpenConditionManager::handleInitialize(){
       // FILL UP TOKENS
@@ -43,12 +43,18 @@ OpenConditionManager::OpenConditionManager(const TiXmlElement& configData)
 	debugMsg("OpenConditionManager:addFlaw",
 		 "Adding " << token->toString() << " as a candidate flaw.");
 	m_flawCandidates.insert(token);
+
+	if(token->hasAttributes(PSTokenType::EFFECT) || token->getState()->lastDomain().isSingleton()){
+	  debugMsg("OpenConditionManager:addFlaw", "Queueing " << token->toString() << " as a zero commitment flaw.");
+	  m_forcedCandidates.insert(token);
+	}
       }
     }
 
     void OpenConditionManager::removeFlaw(const TokenId token){
       condDebugMsg(m_flawCandidates.find(token) != m_flawCandidates.end(), "OpenConditionManager:removeFlaw", "Removing " << token->toString() << " as a flaw.");
       m_flawCandidates.erase(token);
+      m_forcedCandidates.erase(token);
     }
 
     void OpenConditionManager::notifyRemoved(const ConstrainedVariableId variable){
@@ -68,24 +74,46 @@ OpenConditionManager::OpenConditionManager(const TiXmlElement& configData)
 	removeFlaw(variable->parent());
       else if(changeType == DomainListener::CLOSED)
 	addFlaw(variable->parent());
+      else if(changeType == DomainListener::RESTRICT_TO_SINGLETON &&
+	      m_flawCandidates.find(variable->parent()) != m_flawCandidates.end())
+	m_forcedCandidates.insert(variable->parent());
     }
 
-    DecisionPointId OpenConditionManager::nextZeroCommitmentDecision()
-    {
-    	static std::string explanation("Processing action effects first");
-
-    	for(TokenSet::const_iterator it=m_flawCandidates.begin();it != m_flawCandidates.end();++it) {
-    		TokenId token = *it;
-    		// Deal with action effects right away
-    		if (token->hasAttributes(PSTokenType::EFFECT)) {
-    		      FlawHandlerId flawHandler = getFlawHandler(token);
-    		      checkError(flawHandler.isValid(), "No flawHandler for " << token->toString());
-    		      DecisionPointId dp =  flawHandler->create(m_db->getClient(), token, explanation);
-    		      return dp;
-    		}
-    	}
-
-    	return DecisionPointId::noId();
+    /**
+     * Forced tokens are queued as they are added or restricted, so we only look at the queue
+     * rather than the whole candidate set. Action effects are dealt with right away.
+     */
+    DecisionPointId OpenConditionManager::nextZeroCommitmentDecision(){
+      static const std::string explanation("Processing action effects first");
+
+      for(TokenSet::const_iterator it = m_forcedCandidates.begin(); it != m_forcedCandidates.end(); ++it){
+	TokenId token = *it;
+	if(isForced(token))
+	  return allocateDecisionPoint(token, explanation);
+      }
+
+      return DecisionPointId::noId();
+    }
+
+    void OpenConditionManager::getZeroCommitmentDecisions(std::vector<DecisionPointId>& results){
+      static const std::string explanation("Processing action effects first");
+
+      for(TokenSet::const_iterator it = m_forcedCandidates.begin(); it != m_forcedCandidates.end(); ++it){
+	TokenId token = *it;
+	if(isForced(token))
+	  results.push_back(allocateDecisionPoint(token, explanation));
+      }
+    }
+
+    /**
+     * Action effects are not filtered dynamically, to preserve their precedence over all other flaws.
+     */
+    bool OpenConditionManager::isForced(const TokenId token){
+      checkError(m_flawCandidates.find(token) != m_flawCandidates.end(),
+		 "Forced queue out of sync with candidates for " << token->toString());
+      if(token->hasAttributes(PSTokenType::EFFECT))
+	return true;
+      return token->getState()->lastDomain().isSingleton() && !dynamicMatch(token);
     }
 
     std::string OpenConditionManager::toString(const EntityId entity) const {
@@ -23,6 +23,7 @@ namespace SOLVERS {
       virtual IteratorId createIterator();
 
       virtual DecisionPointId nextZeroCommitmentDecision();
+      virtual void getZeroCommitmentDecisions(std::vector<DecisionPointId>& results);
 
       virtual std::string toString(const EntityId entity) const;
 
@@ -37,7 +38,13 @@ namespace SOLVERS {
       void notifyRemoved(const ConstrainedVariableId variable);
       void notifyChanged(const ConstrainedVariableId variable, const DomainListener::ChangeType& changeType);
 
+      /**
+       * @brief True if the token is an action effect, or its state can only take one value.
+       */
+      bool isForced(const TokenId token);
+
       TokenSet m_flawCandidates; /*!< The set of candidate token flaws */
+      TokenSet m_forcedCandidates; /*!< Candidates queued as zero commitment flaws */
     };
   }
 }
@@ -5,6 +5,7 @@
 #include "DbClient.hh"
 #include "Debug.hh"
 #include "PlanDatabase.hh"
+#include "ConstraintEngine.hh"
 
 /**
  * @author Conor McGann
@@ -23,7 +24,8 @@ namespace EUROPA {
                                            const TiXmlElement&,
                                            const std::string& explanation)
       : DecisionPoint(client, tokenToOrder->getKey(), explanation),
-        m_tokenToOrder(tokenToOrder), m_choices(), m_choiceCount(0), m_index(0) {
+        m_tokenToOrder(tokenToOrder), m_objects(), m_objectIndex(0), m_blockObject(0),
+        m_blockOffset(0), m_choices(), m_choiceCount(0), m_index(0), m_choiceOffset(0) {
       // Here is where we would look for custom processing for configuration of the decision point
     }
 
@@ -58,36 +60,115 @@ namespace EUROPA {
 
       m_client->free(object, predecessor, successor);
       m_index++; // Advance to next choice
+
+      // Once the drawn choices are used up, release them and draw from the next objects. The plan is
+      // back in the state it was in on initialization once the relaxation is propagated.
+      if(m_index == m_choiceCount && m_objectIndex < m_objects.size()){
+        m_choices.clear();
+        m_choiceOffset = m_index;
+        if(m_client->propagate())
+          drawChoices();
+        else
+          m_objectIndex = m_objects.size();
+      }
     }
 
     bool ThreatDecisionPoint::hasNext() const {
       return m_index < m_choiceCount;
     }
 
-    class ObjectComparator {
-    public:
-      bool operator() (const std::pair<ObjectId, std::pair<TokenId, TokenId> >& p1,
-		       const std::pair<ObjectId, std::pair<TokenId, TokenId> >& p2) const {
-	ObjectId o1 = p1.first;
-	ObjectId o2 = p2.first;
-	return o1->getKey() < o2->getKey();
+    /**
+     * @brief Objects are taken in key order. Should customize orderChoices to change the ordering.
+     */
+    void ThreatDecisionPoint::handleInitialize() {
+      PlanDatabaseId db = m_tokenToOrder->getPlanDatabase();
+      if(!db->getConstraintEngine()->propagate())
+        return;
+
+      const std::map<eint, std::pair<TokenId, ObjectSet> >& tokensToOrder = db->getTokensToOrder();
+      std::map<eint, std::pair<TokenId, ObjectSet> >::const_iterator it = tokensToOrder.find(m_tokenToOrder->getKey());
+      checkError(it != tokensToOrder.end(),
+                 "Should not be ordering a token that is not in need of ordering. " << m_tokenToOrder->toString());
+      m_objects.assign(it->second.second.begin(), it->second.second.end());
+      drawChoices();
+    }
+
+    void ThreatDecisionPoint::drawChoices() {
+      m_blockObject = m_objectIndex;
+      m_blockOffset = m_choiceOffset;
+      std::vector<std::pair<TokenId, TokenId> > pairs;
+      while(m_objectIndex < m_objects.size() && (m_choices.empty() || ordersAcrossObjects())){
+        ObjectId object = m_objects[m_objectIndex++];
+        check_error(object.isValid());
+        pairs.clear();
+        object->getOrderingChoices(m_tokenToOrder, pairs);
+        for(std::vector<std::pair<TokenId, TokenId> >::const_iterator it = pairs.begin(); it != pairs.end(); ++it)
+          m_choices.push_back(std::make_pair(object, *it));
       }
-      bool operator==(const ObjectComparator&){return true;}
-    };
+      m_choiceCount = m_choiceOffset + m_choices.size();
+      orderChoices();
+      debugMsg("ThreatDecisionPoint:drawChoices", "Drew " << m_choiceCount - m_blockOffset << " choices from " <<
+               m_objectIndex - m_blockObject << " objects for " << m_tokenToOrder->getKey());
+    }
 
     /**
-     * @brief populate over all objects in the tokens object domain. Should customize to change the ordering.
+     * @brief Retain only the executed choice. Undo needs nothing else.
      */
-    void ThreatDecisionPoint::handleInitialize() {
-      m_tokenToOrder->getPlanDatabase()->getOrderingChoices(m_tokenToOrder, m_choices);
-      ObjectComparator cmp;
-      std::sort<std::vector<std::pair<ObjectId, std::pair<TokenId, TokenId> > >::iterator, ObjectComparator&>(m_choices.begin(), m_choices.end(), cmp);
-      m_choiceCount = m_choices.size();
+    bool ThreatDecisionPoint::handleCompact() {
+      if(m_choices.size() <= 1)
+        return false;
+
+      std::vector<std::pair<ObjectId, std::pair<TokenId, TokenId> > >(1, m_choices[m_index - m_choiceOffset]).swap(m_choices);
+      m_choiceOffset = m_index;
+      return true;
+    }
+
+    /**
+     * @brief Draw the released choices again from the same objects. The plan is back in the state it
+     * was in when they were first drawn, so they must come out the same.
+     */
+    void ThreatDecisionPoint::handleRestore() {
+      // Choices drawn from the next objects on undo are not compacted
+      if(hasChoice(m_index))
+        return;
+
+      checkError(m_choices.size() == 1 && m_choiceOffset < m_index,
+                 "Expected only the executed choice to be retained for " << m_tokenToOrder->getKey());
+      const std::pair<ObjectId, std::pair<TokenId, TokenId> > executed = m_choices[0];
+      const unsigned long executedIndex = m_choiceOffset;
+      const unsigned long choiceCount = m_choiceCount;
+      const unsigned long objectIndex = m_objectIndex;
+
+      m_choices.clear();
+      m_choiceOffset = m_blockOffset;
+      m_objectIndex = m_blockObject;
+      drawChoices();
+
+      checkError(m_choiceCount == choiceCount && m_objectIndex == objectIndex,
+                 "Regenerated " << m_choiceCount << " choices for " << m_tokenToOrder->getKey() <<
+                 " where there were " << choiceCount);
+      checkError(hasChoice(executedIndex) && m_choices[executedIndex - m_choiceOffset] == executed,
+                 "Choice " << executedIndex << " for " << m_tokenToOrder->getKey() <<
+                 " is not the one executed before.");
+    }
+
+    size_t ThreatDecisionPoint::getChoiceMemory() const {
+      return m_choices.capacity() * sizeof(std::pair<ObjectId, std::pair<TokenId, TokenId> >) +
+          m_objects.capacity() * sizeof(ObjectId);
+    }
+
+    bool ThreatDecisionPoint::hasChoice(unsigned long index) const {
+      return index >= m_choiceOffset && index - m_choiceOffset < m_choices.size();
     }
 
     std::string ThreatDecisionPoint::toShortString() const {
       std::stringstream os;
       
+      if(!hasChoice(m_index)) {
+        os << "THR{" << m_tokenToOrder->getKey() << " released}";
+        return os.str();
+      }
+
       ObjectId object;
       TokenId predecessor, successor;
       extractParts(m_index, object, predecessor, successor);
@@ -101,14 +182,14 @@ namespace EUROPA {
 
       std::stringstream strStream;
       strStream << "THREAT:";
-      if(!m_choices.empty())
-	strStream << "    " << toString(m_index, m_choices[m_index]) << " :" ;
+      if(hasChoice(m_index))
+	strStream << "    " << toString(m_index, m_choices[m_index - m_choiceOffset]) << " :" ;
       strStream << "    TOKEN=" << m_tokenToOrder->toString() << ":"
 		<< "    OBJECT=" << Object::toString(m_tokenToOrder->getObject()) << ":" 
 		<< "    CHOICES(current=" << m_index << "):";
 
-      for (unsigned int i = 0; i < m_choiceCount; i++)
-	strStream << i << ") " << toString(i, m_choices[i]) << ":";
+      for (unsigned long i = m_choiceOffset; i < m_choiceOffset + m_choices.size(); i++)
+	strStream << i << ") " << toString(i, m_choices[i - m_choiceOffset]) << ":";
 
       return strStream.str();
     }
@@ -126,7 +207,8 @@ namespace EUROPA {
 
   void ThreatDecisionPoint::extractParts(unsigned long index, ObjectId& object,
                                          TokenId& predecessor, TokenId& successor) const{
-    const std::pair<ObjectId, std::pair<TokenId, TokenId> >& choice = m_choices[index];
+    checkError(hasChoice(index), "Choice " << index << " is not retained for " << m_tokenToOrder->getKey());
+    const std::pair<ObjectId, std::pair<TokenId, TokenId> >& choice = m_choices[index - m_choiceOffset];
     object = choice.first;
     predecessor = choice.second.first;
     successor = choice.second.second;
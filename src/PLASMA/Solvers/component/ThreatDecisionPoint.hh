@@ -14,7 +14,8 @@ namespace SOLVERS {
 
 /**
  * @brief Defines a class for formulation, execution and retraction of token ordering
- * decisions as a means to resolve object flaws.
+ * decisions as a means to resolve object flaws. Choices are drawn one object at a time,
+ * in key order, as earlier ones are used up.
  */
 class ThreatDecisionPoint: public DecisionPoint {
  public:
@@ -33,8 +34,40 @@ class ThreatDecisionPoint: public DecisionPoint {
   virtual std::string toString() const;
   virtual std::string toShortString() const;
 
+  virtual size_t getChoiceMemory() const;
+
+  /**
+   * @brief The number of choices drawn so far.
+   */
+  unsigned long getChoiceCount() const {return m_choiceCount;}
+
  protected:
   virtual void handleInitialize();
+  virtual bool handleCompact();
+  virtual void handleRestore();
+
+  /**
+   * @brief True if the choice at the given position is retained in m_choices.
+   */
+  bool hasChoice(unsigned long index) const;
+
+  /**
+   * @brief Appends the choices of the next objects to m_choices, up to the first object with
+   * any, or all of them if ordersAcrossObjects.
+   */
+  void drawChoices();
+
+  /**
+   * @brief Orders the choices in m_choices after they are drawn. The default keeps them grouped
+   * by object in key order.
+   */
+  virtual void orderChoices() {}
+
+  /**
+   * @brief True if orderChoices mixes the choices of different objects, in which case all of them
+   * are drawn on initialization.
+   */
+  virtual bool ordersAcrossObjects() const {return false;}
 
   void extractParts(unsigned long index, ObjectId& object, TokenId& predecessor,
                     TokenId& successor) const;
@@ -43,9 +76,14 @@ class ThreatDecisionPoint: public DecisionPoint {
   bool hasNext() const;
 
   const TokenId m_tokenToOrder; /*!< The token that must be ordered */
-  std::vector< std::pair<ObjectId, std::pair<TokenId, TokenId> > > m_choices; /*!< Choices across all objects */
-  unsigned long m_choiceCount; /*!< Stored choice count - size of m_orderingChoices */
-  unsigned long m_index; /*!< Current choice position in m_orderingChoices */
+  std::vector<ObjectId> m_objects; /*!< Objects the token may be ordered on, in key order */
+  unsigned long m_objectIndex; /*!< Cursor: the number of objects drawn from */
+  unsigned long m_blockObject; /*!< The first object drawn from into m_choices */
+  unsigned long m_blockOffset; /*!< Position of the first choice drawn into m_choices in the full sequence */
+  std::vector< std::pair<ObjectId, std::pair<TokenId, TokenId> > > m_choices; /*!< Drawn choices not yet released */
+  unsigned long m_choiceCount; /*!< Number of choices drawn so far */
+  unsigned long m_index; /*!< Current choice position in the full sequence */
+  unsigned long m_choiceOffset; /*!< Position of m_choices[0] in the full sequence */
 
  private:
   virtual void handleExecute();
@@ -27,7 +27,7 @@ namespace SOLVERS {
  * @see ComponentFactory
  */
 UnboundVariableManager::UnboundVariableManager(const TiXmlElement& configData)
-    : FlawManager(configData), m_flawCandidates() {}
+    : FlawManager(configData), m_flawCandidates(), m_singletonCandidates() {}
 
     void UnboundVariableManager::handleInitialize(){
 
@@ -40,10 +40,38 @@ UnboundVariableManager::UnboundVariableManager(const TiXmlElement& configData)
 
     }
 
+    /**
+     * Singleton candidates are queued as their domains are restricted, so we only look at the queue
+     * rather than the whole candidate set.
+     */
     DecisionPointId UnboundVariableManager::nextZeroCommitmentDecision(){
+      static const std::string explanation("Binding singleton variables first");
+
+      for(ConstrainedVariableSet::const_iterator it = m_singletonCandidates.begin(); it != m_singletonCandidates.end(); ++it){
+        ConstrainedVariableId var = *it;
+        if(isForced(var))
+          return allocateDecisionPoint(var, explanation);
+      }
+
       return DecisionPointId::noId();
     }
 
+    void UnboundVariableManager::getZeroCommitmentDecisions(std::vector<DecisionPointId>& results){
+      static const std::string explanation("Binding singleton variables first");
+
+      for(ConstrainedVariableSet::const_iterator it = m_singletonCandidates.begin(); it != m_singletonCandidates.end(); ++it){
+        ConstrainedVariableId var = *it;
+        if(isForced(var))
+          results.push_back(allocateDecisionPoint(var, explanation));
+      }
+    }
+
+    bool UnboundVariableManager::isForced(const ConstrainedVariableId var){
+      checkError(m_flawCandidates.find(var) != m_flawCandidates.end(),
+                 "Singleton queue out of sync with candidates for " << var->toString());
+      return var->lastDomain().isSingleton() && !dynamicMatch(var);
+    }
+
     /**
      * Filter out if not a variable
      */
@@ -82,6 +110,7 @@ UnboundVariableManager::UnboundVariableManager(const TiXmlElement& configData)
     void UnboundVariableManager::updateFlaw(const ConstrainedVariableId var){
       debugMsg("UnboundVariableManager:updateFlaw", var->toLongString());
       m_flawCandidates.erase(var);
+      m_singletonCandidates.erase(var);
 
       if(variableOfNonActiveToken(var) || !var->canBeSpecified() || var->isSpecified() || staticMatch(var)){
         debugMsg("UnboundVariableManager:updateFlaw", "Excluding  " << var->toLongString());
@@ -95,6 +124,11 @@ UnboundVariableManager::UnboundVariableManager(const TiXmlElement& configData)
 	       "Including " << var->getKey() << ". " << var->toString() << " as a candidate flaw.");
 
       m_flawCandidates.insert(var);
+
+      if(var->lastDomain().isSingleton()){
+        debugMsg("UnboundVariableManager:addFlaw", "Queueing " << var->getKey() << " as a zero commitment flaw.");
+        m_singletonCandidates.insert(var);
+      }
     }
 
     void UnboundVariableManager::removeFlaw(const ConstrainedVariableId var){
@@ -103,6 +137,7 @@ UnboundVariableManager::UnboundVariableManager(const TiXmlElement& configData)
 		   "Removing " << var->getKey() << ". " << var->toString() << " as a flaw.");
 
       m_flawCandidates.erase(var);
+      m_singletonCandidates.erase(var);
     }
 
     bool UnboundVariableManager::variableOfNonActiveToken(const ConstrainedVariableId var){
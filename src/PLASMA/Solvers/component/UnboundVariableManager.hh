@@ -17,6 +17,7 @@ class UnboundVariableManager: public FlawManager {
   UnboundVariableManager(const TiXmlElement& configData);
 
   DecisionPointId nextZeroCommitmentDecision();
+  void getZeroCommitmentDecisions(std::vector<DecisionPointId>& results);
 
   bool staticMatch(const EntityId entity);
   bool dynamicMatch(const EntityId entity);
@@ -42,7 +43,13 @@ class UnboundVariableManager: public FlawManager {
   static bool variableOfNonActiveToken(const ConstrainedVariableId var);
 
 
+  /**
+   * @brief True if the candidate is restricted to a single value and may be bound without commitment.
+   */
+  bool isForced(const ConstrainedVariableId var);
+
   ConstrainedVariableSet m_flawCandidates; /*!< All variables that have passed the static filter */
+  ConstrainedVariableSet m_singletonCandidates; /*!< Candidates whose derived domain is a singleton */
 };
 }
 }
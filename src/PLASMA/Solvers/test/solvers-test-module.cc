@@ -1,6 +1,7 @@
 #include "solvers-test-module.hh"
 //#include "Nddl.hh"
 #include "Solver.hh"
+#include "SearchProfiler.hh"
 #include "ComponentFactory.hh"
 #include "Constraint.hh"
 #include "ConstraintType.hh"
@@ -1621,10 +1622,167 @@ public:
     EUROPA_runTest(testDeleteAfterCommit);
     EUROPA_runTest(testSingleonGuardLoop);
     EUROPA_runTest(testNoMoreFlawsAfterAddition);
+    EUROPA_runTest(testProfiler);
+    EUROPA_runTest(testBoundedStackMemory);
+    EUROPA_runTest(testLazyThreatChoices);
+    EUROPA_runTest(testDrainZeroCommitment);
     return true;
   }
 
 private:
+  static unsigned int solveSimpleActivation(size_t maxStackMemory, unsigned long& depth) {
+    TestEngine testEngine;
+    TiXmlElement* root = initXml((getTestLoadLibraryPath() + "/SolverTests.xml").c_str(), "SimpleActivationSolver");
+    TiXmlElement* child = root->FirstChildElement();
+    unsigned int stepCount = 0;
+    {
+      CPPUNIT_ASSERT(testEngine.playTransactions((getTestLoadLibraryPath() + "/SimpleActivation.nddl").c_str()));
+      Solver solver(testEngine.getPlanDatabase(), *child);
+      solver.setMaxStackMemory(maxStackMemory);
+      ContextId ctx = solver.getContext();
+      ctx->put("horizonStart", 0);
+      ctx->put("horizonEnd", 1000);
+
+      CPPUNIT_ASSERT(solver.solve());
+      stepCount = solver.getStepCount();
+      depth = solver.getDepth();
+    }
+    delete root;
+    return stepCount;
+  }
+
+  static bool testBoundedStackMemory() {
+    unsigned long depth = 0;
+    unsigned long boundedDepth = 0;
+    unsigned int stepCount = solveSimpleActivation(0, depth);
+    unsigned int boundedStepCount = solveSimpleActivation(1, boundedDepth);
+    CPPUNIT_ASSERT_MESSAGE(toString(boundedStepCount) + " != " + toString(stepCount), boundedStepCount == stepCount);
+    CPPUNIT_ASSERT(boundedDepth == depth);
+    return true;
+  }
+
+  /**
+   * @brief Ordering choices are drawn one object at a time, and a compacted decision resumes
+   * on the same choice.
+   */
+  static bool testLazyThreatChoices() {
+    TestEngine testEngine(true);
+    testEngine.getSchema()->addPredicate("A.Foo");
+    PlanDatabaseId db = testEngine.getPlanDatabase();
+    DbClientId client = db->getClient();
+    Timeline o1(db, "A", "o1");
+    Timeline o2(db, "A", "o2");
+    db->close();
+
+    IntervalToken tok1(db, "A.Foo", false, false, IntervalIntDomain(10, 10), IntervalIntDomain(20, 20),
+                       IntervalIntDomain(10, 10), "o1");
+    client->activate(tok1.getId());
+    client->constrain(o1.getId(), tok1.getId(), tok1.getId());
+
+    IntervalToken tok2(db, "A.Foo", false, false, IntervalIntDomain(10, 10), IntervalIntDomain(20, 20),
+                       IntervalIntDomain(10, 10), "o2");
+    client->activate(tok2.getId());
+    client->constrain(o2.getId(), tok2.getId(), tok2.getId());
+
+    IntervalToken flawedToken(db, "A.Foo", false, false, IntervalIntDomain(0, 100), IntervalIntDomain(0, 100),
+                              IntervalIntDomain(1, 10));
+    client->activate(flawedToken.getId());
+    CPPUNIT_ASSERT(client->propagate());
+
+    std::vector<std::pair<TokenId, TokenId> > o1Choices, o2Choices;
+    o1.getOrderingChoices(flawedToken.getId(), o1Choices);
+    o2.getOrderingChoices(flawedToken.getId(), o2Choices);
+    CPPUNIT_ASSERT(!o1Choices.empty() && !o2Choices.empty());
+
+    TiXmlElement dummy("");
+    SOLVERS::ThreatDecisionPoint dp(client, flawedToken.getId(), dummy);
+    DecisionPoint& decision = dp;
+    dp.initialize();
+    CPPUNIT_ASSERT(dp.getChoiceCount() == o1Choices.size());
+
+    unsigned long executed = 0;
+    while(decision.hasNext()) {
+      decision.execute();
+      std::string choice = dp.toShortString();
+      CPPUNIT_ASSERT_MESSAGE(choice, choice.find(executed < o1Choices.size() ? "o1" : "o2") != std::string::npos);
+
+      // Released choices are drawn again on the next execute
+      decision.compact();
+      decision.undo();
+      CPPUNIT_ASSERT(client->propagate());
+      executed++;
+    }
+    CPPUNIT_ASSERT(executed == o1Choices.size() + o2Choices.size());
+    CPPUNIT_ASSERT(dp.getChoiceCount() == o1Choices.size() + o2Choices.size());
+
+    return true;
+  }
+
+  static unsigned int solveWithSingletons(bool drain, unsigned long& depth) {
+    TestEngine testEngine;
+    TiXmlElement* root = initXml((getTestLoadLibraryPath() + "/SolverTests.xml").c_str(), "SimpleCSPSolver");
+    TiXmlElement* child = root->FirstChildElement();
+    unsigned int stepCount = 0;
+    {
+      CPPUNIT_ASSERT(testEngine.playTransactions((getTestLoadLibraryPath() + "/StaticCSP.nddl").c_str()));
+      DbClientId client = testEngine.getPlanDatabase()->getClient();
+      for(int i = 0; i < 4; i++)
+        client->createVariable("int", IntervalIntDomain(i, i), "s" + toString(i));
+
+      Solver solver(testEngine.getPlanDatabase(), *child);
+      solver.setDrainZeroCommitment(drain);
+      CPPUNIT_ASSERT(solver.solve());
+      CPPUNIT_ASSERT(solver.noMoreFlaws());
+      stepCount = solver.getStepCount();
+      depth = solver.getDepth();
+    }
+    delete root;
+    return stepCount;
+  }
+
+  /**
+   * @brief Forced decisions taken in bulk should reach the same depth in fewer steps.
+   */
+  static bool testDrainZeroCommitment() {
+    unsigned long depth = 0;
+    unsigned long drainedDepth = 0;
+    unsigned int stepCount = solveWithSingletons(false, depth);
+    unsigned int drainedStepCount = solveWithSingletons(true, drainedDepth);
+    CPPUNIT_ASSERT(stepCount == depth);
+    CPPUNIT_ASSERT(drainedDepth == depth);
+    CPPUNIT_ASSERT_MESSAGE(toString(drainedStepCount) + " >= " + toString(stepCount), drainedStepCount < stepCount);
+    return true;
+  }
+
+  static bool testProfiler() {
+    TestEngine testEngine;
+    testEngine.getConfig()->setProperty("Solver.profile", "SolverProfile");
+    TiXmlElement* root = initXml( (getTestLoadLibraryPath() + "/SolverTests.xml").c_str(), "SimpleCSPSolver");
+    TiXmlElement* child = root->FirstChildElement();
+    {
+      CPPUNIT_ASSERT(testEngine.playTransactions((getTestLoadLibraryPath() + "/SuccessfulSearch.nddl").c_str()));
+      Solver solver(testEngine.getPlanDatabase(), *child);
+      SearchProfiler* profiler = solver.getProfiler();
+      CPPUNIT_ASSERT(profiler != NULL);
+      CPPUNIT_ASSERT(solver.solve());
+
+      const SearchProfiler::Entries& phases = profiler->getEntries(SearchProfiler::PHASE);
+      CPPUNIT_ASSERT(phases.find("solve") != phases.end());
+      CPPUNIT_ASSERT(phases.find("solve")->second.count == 1);
+      CPPUNIT_ASSERT(phases.find("execute")->second.count == solver.getStepCount());
+      CPPUNIT_ASSERT(!profiler->getEntries(SearchProfiler::DECISION).empty());
+      CPPUNIT_ASSERT(!profiler->getEntries(SearchProfiler::HANDLER).empty());
+      CPPUNIT_ASSERT(!profiler->getStacks().empty());
+
+      std::ifstream json("SolverProfile.json");
+      CPPUNIT_ASSERT(json.good());
+      std::ifstream folded("SolverProfile.folded");
+      CPPUNIT_ASSERT(folded.good());
+    }
+    delete root;
+    return true;
+  }
+
   static bool testNoMoreFlawsAfterAddition() {
     TestEngine testEngine;
     TiXmlElement* root = initXml( (getTestLoadLibraryPath() + "/SolverTests.xml").c_str(), "SingletonLoop");
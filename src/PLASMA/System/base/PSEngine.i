@@ -560,6 +560,10 @@ namespace EUROPA {
     PSResourceProfile* getFDLevels();
     PSResourceProfile* getVDLevels();
 
+    double getMinUsage(TimePoint start, TimePoint end);
+    double getMaxUsage(TimePoint start, TimePoint end);
+    TimePoint getFirstTimeUsageBelow(double level, TimePoint from, bool necessarily);
+
     PSList<PSEntityKey> getOrderingChoices(TimePoint t);
 
     static PSResource* asPSResource(PSObject* obj);
@@ -607,6 +611,10 @@ namespace EUROPA {
       void close(PSVariable* variable) = 0;
       void close(const std::string& objectType) = 0;
       void close() = 0;
+
+      void beginBulkLoad() = 0;
+      bool endBulkLoad() = 0;
+      void abandonBulkLoad() = 0;
   };
 
 // generate directors for all virtual methods in class Foo